@@ -3,6 +3,7 @@
 
 #include "boundarysettings.hpp"
 
+#include <cstddef>
 #include <random>
 #include <unordered_map>
 #include <vector>
@@ -101,6 +102,53 @@ namespace mythical {
          */
         std::unordered_map<int, std::unordered_map<int, double>> getNeighborDistances(const double cutoff) const;
 
+        /**
+         * @brief Get Neighbor Distances within cutoff for the whole lattice
+         * as compressed sparse row arrays
+         *
+         * The offsets within the cutoff are worked out once and the z planes
+         * of the lattice are filled in in parallel, which is much faster than
+         * the map version for large lattices. Every neighbor of a site is
+         * listed in the row of that site, so once the distances have been
+         * turned into rates the arrays can be passed straight to
+         * CoarseGrainSystem::initializeSystem. If several periodic images of
+         * a site are within the cutoff only the closest one is kept.
+         *
+         * @param cutoff
+         * @param row_offsets - one more value than there are sites, the
+         * neighbors of site i are stored between row_offsets[i] and
+         * row_offsets[i+1]
+         * @param neighbor_ids
+         * @param distances
+         * @param thread_count - 0 uses one thread per hardware thread
+         */
+        void getNeighborDistances(const double cutoff,
+            std::vector<size_t> & row_offsets,
+            std::vector<int> & neighbor_ids,
+            std::vector<double> & distances,
+            const size_t thread_count = 0) const;
+
+        /**
+         * @brief Get Neighbor Distances within cutoff for the sites of a
+         * single z plane
+         *
+         * Fills in the rows of the sites with z coordinate **z**, in the
+         * same order and with the same neighbors as the compressed sparse
+         * row version above. Lets the rows of a large lattice be worked out
+         * and used a plane at a time.
+         *
+         * @param z - the plane, sites are visited in order of their index
+         * @param cutoff
+         * @param counts - number of neighbors of each site of the plane
+         * @param neighbor_ids
+         * @param distances
+         */
+        void getPlaneNeighborDistances(const int z,
+            const double cutoff,
+            std::vector<size_t> & counts,
+            std::vector<int> & neighbor_ids,
+            std::vector<double> & distances) const;
+
         /**
          * @brief Get the distance between two sites
          *
@@ -147,6 +195,17 @@ namespace mythical {
 
         std::vector<std::pair<int,double>> getNeighborDistances_(const std::vector<int> lattice_pos, const double cutoff) const;
 
+        /**
+         * Position along an axis of every site shifted by every offset of the
+         * stencil, offsets that leave a fixed boundary are set to -1.
+         * Positions are multiplied by stride so they can be summed into an
+         * index.
+         */
+        std::vector<int> getShiftedPositions_(const int size,
+            const BoundarySetting bound,
+            const int reach,
+            const int stride) const;
+
 
     };
   }
@@ -0,0 +1,55 @@
+#ifndef MYTHICAL_CHARGE_TRANSPORT_RATE_FILE_HPP
+#define MYTHICAL_CHARGE_TRANSPORT_RATE_FILE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mythical {
+
+  namespace charge_transport {
+
+    class Cuboid;
+    class Marcus;
+
+    /**
+     * @brief Write the Marcus rates between the sites of a lattice to a
+     * rate file
+     *
+     * Every pair of sites within the cutoff is connected in both
+     * directions, the neighbors of each site are stored in order of their
+     * index. The rows are found a z plane at a time with
+     * Cuboid::getPlaneNeighborDistances and streamed to the file, the rates
+     * are worked out in blocks with Marcus::getRates. As the file stores
+     * all the neighbor ids before all the rates each plane is visited once
+     * for the row offsets, once for the neighbor ids and once for the rates,
+     * only the row offsets are held for the whole lattice. The positions of
+     * the sites, scaled by the lattice spacing, and their energies are
+     * stored as well. The file can be loaded with
+     * CoarseGrainSystem::initializeSystemFromFile, see RateFileWriter for
+     * its layout.
+     *
+     * @param file_name
+     * @param lattice
+     * @param marcus
+     * @param energies - The energy of each site of the lattice in order of
+     * the site index [ eV ]
+     * @param cutoff - Largest distance between sites connected by a rate
+     * @param coupling - Electronic coupling H_AB between two sites given the
+     * distance between them
+     * @param thread_count - Number of planes worked out at once, 0 uses one
+     * thread per hardware thread
+     */
+    void writeRateFile(const std::string & file_name,
+        const Cuboid & lattice,
+        const Marcus & marcus,
+        const std::vector<double> & energies,
+        const double cutoff,
+        const std::function<double(const double)> & coupling,
+        const size_t thread_count = 0);
+
+  }
+}
+
+#endif // MYTHICAL_CHARGE_TRANSPORT_RATE_FILE_HPP
@@ -1,26 +1,34 @@
 #ifndef MYTHICAL_COARSEGRAINSYSTEM_HPP
 #define MYTHICAL_COARSEGRAINSYSTEM_HPP
 
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <string>
 #include <unordered_set>
 #include <unordered_map>
 #include <memory>
 #include <vector>
 
 #include "constants.hpp"
-
-namespace ugly {
-template <typename... Ts>
-class Graph;
-}
+#include "random_policy.hpp"
 
 namespace mythical {
 
 class Site_Container;
+class BasinExplorer;
+class Binary_Reader;
+class Binary_Writer;
+class Basin_Graph;
 class Cluster_Container;
+class EventLog;
+class Random_Stream;
+class Rate_Graph;
+class IndexedQueue;
 class TopologyFeature;
 
 class Walker;
+class WalkerPool;
 
 /**
  * \brief Coarse Grain System allows abstraction of renormalization of sites
@@ -49,10 +57,9 @@ class CoarseGrainSystem {
   /**
    * \brief This will correctly initialize the system
    *
-   * Essentially pointers to all the rates are stored in this class. Pointers
-   * are used in case any of the rates are changed, there will be no need to
-   * pass them back into the couse grain object. An updated function could
-   * simply be called. This function must be called before the walkers can
+   * The rates are copied into a single compressed sparse row store that is
+   * shared by all the sites, so the map can be discarded once the system has
+   * been initialized. This function must be called before the walkers can
    * be initialized `initializeWalkerss` and before a hopping event is called
    * on a walker `hop`.
    *
@@ -96,7 +103,126 @@ class CoarseGrainSystem {
    *
    * Where each of the rateFrom variables is a double
    **/
-  void initializeSystem(std::unordered_map<int, std::unordered_map<int, double>> &ratesOfAllSites);
+  void initializeSystem(const std::unordered_map<int, std::unordered_map<int, double>> &ratesOfAllSites);
+
+  /**
+   * \brief Initialize the system from compressed sparse row arrays
+   *
+   * Avoids building the map of maps for large systems. The site ids are
+   * given by the row, so the rates off of site i are stored in neighbor_ids
+   * and rates between row_offsets[i] and row_offsets[i+1]. Using the example
+   * above with the sites renumbered from 0:
+   *
+   * row_offsets  = { 0, 3, 5, 6, 7, 8 };
+   * neighbor_ids = { 1, 3, 4, 0, 2, 1, 0, 0 };
+   * rates        = { rateFrom0to1, rateFrom0to3, rateFrom0to4, ... };
+   *
+   * Neighbor ids that do not have a row of their own are treated as drains.
+   *
+   * \param[in] row_offsets one more value than there are sites, starting at 0
+   * \param[in] neighbor_ids the ids of the neighbors of each site
+   * \param[in] rates the rates to each of the neighbors
+   **/
+  void initializeSystem(
+      std::vector<size_t> row_offsets,
+      std::vector<int> neighbor_ids,
+      std::vector<double> rates);
+
+  /**
+   * \brief Initialize the system from a rate file
+   *
+   * See RateFileWriter for the layout of the file. The file is memory mapped
+   * where the platform allows it and, if the neighbors of each row are in
+   * ascending order as charge_transport::writeRateFile stores them, its
+   * arrays are used in place and the file stays mapped for as long as the
+   * system needs the rates. Otherwise the arrays are copied and sorted. The
+   * sites are seeded in the order of the rows of the file.
+   *
+   * \param[in] file_name
+   **/
+  void initializeSystemFromFile(const std::string & file_name);
+
+  /**
+   * \brief Initialize the system with the rates of another system
+   *
+   * The rates are shared rather than copied, they are only ever read so the
+   * two systems can be used from different threads. The sites, clusters,
+   * walkers and random numbers of each system remain separate. The time
+   * resolution and random seed must be set beforehand as usual, the sites
+   * are seeded in the order they are stored in the other system.
+   *
+   * \param[in] system an initialized system providing the rates
+   **/
+  void initializeSystem(const CoarseGrainSystem & system);
+
+  /**
+   * \brief Write the state of the system to a binary snapshot
+   *
+   * The snapshot holds everything needed to carry on as if the run had not
+   * been interrupted: the settings, the rates, the occupation, visits and
+   * random numbers of every site, the clusters with their stationary
+   * probabilities, resolutions and visits, the iteration counters and the
+   * number of steps taken by each walker. If a pool is passed in its
+   * walkers are written as well. Walkers stored as std::shared_ptr<Walker>
+   * must be saved by the caller.
+   *
+   * The file starts with the characters MYTHSNAP, a version number and a
+   * byte order mark, the values that follow are in the byte order of the
+   * machine.
+   **/
+  void saveSnapshot(const std::string & file_name);
+  void saveSnapshot(const std::string & file_name, const WalkerPool & walkers);
+
+  /**
+   * \brief Restore the state written by saveSnapshot
+   *
+   * Must be called instead of initializeSystem, every setting including the
+   * time resolution and random seed is taken from the snapshot. The clusters
+   * are restored without exploring basins or solving the master equation
+   * again. The file is memory mapped where the platform allows it. Throws if
+   * the file is not a snapshot, was written by a newer version, or is
+   * truncated, in which case the system is left uninitialized.
+   *
+   * \param[in] file_name
+   * \param[out] walkers replaced by the walkers stored in the snapshot,
+   * throws if the snapshot does not contain any
+   **/
+  void loadSnapshot(const std::string & file_name);
+  void loadSnapshot(const std::string & file_name, WalkerPool & walkers);
+
+  /**
+   * \brief Key identifying the inputs the clusters depend on
+   *
+   * A hash of the rates, the time resolution, the performance ratio and the
+   * minimum coarse graining resolution. The clusters found do not depend on
+   * the walkers or the random seed, so systems with the same key can share
+   * them.
+   **/
+  uint64_t getClusterCacheKey() const;
+
+  /**
+   * \brief Write the clusters found so far to a cluster cache
+   *
+   * Only the parts of the clusters that depend on the rates are written,
+   * their visits and random numbers are not. The file starts with the
+   * characters MYTHCLST and is tagged with getClusterCacheKey.
+   **/
+  void exportClusters(const std::string & file_name) const;
+
+  /**
+   * \brief Start with the clusters of a cluster cache
+   *
+   * Must be called after initializeSystem and before any clusters have
+   * formed, typically in a new run on the same energy landscape with a
+   * different seed. The walkers then do not have to rattle around the traps
+   * until the clusters are found again. The clusters start without visits
+   * and are seeded from the random seed of this system.
+   *
+   * Throws if the cache was written for a different key, if clusters have
+   * already formed, or if a cached cluster contains a site excluded from
+   * clusters, in which case no clusters are added.
+   **/
+  void importClusters(const std::string & file_name);
 
   /**
    * \brief Initialize walker dwell times and future hop site id
@@ -111,16 +237,49 @@ class CoarseGrainSystem {
    **/
   void initializeWalkers(std::vector<std::pair<int,std::shared_ptr<Walker>>>& walkers);
 
+  /**
+   * \brief Initialize the walkers stored in a pool
+   *
+   * Same as above, the absolute time of each walker is advanced by its dwell
+   * time and the walker is added to the event queue of the pool. Walkers that
+   * are already active are skipped, so walkers can be added to the pool and
+   * initialized later on.
+   *
+   * \param[in,out] walkers
+   **/
+  void initializeWalkers(WalkerPool & walkers);
+
+  /**
+   * \brief Initialize a single walker of the pool
+   *
+   * Unlike initializeWalkers the other inactive walkers of the pool are left
+   * alone, which allows the walkers of a pool to be shared out between
+   * several systems. Throws if the walker is already active.
+   **/
+  void initializeWalker(WalkerPool & walkers, const int walker_id);
+
   /**
    * \brief Define the seed for the random number generator
    *
    * This allows the user to create reproducable results if desired. By
-   * default the seed will be determined from the time.
+   * default the seed will be determined from the time. What is reproduced
+   * depends on the random policy, see RandomPolicy. Must be called before
+   * `initializeSystem`.
    *
    * \param[in] seed
    **/
   void setRandomSeed(const unsigned long seed);
 
+  /**
+   * \brief Choose the random number generator used by the sites and clusters
+   *
+   * By default the counter based generator is used. Must be called before
+   * `initializeSystem`.
+   *
+   * \param[in] policy
+   **/
+  void setRandomPolicy(const RandomPolicy policy);
+
   /**
    * \brief Make the walker hop to a site in the system
    *
@@ -136,11 +295,83 @@ class CoarseGrainSystem {
   void hop(int walker_id, std::shared_ptr<Walker>& walker);
   //void hop(Walker& walker);
 
+  /**
+   * \brief Called after every hop made by the batched hop
+   *
+   * Receives the walker id, the id of the site the walker occupied before the
+   * hop, the walker and the absolute time of its next hop. Returning false
+   * removes the walker from the event queue and from the system.
+   **/
+  typedef std::function<bool(const int, const int, Walker &, const double)> HopCallback;
+
+  /**
+   * \brief Hop all walkers whose next event falls before the time horizon
+   *
+   * The event queue holds the absolute time of the next hop of each walker
+   * keyed by the walker id, every walker in the queue must be in walkers.
+   * The walker with the earliest time is hopped, its time is advanced by its
+   * new dwell time and it is rescheduled. This is repeated until the
+   * earliest time in the queue is at or after the time horizon, so a whole
+   * sampling interval is handled by a single call.
+   *
+   * \param[in] walkers the walkers and their ids
+   * \param[in,out] event_queue absolute time of the next hop of each walker
+   * \param[in] time_horizon walkers are not hopped at or past this time
+   * \param[in] callback optional, see HopCallback
+   *
+   * \return the number of hops made
+   **/
+  size_t hop(
+      std::vector<std::pair<int,std::shared_ptr<Walker>>>& walkers,
+      IndexedQueue & event_queue,
+      const double time_horizon,
+      const HopCallback & callback = HopCallback());
+
+  /// Make a walker stored in the pool hop, its absolute time is advanced by
+  /// the new dwell time
+  void hop(WalkerPool & walkers, const int walker_id);
+
+  /**
+   * \brief Called after every hop made by the batched hop of a WalkerPool
+   *
+   * Receives the walker id and the id of the site the walker occupied before
+   * the hop. Returning false removes the walker from the system.
+   **/
+  typedef std::function<bool(const int, const int)> WalkerPoolHopCallback;
+
+  /**
+   * \brief Hop the walkers of the pool until the time horizon is reached
+   *
+   * Same as the batched hop above but uses the event queue of the pool.
+   *
+   * \return the number of hops made
+   **/
+  size_t hop(
+      WalkerPool & walkers,
+      const double time_horizon,
+      const WalkerPoolHopCallback & callback = WalkerPoolHopCallback());
+
+  /**
+   * \brief Record every hop made by the system in an event log
+   *
+   * Each hop is recorded with the walker id, the sites it hopped from and
+   * to, the absolute time of the hop and whether the walker was on a
+   * cluster. Walkers hopped with the single walker overloads that take a
+   * Walker do not carry an absolute time, the time recorded for them is
+   * the sum of their dwell times since the log was set. Pass nullptr to
+   * stop recording, by default nothing is recorded. The log is not copied
+   * by initializeSystem or kept in a snapshot.
+   *
+   * \param[in] event_log may be shared with systems hopping on other threads
+   **/
+  void setEventLog(std::shared_ptr<EventLog> event_log);
+
   /**
    * \brief Remove the walker from the system
    **/
   void removeWalkerFromSystem(std::pair<int,std::shared_ptr<Walker>>& walker);
   void removeWalkerFromSystem(const int walker_id,std::shared_ptr<Walker>& walker);
+  void removeWalkerFromSystem(WalkerPool & walkers, const int walker_id);
 
   /**
    * \brief Determine if the site is part of a cluster
@@ -154,6 +385,28 @@ class CoarseGrainSystem {
    **/
   int getClusterIdOfSite(const int siteId);
 
+  /// Whether a walker occupies the site, or it has been marked as occupied
+  bool isSiteOccupied(const int siteId);
+
+  /**
+   * \brief Mark a site as occupied or vacant without a walker
+   *
+   * Walkers cannot hop onto an occupied site. This is used to represent
+   * walkers that are simulated by another system, e.g. near the boundary of
+   * a domain. The site must not be part of a cluster and should not be
+   * occupied by a walker of this system.
+   **/
+  void setSiteOccupied(const int siteId, const bool occupied);
+
+  /**
+   * \brief Prevent sites from being coarse grained
+   *
+   * A cluster is never formed or grown if it would contain one of the sites.
+   * Can only be called once the system has been initialized and the sites
+   * must not already be part of a cluster.
+   **/
+  void excludeSitesFromClusters(const std::vector<int> & siteIds);
+
   int getVisitFrequencyOfSite(const int siteId);
 
   /**
@@ -179,6 +432,30 @@ class CoarseGrainSystem {
    */
   std::unordered_map<int,std::vector<int>> getClusters();
 
+  /**
+   * \brief Look for traps across the whole system and coarse grain them
+   *
+   * Clusters are otherwise only formed around the site a walker has just
+   * hopped to, after the walkers have rattled around a trap for a while.
+   * Here a basin is grown from every site, using the same BasinExplorer and
+   * the same conditions as while hopping, so the traps are coarse grained
+   * before the first hop. As while hopping, basins grown from the sites of a
+   * cluster can reach further, so this is repeated from the sites of the
+   * clusters until no more sites are added. The basins are found in
+   * parallel, the clusters are then formed one basin at a time in order of
+   * the site they were grown from, so the result does not depend on the
+   * number of threads.
+   *
+   * Must be called after the system has been initialized. Does nothing if
+   * coarse graining has been turned off with
+   * setMinCoarseGrainIterationThreshold(constants::inf_iterations).
+   *
+   * \param[in] thread_count 0 uses one thread per hardware thread
+   *
+   * \return the number of basins that were coarse grained
+   **/
+  size_t coarseGrainTraps(const size_t thread_count = 0);
+
   std::unordered_map<int,double> getResolutionOfClusters();
   std::unordered_map<int,double> getTimeIncrementOfClusters();
   /**
@@ -191,6 +468,31 @@ class CoarseGrainSystem {
   double getTimeResolution();
   void setTimeResolution(const double time_resolution);
 
+  /**
+   * \brief Let walkers leave clusters in a single event
+   *
+   * When sampling the simulation coarsely the hops a walker makes within a
+   * cluster before leaving it are not needed. With direct exit a walker on a
+   * cluster is given the whole escape time at once and its next hop takes it
+   * to a neighbor of the cluster. Until then it stays on the site through
+   * which it entered the cluster, see sampleOccupiedSite. Applies to the
+   * existing clusters and the ones created afterwards. Off by default.
+   **/
+  void setDirectClusterExit(const bool direct_exit);
+  bool getDirectClusterExit() const { return direct_cluster_exit_; }
+
+  /**
+   * \brief Draw the site a walker occupies before its next hop
+   *
+   * If the site is part of a cluster that walkers exit directly, a site of
+   * the cluster is drawn from the fraction of time spent on each of them.
+   * Otherwise the site passed in is returned. The numbers are drawn from a
+   * separate stream so the walkers are not affected.
+   *
+   * \param[in] siteId the site the walker currently occupies
+   **/
+  int sampleOccupiedSite(const int siteId);
+
   /**
    * @brief Adjusts how easy it is to create a cluster.
    *
@@ -217,6 +519,9 @@ class CoarseGrainSystem {
     performance_ratio_ = performance_ratio;
   }
  private:
+  /// Reads the sites and random numbers while speculating
+  friend class OptimisticScheduler;
+
   /// Performance ratio
   double performance_ratio_;
 
@@ -226,6 +531,29 @@ class CoarseGrainSystem {
   /// The random seed
   unsigned long seed_;
 
+  /// Random number generator used by the sites and clusters
+  RandomPolicy random_policy_;
+
+  /// Walkers leave clusters in a single event
+  bool direct_cluster_exit_;
+
+  /// Id given to the next cluster created by this system
+  int next_cluster_id_;
+
+  /// Used by sampleOccupiedSite, created when first needed
+  std::unique_ptr<Random_Stream> observer_stream_;
+
+  /// Number of hops made by each walker, used to key the random numbers.
+  /// Indexed by the walker id like the arrays of WalkerPool and kept when a
+  /// walker is removed in case the id is reused.
+  std::vector<uint64_t> walker_steps_;
+
+  /// Records the hops if set
+  std::shared_ptr<EventLog> event_log_;
+  /// Time of the last hop recorded for each walker id, only used by the
+  /// hops of walkers that do not carry an absolute time
+  std::unordered_map<int,double> walker_clocks_;
+
   bool time_resolution_set_;
   /// The resolution of the clusters. Essentially how many hops will a walker
   /// move within the cluster before it is likely to leave, the point of this
@@ -249,13 +577,76 @@ class CoarseGrainSystem {
   /// The iteration threshold is reset to the min value if a cluster is found
   int iteration_threshold_min_;
 
-  std::unordered_map<int, TopologyFeature *> topology_features_;
+  /// Indexed by the dense site index of the Site_Container
+  std::vector<TopologyFeature *> topology_features_;
+
+  /// Indexed like topology_features_, empty if no sites are excluded
+  std::vector<bool> excluded_from_clusters_;
   /// Stores smart pointers to all the sites
   std::unique_ptr<Site_Container> sites_;
 
+  /// Contiguous storage of the rates between all the sites
+  std::shared_ptr<Rate_Graph> rate_graph_;
+
+  /// Kept so that their buffers are reused every time coarse graining is
+  /// attempted
+  std::unique_ptr<BasinExplorer> basin_explorer_;
+  std::unique_ptr<Basin_Graph> basin_graph_;
+
   /// Stores smart pointers to all the clusters
   std::unique_ptr<Cluster_Container> clusters_;
 
+  /// Creates a site for every row of the rate graph, the sites are seeded in
+  /// the order provided
+  void initializeSitesFromRateGraph_(const int * seed_order,
+      const size_t seed_count);
+
+  /// Write or read everything except the walkers of a pool
+  void saveSnapshot_(Binary_Writer & writer);
+  void loadSnapshot_(Binary_Reader & reader);
+
+  /// Discard the sites and clusters after a snapshot failed to load
+  void resetSystem_();
+
+  /// Seed a site or cluster according to the random policy
+  void seedTopologyFeature_(TopologyFeature & feature, const uint64_t stream_id);
+
+  /// Makes room in walker_steps_ for the walker, throws if the id is negative
+  void registerWalkerStep_(const int walker_id);
+
+  /// Set the dwell time and the potential site of the walker
+  void drawNextHop_(TopologyFeature & feature, const int walker_id, Walker & walker);
+  void drawNextHop_(
+      TopologyFeature & feature,
+      const int walker_id,
+      double & dwell_time,
+      int & potential_site);
+
+  /// Moves the walker to the potential site if it is free, draws the next
+  /// hop and returns the id of the site the walker ends up on
+  int moveWalker_(
+      const int walker_id,
+      const int siteId,
+      const int siteToHopToId,
+      double & dwell_time,
+      int & potential_site);
+
+  /// Hop a walker that does not carry an absolute time, returns the id of
+  /// the site it hopped from
+  int hopWalker_(const int walker_id, Walker & walker);
+
+  /// Only called if event_log_ is set, in_cluster is whether siteId was
+  /// part of a cluster before the hop
+  void recordHop_(
+      const int walker_id,
+      const int siteId,
+      const int new_siteId,
+      const double time,
+      const bool in_cluster);
+
+  /// Returns the site or cluster the site with id siteId currently belongs to
+  TopologyFeature * getTopologyFeature_(const int siteId);
+
   void coarseGrainSiteIfNeeded_(std::shared_ptr<Walker>& walker);
 
   /**
@@ -272,9 +663,26 @@ class CoarseGrainSystem {
    *
    * \return true if the sites satisfy the condition false otherwise
    **/
-  bool sitesSatisfyEquilibriumCondition_(std::vector<int> siteIds, double maxtime);
+  bool sitesSatisfyEquilibriumCondition_(std::vector<int> siteIds, double maxtime) const;
 
-  double getInternalTimeLimit_(std::vector<int> siteIds);
+  /// Longest of the shortest crossing times between any two of the sites
+  double getInternalTimeLimit_(const std::vector<int> & siteIds);
+  double getInternalTimeLimit_(
+      const std::vector<int> & siteIds,
+      Basin_Graph & basin_graph) const;
+
+  /**
+   * \brief Checks if a basin found by the BasinExplorer is worth a cluster
+   *
+   * Only reads the sites, so basins can be checked in parallel as long as
+   * each thread passes its own Basin_Graph.
+   *
+   * \param[out] internal_time_limit set if the basin is worth a cluster
+   **/
+  bool basinSatisfiesCoarseGrainCondition_(
+      const std::vector<int> & basin_site_ids,
+      Basin_Graph & basin_graph,
+      double & internal_time_limit) const;
 
   /**
    * @brief Gets the fastest rate off the basin sites
@@ -301,6 +709,11 @@ class CoarseGrainSystem {
   int getFavoredClusterId_(std::vector<int> siteIds);
 
   bool coarseGrain_(int siteId);
+  /// Creates a cluster from the basin or merges it with the clusters it
+  /// overlaps, returns false if the basin is already part of one cluster
+  bool coarseGrainBasin_(
+      const std::vector<int> & basin_site_ids,
+      const double internal_time_limit);
   std::unordered_map<int,int> getClustersOfSites(const std::vector<int> & siteIds);
   int createCluster_(std::vector<int> siteIds,double internal_time_limit);
   void mergeSitesAndClusters_(std::unordered_map<int,int> sites_and_clusters, int clusterId);
@@ -0,0 +1,176 @@
+#ifndef MYTHICAL_DOMAIN_DECOMPOSED_SYSTEM_HPP
+#define MYTHICAL_DOMAIN_DECOMPOSED_SYSTEM_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "charge_transport/cuboid_lattice.hpp"
+#include "coarsegrainsystem.hpp"
+#include "walker_pool.hpp"
+
+namespace mythical {
+
+class Thread_Pool;
+
+/**
+ * \brief Splits a cuboid lattice into slabs along x that are run in parallel
+ *
+ * Each slab (domain) is simulated by its own CoarseGrainSystem, the rates
+ * are shared between the domains. A domain only moves the walkers on the
+ * sites it owns. The sites of the neighboring domains that can be reached in
+ * a single hop form its ghost region, a ghost site is marked as occupied if a
+ * walker of the neighboring domain is on it. A walker that hops onto a ghost
+ * site is handed to the domain owning the site.
+ *
+ * Time is advanced in windows. Within a window the domains are simulated in
+ * two groups (three if x is periodic and there is an odd number of
+ * domains), such that neighboring domains are never simulated at the same
+ * time, the synchronous sublattice approach. Domains of the same group run
+ * on different threads. The walkers handed over are placed in their new
+ * domain at the time they made the hop, between groups. As the neighbors of
+ * a domain may have been simulated to the end of the window already, events
+ * close to the domain boundaries can be processed out of order by up to the
+ * length of the window. The window should be short compared to the dwell
+ * times for this to be negligible.
+ *
+ * Clusters are only formed from the sites owned by a domain, so they never
+ * straddle two domains. The results of seeded domains do not depend on the
+ * number of threads. The site ids must be the indices of the lattice.
+ **/
+class DomainDecomposedSystem {
+ public:
+  /**
+   * \brief Called for every domain before it is initialized
+   *
+   * Receives the index of the domain and the system, use it to set the time
+   * resolution, random seed etc. Each domain should be given a different
+   * seed, a walker keeps its id when it moves between domains.
+   **/
+  typedef std::function<void(const size_t, CoarseGrainSystem &)> ConfigureFunction;
+
+  /**
+   * \param[in] domain_count number of slabs along x
+   * \param[in] thread_count number of threads, 0 uses one per hardware
+   * thread
+   **/
+  DomainDecomposedSystem(const size_t domain_count, const size_t thread_count = 0);
+  ~DomainDecomposedSystem();
+
+  /// Number of domains
+  size_t size() const { return domains_.size(); }
+
+  size_t getNumberOfThreads() const;
+
+  /// Length of the synchronisation window, must be set before hopping
+  void setTimeWindow(const double time_window);
+  double getTimeWindow() const { return time_window_; }
+
+  /**
+   * \brief Split the lattice and initialize the domains
+   *
+   * Every slab must be at least twice as wide as the longest hop along x,
+   * so that no site is in the ghost region of two domains simulated at the
+   * same time.
+   *
+   * \param[in] lattice the lattice, the site ids are its indices
+   * \param[in] ratesOfAllSites see CoarseGrainSystem::initializeSystem
+   * \param[in] configure see ConfigureFunction
+   **/
+  void initializeSystem(
+      const charge_transport::Cuboid & lattice,
+      const std::unordered_map<int, std::unordered_map<int, double>> & ratesOfAllSites,
+      const ConfigureFunction & configure);
+
+  /// Same as above using compressed sparse row arrays
+  void initializeSystem(
+      const charge_transport::Cuboid & lattice,
+      std::vector<size_t> row_offsets,
+      std::vector<int> neighbor_ids,
+      std::vector<double> rates,
+      const ConfigureFunction & configure);
+
+  size_t getDomainOfSite(const int siteId) const;
+
+  CoarseGrainSystem & getDomain(const size_t domain);
+
+  /// Sites of other domains that can be reached from the domain in one hop
+  const std::vector<int> & getGhostSites(const size_t domain) const;
+
+  /**
+   * \brief Place a walker on a site
+   *
+   * \param[in] siteId the site the walker occupies
+   * \param[in] time the absolute time at which the walker arrives on the site
+   *
+   * \return the id of the walker, starting from 0
+   **/
+  int addWalker(const int siteId, const double time = 0.0);
+
+  size_t getNumberOfWalkers() const { return domain_of_walker_.size(); }
+
+  size_t getDomainOfWalker(const int walker_id) const;
+  int getIdOfSiteCurrentlyOccupying(const int walker_id) const;
+
+  /// Absolute time of the next hop of the walker
+  double getTime(const int walker_id) const;
+
+  /// The time all the domains have been simulated to
+  double getCurrentTime() const { return time_; }
+
+  /// Number of times a walker has been handed from one domain to another
+  size_t getNumberOfMigrations() const { return migration_count_; }
+
+  /**
+   * \brief Simulate all the domains up to the time horizon
+   *
+   * \return the number of hops made
+   **/
+  size_t hop(const double time_horizon);
+
+ private:
+  /// A walker that hopped onto a ghost site
+  struct Migration {
+    int walker_id;
+    int site_id;
+    double time;
+  };
+
+  std::vector<std::unique_ptr<CoarseGrainSystem>> domains_;
+  /// Every pool holds all the walkers, they are only active in one domain
+  std::vector<WalkerPool> walkers_;
+  std::vector<std::vector<int>> ghost_sites_;
+  std::vector<std::vector<Migration>> migrations_;
+
+  /// Domains with the same group are simulated at the same time
+  std::vector<size_t> group_;
+  size_t group_count_;
+
+  /// Indexed by the site id
+  std::vector<size_t> domain_of_site_;
+  std::vector<size_t> domain_of_walker_;
+
+  double time_window_;
+  double time_;
+  size_t migration_count_;
+
+  std::unique_ptr<Thread_Pool> thread_pool_;
+
+  /// Sites stored in the systems, only needed while they are initialized
+  std::vector<int> site_ids_;
+
+  void splitLattice_(
+      const charge_transport::Cuboid & lattice,
+      const std::vector<std::pair<int,int>> & edges);
+  void initializeRemainingDomains_(const ConfigureFunction & configure);
+  void refreshGhostSites_(const size_t domain);
+  size_t advanceDomain_(const size_t domain, const double time_horizon);
+  void migrateWalkers_(const std::vector<size_t> & domains);
+  void checkWalker_(const int walker_id) const;
+};
+
+}
+
+#endif // MYTHICAL_DOMAIN_DECOMPOSED_SYSTEM_HPP
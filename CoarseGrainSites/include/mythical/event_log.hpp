@@ -0,0 +1,152 @@
+#ifndef MYTHICAL_EVENT_LOG_HPP
+#define MYTHICAL_EVENT_LOG_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mythical {
+
+class Binary_Reader;
+class Binary_Writer;
+class Event_Ring;
+
+/// A single hop as recorded by EventLog
+struct HopEvent {
+  int walker_id;
+  int from_site_id;
+  /// Equal to from_site_id if the site hopped to was occupied
+  int to_site_id;
+  /// Absolute time of the hop [ s ]
+  double time;
+  /// The walker hopped off of a site that is part of a cluster
+  bool in_cluster;
+};
+
+/**
+ * \brief Streams hop events to a binary file from a background thread
+ *
+ * Pass the log to CoarseGrainSystem::setEventLog to record every hop the
+ * system makes. Each thread that records events is given its own ring
+ * buffer, so threads do not contend with one another, and a background
+ * thread drains the buffers and writes them to the file. If a buffer is
+ * full the thread recording waits for the writer, no events are dropped.
+ *
+ * The file is written with the header of the other binary files of the
+ * library, magic MYTHHOPS, version 1. It is followed by blocks of events,
+ * each one the events drained from a single buffer, stored as an array of
+ * bytes: the number of events followed by the events, all as LEB128
+ * varints. The fields of an event are stored as differences from the
+ * previous event of the block, the first event of a block is relative to
+ * zero:
+ *
+ * - the walker id difference zigzag encoded, shifted left by one with the
+ *   in cluster flag in the lowest bit
+ * - the from site id difference, zigzag encoded
+ * - to site id minus from site id, zigzag encoded
+ * - the difference of the bit patterns of the times, as int64 and zigzag
+ *   encoded, so no precision is lost while increasing times stay small
+ *
+ * Events are in the order they were recorded within a block, blocks from
+ * different threads are interleaved. Use EventLogReader to read the file.
+ **/
+class EventLog {
+ public:
+  /**
+   * \brief Opens the file, throws if it cannot be written
+   *
+   * \param[in] file_name
+   * \param[in] buffer_size number of events each thread can buffer, rounded
+   * up to a power of 2
+   **/
+  explicit EventLog(const std::string & file_name,
+      const size_t buffer_size = 16384);
+  /// Closes the log, errors are ignored, call close to see them
+  ~EventLog();
+
+  EventLog(const EventLog &) = delete;
+  EventLog & operator=(const EventLog &) = delete;
+
+  /// Add an event to the buffer of the calling thread, throws if the log
+  /// has been closed
+  void record(const HopEvent & event);
+
+  /**
+   * \brief Write the remaining events and close the file
+   *
+   * No events may be recorded while the log is closed or afterwards. Throws
+   * a runtime_error if any of the writes failed.
+   **/
+  void close();
+
+ private:
+  std::unique_ptr<Binary_Writer> writer_;
+  size_t buffer_size_;
+  /// Distinguishes the logs in the cache of each thread, the address of a
+  /// log may be reused
+  uint64_t serial_;
+
+  std::mutex mutex_;
+  /// Wakes the background thread early, when a buffer is half full or the
+  /// log is closed
+  std::condition_variable wake_;
+  std::atomic<bool> flush_requested_;
+  std::atomic<bool> closed_;
+  bool stop_;
+  std::exception_ptr error_;
+
+  /// One buffer per thread that has recorded events, guarded by mutex_
+  std::vector<std::unique_ptr<Event_Ring>> rings_;
+  std::unordered_map<std::thread::id, Event_Ring *> ring_of_thread_;
+
+  std::thread thread_;
+
+  /// Buffer of the calling thread, created the first time it records
+  Event_Ring & getRing_();
+  void requestFlush_();
+  /// Run by the background thread
+  void write_();
+  void writeBlock_(Event_Ring & ring, std::vector<HopEvent> & events,
+      std::vector<uint8_t> & bytes);
+};
+
+/**
+ * \brief Reads the events written by EventLog
+ *
+ * The file is memory mapped where the platform allows it. Throws a
+ * runtime_error if the file is not an event log or a block is truncated.
+ **/
+class EventLogReader {
+ public:
+  explicit EventLogReader(const std::string & file_name);
+  ~EventLogReader();
+
+  /// Returns false once every event has been read
+  bool read(HopEvent & event);
+
+ private:
+  std::unique_ptr<Binary_Reader> reader_;
+  std::string file_name_;
+
+  /// Current block
+  const uint8_t * bytes_;
+  size_t size_;
+  size_t position_;
+  uint64_t events_left_;
+  /// Fields of the previous event of the block
+  HopEvent previous_;
+
+  uint64_t readVarint_();
+};
+
+}
+
+#endif // MYTHICAL_EVENT_LOG_HPP
@@ -0,0 +1,126 @@
+#ifndef MYTHICAL_INDEXED_QUEUE_HPP
+#define MYTHICAL_INDEXED_QUEUE_HPP
+
+#include "constants.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace mythical {
+
+/**
+ * \brief Event queue of walkers ordered by the time of their next hop
+ *
+ * Provides the same interface as Queue, but the walkers are stored in a
+ * binary heap with an index from the walker id to its position in the heap.
+ * Adding a walker, popping the next walker and rescheduling a walker are all
+ * O(log N) instead of O(N). Walkers with the same time are popped in the
+ * order they were added, as with Queue::sortedAdd.
+ *
+ * Because the heap is always ordered, add and sortedAdd behave the same and
+ * the queue is always sorted. Each walker id may only be stored once. The
+ * position of each walker is looked up in an array indexed by the walker id,
+ * so the ids must not be negative and are best kept small, as the ids
+ * handed out by WalkerPool are.
+ **/
+class IndexedQueue {
+ public:
+  IndexedQueue() : sequence_(0), snapshot_valid_(true) {};
+
+  /**
+   * \brief get the walker at the front of the queue also removes from the list
+   **/
+  std::pair<int,double> pop_current();
+
+  /**
+   * \brief add to the queue, same as sortedAdd
+   **/
+  void add(std::pair<int,double> walker);
+
+  /**
+   * \brief The walker is added in the correct order.
+   *
+   * Will throw an error if the walker is already in the queue
+   *
+   * \param walker the id of the walker and the time of its next hop
+   **/
+  void sortedAdd(std::pair<int,double> walker);
+
+  /**
+   * \brief Change the time of a walker that is already in the queue
+   *
+   * Works for both an earlier (decrease-key) and a later time, the walker
+   * is moved to the back of any walkers sharing the new time.
+   **/
+  void reschedule(const int walker_id, const double time);
+
+  /// Remove a walker from anywhere in the queue
+  void remove(const int walker_id);
+
+  bool contains(const int walker_id) const;
+
+  /// Time of the walker's next hop, throws if the walker is not stored
+  double getTime(const int walker_id) const;
+
+  bool isSorted() const noexcept { return true; }
+
+  /// Provided for compatibility with Queue, the heap is always sorted
+  void sort() {}
+
+  std::size_t size() const noexcept { return heap_.size(); }
+
+  bool empty() const noexcept { return heap_.empty(); }
+
+  /**
+   * \brief Access the walker at position index in time order
+   *
+   * at(0) is constant time, any other index requires a sorted copy of the
+   * queue which is rebuilt, O(N log N), after the queue has been modified.
+   **/
+  const std::pair<int,double> & at(int index) const;
+
+ private:
+  struct Event {
+    std::pair<int,double> walker;
+    /// Insertion order, used to break ties between equal times
+    uint64_t sequence;
+  };
+
+  static bool earlier_(const Event & event1, const Event & event2){
+    if(event1.walker.second != event2.walker.second){
+      return event1.walker.second < event2.walker.second;
+    }
+    return event1.sequence < event2.sequence;
+  }
+
+  std::vector<Event> heap_;
+
+  /// Stored in position_ for walkers that are not in the queue
+  static const size_t not_queued = std::numeric_limits<size_t>::max();
+
+  /// Position of each walker in the heap, indexed by the walker id
+  std::vector<size_t> position_;
+
+  uint64_t sequence_;
+
+  mutable std::vector<std::pair<int,double>> snapshot_;
+  mutable bool snapshot_valid_;
+
+  /// Position of the walker in the heap or not_queued
+  size_t findPosition_(const int walker_id) const {
+    if(walker_id<0 || static_cast<size_t>(walker_id)>=position_.size()){
+      return not_queued;
+    }
+    return position_[static_cast<size_t>(walker_id)];
+  }
+
+  void siftUp_(size_t index);
+  void siftDown_(size_t index);
+  void swap_(size_t index1, size_t index2);
+  void removeAt_(size_t index);
+};
+}
+#endif  // MYTHICAL_INDEXED_QUEUE_HPP
@@ -0,0 +1,128 @@
+#ifndef MYTHICAL_OPTIMISTIC_SCHEDULER_HPP
+#define MYTHICAL_OPTIMISTIC_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "coarsegrainsystem.hpp"
+#include "event_log.hpp"
+#include "walker_pool.hpp"
+
+namespace mythical {
+
+class Thread_Pool;
+
+/**
+ * \brief Experimental optimistic parallel hopping of the walkers of a pool
+ *
+ * Walkers only interact by not being allowed to hop onto an occupied site.
+ * The scheduler lets every walker hop ahead on its own, in parallel, up to
+ * the end of a time window, assuming that the other walkers stay where they
+ * were at the start of the window. The state of the walker before each hop
+ * is kept as a checkpoint, this is cheap as the random numbers of the
+ * counter based policy only depend on the number of steps a walker has
+ * taken.
+ *
+ * Every site entered or left during the window is given a version stamp,
+ * the earliest time it was changed and by which walker. A hop that checked a
+ * site that another walker changed before the hop took place conflicts with
+ * the serial order. All the hops before the earliest conflict are committed,
+ * all the walkers are rolled back to their checkpoint at the time of the
+ * conflict and the next window starts from there. As the committed hops are
+ * exactly the ones the serial hop loop would have made, the walkers follow
+ * the same paths as with CoarseGrainSystem::hop(WalkerPool &,double), up to
+ * walkers hopping at exactly the same time.
+ *
+ * If the system has an event log the committed hops of each window are
+ * recorded in order of time once the window is over.
+ *
+ * Only supported with the counter based random policy and without coarse
+ * graining, the iteration threshold must be constants::inf_iterations.
+ **/
+class OptimisticScheduler {
+ public:
+  /**
+   * \param[in] system an initialized system, must outlive the scheduler
+   * \param[in] thread_count number of threads, 0 uses one per hardware
+   * thread
+   **/
+  OptimisticScheduler(CoarseGrainSystem & system, const size_t thread_count = 0);
+  ~OptimisticScheduler();
+
+  size_t getNumberOfThreads() const;
+
+  /// How far ahead the walkers hop before checking for conflicts
+  void setTimeWindow(const double time_window);
+  double getTimeWindow() const { return time_window_; }
+
+  /**
+   * \brief Hop the walkers of the pool until the time horizon is reached
+   *
+   * Same as CoarseGrainSystem::hop(WalkerPool &,double) without a callback.
+   *
+   * \return the number of hops made, hops that were rolled back are not
+   * counted
+   **/
+  size_t hop(WalkerPool & walkers, const double time_horizon);
+
+  /// Number of windows that ended with a conflict
+  size_t getNumberOfRollbacks() const { return rollback_count_; }
+
+  /// Number of hops that were made and then undone
+  size_t getNumberOfHopsRolledBack() const { return hops_rolled_back_; }
+
+ private:
+  struct Walker_State {
+    int site_id;
+    int potential_site;
+    double dwell_time;
+    /// Absolute time of the next hop
+    double time;
+    uint64_t step;
+  };
+
+  /// The hops a single walker made during the window
+  struct Walker_Log {
+    int walker_id;
+    Walker_State start;
+    /// The state before each of the hops
+    std::vector<Walker_State> checkpoints;
+    /// Whether each hop moved the walker or it was blocked
+    std::vector<char> moved;
+    Walker_State end;
+  };
+
+  /// Earliest change to a site and the earliest change by any other walker
+  struct Version_Stamp {
+    double time;
+    int walker_id;
+    double other_time;
+  };
+
+  CoarseGrainSystem & system_;
+  double time_window_;
+  size_t rollback_count_;
+  size_t hops_rolled_back_;
+
+  std::vector<Walker_Log> logs_;
+  /// Indexed by the dense index of the site
+  std::vector<Version_Stamp> stamps_;
+  std::vector<size_t> stamped_sites_;
+  /// Hops committed at the end of a window, only kept while the system has
+  /// an event log
+  std::vector<HopEvent> committed_events_;
+
+  std::unique_ptr<Thread_Pool> thread_pool_;
+
+  void checkSystem_() const;
+  void speculate_(Walker_Log & log, const double window_end);
+  void stampSite_(const int siteId, const double time, const int walker_id);
+  double findConflict_(const Walker_Log & log);
+  size_t commit_(WalkerPool & walkers, const double conflict_time);
+};
+
+}
+
+#endif // MYTHICAL_OPTIMISTIC_SCHEDULER_HPP
@@ -0,0 +1,35 @@
+#ifndef MYTHICAL_RANDOM_POLICY_HPP
+#define MYTHICAL_RANDOM_POLICY_HPP
+
+namespace mythical {
+
+/**
+ * \brief Random number generators that can be used by the sites and clusters
+ *
+ * counter_based
+ *
+ * This is the default. Random numbers are drawn from Philox4x32-10 streams,
+ * the state is only a few bytes per site. When moving a walker with
+ * CoarseGrainSystem the numbers are keyed by the seed, the walker id and the
+ * number of hops the walker has made. Given the same seed, a walker will
+ * draw the same numbers regardless of the order in which walkers are moved,
+ * the order in which the sites were passed to initializeSystem, the compiler
+ * or the platform. Sites and clusters used on their own are keyed by the
+ * seed and the id of the site or cluster instead. The sequences of
+ * different walkers, sites and clusters are statistically independent.
+ *
+ * mersenne_twister
+ *
+ * Each site and cluster allocates its own std::mt19937 engine. This costs
+ * about 5 KB per site. The seed is incremented for every site and cluster
+ * that is created, so results are only reproducible if the sites are
+ * supplied in the same order.
+ **/
+enum class RandomPolicy {
+  counter_based,
+  mersenne_twister
+};
+
+}
+
+#endif  // MYTHICAL_RANDOM_POLICY_HPP
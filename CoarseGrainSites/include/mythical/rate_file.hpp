@@ -0,0 +1,155 @@
+#ifndef MYTHICAL_RATE_FILE_HPP
+#define MYTHICAL_RATE_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace mythical {
+
+class Binary_Reader;
+class Binary_Writer;
+
+/**
+ * \brief Binary file holding the rates between the sites of a system
+ *
+ * Lets rates generated offline be handed to CoarseGrainSystem without going
+ * through a map of maps. The file starts with a 16 byte header:
+ *
+ * - the 8 characters MYTHRATE
+ * - uint32 version, currently 1
+ * - uint32 0x01020304 written in the byte order of the machine, files are
+ *   only read on machines with the same byte order
+ *
+ * followed by six arrays, always in this order. Each array is a uint64
+ * count followed by the values, which start at a multiple of 8 bytes from
+ * the start of the file, so the file can be memory mapped and read in place:
+ *
+ * 1. site_ids      int32  N    the id of the site of each row
+ * 2. row_offsets   uint64 N+1  starting at 0, the rates off of row i are
+ *                              stored between row_offsets[i] and
+ *                              row_offsets[i+1]
+ * 3. neighbor_ids  int32  M    id of the site each rate leads to, ids
+ *                              without a row of their own are drains
+ * 4. rates         double M    [ 1/s ]
+ * 5. positions     double 3N   optional, x y z of each site, 0 if absent
+ * 6. energies      double N    optional, energy of each site, 0 if absent
+ *
+ * The positions and energies are not needed by CoarseGrainSystem, they are
+ * kept so that the file describes the system on its own.
+ **/
+
+/**
+ * \brief Writes a rate file a piece at a time
+ *
+ * The number of sites and rates must be known up front. The arrays are then
+ * written in the order of the file, each one can be passed in several
+ * pieces, so a system never has to be held in memory in full. An array
+ * must be complete before the next one is started, anything written out of
+ * order throws a runtime_error.
+ *
+ * RateFileWriter writer("rates.bin", 2, 2, false, false);
+ * writer.writeSiteIds(site_ids, 2);
+ * writer.writeRowOffsets(row_offsets, 3);
+ * writer.writeNeighborIds(neighbor_ids, 2);
+ * writer.writeRates(rates, 2);
+ * writer.close();
+ **/
+class RateFileWriter {
+ public:
+  RateFileWriter(
+      const std::string & file_name,
+      const size_t site_count,
+      const size_t rate_count,
+      const bool has_positions,
+      const bool has_energies);
+  ~RateFileWriter();
+
+  void writeSiteIds(const int * site_ids, const size_t count);
+  void writeRowOffsets(const size_t * row_offsets, const size_t count);
+  void writeNeighborIds(const int * neighbor_ids, const size_t count);
+  void writeRates(const double * rates, const size_t count);
+  /// Three values per site, x y z
+  void writePositions(const double * positions, const size_t count);
+  void writeEnergies(const double * energies, const size_t count);
+
+  /// Throws if any of the arrays is incomplete or the file could not be
+  /// written
+  void close();
+
+ private:
+  enum Section {
+    site_id_section,
+    row_offset_section,
+    neighbor_id_section,
+    rate_section,
+    position_section,
+    energy_section,
+    /// Every array has been written
+    end_section
+  };
+
+  std::unique_ptr<Binary_Writer> writer_;
+  size_t site_count_;
+  size_t rate_count_;
+  bool has_positions_;
+  bool has_energies_;
+
+  Section section_;
+  /// Values still to be written to the current section
+  size_t remaining_;
+
+  size_t sectionSize_(const Section section) const;
+  /// Checks the values belong to the current section and moves on to the
+  /// next section once it is full
+  template<typename T>
+  void append_(const Section section, const T * values, const size_t count);
+  void startSection_(const Section section);
+};
+
+/**
+ * \brief Reads a rate file
+ *
+ * The file is memory mapped where the platform allows it, the arrays are
+ * then read in place and only paged in as they are used. The pointers
+ * remain valid as long as the reader exists. Throws a runtime_error if the
+ * file is not a rate file, is truncated or its arrays are inconsistent.
+ **/
+class RateFileReader {
+ public:
+  explicit RateFileReader(const std::string & file_name);
+  ~RateFileReader();
+
+  size_t getNumberOfSites() const noexcept { return site_count_; }
+  size_t getNumberOfRates() const noexcept { return rate_count_; }
+
+  const int * getSiteIds() const noexcept { return site_ids_; }
+  const uint64_t * getRowOffsets() const noexcept { return row_offsets_; }
+  const int * getNeighborIds() const noexcept { return neighbor_ids_; }
+  const double * getRates() const noexcept { return rates_; }
+
+  bool hasPositions() const noexcept { return positions_ != nullptr; }
+  /// x y z of each site, nullptr if the file does not contain them
+  const double * getPositions() const noexcept { return positions_; }
+
+  bool hasEnergies() const noexcept { return energies_ != nullptr; }
+  /// nullptr if the file does not contain them
+  const double * getEnergies() const noexcept { return energies_; }
+
+ private:
+  std::unique_ptr<Binary_Reader> reader_;
+  size_t site_count_;
+  size_t rate_count_;
+
+  const int * site_ids_;
+  const uint64_t * row_offsets_;
+  const int * neighbor_ids_;
+  const double * rates_;
+  const double * positions_;
+  const double * energies_;
+};
+
+}
+
+#endif // MYTHICAL_RATE_FILE_HPP
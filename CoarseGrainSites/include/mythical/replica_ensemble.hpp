@@ -0,0 +1,112 @@
+#ifndef MYTHICAL_REPLICA_ENSEMBLE_HPP
+#define MYTHICAL_REPLICA_ENSEMBLE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "coarsegrainsystem.hpp"
+
+namespace mythical {
+
+class Thread_Pool;
+
+/**
+ * \brief Runs several independent coarse grained systems in parallel
+ *
+ * Every replica is a CoarseGrainSystem of its own, with its own sites,
+ * clusters, walkers and random numbers. The rates are stored once and
+ * shared by all the replicas, as they are only ever read. The replicas are
+ * advanced on a pool of threads one sample at a time, at the end of each
+ * sample the observables of the replicas are summed.
+ *
+ * The observables are summed in the order of the replicas, so for seeded
+ * replicas the results do not depend on the number of threads.
+ **/
+class ReplicaEnsemble {
+ public:
+  /**
+   * \brief Called for every replica before it is initialized
+   *
+   * Receives the index of the replica and the system, use it to set the time
+   * resolution, random seed, random policy etc.
+   **/
+  typedef std::function<void(const size_t, CoarseGrainSystem &)> ConfigureFunction;
+
+  /**
+   * \brief Called for every replica and every sample
+   *
+   * Receives the index of the replica, the index of the sample, the system
+   * and an empty vector. The function should advance the system to the end
+   * of the sample and store the observables in the vector, e.g. the current
+   * or the occupancy of a set of sites. Every replica must store the same
+   * number of observables.
+   **/
+  typedef std::function<void(
+      const size_t,
+      const size_t,
+      CoarseGrainSystem &,
+      std::vector<double> &)> SampleFunction;
+
+  /**
+   * \brief Create the replicas and the threads
+   *
+   * \param[in] replica_count number of systems
+   * \param[in] thread_count number of threads, 0 uses one per hardware
+   * thread
+   **/
+  ReplicaEnsemble(const size_t replica_count, const size_t thread_count = 0);
+  ~ReplicaEnsemble();
+
+  /// Number of replicas
+  size_t size() const { return replicas_.size(); }
+
+  size_t getNumberOfThreads() const;
+
+  /**
+   * \brief Initialize all the replicas with the same rates
+   *
+   * The first replica is initialized from the rates, the remaining replicas
+   * share its rates and are initialized in parallel. The configure function
+   * must at least set the time resolution.
+   **/
+  void initializeSystems(
+      const std::unordered_map<int, std::unordered_map<int, double>> & ratesOfAllSites,
+      const ConfigureFunction & configure);
+
+  /// Same as above using compressed sparse row arrays
+  void initializeSystems(
+      std::vector<size_t> row_offsets,
+      std::vector<int> neighbor_ids,
+      std::vector<double> rates,
+      const ConfigureFunction & configure);
+
+  CoarseGrainSystem & getReplica(const size_t replica);
+
+  /// Call the function with every replica in parallel, e.g. to place walkers
+  void forEachReplica(const ConfigureFunction & function);
+
+  /**
+   * \brief Run all the replicas for a number of samples
+   *
+   * \param[in] sample_count number of samples
+   * \param[in] sample see SampleFunction
+   *
+   * \return the observables of each sample summed over the replicas
+   **/
+  std::vector<std::vector<double>> run(
+      const size_t sample_count,
+      const SampleFunction & sample);
+
+ private:
+  std::vector<std::unique_ptr<CoarseGrainSystem>> replicas_;
+  std::unique_ptr<Thread_Pool> thread_pool_;
+
+  void initializeRemainingSystems_(const ConfigureFunction & configure);
+};
+
+}
+
+#endif // MYTHICAL_REPLICA_ENSEMBLE_HPP
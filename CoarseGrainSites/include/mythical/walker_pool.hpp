@@ -0,0 +1,102 @@
+#ifndef MYTHICAL_WALKER_POOL_HPP
+#define MYTHICAL_WALKER_POOL_HPP
+
+#include "constants.hpp"
+#include "indexed_queue.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace mythical {
+
+/**
+ * \brief Stores many walkers as a structure of arrays
+ *
+ * An alternative to passing around std::shared_ptr<Walker>. The current
+ * site, potential site, dwell time and absolute time of the walkers are each
+ * stored in their own contiguous array indexed by the walker id. The ids are
+ * handed out by addWalker starting from 0.
+ *
+ * The absolute time is the time at which the walker will make its next hop.
+ * It is advanced by CoarseGrainSystem each time a new dwell time is drawn,
+ * the walkers are kept in an IndexedQueue ordered by this time. Removed
+ * walkers keep their id but are no longer active.
+ *
+ * Walker remains available for users that need to attach their own data to
+ * each walker.
+ **/
+class WalkerPool {
+ public:
+  WalkerPool() {};
+
+  /**
+   * \brief Place a new walker on a site
+   *
+   * \param[in] siteId the site the walker occupies
+   * \param[in] time the absolute time at which the walker arrives on the site
+   *
+   * \return the id of the walker
+   **/
+  int addWalker(const int siteId, const double time = 0.0);
+
+  /**
+   * \brief Move an inactive walker to a new site
+   *
+   * Used to hand a walker that was removed from one system to another, the
+   * walker keeps its id. It must be initialized again before it can hop.
+   *
+   * \param[in] walker_id a walker that is not active
+   * \param[in] siteId the site the walker occupies
+   * \param[in] time the absolute time at which the walker arrives on the site
+   **/
+  void placeWalker(const int walker_id, const int siteId, const double time);
+
+  /// Number of walkers that have been added including removed walkers
+  std::size_t size() const noexcept { return current_site_.size(); }
+
+  /// Number of walkers that have been initialized and not removed
+  std::size_t countActiveWalkers() const noexcept { return event_queue_.size(); }
+
+  bool isActive(const int walker_id) const;
+
+  int getIdOfSiteCurrentlyOccupying(const int walker_id) const {
+    return current_site_.at(walker_id);
+  }
+  int getPotentialSite(const int walker_id) const {
+    return potential_site_.at(walker_id);
+  }
+  double getDwellTime(const int walker_id) const {
+    return dwell_time_.at(walker_id);
+  }
+  double getTime(const int walker_id) const { return time_.at(walker_id); }
+
+  /// Contiguous arrays indexed by the walker id
+  const std::vector<int> & getIdsOfSitesCurrentlyOccupying() const noexcept {
+    return current_site_;
+  }
+  const std::vector<int> & getPotentialSites() const noexcept {
+    return potential_site_;
+  }
+  const std::vector<double> & getDwellTimes() const noexcept {
+    return dwell_time_;
+  }
+  const std::vector<double> & getTimes() const noexcept { return time_; }
+
+  /// Active walkers ordered by the absolute time of their next hop
+  const IndexedQueue & getEventQueue() const noexcept { return event_queue_; }
+
+ private:
+  friend class CoarseGrainSystem;
+  friend class OptimisticScheduler;
+
+  std::vector<int> current_site_;
+  std::vector<int> potential_site_;
+  std::vector<double> dwell_time_;
+  std::vector<double> time_;
+
+  IndexedQueue event_queue_;
+};
+
+}
+
+#endif  // MYTHICAL_WALKER_POOL_HPP
@@ -1,30 +1,21 @@
 
-#include <unordered_set>
+#include <algorithm>
 
 #include "basin_explorer.hpp"
-#include "graph_library_adapter.hpp"
-#include "ugly/graphvisitor/graphvisitor_largest_known_value.hpp"
 
-using namespace ugly;
 using namespace std;
 
 namespace mythical {
 
-  typedef unordered_set<shared_ptr<Edge>> shared_edge_set;
-  typedef vector<weak_ptr<Edge>> weak_edge_vec;
-
   vector<int> BasinExplorer::findBasin(
       Site_Container& sites,
-      Cluster_Container& clusters,
+      const Cluster_Container& clusters,
       int siteId){
-    
-    auto edges_store = 
-      convertSitesOutgoingRatesToSharedWeightedEdges<shared_edge_set>( sites, siteId);
-
-    weak_edge_vec edges_weak(edges_store.begin(),edges_store.end());
 
-    GraphVisitorLargestKnownValue gv_largest_known;
-    gv_largest_known.setStartingVertex(siteId);
+    explored_.clear();
+    known_edges_.clear();
+    sequence_ = 0;
+    explored_.push_back(siteId);
 
     fastest_rate_ = sites.getFastestRateOffSite(siteId);
     if(sites.partOfCluster(siteId)){
@@ -35,53 +26,48 @@ namespace mythical {
     }
     current_sites_fastest_rate_ = fastest_rate_;
 
-    addEdges_(sites,edges_weak,siteId,gv_largest_known);
-
-    int exploration_count = 1;
+    addEdges_(sites,siteId);
 
-    while(gv_largest_known.allEdgesExplored()==false){
-      weak_ptr<Edge> next_edge = gv_largest_known.getNextEdge<Edge>();
+    while(!known_edges_.empty()){
+      pop_heap(known_edges_.begin(),known_edges_.end(),Slower_Edge_());
+      int next_vertex = known_edges_.back().terminal_site;
+      known_edges_.pop_back();
+      // Another edge has already led to the site
+      if(isExplored_(next_vertex)) continue;
 
-      auto next_vertex = gv_largest_known.chooseTerminalVertex(next_edge);
+      explored_.push_back(next_vertex);
+      addEdges_(sites,next_vertex);
 
-      gv_largest_known.exploreEdge(next_edge);
-      auto edges_tmp = convertSitesOutgoingRatesToSharedWeightedEdges<shared_edge_set>( sites, next_vertex);
-      
-      weak_edge_vec edges_weak_tmp(edges_tmp.begin(),edges_tmp.end());
-      edges_store.insert(edges_tmp.begin(),edges_tmp.end());
-
-      addEdges_(sites,edges_weak_tmp,next_vertex,gv_largest_known);
- 
-      ++exploration_count; 
-      if(gv_largest_known.countExploredVertices()>max_exploration_count_){
+      if(explored_.size()>max_exploration_count_){
         vector<int> empty_vec;
         return empty_vec;
       }
     }
-    return gv_largest_known.getExploredVertices();
+    return explored_;
 
   }
 
   void BasinExplorer::addEdges_(
       Site_Container& sites,
-      weak_edge_vec edges_weak,
-      int vertex,
-      GraphVisitorLargestKnownValue & gv_largest_known){
-
-    for(auto edge : edges_weak){
-      if(gv_largest_known.edgeCanBeAdded(edge)){
-        double rate = getRate_(sites,edge, vertex);
-        updateFastestRate_(rate);
-
-        current_sites_fastest_rate_ = sites.getFastestRateOffSite(vertex);
-        // The problem with this is it is updating as it accessing nodes.
-
-        if(rateFastEnough_(rate)){
-          
-          gv_largest_known.addEdge(edge);
-          // Update the slowest rate
-          updateSlowestRate_(rate);
-        }
+      int vertex){
+
+    if(!sites.exist(vertex)) return;
+    Rate_View rates = sites.getRateView(vertex);
+    for(size_t ind = 0; ind < rates.size(); ++ind){
+      int terminal_site = rates.neighborId(ind);
+      if(isExplored_(terminal_site)) continue;
+
+      double rate = rates.rate(ind);
+      updateFastestRate_(rate);
+
+      current_sites_fastest_rate_ = sites.getFastestRateOffSite(vertex);
+      // The problem with this is it is updating as it accessing nodes.
+
+      if(rateFastEnough_(rate)){
+        known_edges_.push_back(Known_Edge_{rate,sequence_++,terminal_site});
+        push_heap(known_edges_.begin(),known_edges_.end(),Slower_Edge_());
+        // Update the slowest rate
+        updateSlowestRate_(rate);
       }
     }
 
@@ -115,15 +101,10 @@ namespace mythical {
     return false;
   }
 
-  double BasinExplorer::getRate_(Site_Container& sites,std::weak_ptr<Edge> edge, int vertex){
-    double rate;
-    if(auto ed = edge.lock()){
-      rate = sites.getRateToNeighborOfSite(vertex,ed->getOtherVertex(vertex));
-    }else{
-      throw runtime_error("Edge is no longer accesible in memory.");
-    }
-    return rate;
+  // The basin is limited to max_exploration_count_ sites, a linear search is
+  // faster than hashing for so few
+  bool BasinExplorer::isExplored_(int siteId) const {
+    return find(explored_.begin(),explored_.end(),siteId)!=explored_.end();
   }
 
 }
-
@@ -1,37 +1,64 @@
 #ifndef MYTHICAL_BASIN_EXPLORER_HPP
 #define MYTHICAL_BASIN_EXPLORER_HPP
 
+#include <cstddef>
 #include <vector>
 
 #include "site_container.hpp"
 #include "cluster_container.hpp"
-#include "ugly/graphvisitor/graphvisitor_largest_known_value.hpp"
 
 namespace mythical {
 
+/**
+ * \brief Grows a basin of sites connected by fast rates
+ *
+ * Starting from a site, the fastest known edge leaving the explored sites is
+ * followed first. Edges are only considered if their rate is fast enough
+ * compared to the fastest and slowest rates seen so far. The search works
+ * directly on the rates stored in the Site_Container, the edges are kept in
+ * a binary heap and the buffers are reused between calls.
+ **/
 class BasinExplorer{
   public:
-    BasinExplorer() : threshold_(0.95), max_exploration_count_(5) {};
+    BasinExplorer() : threshold_(0.95), max_exploration_count_(5), sequence_(0) {};
     void setThreshold(double threshold);
     void setMaxExplorationCount(int count);
-    std::vector<int> findBasin(Site_Container& sites,Cluster_Container& clusters, int siteId);
+    std::vector<int> findBasin(Site_Container& sites,const Cluster_Container& clusters, int siteId);
   private:
+    /// Directed edge from the explored site to a site that is not yet
+    /// explored
+    struct Known_Edge_ {
+      double rate;
+      /// Order in which the edge was added, the older edge wins a tie
+      size_t sequence;
+      int terminal_site;
+    };
+
+    /// Orders the heap so that the fastest edge is on top
+    struct Slower_Edge_ {
+      bool operator()(const Known_Edge_ & lhs, const Known_Edge_ & rhs) const {
+        if(lhs.rate!=rhs.rate) return lhs.rate < rhs.rate;
+        return lhs.sequence > rhs.sequence;
+      }
+    };
+
     double threshold_;
     double fastest_rate_;
     double slowest_rate_;
     double current_sites_fastest_rate_; 
     size_t max_exploration_count_;
 
+    /// Scratch buffers reused between calls
+    std::vector<int> explored_;
+    std::vector<Known_Edge_> known_edges_;
+    size_t sequence_;
+
     bool rateFastEnough_(double rate);
-    double getRate_(Site_Container& sites, std::weak_ptr<ugly::Edge> edge, int vertex);
+    bool isExplored_(int siteId) const;
     void updateFastestRate_(double rate);
     void updateSlowestRate_(double rate);
 
-    void addEdges_(
-        Site_Container& sites,
-        std::vector<std::weak_ptr<ugly::Edge>> edges_weak, 
-        int vertex, 
-        ugly::GraphVisitorLargestKnownValue & gv_largest_known);
+    void addEdges_(Site_Container& sites, int vertex);
 };
 
 
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "basin_graph.hpp"
+#include "site_container.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  void Basin_Graph::build(const Site_Container & sites, const vector<int> & siteIds){
+    site_ids_.assign(siteIds.begin(),siteIds.end());
+    sort(site_ids_.begin(),site_ids_.end());
+    site_ids_.erase(unique(site_ids_.begin(),site_ids_.end()),site_ids_.end());
+
+    row_offsets_.assign(1,0);
+    neighbors_.clear();
+    times_.clear();
+    for( const int & siteId : site_ids_ ){
+      if(sites.exist(siteId)){
+        Rate_View rates = sites.getRateView(siteId);
+        for(size_t ind = 0; ind < rates.size(); ++ind){
+          int neighbor = getIndex(rates.neighborId(ind));
+          if(neighbor==-1) continue;
+          neighbors_.push_back(neighbor);
+          times_.push_back(1.0/rates.rate(ind));
+        }
+      }
+      row_offsets_.push_back(neighbors_.size());
+    }
+    distances_.clear();
+  }
+
+  int Basin_Graph::getIndex(const int siteId) const {
+    auto it = lower_bound(site_ids_.begin(),site_ids_.end(),siteId);
+    if(it==site_ids_.end() || *it!=siteId) return -1;
+    return static_cast<int>(it-site_ids_.begin());
+  }
+
+  void Basin_Graph::calculateShortestPaths(){
+    const size_t count = site_ids_.size();
+    const double infinity = numeric_limits<double>::infinity();
+    distances_.assign(count*count,infinity);
+
+    const greater<pair<double,int>> later;
+    for(size_t source = 0; source < count; ++source){
+      double * distance = distances_.data() + source*count;
+      distance[source] = 0.0;
+      heap_.clear();
+      heap_.emplace_back(0.0,static_cast<int>(source));
+      while(!heap_.empty()){
+        pop_heap(heap_.begin(),heap_.end(),later);
+        pair<double,int> current = heap_.back();
+        heap_.pop_back();
+        // Stale entry, a shorter path has already been found
+        if(current.first > distance[current.second]) continue;
+        for(size_t ind = row_offsets_[current.second];
+            ind < row_offsets_[current.second+1]; ++ind){
+          double candidate = current.first + times_[ind];
+          if(candidate < distance[neighbors_[ind]]){
+            distance[neighbors_[ind]] = candidate;
+            heap_.emplace_back(candidate,neighbors_[ind]);
+            push_heap(heap_.begin(),heap_.end(),later);
+          }
+        }
+      }
+    }
+  }
+
+  double Basin_Graph::getShortestPath(const size_t source, const size_t target) const {
+    if(distances_.size()!=site_ids_.size()*site_ids_.size()){
+      throw runtime_error("Cannot get shortest path, the shortest paths have "
+          "not been calculated.");
+    }
+    if(source>=site_ids_.size() || target>=site_ids_.size()){
+      throw out_of_range("Cannot get shortest path, index is out of range.");
+    }
+    return distances_[source*site_ids_.size()+target];
+  }
+
+  double Basin_Graph::getEccentricity(const size_t source) const {
+    double eccentricity = 0.0;
+    for(size_t target = 0; target < site_ids_.size(); ++target){
+      double distance = getShortestPath(source,target);
+      if(distance != numeric_limits<double>::infinity() && distance > eccentricity){
+        eccentricity = distance;
+      }
+    }
+    return eccentricity;
+  }
+
+  double Basin_Graph::getDiameter() const {
+    double diameter = 0.0;
+    for(size_t source = 0; source < site_ids_.size(); ++source){
+      diameter = max(diameter,getEccentricity(source));
+    }
+    return diameter;
+  }
+}
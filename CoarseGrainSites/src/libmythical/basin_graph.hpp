@@ -0,0 +1,69 @@
+#ifndef MYTHICAL_BASIN_GRAPH_HPP
+#define MYTHICAL_BASIN_GRAPH_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mythical {
+
+class Site_Container;
+
+/**
+ * \brief Small directed subgraph of the sites in a basin
+ *
+ * The sites are given a local index 0..N-1 in ascending order of their ids,
+ * duplicates are ignored. Only the edges between the sites of the basin are
+ * kept, stored in CSR form. The weight of an edge is the time it takes to cross it,
+ * 1/rate.
+ *
+ * All the buffers are kept between calls, once they have grown to the size
+ * of the largest basin seen rebuilding the graph and computing the shortest
+ * paths does not allocate.
+ **/
+class Basin_Graph {
+  public:
+    /// Replaces the current graph with the subgraph of siteIds
+    void build(const Site_Container & sites, const std::vector<int> & siteIds);
+
+    size_t size() const { return site_ids_.size(); }
+
+    int getSiteId(const size_t index) const { return site_ids_.at(index); }
+
+    /// Returns -1 if the site is not part of the graph
+    int getIndex(const int siteId) const;
+
+    /**
+     * \brief Shortest crossing time between every pair of sites
+     *
+     * Dijkstra's algorithm is run from every site. Must be called after build
+     * and before any of the distance accessors.
+     **/
+    void calculateShortestPaths();
+
+    /// Infinity if target cannot be reached from source
+    double getShortestPath(const size_t source, const size_t target) const;
+
+    /// Largest finite shortest path from the site to any other site
+    double getEccentricity(const size_t source) const;
+
+    /// Largest eccentricity of all the sites, 0.0 if the graph is empty
+    double getDiameter() const;
+
+  private:
+    /// Sorted, the position is the local index
+    std::vector<int> site_ids_;
+
+    std::vector<size_t> row_offsets_;
+    std::vector<int> neighbors_;
+    std::vector<double> times_;
+
+    /// Row major size() x size() matrix of the shortest paths
+    std::vector<double> distances_;
+    /// Binary heap of (distance, index) used by Dijkstra's algorithm
+    std::vector<std::pair<double,int>> heap_;
+};
+
+}
+
+#endif // MYTHICAL_BASIN_GRAPH_HPP
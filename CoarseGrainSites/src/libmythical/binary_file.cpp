@@ -0,0 +1,184 @@
+#include "binary_file.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MYTHICAL_MMAP_AVAILABLE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Constants
+ ****************************************************************************/
+
+static const uint32_t byte_order_mark = 0x01020304;
+static const uint32_t swapped_byte_order_mark = 0x04030201;
+static const size_t alignment = 8;
+static const size_t header_size = 16;
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+Binary_Writer::Binary_Writer(
+    const string & file_name,
+    const char (&magic)[9],
+    const uint32_t version) :
+  file_(file_name, ios::binary | ios::trunc),
+  file_name_(file_name),
+  position_(0) {
+
+  if(!file_){
+    throw runtime_error("Unable to open " + file_name + " for writing.");
+  }
+  writeBytes_(magic, 8);
+  write(version);
+  write(byte_order_mark);
+}
+
+void Binary_Writer::close() {
+  file_.flush();
+  if(!file_){
+    throw runtime_error("Failed to write " + file_name_ + ".");
+  }
+  file_.close();
+}
+
+Binary_Reader::Binary_Reader(
+    const string & file_name,
+    const char (&magic)[9],
+    const uint32_t max_version) :
+  file_name_(file_name),
+  data_(nullptr),
+  size_(0),
+  position_(0),
+  version_(0),
+  mapped_(false) {
+
+#ifdef MYTHICAL_MMAP_AVAILABLE
+  int descriptor = open(file_name.c_str(), O_RDONLY);
+  if(descriptor<0){
+    throw runtime_error("Unable to open " + file_name + " for reading.");
+  }
+  struct stat status;
+  if(fstat(descriptor,&status)==0 && status.st_size>0){
+    void * mapping = mmap(nullptr, static_cast<size_t>(status.st_size),
+        PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if(mapping!=MAP_FAILED){
+      data_ = static_cast<const char *>(mapping);
+      size_ = static_cast<size_t>(status.st_size);
+      mapped_ = true;
+    }
+  }
+  ::close(descriptor);
+#endif
+
+  if(!mapped_){
+    ifstream file(file_name, ios::binary | ios::ate);
+    if(!file){
+      throw runtime_error("Unable to open " + file_name + " for reading.");
+    }
+    buffer_.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer_.data(), static_cast<streamsize>(buffer_.size()));
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+
+  // The destructor is not run if the constructor throws
+  try {
+    readHeader_(magic, max_version);
+  }catch(...){
+    unmap_();
+    throw;
+  }
+}
+
+Binary_Reader::~Binary_Reader() {
+  unmap_();
+}
+
+void Binary_Reader::checkEnd() const {
+  if(position_!=size_){
+    throw runtime_error(file_name_ + " has " + to_string(size_-position_) +
+        " unexpected bytes at the end.");
+  }
+}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+void Binary_Writer::writeBytes_(const void * data, const size_t size) {
+  file_.write(static_cast<const char *>(data), static_cast<streamsize>(size));
+  position_ += size;
+}
+
+void Binary_Writer::align_() {
+  static const char padding[alignment] = {};
+  const size_t remainder = position_ % alignment;
+  if(remainder!=0) writeBytes_(padding, alignment-remainder);
+}
+
+void Binary_Reader::readHeader_(
+    const char (&magic)[9],
+    const uint32_t max_version) {
+
+  if(size_<header_size || memcmp(data_, magic, 8)!=0){
+    throw runtime_error(file_name_ + " is not a " + string(magic, 8) +
+        " file.");
+  }
+  position_ = 8;
+  version_ = read<uint32_t>();
+  const uint32_t mark = read<uint32_t>();
+  if(mark==swapped_byte_order_mark){
+    throw runtime_error(file_name_ + " was written on a machine with a "
+        "different byte order.");
+  }
+  if(mark!=byte_order_mark){
+    throw runtime_error(file_name_ + " has a corrupt header.");
+  }
+  if(version_==0 || version_>max_version){
+    throw runtime_error(file_name_ + " has version " + to_string(version_) +
+        " only versions up to " + to_string(max_version) +
+        " can be read.");
+  }
+}
+
+void Binary_Reader::unmap_() {
+#ifdef MYTHICAL_MMAP_AVAILABLE
+  if(mapped_){
+    munmap(const_cast<char *>(data_), size_);
+    mapped_ = false;
+  }
+#endif
+}
+
+const char * Binary_Reader::take_(const size_t size) {
+  if(size>size_-position_){
+    throw runtime_error(file_name_ + " is truncated, expected " +
+        to_string(size) + " more bytes at offset " + to_string(position_) +
+        ".");
+  }
+  const char * data = data_ + position_;
+  position_ += size;
+  return data;
+}
+
+size_t Binary_Reader::arraySize_(const size_t value_size) {
+  const uint64_t count = read<uint64_t>();
+  const size_t remainder = position_ % alignment;
+  if(remainder!=0) take_(alignment-remainder);
+  if(value_size!=0 && count>(size_-position_)/value_size){
+    throw runtime_error(file_name_ + " is truncated, an array of " +
+        to_string(count) + " values does not fit in the file.");
+  }
+  return static_cast<size_t>(count);
+}
+
+}
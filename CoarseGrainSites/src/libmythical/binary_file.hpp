@@ -0,0 +1,199 @@
+#ifndef MYTHICAL_BINARY_FILE_HPP
+#define MYTHICAL_BINARY_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mythical {
+
+/**
+ * \brief Writes a versioned binary file
+ *
+ * Every file starts with a header of 16 bytes:
+ *
+ * - 8 character magic string identifying the kind of file
+ * - uint32 version of the layout that follows
+ * - uint32 0x01020304, written in the byte order of the machine
+ *
+ * Values are written in the native byte order, a reader on a machine with a
+ * different byte order refuses the file. The payload of every array is
+ * padded to start at a multiple of 8 bytes from the start of the file, so
+ * that a memory mapped file can be read without copying.
+ **/
+class Binary_Writer {
+  public:
+    /// Throws if the file cannot be opened, magic must be 8 characters
+    Binary_Writer(
+        const std::string & file_name,
+        const char (&magic)[9],
+        const uint32_t version);
+
+    template<typename T>
+    void write(const T & value) {
+      static_assert(std::is_trivially_copyable<T>::value, "Only trivially "
+          "copyable values can be written");
+      writeBytes_(&value, sizeof(T));
+    }
+
+    /// Writes the number of values as a uint64 followed by the aligned values
+    template<typename T>
+    void writeArray(const T * values, const size_t count) {
+      beginArray<T>(count);
+      writeValues(values, count);
+    }
+
+    /**
+     * \brief Start an array whose values are written in pieces
+     *
+     * Exactly count values must then be written with writeValues before
+     * anything else is written.
+     **/
+    template<typename T>
+    void beginArray(const size_t count) {
+      static_assert(std::is_trivially_copyable<T>::value, "Only trivially "
+          "copyable values can be written");
+      write(static_cast<uint64_t>(count));
+      align_();
+    }
+
+    template<typename T>
+    void writeValues(const T * values, const size_t count) {
+      writeBytes_(values, count*sizeof(T));
+    }
+
+    template<typename T>
+    void writeArray(const std::vector<T> & values) {
+      writeArray(values.data(), values.size());
+    }
+
+    void writeString(const std::string & value) {
+      writeArray(value.data(), value.size());
+    }
+
+    /// Flushes the file, throws if any of the writes failed
+    void close();
+
+  private:
+    std::ofstream file_;
+    std::string file_name_;
+    uint64_t position_;
+
+    void writeBytes_(const void * data, const size_t size);
+    void align_();
+};
+
+/**
+ * \brief Reads a file written by Binary_Writer
+ *
+ * Where possible the whole file is memory mapped, so the arrays can be
+ * viewed in place and large files are only paged in as they are read.
+ * Otherwise the file is read into memory in one go. Every read checks that
+ * the file is long enough, a truncated file throws a runtime_error rather
+ * than reading past its end.
+ **/
+class Binary_Reader {
+  public:
+    /**
+     * \brief Opens the file and checks the header
+     *
+     * Throws if the file cannot be opened, if the magic string does not
+     * match, if the version is newer than max_version or if it was written
+     * with a different byte order.
+     **/
+    Binary_Reader(
+        const std::string & file_name,
+        const char (&magic)[9],
+        const uint32_t max_version);
+    ~Binary_Reader();
+
+    Binary_Reader(const Binary_Reader &) = delete;
+    Binary_Reader & operator=(const Binary_Reader &) = delete;
+
+    uint32_t getVersion() const { return version_; }
+
+    template<typename T>
+    T read() {
+      static_assert(std::is_trivially_copyable<T>::value, "Only trivially "
+          "copyable values can be read");
+      T value;
+      std::memcpy(&value, take_(sizeof(T)), sizeof(T));
+      return value;
+    }
+
+    /**
+     * \brief View an array in place
+     *
+     * The pointer remains valid as long as the reader exists.
+     **/
+    template<typename T>
+    const T * viewArray(size_t & count) {
+      static_assert(std::is_trivially_copyable<T>::value, "Only trivially "
+          "copyable values can be read");
+      count = arraySize_(sizeof(T));
+      return reinterpret_cast<const T *>(take_(count*sizeof(T)));
+    }
+
+    template<typename T>
+    void readArray(std::vector<T> & values) {
+      size_t count;
+      const T * data = viewArray<T>(count);
+      values.assign(data, data + count);
+    }
+
+    std::string readString() {
+      size_t count;
+      const char * data = viewArray<char>(count);
+      return std::string(data, count);
+    }
+
+    /// Throws if there is anything left in the file that was not read
+    void checkEnd() const;
+
+    bool atEnd() const { return position_ == size_; }
+
+  private:
+    std::string file_name_;
+    const char * data_;
+    size_t size_;
+    size_t position_;
+    uint32_t version_;
+
+    /// Only used if the file could not be memory mapped
+    std::vector<char> buffer_;
+    bool mapped_;
+
+    void readHeader_(const char (&magic)[9], const uint32_t max_version);
+    /// Releases the memory map, if there is one
+    void unmap_();
+    const char * take_(const size_t size);
+    /// Reads the count of an array and skips the padding before its values
+    size_t arraySize_(const size_t value_size);
+};
+
+/**
+ * \brief 64 bit FNV-1a hash of a block of bytes
+ *
+ * Pass the result back in as hash to extend it with more bytes. Used to
+ * check that a file was written for the same inputs, not for security.
+ **/
+inline uint64_t hashBytes(
+    const void * data,
+    const size_t size,
+    uint64_t hash = 14695981039346656037ULL) {
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  for (size_t index = 0; index < size; ++index) {
+    hash ^= bytes[index];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+}
+
+#endif // MYTHICAL_BINARY_FILE_HPP
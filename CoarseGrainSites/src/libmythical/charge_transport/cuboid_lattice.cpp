@@ -1,6 +1,9 @@
 
 #include "mythical/charge_transport/cuboid_lattice.hpp"
+#include "libmythical/thread_pool.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -181,6 +184,28 @@ namespace mythical {
       distribution_z_ = std::uniform_int_distribution<int>(0,height_-1);
     }
 
+    std::vector<int> Cuboid::getShiftedPositions_(const int size,
+        const BoundarySetting bound,
+        const int reach,
+        const int stride) const {
+
+      const int span = 2*reach+1;
+      std::vector<int> shifted(static_cast<size_t>(size*span));
+      for ( int pos = 0; pos < size; ++pos ) {
+        for ( int shift = -reach; shift <= reach; ++shift ) {
+          int shifted_pos = pos + shift;
+          if ( bound == BoundarySetting::Periodic ) {
+            // The cutoff may reach around the lattice more than once
+            shifted_pos = ((shifted_pos % size) + size) % size;
+          } else if ( shifted_pos < 0 || shifted_pos >= size ) {
+            shifted_pos = -1;
+          }
+          shifted[pos*span + shift + reach] = shifted_pos < 0 ? -1 : shifted_pos*stride;
+        }
+      }
+      return shifted;
+    }
+
     /**************************************************************************
      * Public Methods
      *************************************************************************/
@@ -500,6 +525,135 @@ namespace mythical {
       return neigh_distances;
     }
 
+    void Cuboid::getNeighborDistances(const double cutoff,
+        std::vector<size_t> & row_offsets,
+        std::vector<int> & neighbor_ids,
+        std::vector<double> & distances,
+        const size_t thread_count) const {
+
+      std::vector<std::vector<size_t>> plane_counts(static_cast<size_t>(height_));
+      std::vector<std::vector<int>> plane_ids(static_cast<size_t>(height_));
+      std::vector<std::vector<double>> plane_distances(static_cast<size_t>(height_));
+
+      Thread_Pool thread_pool(thread_count);
+      thread_pool.parallelFor(static_cast<size_t>(height_), [&](size_t plane){
+          getPlaneNeighborDistances(static_cast<int>(plane), cutoff,
+              plane_counts[plane], plane_ids[plane], plane_distances[plane]);
+        });
+
+      std::vector<size_t> plane_offsets(static_cast<size_t>(height_) + 1, 0);
+      row_offsets.assign(1, 0);
+      row_offsets.reserve(static_cast<size_t>(total_) + 1);
+      for ( size_t plane = 0; plane < plane_counts.size(); ++plane ) {
+        for ( const size_t & count : plane_counts[plane] ) {
+          row_offsets.push_back(row_offsets.back() + count);
+        }
+        plane_offsets[plane+1] = row_offsets.back();
+      }
+
+      neighbor_ids.resize(row_offsets.back());
+      distances.resize(row_offsets.back());
+      thread_pool.parallelFor(static_cast<size_t>(height_), [&](size_t plane){
+          std::copy(plane_ids[plane].begin(), plane_ids[plane].end(),
+              neighbor_ids.begin() + static_cast<std::ptrdiff_t>(plane_offsets[plane]));
+          std::copy(plane_distances[plane].begin(), plane_distances[plane].end(),
+              distances.begin() + static_cast<std::ptrdiff_t>(plane_offsets[plane]));
+          std::vector<int>().swap(plane_ids[plane]);
+          std::vector<double>().swap(plane_distances[plane]);
+        });
+    }
+
+    void Cuboid::getPlaneNeighborDistances(const int z,
+        const double cutoff,
+        std::vector<size_t> & counts,
+        std::vector<int> & neighbor_ids,
+        std::vector<double> & distances) const {
+
+      checkPosZ_(z);
+      const int reach = static_cast<int>(std::floor(cutoff/inter_site_distance_));
+      const int span = 2*reach+1;
+
+      // The offsets within the cutoff are found once for the plane, they are
+      // ordered so the neighbors of sites away from the boundaries have
+      // increasing indices
+      struct Offset {
+        int x;
+        int y;
+        int z;
+        double distance;
+      };
+      std::vector<Offset> stencil;
+      for ( int z_shift = -reach; z_shift <= reach; ++z_shift ) {
+        for ( int y_shift = -reach; y_shift <= reach; ++y_shift ) {
+          for ( int x_shift = -reach; x_shift <= reach; ++x_shift ) {
+            if ( x_shift == 0 && y_shift == 0 && z_shift == 0 ) continue;
+            double dist = getDistance_(x_shift, y_shift, z_shift, 0, 0, 0);
+            if ( dist <= cutoff ) {
+              stencil.push_back(Offset{x_shift+reach, y_shift+reach, z_shift+reach, dist});
+            }
+          }
+        }
+      }
+
+      // Wrapping around periodic boundaries is looked up rather than
+      // worked out for every neighbor
+      const std::vector<int> x_shifted = getShiftedPositions_(length_, x_bound_, reach, 1);
+      const std::vector<int> y_shifted = getShiftedPositions_(width_, y_bound_, reach, length_);
+      const std::vector<int> z_shifted = getShiftedPositions_(height_, z_bound_, reach, length_*width_);
+
+      // Periodic images of the same site only overlap if the stencil is
+      // wider than the lattice
+      const bool images_overlap =
+        (x_bound_ == BoundarySetting::Periodic && span > length_) ||
+        (y_bound_ == BoundarySetting::Periodic && span > width_) ||
+        (z_bound_ == BoundarySetting::Periodic && span > height_);
+
+      const size_t plane_size = static_cast<size_t>(length_*width_);
+      counts.clear();
+      neighbor_ids.clear();
+      distances.clear();
+      counts.reserve(plane_size);
+      neighbor_ids.reserve(plane_size*stencil.size());
+      distances.reserve(plane_size*stencil.size());
+
+      std::vector<std::pair<int,double>> images;
+      const int * z_row = &z_shifted[z*span];
+      for ( int y = 0; y < width_; ++y ) {
+        const int * y_row = &y_shifted[y*span];
+        for ( int x = 0; x < length_; ++x ) {
+          const int * x_row = &x_shifted[x*span];
+          const int index = getIndex_(x, y, z);
+          const size_t row_start = neighbor_ids.size();
+          for ( const Offset & offset : stencil ) {
+            const int x_pos = x_row[offset.x];
+            const int y_pos = y_row[offset.y];
+            const int z_pos = z_row[offset.z];
+            if ( (x_pos | y_pos | z_pos) < 0 ) continue;
+            const int neigh_index = x_pos + y_pos + z_pos;
+            if ( neigh_index == index ) continue;
+            neighbor_ids.push_back(neigh_index);
+            distances.push_back(offset.distance);
+          }
+          if ( images_overlap ) {
+            // Keep the closest image of each neighbor
+            images.clear();
+            for ( size_t ind = row_start; ind < neighbor_ids.size(); ++ind ) {
+              images.emplace_back(neighbor_ids[ind], distances[ind]);
+            }
+            std::sort(images.begin(), images.end());
+            neighbor_ids.resize(row_start);
+            distances.resize(row_start);
+            for ( const std::pair<int,double> & image : images ) {
+              if ( neighbor_ids.size() > row_start && neighbor_ids.back() == image.first ) continue;
+              neighbor_ids.push_back(image.first);
+              distances.push_back(image.second);
+            }
+          }
+          counts.push_back(neighbor_ids.size() - row_start);
+        }
+      }
+    }
+
     double Cuboid::getSmallestDistance(const int index1, const int index2) const {
       checkIndex_(index1);
       checkIndex_(index2);
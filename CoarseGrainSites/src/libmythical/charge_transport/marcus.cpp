@@ -2,12 +2,113 @@
 #include "mythical/constants.hpp"
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 
 using namespace mythical::constants;
 
 namespace mythical {
   namespace charge_transport {
 
+    /**************************************************************************
+     * Internal Functions
+     *************************************************************************/
+
+    namespace {
+
+      // exp rounds to 0 below -746 and overflows well before 746, the
+      // argument is clamped to this magnitude so 2^n stays in range. Only
+      // the high 32 bits are compared, 746 has none set in the low half.
+      const uint64_t max_magnitude_bits = 0x4087500000000000ULL;
+      const int32_t max_magnitude_high = 0x40875000;
+      const uint64_t sign_bit = 0x8000000000000000ULL;
+
+      const double log2e = 1.4426950408889634074;
+      // ln(2) split so that n*ln2_hi is exact
+      const double ln2_hi = 6.93147180369123816490e-01;
+      const double ln2_lo = 1.90821492927058770002e-10;
+      // Adding 1.5*2^52 rounds to the nearest integer
+      const double round_shift = 6755399441055744.0;
+      // Adding 2^52 + 1023 to an integer k leaves k + 1023 in the low bits
+      // of the mantissa, shifting them up by 52 gives the bits of 2^k
+      const double exponent_shift = 4503599627371519.0;
+
+      inline double bitsToDouble(const uint64_t bits) noexcept {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+      }
+
+      inline uint64_t doubleToBits(const double value) noexcept {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+      }
+
+      /// 2^k for an integer valued k in [-1022,1023]
+      inline double powerOfTwo(const double k) noexcept {
+        return bitsToDouble(doubleToBits(k + exponent_shift) << 52);
+      }
+
+      /**
+       * exp without branches, library calls, floating point comparisons or
+       * 64 bit integer comparisons, so that GCC vectorizes loops calling it
+       * without needing -ffast-math or AVX-512
+       *
+       * exp(x) = 2^n * exp(r) with |r| <= ln(2)/2, exp(r) is found with its
+       * Taylor series up to r^13 which is accurate to well below an ulp on
+       * that range. NaN is treated as a magnitude beyond the clamp.
+       */
+      inline double exp_(double x) noexcept {
+        uint64_t bits = doubleToBits(x);
+        const int32_t magnitude_high =
+          static_cast<int32_t>(bits >> 32) & 0x7FFFFFFF;
+        bits = magnitude_high < max_magnitude_high ?
+          bits : ((bits & sign_bit) | max_magnitude_bits);
+        x = bitsToDouble(bits);
+
+        const double n = (x*log2e + round_shift) - round_shift;
+        const double r = (x - n*ln2_hi) - n*ln2_lo;
+
+        double p = 1.0/6227020800.0;
+        p = p*r + 1.0/479001600.0;
+        p = p*r + 1.0/39916800.0;
+        p = p*r + 1.0/3628800.0;
+        p = p*r + 1.0/362880.0;
+        p = p*r + 1.0/40320.0;
+        p = p*r + 1.0/5040.0;
+        p = p*r + 1.0/720.0;
+        p = p*r + 1.0/120.0;
+        p = p*r + 1.0/24.0;
+        p = p*r + 1.0/6.0;
+        p = p*r + 0.5;
+        p = p*r + 1.0;
+        p = p*r + 1.0;
+
+        // 2^n is applied in two halves so that neither overflows the exponent
+        const double half = (0.5*n + round_shift) - round_shift;
+        return p*powerOfTwo(half)*powerOfTwo(n - half);
+      }
+
+      void checkSizes_(const std::vector<double> & E_i,
+          const std::vector<double> & E_j,
+          const std::vector<double> & H_AB) {
+        if ( E_j.size() != E_i.size() || H_AB.size() != E_i.size() ) {
+          throw std::invalid_argument("Unable to calculate the rates, the "
+              "energies and couplings must be the same size, E_i has " +
+              std::to_string(E_i.size()) + " values, E_j has " +
+              std::to_string(E_j.size()) + " and H_AB has " +
+              std::to_string(H_AB.size()));
+        }
+      }
+    }
+
+    /**************************************************************************
+     * Public Methods
+     *************************************************************************/
+
     Marcus::Marcus(const double lambda, const double T) :
       lambda_(lambda), 
       expon_denom_(4.0*lambda*k_B*T),
@@ -17,5 +118,58 @@ namespace mythical {
       // DeltaG = E_j - E_i 
       return pre_factor_ * H_AB * H_AB * std::exp(-1.0*std::pow(lambda_ + E_j - E_i,2.0)/expon_denom_);
     }
+
+    void Marcus::getRates(const double * E_i,
+        const double * E_j,
+        const double * H_AB,
+        double * rates,
+        const size_t count) const noexcept {
+
+      for ( size_t ind = 0; ind < count; ++ind ) {
+        // Same operations in the same order as getRate
+        const double diff = lambda_ + E_j[ind] - E_i[ind];
+        rates[ind] = pre_factor_ * H_AB[ind] * H_AB[ind] *
+          exp_(-1.0*(diff*diff)/expon_denom_);
+      }
+    }
+
+    void Marcus::getRates(const std::vector<double> & E_i,
+        const std::vector<double> & E_j,
+        const std::vector<double> & H_AB,
+        std::vector<double> & rates) const {
+
+      checkSizes_(E_i, E_j, H_AB);
+      rates.resize(E_i.size());
+      getRates(E_i.data(), E_j.data(), H_AB.data(), rates.data(), E_i.size());
+    }
+
+    void Marcus::getForwardAndReverseRates(const double * E_i,
+        const double * E_j,
+        const double * H_AB,
+        double * forward_rates,
+        double * reverse_rates,
+        const size_t count) const noexcept {
+
+      for ( size_t ind = 0; ind < count; ++ind ) {
+        const double coupling = pre_factor_ * H_AB[ind] * H_AB[ind];
+        const double forward_diff = lambda_ + E_j[ind] - E_i[ind];
+        const double reverse_diff = lambda_ + E_i[ind] - E_j[ind];
+        forward_rates[ind] = coupling * exp_(-1.0*(forward_diff*forward_diff)/expon_denom_);
+        reverse_rates[ind] = coupling * exp_(-1.0*(reverse_diff*reverse_diff)/expon_denom_);
+      }
+    }
+
+    void Marcus::getForwardAndReverseRates(const std::vector<double> & E_i,
+        const std::vector<double> & E_j,
+        const std::vector<double> & H_AB,
+        std::vector<double> & forward_rates,
+        std::vector<double> & reverse_rates) const {
+
+      checkSizes_(E_i, E_j, H_AB);
+      forward_rates.resize(E_i.size());
+      reverse_rates.resize(E_i.size());
+      getForwardAndReverseRates(E_i.data(), E_j.data(), H_AB.data(),
+          forward_rates.data(), reverse_rates.data(), E_i.size());
+    }
   }
 }
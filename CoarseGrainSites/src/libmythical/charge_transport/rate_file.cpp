@@ -0,0 +1,172 @@
+#include "mythical/charge_transport/rate_file.hpp"
+#include "mythical/charge_transport/cuboid_lattice.hpp"
+#include "mythical/charge_transport/marcus.hpp"
+#include "mythical/rate_file.hpp"
+#include "libmythical/thread_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mythical {
+  namespace charge_transport {
+
+    namespace {
+      /// Number of sites or rates worked out before they are written
+      const size_t block_size = 4096;
+
+      /// Neighbors of the sites of one z plane of the lattice
+      struct Plane_Rows {
+        std::vector<size_t> counts;
+        std::vector<size_t> row_offsets;
+        std::vector<int> neighbor_ids;
+        std::vector<double> distances;
+        std::vector<std::pair<int,double>> row;
+      };
+
+      // The neighbors of each row are put in order of their index so that
+      // CoarseGrainSystem::initializeSystemFromFile can read the rows in
+      // place, the rows of sites next to a periodic boundary wrap around
+      void getSortedRows(const Cuboid & lattice,
+          const int z,
+          const double cutoff,
+          Plane_Rows & rows) {
+
+        lattice.getPlaneNeighborDistances(z,cutoff,rows.counts,
+            rows.neighbor_ids,rows.distances);
+        rows.row_offsets.assign(1,0);
+        for(const size_t & count : rows.counts){
+          const size_t begin = rows.row_offsets.back();
+          const size_t end = begin+count;
+          rows.row_offsets.push_back(end);
+          if(std::is_sorted(rows.neighbor_ids.begin()+begin,
+                rows.neighbor_ids.begin()+end)) continue;
+          rows.row.clear();
+          for(size_t ind = begin; ind < end; ++ind){
+            rows.row.emplace_back(rows.neighbor_ids[ind],rows.distances[ind]);
+          }
+          std::sort(rows.row.begin(),rows.row.end());
+          for(size_t ind = begin; ind < end; ++ind){
+            rows.neighbor_ids[ind] = rows.row[ind-begin].first;
+            rows.distances[ind] = rows.row[ind-begin].second;
+          }
+        }
+      }
+    }
+
+    /**************************************************************************
+     * Public Facing Functions
+     *************************************************************************/
+
+    void writeRateFile(const std::string & file_name,
+        const Cuboid & lattice,
+        const Marcus & marcus,
+        const std::vector<double> & energies,
+        const double cutoff,
+        const std::function<double(const double)> & coupling,
+        const size_t thread_count) {
+
+      const size_t site_count = static_cast<size_t>(lattice.getLength())*
+        static_cast<size_t>(lattice.getWidth())*
+        static_cast<size_t>(lattice.getHeight());
+      if(energies.size()!=site_count){
+        throw std::invalid_argument("There must be an energy for each of the "
+            + std::to_string(site_count) + " sites of the lattice, "
+            + std::to_string(energies.size()) + " were given.");
+      }
+      if(!coupling){
+        throw std::invalid_argument("A coupling function must be given to "
+            "write the rates of the lattice.");
+      }
+
+      // Only the row offsets are kept for the whole lattice, the neighbors
+      // are worked out again a batch of planes at a time for each section
+      // of the file that needs them
+      Thread_Pool thread_pool(thread_count);
+      const size_t plane_count = static_cast<size_t>(lattice.getHeight());
+      const size_t batch_size = thread_pool.size();
+      std::vector<Plane_Rows> planes(batch_size);
+      auto forEachPlane = [&](const std::function<void(const Plane_Rows &,
+            const size_t)> & use){
+        size_t first_site = 0;
+        for(size_t first = 0; first < plane_count; first+=batch_size){
+          const size_t count = std::min(plane_count-first,batch_size);
+          thread_pool.parallelFor(count,[&](size_t plane){
+              getSortedRows(lattice,static_cast<int>(first+plane),cutoff,
+                planes[plane]);
+            });
+          for(size_t plane = 0; plane < count; ++plane){
+            use(planes[plane],first_site);
+            first_site += planes[plane].counts.size();
+          }
+        }
+      };
+
+      std::vector<size_t> row_offsets(1,0);
+      row_offsets.reserve(site_count+1);
+      forEachPlane([&](const Plane_Rows & rows, const size_t){
+          for(const size_t & count : rows.counts){
+            row_offsets.push_back(row_offsets.back()+count);
+          }
+        });
+
+      RateFileWriter writer(file_name,site_count,row_offsets.back(),true,true);
+
+      std::vector<int> site_ids(std::min(site_count,block_size));
+      for(size_t first = 0; first < site_count; first+=block_size){
+        const size_t count = std::min(site_count-first,block_size);
+        std::iota(site_ids.begin(),site_ids.begin()+count,
+            static_cast<int>(first));
+        writer.writeSiteIds(site_ids.data(),count);
+      }
+      writer.writeRowOffsets(row_offsets.data(),row_offsets.size());
+      forEachPlane([&](const Plane_Rows & rows, const size_t){
+          writer.writeNeighborIds(rows.neighbor_ids.data(),
+              rows.neighbor_ids.size());
+        });
+
+      // The rates of a block of neighbors are worked out together so the
+      // vectorized loop of getRates is used
+      std::vector<double> E_i(block_size);
+      std::vector<double> E_j(block_size);
+      std::vector<double> H_AB(block_size);
+      std::vector<double> rates(block_size);
+      forEachPlane([&](const Plane_Rows & rows, const size_t first_site){
+          size_t site = 0;
+          const size_t rate_count = rows.neighbor_ids.size();
+          for(size_t first = 0; first < rate_count; first+=block_size){
+            const size_t count = std::min(rate_count-first,block_size);
+            for(size_t index = 0; index < count; ++index){
+              const size_t neighbor = first+index;
+              while(rows.row_offsets[site+1]<=neighbor) ++site;
+              E_i[index] = energies[first_site+site];
+              E_j[index] = energies[static_cast<size_t>(rows.neighbor_ids[neighbor])];
+              H_AB[index] = coupling(rows.distances[neighbor]);
+            }
+            marcus.getRates(E_i.data(),E_j.data(),H_AB.data(),rates.data(),count);
+            writer.writeRates(rates.data(),count);
+          }
+        });
+
+      const double spacing = lattice.getLatticeSpacing();
+      std::vector<double> positions(3*std::min(site_count,block_size));
+      for(size_t first = 0; first < site_count; first+=block_size){
+        const size_t count = std::min(site_count-first,block_size);
+        for(size_t index = 0; index < count; ++index){
+          const int site_index = static_cast<int>(first+index);
+          positions[3*index] = spacing*lattice.getX(site_index);
+          positions[3*index+1] = spacing*lattice.getY(site_index);
+          positions[3*index+2] = spacing*lattice.getZ(site_index);
+        }
+        writer.writePositions(positions.data(),3*count);
+      }
+      writer.writeEnergies(energies.data(),energies.size());
+      writer.close();
+    }
+
+  }
+}
@@ -30,6 +30,16 @@ namespace mythical {
     return clusters_[clusterId];
   }
 
+  const Cluster& Cluster_Container::getCluster(int clusterId) const {
+    auto it = clusters_.find(clusterId);
+    if(it==clusters_.end()){
+      cerr << "Trying to access cluster with id " << clusterId << endl;
+      throw invalid_argument("Cannot get cluster as it is not stored in the"
+          " container.");
+    }
+    return it->second;
+  }
+
   bool Cluster_Container::exist(const int & clusterId) const{
     if(clusters_.count(clusterId)){
       return true;
@@ -21,6 +21,7 @@ class Cluster_Container {
     void addCluster(Cluster& cluster);
     void addClusters(std::vector<Cluster>& clusters);
     Cluster& getCluster(int clusterId);
+    const Cluster& getCluster(int clusterId) const;
 
     size_t size() const { return clusters_.size();}
 
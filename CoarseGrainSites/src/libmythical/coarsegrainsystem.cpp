@@ -1,36 +1,39 @@
 
+#include <cassert>
 #include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <numeric>
+#include <set>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_set>
 
 #include "mythical/coarsegrainsystem.hpp"
 #include "mythical/constants.hpp"
+#include "mythical/event_log.hpp"
+#include "mythical/indexed_queue.hpp"
+#include "mythical/rate_file.hpp"
 #include "mythical/walker.hpp"
+#include "mythical/walker_pool.hpp"
 
 #include "topologyfeatures/topology_feature.hpp"
 #include "topologyfeatures/cluster.hpp"
 #include "topologyfeatures/site.hpp"
 #include "log.hpp"
 #include "basin_explorer.hpp"
-#include "graph_library_adapter.hpp"
+#include "binary_file.hpp"
+#include "basin_graph.hpp"
+#include "random_stream.hpp"
+#include "rate_graph.hpp"
 #include "site_container.hpp"
 #include "cluster_container.hpp"
-
-#include "../../../UGLY/include/ugly/pair_hash.hpp"
-#include "../../../UGLY/include/ugly/edge_directed_weighted.hpp"
-#include "../../../UGLY/include/ugly/graph.hpp"
-#include "../../../UGLY/include/ugly/graph_algorithms.hpp"
-#include "../../../UGLY/include/ugly/graph_node.hpp"
-#include "../../../UGLY/include/ugly/graphvisitor/graphvisitor_smallest_known_value.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 using namespace std::chrono;
-using namespace ugly;
-using namespace ugly::graphalgorithms;
 
 namespace mythical {
   /****************************************************************************
@@ -41,11 +44,31 @@ namespace mythical {
     return x.second>y.second;
   }
 
-  unordered_map<int, shared_ptr<GraphNode<string>>> createNode_(int siteIds);
-
   size_t countUniqueClusters(const unordered_map<int,int> & sites_and_clusters);
   int getFavoredClusterId(unordered_map<int,int> sites_and_clusters);
 
+  /// Identifies snapshot files, the version is increased whenever the layout
+  /// written by saveSnapshot changes
+  static const char snapshot_magic[9] = "MYTHSNAP";
+  static const uint32_t snapshot_version = 2;
+
+  /// Identifies cluster caches written by exportClusters
+  static const char cluster_cache_magic[9] = "MYTHCLST";
+  static const uint32_t cluster_cache_version = 2;
+
+  /// Version 1 files store random streams that are no longer drawn from in
+  /// the same way, they cannot be continued
+  void checkNotOlder(
+      const Binary_Reader & reader,
+      const uint32_t version,
+      const string & file_name){
+    if(reader.getVersion()<version){
+      throw runtime_error(file_name + " was written with version " +
+          to_string(reader.getVersion()) + " of the layout, only version " +
+          to_string(version) + " can be read.");
+    }
+  }
+
   /****************************************************************************
    * Public Facing Functions
    ****************************************************************************/
@@ -53,7 +76,11 @@ namespace mythical {
   CoarseGrainSystem::CoarseGrainSystem() :
     performance_ratio_(1.00),
     seed_set_(false),
-    seed_(0),
+    seed_(static_cast<unsigned long>(
+          system_clock::now().time_since_epoch().count())),
+    random_policy_(RandomPolicy::counter_based),
+    direct_cluster_exit_(false),
+    next_cluster_id_(0),
     time_resolution_set_(false),
     minimum_coarse_graining_resolution_(2),
     iteration_(0),
@@ -61,6 +88,8 @@ namespace mythical {
     iteration_threshold_min_(1000){
       sites_ = unique_ptr<Site_Container>( new Site_Container );
       clusters_ = unique_ptr<Cluster_Container>( new Cluster_Container );
+      basin_explorer_ = unique_ptr<BasinExplorer>( new BasinExplorer );
+      basin_graph_ = unique_ptr<Basin_Graph>( new Basin_Graph );
     }
 
   CoarseGrainSystem::~CoarseGrainSystem(){
@@ -82,7 +111,7 @@ namespace mythical {
     time_resolution_ = time_resolution;
   }
 
-  void CoarseGrainSystem::initializeSystem(unordered_map<int, unordered_map<int, double>>& ratesOfAllSites) {
+  void CoarseGrainSystem::initializeSystem(const unordered_map<int, unordered_map<int, double>>& ratesOfAllSites) {
 
     LOG("Initializeing system", 1);
 
@@ -91,35 +120,326 @@ namespace mythical {
           "before you can initialize the system.");
     }
 
-    for (auto it = ratesOfAllSites.begin(); it != ratesOfAllSites.end(); ++it) {
-      Site site;
-      site.setId(it->first);
+    rate_graph_ = make_shared<Rate_Graph>(ratesOfAllSites);
+    // Seeds are handed out in the order the sites were provided
+    vector<int> seed_order;
+    seed_order.reserve(ratesOfAllSites.size());
+    for( const auto & site_and_rates : ratesOfAllSites ){
+      seed_order.push_back(site_and_rates.first);
+    }
+    initializeSitesFromRateGraph_(seed_order.data(),seed_order.size());
+  }
 
-      site.setRatesToNeighbors(it->second);
-      if (seed_set_) {
-        site.setRandomSeed(seed_);
-        ++seed_;
+  void CoarseGrainSystem::initializeSystem(
+      vector<size_t> row_offsets,
+      vector<int> neighbor_ids,
+      vector<double> rates) {
+
+    LOG("Initializeing system from compressed sparse row arrays", 1);
+
+    if(!time_resolution_set_){
+      throw runtime_error("You must first set the time resolution of the system "
+          "before you can initialize the system.");
+    }
+    if(row_offsets.empty()){
+      throw invalid_argument("Cannot initialize system, the row offsets must "
+          "contain at least a single value.");
+    }
+
+    vector<int> site_ids(row_offsets.size()-1);
+    iota(site_ids.begin(),site_ids.end(),0);
+    vector<int> seed_order = site_ids;
+    rate_graph_ = make_shared<Rate_Graph>(
+        move(site_ids),
+        move(row_offsets),
+        move(neighbor_ids),
+        move(rates));
+    initializeSitesFromRateGraph_(seed_order.data(),seed_order.size());
+  }
+
+  void CoarseGrainSystem::initializeSystemFromFile(const string & file_name) {
+
+    LOG("Initializeing system from a rate file", 1);
+
+    if(!time_resolution_set_){
+      throw runtime_error("You must first set the time resolution of the system "
+          "before you can initialize the system.");
+    }
+
+    // The rate graph reads the mapped arrays in place and keeps the file
+    // mapped for as long as it is alive
+    auto reader = make_shared<RateFileReader>(file_name);
+    const size_t site_count = reader->getNumberOfSites();
+    const int * site_ids = reader->getSiteIds();
+    if(is_same<size_t,uint64_t>::value){
+      rate_graph_ = make_shared<Rate_Graph>(
+          reader,
+          site_ids,
+          reinterpret_cast<const size_t *>(reader->getRowOffsets()),
+          reader->getNeighborIds(),
+          reader->getRates(),
+          site_count);
+    }else{
+      const size_t rate_count = reader->getNumberOfRates();
+      rate_graph_ = make_shared<Rate_Graph>(
+          vector<int>(site_ids,site_ids+site_count),
+          vector<size_t>(reader->getRowOffsets(),
+            reader->getRowOffsets()+site_count+1),
+          vector<int>(reader->getNeighborIds(),
+            reader->getNeighborIds()+rate_count),
+          vector<double>(reader->getRates(),reader->getRates()+rate_count));
+    }
+    initializeSitesFromRateGraph_(site_ids,site_count);
+  }
+
+  void CoarseGrainSystem::initializeSystem(const CoarseGrainSystem & system) {
+
+    LOG("Initializeing system from the rates of another system", 1);
+
+    if(!time_resolution_set_){
+      throw runtime_error("You must first set the time resolution of the system "
+          "before you can initialize the system.");
+    }
+    if(!system.rate_graph_){
+      throw invalid_argument("Cannot initialize system, the system providing "
+          "the rates has not been initialized.");
+    }
+
+    // The rate graph is never modified so it can be read by both systems
+    rate_graph_ = system.rate_graph_;
+    vector<int> seed_order;
+    seed_order.reserve(rate_graph_->size());
+    for( size_t index = 0; index < rate_graph_->size(); ++index){
+      seed_order.push_back(rate_graph_->getSiteId(static_cast<int>(index)));
+    }
+    initializeSitesFromRateGraph_(seed_order.data(),seed_order.size());
+  }
+
+  void CoarseGrainSystem::saveSnapshot(const string & file_name) {
+    if (topology_features_.size() == 0) {
+      throw runtime_error("Cannot save a snapshot of a system that has not "
+          "been initialized.");
+    }
+    Binary_Writer writer(file_name,snapshot_magic,snapshot_version);
+    saveSnapshot_(writer);
+    writer.write(static_cast<uint8_t>(0));
+    writer.close();
+  }
+
+  void CoarseGrainSystem::saveSnapshot(
+      const string & file_name,
+      const WalkerPool & walkers) {
+    if (topology_features_.size() == 0) {
+      throw runtime_error("Cannot save a snapshot of a system that has not "
+          "been initialized.");
+    }
+    Binary_Writer writer(file_name,snapshot_magic,snapshot_version);
+    saveSnapshot_(writer);
+    writer.write(static_cast<uint8_t>(1));
+    writer.writeArray(walkers.current_site_);
+    writer.writeArray(walkers.potential_site_);
+    writer.writeArray(walkers.dwell_time_);
+    writer.writeArray(walkers.time_);
+    // In time order, adding them back in this order keeps the order of
+    // walkers that share a time
+    vector<int> active_ids;
+    vector<double> active_times;
+    for( size_t index = 0; index < walkers.event_queue_.size(); ++index){
+      const pair<int,double> & event = walkers.event_queue_.at(static_cast<int>(index));
+      active_ids.push_back(event.first);
+      active_times.push_back(event.second);
+    }
+    writer.writeArray(active_ids);
+    writer.writeArray(active_times);
+    writer.close();
+  }
+
+  void CoarseGrainSystem::loadSnapshot(const string & file_name) {
+    if (topology_features_.size() != 0) {
+      throw runtime_error("A snapshot can only be loaded into a system that "
+          "has not been initialized.");
+    }
+    Binary_Reader reader(file_name,snapshot_magic,snapshot_version);
+    checkNotOlder(reader,snapshot_version,file_name);
+    try {
+      loadSnapshot_(reader);
+      // Any walkers are left for the caller to restore
+    } catch(...) {
+      resetSystem_();
+      throw;
+    }
+  }
+
+  void CoarseGrainSystem::loadSnapshot(
+      const string & file_name,
+      WalkerPool & walkers) {
+    if (topology_features_.size() != 0) {
+      throw runtime_error("A snapshot can only be loaded into a system that "
+          "has not been initialized.");
+    }
+    Binary_Reader reader(file_name,snapshot_magic,snapshot_version);
+    checkNotOlder(reader,snapshot_version,file_name);
+    try {
+      loadSnapshot_(reader);
+      if (reader.read<uint8_t>() == 0) {
+        throw runtime_error("The snapshot " + file_name + " does not "
+            "contain any walkers.");
+      }
+      WalkerPool pool;
+      reader.readArray(pool.current_site_);
+      reader.readArray(pool.potential_site_);
+      reader.readArray(pool.dwell_time_);
+      reader.readArray(pool.time_);
+      vector<int> active_ids;
+      vector<double> active_times;
+      reader.readArray(active_ids);
+      reader.readArray(active_times);
+      reader.checkEnd();
+
+      const size_t count = pool.current_site_.size();
+      if (pool.potential_site_.size() != count ||
+          pool.dwell_time_.size() != count ||
+          pool.time_.size() != count ||
+          active_ids.size() != active_times.size()) {
+        throw runtime_error("The walkers stored in the snapshot " +
+            file_name + " are inconsistent.");
       }
-      sites_->addSite(site);
-      topology_features_[it->first] = &(sites_->getSite(it->first));
+      for( size_t index = 0; index < active_ids.size(); ++index){
+        if (active_ids[index] < 0 ||
+            static_cast<size_t>(active_ids[index]) >= count) {
+          throw runtime_error("The snapshot " + file_name + " contains an "
+              "unknown active walker " + to_string(active_ids[index]) + ".");
+        }
+        pool.event_queue_.add(pair<int,double>(active_ids[index],active_times[index]));
+      }
+      walkers = move(pool);
+    } catch(...) {
+      resetSystem_();
+      throw;
+    }
+  }
+
+  uint64_t CoarseGrainSystem::getClusterCacheKey() const {
+    if(!rate_graph_){
+      throw runtime_error("The system must be initialized before the key of "
+          "its clusters is known.");
+    }
+    uint64_t key = rate_graph_->getHash();
+    key = hashBytes(&time_resolution_,sizeof(time_resolution_),key);
+    key = hashBytes(&performance_ratio_,sizeof(performance_ratio_),key);
+    return hashBytes(&minimum_coarse_graining_resolution_,
+        sizeof(minimum_coarse_graining_resolution_),key);
+  }
+
+  void CoarseGrainSystem::exportClusters(const string & file_name) const {
+    const uint64_t key = getClusterCacheKey();
+    Binary_Writer writer(file_name,cluster_cache_magic,cluster_cache_version);
+    writer.write(key);
+    writer.write(static_cast<int32_t>(next_cluster_id_));
+
+    vector<int> cluster_ids = clusters_->getClusterIds();
+    sort(cluster_ids.begin(),cluster_ids.end());
+    writer.write(static_cast<uint64_t>(cluster_ids.size()));
+    for( const int & cluster_id : cluster_ids ){
+      const Cluster & cluster = clusters_->getCluster(cluster_id);
+      writer.write(static_cast<int32_t>(cluster_id));
+      writer.writeArray(cluster.getSiteIdsInCluster());
+      cluster.saveSolution(writer);
     }
+    writer.close();
+  }
 
-    // Address sites that will act as drains with no rates off of them
-    unordered_set<int> drain_sites;
-    for (pair<const int,unordered_map<int,double>> & sites_and_rates : ratesOfAllSites){
-      for(const pair<int,double> & site_and_rate : sites_and_rates.second ){
-        if(ratesOfAllSites.count(site_and_rate.first)==0){
-          drain_sites.insert(site_and_rate.first);
+  void CoarseGrainSystem::importClusters(const string & file_name) {
+    const uint64_t key = getClusterCacheKey();
+    if(clusters_->size()!=0){
+      throw runtime_error("Clusters can only be imported before any clusters "
+          "have formed.");
+    }
+    Binary_Reader reader(file_name,cluster_cache_magic,cluster_cache_version);
+    checkNotOlder(reader,cluster_cache_version,file_name);
+    if(reader.read<uint64_t>()!=key){
+      throw runtime_error("The cluster cache " + file_name + " was written "
+          "for different rates or settings.");
+    }
+    const int next_cluster_id = reader.read<int32_t>();
+
+    // The clusters are only added to the system once all of them have been
+    // read, so a bad cache leaves the system untouched
+    vector<Cluster> clusters;
+    vector<int> clustered_sites;
+    try {
+      const uint64_t cluster_count = reader.read<uint64_t>();
+      for( uint64_t cluster_index = 0; cluster_index < cluster_count; ++cluster_index){
+        const int cluster_id = reader.read<int32_t>();
+        vector<int> site_ids;
+        reader.readArray(site_ids);
+        clusters.emplace_back(cluster_id);
+        Cluster & cluster = clusters.back();
+        for( const int & site_id : site_ids ){
+          if(!sites_->exist(site_id) || sites_->partOfCluster(site_id)){
+            throw runtime_error("Cluster " + to_string(cluster_id) + " of the "
+                "cache contains an unknown site or one that is already part "
+                "of another cluster.");
+          }
+          if(!excluded_from_clusters_.empty() &&
+              excluded_from_clusters_[static_cast<size_t>(sites_->getIndex(site_id))]){
+            throw runtime_error("Cluster " + to_string(cluster_id) + " of the "
+                "cache contains site " + to_string(site_id) + " which is "
+                "excluded from clusters.");
+          }
+          cluster.addSite(sites_->getSite(site_id));
+          clustered_sites.push_back(site_id);
         }
+        cluster.loadSolution(reader);
       }
+      reader.checkEnd();
+    } catch(...) {
+      for( const int & site_id : clustered_sites ){
+        sites_->setClusterId(site_id,constants::unassignedId);
+      }
+      throw;
     }
 
-    for( const int & drain_site_id : drain_sites ){
-      Site site;
-      site.setId(drain_site_id);
-      sites_->addSite(site);
-      topology_features_[drain_site_id] = &(sites_->getSite(drain_site_id));
+    for( Cluster & cluster : clusters ){
+      cluster.setRandomPolicy(random_policy_);
+      cluster.setExitDirectly(direct_cluster_exit_);
+      if (seed_set_) {
+        seedTopologyFeature_(cluster,Random_Stream::clusterStream(cluster.getId()));
+      }
+      clusters_->addCluster(cluster);
+      Cluster & stored_cluster = clusters_->getCluster(cluster.getId());
+      for( const int & site_id : stored_cluster.getSiteIdsInCluster() ){
+        topology_features_[sites_->getIndex(site_id)] = &stored_cluster;
+      }
     }
+    if(next_cluster_id > next_cluster_id_) next_cluster_id_ = next_cluster_id;
+  }
+
+  void CoarseGrainSystem::setDirectClusterExit(const bool direct_exit){
+    direct_cluster_exit_ = direct_exit;
+    for(const int & clusterId : clusters_->getClusterIds()){
+      clusters_->getCluster(clusterId).setExitDirectly(direct_exit);
+    }
+  }
+
+  int CoarseGrainSystem::sampleOccupiedSite(const int siteId){
+    if(sites_->exist(siteId)==false){
+      throw invalid_argument("Cannot sample the occupied site, site " +
+          to_string(siteId) + " is not stored in the coarse grained system.");
+    }
+    if(!sites_->partOfCluster(siteId)) return siteId;
+    Cluster & cluster = clusters_->getCluster(sites_->getClusterIdOfSite(siteId));
+    if(!cluster.exitsDirectly()) return siteId;
+
+    if(!observer_stream_){
+      if(seed_set_){
+        observer_stream_ = unique_ptr<Random_Stream>(
+            new Random_Stream(seed_,Random_Stream::observerStream()));
+      }else{
+        observer_stream_ = unique_ptr<Random_Stream>(new Random_Stream);
+      }
+    }
+    return cluster.pickOccupiedSite(*observer_stream_);
   }
 
   int CoarseGrainSystem::getVisitFrequencyOfSite(const int siteId){
@@ -156,7 +476,7 @@ namespace mythical {
         throw runtime_error(error_msg);
       }
 
-      if (topology_features_.count(siteId) == 0 ) {
+      if (!sites_->exist(siteId)) {
         string error_msg = std::string(__FILE__) + ":" + to_string(__LINE__) +
           " Walker at index " + to_string(index) +
           " is found to occupy site " + to_string(siteId) + " but an associated"
@@ -165,15 +485,68 @@ namespace mythical {
           "within the rates parameter.";
         throw runtime_error(error_msg);
       }
-      topology_features_[siteId]->occupy();
+      TopologyFeature * feature = getTopologyFeature_(siteId);
+      feature->occupy();
+
+      registerWalkerStep_(walkers.at(index).first);
+      drawNextHop_(*feature,walkers.at(index).first,*(walkers.at(index).second));
+    }
+  }
+
+  void CoarseGrainSystem::initializeWalkers(WalkerPool & walkers) {
+
+    LOG("Initializeing walkers", 1);
 
-      auto hopTime = topology_features_[siteId]->getDwellTime(walkers.at(index).first);
-      int newId = topology_features_[siteId]->pickNewSiteId(walkers.at(index).first);
-      walkers.at(index).second->setDwellTime(hopTime);
-      walkers.at(index).second->setPotentialSite(newId);
+    if (topology_features_.size() == 0) {
+      throw runtime_error(
+          "You must first initialize the system before you "
+          "can initialize the walkers");
+    }
+    for ( size_t index = 0; index<walkers.size(); ++index){
+      const int walker_id = static_cast<int>(index);
+      // Walkers added to the pool since the last call
+      if(walkers.isActive(walker_id)) continue;
+      initializeWalker(walkers,walker_id);
     }
   }
 
+  void CoarseGrainSystem::initializeWalker(WalkerPool & walkers, const int walker_id) {
+
+    if (topology_features_.size() == 0) {
+      throw runtime_error(
+          "You must first initialize the system before you "
+          "can initialize the walkers");
+    }
+    if (walker_id<0 || static_cast<size_t>(walker_id)>=walkers.size()) {
+      throw out_of_range("Cannot initialize walker " + to_string(walker_id) +
+          " it has not been added to the pool.");
+    }
+    if (walkers.isActive(walker_id)) {
+      throw invalid_argument("Cannot initialize walker " +
+          to_string(walker_id) + " it is already active in the system.");
+    }
+    const size_t index = static_cast<size_t>(walker_id);
+    const int siteId = walkers.current_site_[index];
+    if (!sites_->exist(siteId)) {
+      string error_msg = std::string(__FILE__) + ":" + to_string(__LINE__) +
+        " Walker " + to_string(walker_id) +
+        " is found to occupy site " + to_string(siteId) + " but an associated"
+        " topology feature is missing for that site, be sure that when "
+        "initizeSystem was called that this site existed "
+        "within the rates parameter.";
+      throw runtime_error(error_msg);
+    }
+    TopologyFeature * feature = getTopologyFeature_(siteId);
+    feature->occupy();
+
+    registerWalkerStep_(walker_id);
+    drawNextHop_(*feature,walker_id,
+        walkers.dwell_time_[index],
+        walkers.potential_site_[index]);
+    walkers.time_[index] += walkers.dwell_time_[index];
+    walkers.event_queue_.add(pair<int,double>(walker_id,walkers.time_[index]));
+  }
+
   void CoarseGrainSystem::setMinCoarseGrainIterationThreshold(const int threshold_min) {
     LOG("Setting minimum coarse graining threshold", 1);
     iteration_threshold_min_ = threshold_min;
@@ -190,6 +563,20 @@ namespace mythical {
     seed_set_ = true;
   }
 
+  void CoarseGrainSystem::setRandomPolicy(const RandomPolicy policy) {
+    if (topology_features_.size() != 0) {
+      throw runtime_error(
+          "For the random policy to have an affect, it must be "
+          "set before initializeSystem is called");
+    }
+    random_policy_ = policy;
+  }
+
+  void CoarseGrainSystem::setEventLog(std::shared_ptr<EventLog> event_log) {
+    event_log_ = event_log;
+    walker_clocks_.clear();
+  }
+
   void CoarseGrainSystem::removeWalkerFromSystem(pair<int,std::shared_ptr<Walker>>& walker) {
     removeWalkerFromSystem(walker.first,walker.second);
   }
@@ -197,36 +584,455 @@ namespace mythical {
   void CoarseGrainSystem::removeWalkerFromSystem(int walker_id, std::shared_ptr<Walker>& walker) {
     LOG("Walker is being removed from system", 1);
     auto siteId = walker->getIdOfSiteCurrentlyOccupying();
-    topology_features_[siteId]->removeWalker(walker_id,siteId);
+    getTopologyFeature_(siteId)->removeWalker(walker_id,siteId);
+    walker_clocks_.erase(walker_id);
+  }
+
+  void CoarseGrainSystem::removeWalkerFromSystem(WalkerPool & walkers, const int walker_id) {
+    LOG("Walker is being removed from system", 1);
+    if(!walkers.isActive(walker_id)){
+      throw invalid_argument("Cannot remove walker " + to_string(walker_id) +
+          " it is not active in the system.");
+    }
+    auto siteId = walkers.current_site_[walker_id];
+    getTopologyFeature_(siteId)->removeWalker(walker_id,siteId);
+    walkers.event_queue_.remove(walker_id);
   }
 
   int CoarseGrainSystem::getClusterIdOfSite(const int siteId) {
     return sites_->getClusterIdOfSite(siteId);
   }
 
+  bool CoarseGrainSystem::isSiteOccupied(const int siteId) {
+    if(sites_->exist(siteId)==false){
+      throw invalid_argument("Cannot check the occupancy, site " +
+          to_string(siteId) + " is not stored in the coarse grained system.");
+    }
+    return getTopologyFeature_(siteId)->isOccupied(siteId);
+  }
+
+  void CoarseGrainSystem::setSiteOccupied(const int siteId, const bool occupied) {
+    if(sites_->exist(siteId)==false){
+      throw invalid_argument("Cannot set the occupancy, site " +
+          to_string(siteId) + " is not stored in the coarse grained system.");
+    }
+    if(sites_->partOfCluster(siteId)){
+      throw invalid_argument("Cannot set the occupancy of site " +
+          to_string(siteId) + " it is part of a cluster.");
+    }
+    Site & site = sites_->getSite(siteId);
+    if(occupied){
+      site.setToOccupiedStatus();
+    }else{
+      site.setToUnoccupiedStatus();
+    }
+  }
+
+  void CoarseGrainSystem::excludeSitesFromClusters(const vector<int> & siteIds) {
+    if (topology_features_.size() == 0) {
+      throw runtime_error("Sites can only be excluded from clusters once the "
+          "system has been initialized.");
+    }
+    excluded_from_clusters_.resize(topology_features_.size(),false);
+    for(const int & siteId : siteIds){
+      if(sites_->exist(siteId)==false){
+        throw invalid_argument("Cannot exclude site " + to_string(siteId) +
+            " from clusters it is not stored in the coarse grained system.");
+      }
+      if(sites_->partOfCluster(siteId)){
+        throw invalid_argument("Cannot exclude site " + to_string(siteId) +
+            " from clusters it is already part of one.");
+      }
+      excluded_from_clusters_[sites_->getIndex(siteId)] = true;
+    }
+  }
+
   void CoarseGrainSystem::hop(pair<int,std::shared_ptr<Walker>>& walker) {
     hop(walker.first,walker.second);
   }
 
   void CoarseGrainSystem::hop(int walker_id, std::shared_ptr<Walker> & walker) {
-    const int & siteId = walker->getIdOfSiteCurrentlyOccupying();
-    const int & siteToHopToId = walker->getPotentialSite();
-    TopologyFeature * feature = topology_features_[siteId];
-    TopologyFeature * feature_to_hop_to = topology_features_[siteToHopToId];
+    if(event_log_){
+      double & time = walker_clocks_[walker_id];
+      time += walker->getDwellTime();
+      const bool in_cluster =
+        sites_->partOfCluster(walker->getIdOfSiteCurrentlyOccupying());
+      const int siteId = hopWalker_(walker_id,*walker);
+      recordHop_(walker_id,siteId,walker->getIdOfSiteCurrentlyOccupying(),time,
+          in_cluster);
+    }else{
+      hopWalker_(walker_id,*walker);
+    }
+  }
+
+  void CoarseGrainSystem::hop(WalkerPool & walkers, const int walker_id) {
+    if(!walkers.isActive(walker_id)){
+      throw invalid_argument("Cannot hop walker " + to_string(walker_id) +
+          " it is not active in the system.");
+    }
+    const int siteId = walkers.current_site_[walker_id];
+    // Before the hop, which may coarse grain the site
+    const bool in_cluster = event_log_ && sites_->partOfCluster(siteId);
+    walkers.current_site_[walker_id] = moveWalker_(
+        walker_id,
+        siteId,
+        walkers.potential_site_[walker_id],
+        walkers.dwell_time_[walker_id],
+        walkers.potential_site_[walker_id]);
+    if(event_log_){
+      recordHop_(walker_id,siteId,walkers.current_site_[walker_id],
+          walkers.time_[walker_id],in_cluster);
+    }
+    walkers.time_[walker_id] += walkers.dwell_time_[walker_id];
+    walkers.event_queue_.reschedule(walker_id,walkers.time_[walker_id]);
+  }
+
+  size_t CoarseGrainSystem::hop(
+      vector<pair<int,std::shared_ptr<Walker>>>& walkers,
+      IndexedQueue & event_queue,
+      const double time_horizon,
+      const HopCallback & callback) {
 
+    unordered_map<int,size_t> walker_index;
+    walker_index.reserve(walkers.size());
+    for( size_t index = 0; index < walkers.size(); ++index){
+      walker_index[walkers[index].first] = index;
+    }
+
+    size_t hop_count = 0;
+    while(!event_queue.empty() && event_queue.at(0).second < time_horizon){
+      const int walker_id = event_queue.at(0).first;
+      auto it = walker_index.find(walker_id);
+      if(it==walker_index.end()){
+        throw invalid_argument("Walker " + to_string(walker_id) + " is in the "
+            "event queue but was not passed in with the walkers.");
+      }
+      std::shared_ptr<Walker> & walker = walkers[it->second].second;
+      const bool in_cluster = event_log_ &&
+        sites_->partOfCluster(walker->getIdOfSiteCurrentlyOccupying());
+      const int previous_site_id = hopWalker_(walker_id,*walker);
+      ++hop_count;
+      // The event queue holds the absolute time of the hop
+      if(event_log_){
+        walker_clocks_[walker_id] = event_queue.at(0).second;
+        recordHop_(walker_id,previous_site_id,
+            walker->getIdOfSiteCurrentlyOccupying(),event_queue.at(0).second,
+            in_cluster);
+      }
+
+      const double time = event_queue.at(0).second + walker->getDwellTime();
+      if(callback && !callback(walker_id,previous_site_id,*walker,time)){
+        event_queue.remove(walker_id);
+        removeWalkerFromSystem(walker_id,walker);
+      }else{
+        event_queue.reschedule(walker_id,time);
+      }
+    }
+    return hop_count;
+  }
+
+  size_t CoarseGrainSystem::hop(
+      WalkerPool & walkers,
+      const double time_horizon,
+      const WalkerPoolHopCallback & callback) {
+
+    IndexedQueue & event_queue = walkers.event_queue_;
+    size_t hop_count = 0;
+    while(!event_queue.empty() && event_queue.at(0).second < time_horizon){
+      const int walker_id = event_queue.at(0).first;
+      const int previous_site_id = walkers.current_site_[walker_id];
+      hop(walkers,walker_id);
+      ++hop_count;
+      if(callback && !callback(walker_id,previous_site_id)){
+        removeWalkerFromSystem(walkers,walker_id);
+      }
+    }
+    return hop_count;
+  }
+
+  /****************************************************************************
+   * Internal Private Functions
+   ****************************************************************************/
+
+  int CoarseGrainSystem::hopWalker_(const int walker_id, Walker & walker) {
+    const int siteId = walker.getIdOfSiteCurrentlyOccupying();
+    double dwell_time;
+    int potential_site;
+    int new_siteId = moveWalker_(
+        walker_id,
+        siteId,
+        walker.getPotentialSite(),
+        dwell_time,
+        potential_site);
+    walker.occupySite(new_siteId);
+    walker.setDwellTime(dwell_time);
+    walker.setPotentialSite(potential_site);
+    return siteId;
+  }
+
+  void CoarseGrainSystem::recordHop_(
+      const int walker_id,
+      const int siteId,
+      const int new_siteId,
+      const double time,
+      const bool in_cluster){
+
+    HopEvent event;
+    event.walker_id = walker_id;
+    event.from_site_id = siteId;
+    event.to_site_id = new_siteId;
+    event.time = time;
+    event.in_cluster = in_cluster;
+    event_log_->record(event);
+  }
+
+  void CoarseGrainSystem::initializeSitesFromRateGraph_(
+      const int * seed_order, const size_t seed_count){
+
+    sites_->addSites(rate_graph_);
+    // The sites are only referenced once they have all been added, as the
+    // container may reallocate while it grows
+    topology_features_.assign(sites_->size(),nullptr);
+    for( size_t index = 0; index < sites_->size(); ++index){
+      Site & site = sites_->getSiteByIndex(index);
+      site.setRandomPolicy(random_policy_);
+      topology_features_[index] = &site;
+    }
+
+    // Drains have no rates off of them and are never seeded
+    if (seed_set_) {
+      for( size_t index = 0; index < seed_count; ++index){
+        const int site_id = seed_order[index];
+        Site & site = sites_->getSite(site_id);
+        if(site.getNumberOfNeighbors()>0){
+          seedTopologyFeature_(site,Random_Stream::siteStream(site_id));
+        }
+      }
+    }
+  }
+
+  void CoarseGrainSystem::saveSnapshot_(Binary_Writer & writer){
+
+    writer.write(performance_ratio_);
+    writer.write(static_cast<uint8_t>(seed_set_));
+    writer.write(static_cast<uint64_t>(seed_));
+    writer.write(static_cast<uint8_t>(random_policy_));
+    writer.write(static_cast<uint8_t>(direct_cluster_exit_));
+    writer.write(static_cast<int32_t>(next_cluster_id_));
+    writer.write(static_cast<uint8_t>(time_resolution_set_));
+    writer.write(time_resolution_);
+    writer.write(static_cast<int32_t>(minimum_coarse_graining_resolution_));
+    writer.write(static_cast<int32_t>(iteration_));
+    writer.write(static_cast<int32_t>(iteration_threshold_));
+    writer.write(static_cast<int32_t>(iteration_threshold_min_));
+
+    rate_graph_->saveState(writer);
+
+    // The sites are stored in the order of the rate graph
+    writer.write(static_cast<uint64_t>(sites_->size()));
+    for( size_t index = 0; index < sites_->size(); ++index){
+      sites_->getSiteByIndex(index).saveState(writer);
+    }
+    vector<uint8_t> excluded(excluded_from_clusters_.begin(),
+        excluded_from_clusters_.end());
+    writer.writeArray(excluded);
+
+    vector<int> cluster_ids = clusters_->getClusterIds();
+    sort(cluster_ids.begin(),cluster_ids.end());
+    writer.write(static_cast<uint64_t>(cluster_ids.size()));
+    for( const int & cluster_id : cluster_ids ){
+      Cluster & cluster = clusters_->getCluster(cluster_id);
+      writer.write(static_cast<int32_t>(cluster_id));
+      writer.writeArray(cluster.getSiteIdsInCluster());
+      cluster.saveState(writer);
+    }
+
+    vector<int> walker_ids(walker_steps_.size());
+    iota(walker_ids.begin(),walker_ids.end(),0);
+    writer.writeArray(walker_ids);
+    writer.writeArray(walker_steps_);
+
+    writer.write(static_cast<uint8_t>(observer_stream_ != nullptr));
+    if(observer_stream_) observer_stream_->saveState(writer);
+  }
+
+  void CoarseGrainSystem::loadSnapshot_(Binary_Reader & reader){
+
+    LOG("Initializeing system from a snapshot", 1);
+
+    performance_ratio_ = reader.read<double>();
+    seed_set_ = reader.read<uint8_t>() != 0;
+    seed_ = static_cast<unsigned long>(reader.read<uint64_t>());
+    const uint8_t policy = reader.read<uint8_t>();
+    if(policy > static_cast<uint8_t>(RandomPolicy::mersenne_twister)){
+      throw runtime_error("The snapshot has an unknown random policy.");
+    }
+    random_policy_ = static_cast<RandomPolicy>(policy);
+    direct_cluster_exit_ = reader.read<uint8_t>() != 0;
+    next_cluster_id_ = reader.read<int32_t>();
+    time_resolution_set_ = reader.read<uint8_t>() != 0;
+    time_resolution_ = reader.read<double>();
+    minimum_coarse_graining_resolution_ = reader.read<int32_t>();
+    iteration_ = reader.read<int32_t>();
+    iteration_threshold_ = reader.read<int32_t>();
+    iteration_threshold_min_ = reader.read<int32_t>();
+
+    rate_graph_ = Rate_Graph::loadState(reader);
+    // The random streams are overwritten below so the seeds do not matter
+    initializeSitesFromRateGraph_(nullptr,0);
+    if(reader.read<uint64_t>() != sites_->size()){
+      throw runtime_error("The number of sites in the snapshot does not "
+          "match its rates.");
+    }
+    for( size_t index = 0; index < sites_->size(); ++index){
+      sites_->getSiteByIndex(index).loadState(reader);
+    }
+    vector<uint8_t> excluded;
+    reader.readArray(excluded);
+    if(!excluded.empty() && excluded.size() != sites_->size()){
+      throw runtime_error("The sites excluded from clusters in the snapshot "
+          "do not match its sites.");
+    }
+    excluded_from_clusters_.assign(excluded.begin(),excluded.end());
+
+    const uint64_t cluster_count = reader.read<uint64_t>();
+    for( uint64_t cluster_index = 0; cluster_index < cluster_count; ++cluster_index){
+      const int cluster_id = reader.read<int32_t>();
+      vector<int> site_ids;
+      reader.readArray(site_ids);
+      Cluster cluster(cluster_id);
+      for( const int & site_id : site_ids ){
+        if(!sites_->exist(site_id) || sites_->partOfCluster(site_id)){
+          throw runtime_error("Cluster " + to_string(cluster_id) + " of the "
+              "snapshot contains an unknown site or one that is already part "
+              "of another cluster.");
+        }
+        cluster.addSite(sites_->getSite(site_id));
+      }
+      cluster.loadState(reader);
+      clusters_->addCluster(cluster);
+      Cluster & stored_cluster = clusters_->getCluster(cluster_id);
+      for( const int & site_id : site_ids ){
+        topology_features_[sites_->getIndex(site_id)] = &stored_cluster;
+      }
+    }
+
+    vector<int> walker_ids;
+    vector<uint64_t> walker_steps;
+    reader.readArray(walker_ids);
+    reader.readArray(walker_steps);
+    if(walker_ids.size() != walker_steps.size()){
+      throw runtime_error("The snapshot has a different number of walker ids "
+          "and steps.");
+    }
+    walker_steps_.clear();
+    for( size_t index = 0; index < walker_ids.size(); ++index){
+      if(walker_ids[index] < 0){
+        throw runtime_error("The snapshot has a negative walker id.");
+      }
+      registerWalkerStep_(walker_ids[index]);
+      walker_steps_[static_cast<size_t>(walker_ids[index])] = walker_steps[index];
+    }
+
+    observer_stream_.reset();
+    if(reader.read<uint8_t>() != 0){
+      observer_stream_ = unique_ptr<Random_Stream>(new Random_Stream(0,0));
+      observer_stream_->loadState(reader);
+    }
+  }
+
+  void CoarseGrainSystem::resetSystem_(){
+    topology_features_.clear();
+    excluded_from_clusters_.clear();
+    walker_steps_.clear();
+    observer_stream_.reset();
+    rate_graph_.reset();
+    sites_ = unique_ptr<Site_Container>( new Site_Container );
+    clusters_ = unique_ptr<Cluster_Container>( new Cluster_Container );
+  }
+
+  void CoarseGrainSystem::seedTopologyFeature_(
+      TopologyFeature & feature, 
+      const uint64_t stream_id){
+    if(random_policy_ == RandomPolicy::mersenne_twister){
+      feature.setRandomSeed(seed_);
+      ++seed_;
+    }else{
+      // The seed is shared, the streams are told apart by the id
+      feature.setRandomSeed(seed_,stream_id);
+    }
+  }
+
+  void CoarseGrainSystem::registerWalkerStep_(const int walker_id){
+    if(walker_id < 0){
+      throw invalid_argument("Walker ids cannot be negative, walker " +
+          to_string(walker_id) + " was given.");
+    }
+    // A walker id that is reused carries on from the step the previous
+    // walker with the same id reached, so the two do not share numbers
+    if(static_cast<size_t>(walker_id) >= walker_steps_.size()){
+      walker_steps_.resize(static_cast<size_t>(walker_id)+1,0);
+    }
+  }
+
+  void CoarseGrainSystem::drawNextHop_(
+      TopologyFeature & feature,
+      const int walker_id,
+      Walker & walker){
+
+    double dwell_time;
+    int potential_site;
+    drawNextHop_(feature,walker_id,dwell_time,potential_site);
+    walker.setDwellTime(dwell_time);
+    walker.setPotentialSite(potential_site);
+  }
+
+  void CoarseGrainSystem::drawNextHop_(
+      TopologyFeature & feature,
+      const int walker_id,
+      double & dwell_time,
+      int & potential_site){
+
+    if(random_policy_ == RandomPolicy::counter_based){
+      // The numbers drawn depend only on the seed, the walker and the number
+      // of steps the walker has taken, not on the order walkers are moved
+      assert(walker_id >= 0 && static_cast<size_t>(walker_id) < walker_steps_.size()
+          && "The walker has not been initialized.");
+      uint64_t & step = walker_steps_[static_cast<size_t>(walker_id)];
+      Random_Stream stream(seed_,Random_Stream::walkerStream(walker_id));
+      stream.setStep(step);
+      ++step;
+      dwell_time = feature.getDwellTime(walker_id,stream);
+      potential_site = feature.pickNewSiteId(walker_id,stream);
+    }else{
+      dwell_time = feature.getDwellTime(walker_id);
+      potential_site = feature.pickNewSiteId(walker_id);
+    }
+  }
+
+  int CoarseGrainSystem::moveWalker_(
+      const int walker_id,
+      const int siteId,
+      const int siteToHopToId,
+      double & dwell_time,
+      int & potential_site){
+
+    TopologyFeature * feature = getTopologyFeature_(siteId);
+    TopologyFeature * feature_to_hop_to = getTopologyFeature_(siteToHopToId);
+
+    int new_siteId;
     if(!feature_to_hop_to->isOccupied(siteToHopToId)){
       feature->vacate(siteId);
       feature_to_hop_to->occupy(siteToHopToId);
 
-      walker->occupySite(siteToHopToId);
-      walker->setDwellTime(feature_to_hop_to->getDwellTime(walker_id));
-      walker->setPotentialSite(feature_to_hop_to->pickNewSiteId(walker_id));
+      new_siteId = siteToHopToId;
+      drawNextHop_(*feature_to_hop_to,walker_id,dwell_time,potential_site);
     }else{
       feature->vacate(siteId);
       feature->occupy(siteId);
 
-      walker->setDwellTime(feature->getDwellTime(walker_id));
-      walker->setPotentialSite(feature->pickNewSiteId(walker_id));
+      new_siteId = siteId;
+      drawNextHop_(*feature,walker_id,dwell_time,potential_site);
     }
 
     ++iteration_;
@@ -240,37 +1046,133 @@ namespace mythical {
       }
       iteration_ = 0;
     }
+    return new_siteId;
   }
 
-  /****************************************************************************
-   * Internal Private Functions
-   ****************************************************************************/
+  TopologyFeature * CoarseGrainSystem::getTopologyFeature_(const int siteId){
+    return topology_features_[sites_->getIndex(siteId)];
+  }
 
   bool CoarseGrainSystem::coarseGrain_(int siteId){
-    BasinExplorer basin_explorer;
-    auto basin_site_ids = basin_explorer.findBasin(*sites_,*clusters_,siteId);
-
-    double internal_time_limit = getInternalTimeLimit_(basin_site_ids);
-
-    if( sitesSatisfyEquilibriumCondition_(basin_site_ids, internal_time_limit) ){
-      auto sites_and_clusters = getClustersOfSites(basin_site_ids);
-      auto number_clusters = countUniqueClusters(sites_and_clusters);
-
-      if(number_clusters==1 &&
-          sites_and_clusters.begin()->second==constants::unassignedId)
-      {
-        createCluster_(basin_site_ids,internal_time_limit);
-        return true;
-      }else if(number_clusters!=1){
-        // Joint clusters and sites to an existing cluster
-        int favored_clusterId = getFavoredClusterId(sites_and_clusters);
-        mergeSitesAndClusters_(sites_and_clusters,favored_clusterId);
-        return true;
+    auto basin_site_ids = basin_explorer_->findBasin(*sites_,*clusters_,siteId);
+
+    double internal_time_limit;
+    if(!basinSatisfiesCoarseGrainCondition_(
+          basin_site_ids,*basin_graph_,internal_time_limit)){
+      return false;
+    }
+    return coarseGrainBasin_(basin_site_ids,internal_time_limit);
+  }
+
+  bool CoarseGrainSystem::basinSatisfiesCoarseGrainCondition_(
+      const vector<int> & basin_site_ids,
+      Basin_Graph & basin_graph,
+      double & internal_time_limit) const {
+
+    if(!excluded_from_clusters_.empty()){
+      for(const int & basin_site_id : basin_site_ids){
+        if(excluded_from_clusters_[sites_->getIndex(basin_site_id)]) return false;
       }
     }
+
+    internal_time_limit = getInternalTimeLimit_(basin_site_ids,basin_graph);
+    return sitesSatisfyEquilibriumCondition_(basin_site_ids, internal_time_limit);
+  }
+
+  bool CoarseGrainSystem::coarseGrainBasin_(
+      const vector<int> & basin_site_ids,
+      const double internal_time_limit){
+
+    auto sites_and_clusters = getClustersOfSites(basin_site_ids);
+    auto number_clusters = countUniqueClusters(sites_and_clusters);
+
+    if(number_clusters==1 &&
+        sites_and_clusters.begin()->second==constants::unassignedId)
+    {
+      createCluster_(basin_site_ids,internal_time_limit);
+      return true;
+    }else if(number_clusters!=1){
+      // Joint clusters and sites to an existing cluster
+      int favored_clusterId = getFavoredClusterId(sites_and_clusters);
+      mergeSitesAndClusters_(sites_and_clusters,favored_clusterId);
+      return true;
+    }
     return false;
   }
 
+  size_t CoarseGrainSystem::coarseGrainTraps(const size_t thread_count){
+
+    LOG("Coarse graining the traps of the system", 1);
+
+    if(topology_features_.size()==0){
+      throw runtime_error("The system must be initialized before its traps "
+          "can be coarse grained.");
+    }
+    if(iteration_threshold_min_==constants::inf_iterations) return 0;
+
+    struct Basin {
+      vector<int> site_ids;
+      double internal_time_limit;
+    };
+
+    Thread_Pool thread_pool(thread_count);
+
+    // A basin grown from a site of a cluster may reach further than one grown
+    // from an isolated site, as it is compared with the fastest rate off the
+    // cluster. The first round grows a basin from every site, the rounds
+    // that follow only from the sites of clusters, until nothing changes.
+    vector<int> seed_site_ids;
+    for( size_t index = 0; index < sites_->size(); ++index){
+      seed_site_ids.push_back(sites_->getSiteByIndex(index).getId());
+    }
+    size_t coarse_grained = 0;
+    bool changed = true;
+    while(changed && !seed_site_ids.empty()){
+      changed = false;
+
+      // Each block of seeds is explored with its own explorer and graph, the
+      // sites and clusters are only read until every block has finished
+      const size_t block_count = min(seed_site_ids.size(),4*thread_pool.size());
+      vector<vector<Basin>> basins_of_blocks(block_count);
+      thread_pool.parallelFor(block_count,[&](size_t block){
+        BasinExplorer basin_explorer(*basin_explorer_);
+        Basin_Graph basin_graph;
+        const size_t first = block*seed_site_ids.size()/block_count;
+        const size_t last = (block+1)*seed_site_ids.size()/block_count;
+        for( size_t index = first; index < last; ++index){
+          Basin basin;
+          basin.site_ids = basin_explorer.findBasin(
+              *sites_,*clusters_,seed_site_ids[index]);
+          if(basinSatisfiesCoarseGrainCondition_(
+                basin.site_ids,basin_graph,basin.internal_time_limit)){
+            basins_of_blocks[block].push_back(move(basin));
+          }
+        }
+      });
+
+      // Neighbouring sites of a trap usually grow the same basin
+      set<vector<int>> seen_basins;
+      for( const vector<Basin> & basins : basins_of_blocks ){
+        for( const Basin & basin : basins ){
+          vector<int> sorted_site_ids(basin.site_ids);
+          sort(sorted_site_ids.begin(),sorted_site_ids.end());
+          if(!seen_basins.insert(move(sorted_site_ids)).second) continue;
+          if(coarseGrainBasin_(basin.site_ids,basin.internal_time_limit)){
+            ++coarse_grained;
+            changed = true;
+          }
+        }
+      }
+
+      seed_site_ids.clear();
+      for( size_t index = 0; index < sites_->size(); ++index){
+        const Site & site = sites_->getSiteByIndex(index);
+        if(site.partOfCluster()) seed_site_ids.push_back(site.getId());
+      }
+    }
+    return coarse_grained;
+  }
+
   size_t countUniqueClusters(const unordered_map<int,int> & sites_and_clusters){
     set<int> clusters;
     for(auto site_and_cluster : sites_and_clusters){
@@ -308,14 +1210,15 @@ namespace mythical {
   int CoarseGrainSystem::createCluster_(vector<int> siteIds, double internal_time_limit) {
     LOG("Creating cluster from vector of sites", 1);
 
-    Cluster cluster;
-    cluster.setConvergenceMethod(Cluster::Method::converge_by_tolerance);
+    // Ids are unique within this system only
+    Cluster cluster(next_cluster_id_++);
+    cluster.setConvergenceMethod(Cluster::Method::converge_by_direct_solve);
+    // Used if the direct solve fails
     cluster.setConvergenceTolerance(0.001);
-    vector<Site> sites;
+    // The cluster refers to the sites stored in the site container
     for (auto siteId : siteIds){
-      sites.push_back(sites_->getSite(siteId));
+      cluster.addSite(sites_->getSite(siteId));
     }
-    cluster.addSites(sites);
     cluster.updateProbabilitiesAndTimeConstant();
 
     double cluster_time_const = cluster.getTimeConstant();
@@ -330,15 +1233,16 @@ namespace mythical {
     if(chosen_resolution<2.0) chosen_resolution=2.0;
    
     cluster.setResolution(chosen_resolution);
+    cluster.setRandomPolicy(random_policy_);
+    cluster.setExitDirectly(direct_cluster_exit_);
     if (seed_set_) {
-      cluster.setRandomSeed(seed_);
-      ++seed_;
+      seedTopologyFeature_(cluster,Random_Stream::clusterStream(cluster.getId()));
     }
     clusters_->addCluster(cluster);
 
     for(auto siteId : siteIds){
       sites_->setClusterId(siteId,cluster.getId());  
-      topology_features_[siteId] = &(clusters_->getCluster(cluster.getId()));
+      topology_features_[sites_->getIndex(siteId)] = &(clusters_->getCluster(cluster.getId()));
     }
 
     auto sitesFoundInCluster = cluster.getSiteIdsInCluster();
@@ -349,24 +1253,33 @@ namespace mythical {
   void CoarseGrainSystem::mergeSitesAndClusters_( unordered_map<int,int> sites_and_clusters,int favoredClusterId) {
 
     LOG("Merging sites to cluster", 1);
-    vector<Site> isolated_sites;
+    vector<Site *> isolated_sites;
     unordered_set<int> cluster_ids;
 
     for (auto site_and_cluster : sites_and_clusters) { 
       if(site_and_cluster.second != favoredClusterId){ 
         if (site_and_cluster.second == constants::unassignedId) {
-          isolated_sites.push_back(sites_->getSite(site_and_cluster.first));
+          isolated_sites.push_back(&(sites_->getSite(site_and_cluster.first)));
         } else {
           cluster_ids.insert(site_and_cluster.second);
         }
-        topology_features_[site_and_cluster.first] = &(clusters_->getCluster(favoredClusterId));
+        topology_features_[sites_->getIndex(site_and_cluster.first)] = 
+          &(clusters_->getCluster(favoredClusterId));
         sites_->setClusterId(site_and_cluster.first,favoredClusterId);
       }
     }
-    clusters_->getCluster(favoredClusterId).addSites(isolated_sites);
-    clusters_->getCluster(favoredClusterId).updateProbabilitiesAndTimeConstant();
+    Cluster & favored_cluster = clusters_->getCluster(favoredClusterId);
+    // Reuses the solution of the favored cluster rather than starting over
+    favored_cluster.mergeSites(isolated_sites);
     for(auto clusterId : cluster_ids ){
-      clusters_->getCluster(favoredClusterId).migrateSitesFrom(clusters_->getCluster(clusterId));
+      Cluster & cluster = clusters_->getCluster(clusterId);
+      // Sites of the cluster that were not passed in must also point to the
+      // favored cluster before this one is erased
+      for(const int & siteId : cluster.getSiteIdsInCluster()){
+        topology_features_[sites_->getIndex(siteId)] = &favored_cluster;
+        sites_->setClusterId(siteId,favoredClusterId);
+      }
+      favored_cluster.migrateSitesFrom(cluster);
       clusters_->erase(clusterId);
     }
 
@@ -381,12 +1294,11 @@ namespace mythical {
 
     double max_rate_off = 0; 
     for(const int & site_id : siteIds){
-      Site & site = sites_->getSite(site_id);
-      const unordered_map<int,double *> neigh_and_rates = site.getNeighborsAndRatesConst();
-      for( const pair<int,double *> & neigh_and_rate : neigh_and_rates){
-        if(internal_sites.count(neigh_and_rate.first)==0){
-          if(*(neigh_and_rate.second) > max_rate_off){
-            max_rate_off = *(neigh_and_rate.second);
+      Rate_View rates = sites_->getSite(site_id).getRateView();
+      for( size_t ind = 0; ind < rates.size(); ++ind){
+        if(internal_sites.count(rates.neighborId(ind))==0){
+          if(rates.rate(ind) > max_rate_off){
+            max_rate_off = rates.rate(ind);
           }
         }
       }
@@ -394,31 +1306,18 @@ namespace mythical {
     return max_rate_off;
   }
 
-double CoarseGrainSystem::getInternalTimeLimit_(vector<int> siteIds ){
-  LOG("Getting the internal time limit of a cluster", 1);
-
-  auto nodes = convertSitesToEmptySharedNodes(siteIds);
-
-  unordered_map<int, weak_ptr<GraphNode<string>>> nodes_weak;
-  for (auto node_iter : nodes) nodes_weak[node_iter.first] = node_iter.second;
-
-  auto edges = convertSitesOutgoingRatesToTimeSharedWeightedEdges<vector<shared_ptr<Edge>>>(
-      *sites_,
-      siteIds);
-
-  list<weak_ptr<Edge>> edges_weak(edges.begin(), edges.end());
-
-  auto graph_ptr =
-      shared_ptr<Graph<string>>(new Graph<string>(edges_weak, nodes_weak));
+double CoarseGrainSystem::getInternalTimeLimit_(const vector<int> & siteIds ){
+  return getInternalTimeLimit_(siteIds,*basin_graph_);
+}
 
-  unordered_map<pair<int, int>, double,hash_functions::hash> verticesAndtimes =
-      maxMinimumDistanceBetweenEveryVertex<string>(*graph_ptr);
+double CoarseGrainSystem::getInternalTimeLimit_(
+    const vector<int> & siteIds,
+    Basin_Graph & basin_graph) const {
+  LOG("Getting the internal time limit of a cluster", 1);
 
-  double maxtime = 0.0;
-  for (auto verticesAndTime : verticesAndtimes) {
-    if (verticesAndTime.second > maxtime) maxtime = verticesAndTime.second;
-  }
-  return maxtime;
+  basin_graph.build(*sites_,siteIds);
+  basin_graph.calculateShortestPaths();
+  return basin_graph.getDiameter();
 }
 
 // Its not worth creating a cluster unless the time is at least cut in half
@@ -429,7 +1328,7 @@ double CoarseGrainSystem::getInternalTimeLimit_(vector<int> siteIds ){
 // The number 25 is the ratio needed between hops within the cluster to hops
 // outside of the cluster in order to see performance gains.
 bool CoarseGrainSystem::sitesSatisfyEquilibriumCondition_(
-    vector<int> siteIds, double maxtime) {
+    vector<int> siteIds, double maxtime) const {
 
   LOG("Checking if sites satisfy equilibrium condition", 1);
   double timeConstant = getTimeConstantFromSitesToNeighbors_(siteIds);
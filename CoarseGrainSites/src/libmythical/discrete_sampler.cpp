@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "discrete_sampler.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+  const size_t Discrete_Sampler::alias_threshold;
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  void Discrete_Sampler::build(const vector<double> & weights){
+    double total = 0.0;
+    for( const double & weight : weights ){
+      if(weight < 0.0){
+        throw invalid_argument("Cannot build sampler, weights must not be "
+            "negative.");
+      }
+      total += weight;
+    }
+    if(weights.size()>0 && !(total > 0.0)){
+      throw invalid_argument("Cannot build sampler, the sum of the weights "
+          "must be positive.");
+    }
+
+    use_alias_ = method_ == alias ||
+      (method_ == automatic && weights.size() >= alias_threshold);
+
+    if(use_alias_){
+      buildAlias_(weights,total);
+    }else{
+      buildCumulative_(weights,total);
+    }
+  }
+
+  void Discrete_Sampler::build(const vector<pair<int,double>> & ids_and_weights){
+    vector<double> weights;
+    weights.reserve(ids_and_weights.size());
+    for( const pair<int,double> & id_and_weight : ids_and_weights ){
+      weights.push_back(id_and_weight.second);
+    }
+    build(weights);
+  }
+
+  size_t Discrete_Sampler::sample(const double number) const {
+    const size_t count = threshold_.size();
+    if(use_alias_){
+      double scaled = number*static_cast<double>(count);
+      size_t column = static_cast<size_t>(scaled);
+      if(column >= count) column = count-1;
+      if(scaled - static_cast<double>(column) < threshold_[column]) return column;
+      return static_cast<size_t>(alias_[column]);
+    }
+    size_t index = static_cast<size_t>(
+        upper_bound(threshold_.begin(),threshold_.end(),number) -
+        threshold_.begin());
+    // Guards against round off in the last cumulative value
+    if(index >= count) index = count-1;
+    return index;
+  }
+
+  void Discrete_Sampler::clear(){
+    threshold_.clear();
+    alias_.clear();
+    use_alias_ = false;
+  }
+
+  /****************************************************************************
+   * Private Internal Functions
+   ****************************************************************************/
+
+  // Vose's method
+  void Discrete_Sampler::buildAlias_(const vector<double> & weights, const double total){
+    const size_t count = weights.size();
+    threshold_.assign(count,1.0);
+    alias_.resize(count);
+
+    vector<int> small;
+    vector<int> large;
+    small.reserve(count);
+    large.reserve(count);
+    const double scale = static_cast<double>(count)/total;
+    for(size_t index = 0; index < count; ++index){
+      threshold_[index] = weights[index]*scale;
+      alias_[index] = static_cast<int>(index);
+      if(threshold_[index] < 1.0){
+        small.push_back(static_cast<int>(index));
+      }else{
+        large.push_back(static_cast<int>(index));
+      }
+    }
+
+    while(!small.empty() && !large.empty()){
+      int less = small.back();
+      small.pop_back();
+      int more = large.back();
+      alias_[less] = more;
+      threshold_[more] = (threshold_[more] + threshold_[less]) - 1.0;
+      if(threshold_[more] < 1.0){
+        large.pop_back();
+        small.push_back(more);
+      }
+    }
+    // Whatever remains is only left over because of round off
+    for( const int & index : large ) threshold_[index] = 1.0;
+    for( const int & index : small ) threshold_[index] = 1.0;
+  }
+
+  void Discrete_Sampler::buildCumulative_(const vector<double> & weights, const double total){
+    alias_.clear();
+    threshold_.resize(weights.size());
+    double cumulative = 0.0;
+    const double inverse_total = 1.0/total;
+    for(size_t index = 0; index < weights.size(); ++index){
+      cumulative += weights[index];
+      threshold_[index] = cumulative*inverse_total;
+    }
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef MYTHICAL_DISCRETE_SAMPLER_HPP
+#define MYTHICAL_DISCRETE_SAMPLER_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mythical {
+
+/**
+ * \brief Draws an index from a discrete probability distribution
+ *
+ * Two methods are supported. The alias method (Walker/Vose) builds a table
+ * in O(N) after which every draw is O(1) regardless of the number of
+ * outcomes. The cumulative method stores the cumulative probabilities and
+ * uses a binary search, O(log N), it is cheaper to build and for a small
+ * number of outcomes just as fast to draw from. By default the alias table
+ * is only built if there are at least alias_threshold outcomes.
+ *
+ * A single uniform random number is consumed per draw for both methods.
+ **/
+class Discrete_Sampler {
+  public:
+    enum Method {
+      automatic,
+      alias,
+      cumulative
+    };
+
+    /// Minimum number of outcomes before the automatic method uses an alias
+    /// table
+    static const size_t alias_threshold = 16;
+
+    Discrete_Sampler() : method_(automatic), use_alias_(false) {};
+
+    /// Will only take effect the next time the sampler is built
+    void setMethod(const Method method) { method_ = method; }
+
+    /**
+     * \brief Build the sampler from a set of weights
+     *
+     * The weights do not need to be normalized but must not be negative.
+     **/
+    void build(const std::vector<double> & weights);
+
+    /// Build the sampler from the second value of each pair
+    void build(const std::vector<std::pair<int,double>> & ids_and_weights);
+
+    /**
+     * \brief Draw an index
+     *
+     * \param[in] number a uniform random number in the range [0,1]
+     *
+     * \return index of the weight that was picked
+     **/
+    size_t sample(const double number) const;
+
+    size_t size() const { return threshold_.size(); }
+
+    bool usesAliasTable() const { return use_alias_; }
+
+    void clear();
+
+  private:
+    Method method_;
+    bool use_alias_;
+
+    /// Alias method: probability of keeping the column, otherwise the
+    /// cumulative probabilities
+    std::vector<double> threshold_;
+    /// Only used by the alias method, the index to switch to
+    std::vector<int> alias_;
+
+    void buildAlias_(const std::vector<double> & weights, const double total);
+    void buildCumulative_(const std::vector<double> & weights, const double total);
+};
+
+}
+
+#endif // MYTHICAL_DISCRETE_SAMPLER_HPP
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include "mythical/domain_decomposed_system.hpp"
+#include "mythical/indexed_queue.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+DomainDecomposedSystem::DomainDecomposedSystem(
+    const size_t domain_count,
+    const size_t thread_count) :
+  group_count_(1),
+  time_window_(0.0),
+  time_(0.0),
+  migration_count_(0) {
+
+  if(domain_count==0){
+    throw invalid_argument("The lattice must be split into at least a single "
+        "domain.");
+  }
+  for(size_t domain = 0; domain < domain_count; ++domain){
+    domains_.push_back(unique_ptr<CoarseGrainSystem>(new CoarseGrainSystem));
+  }
+  walkers_.resize(domain_count);
+  ghost_sites_.resize(domain_count);
+  migrations_.resize(domain_count);
+  group_.assign(domain_count,0);
+  thread_pool_ = unique_ptr<Thread_Pool>(new Thread_Pool(thread_count));
+}
+
+DomainDecomposedSystem::~DomainDecomposedSystem(){
+}
+
+size_t DomainDecomposedSystem::getNumberOfThreads() const {
+  return thread_pool_->size();
+}
+
+void DomainDecomposedSystem::setTimeWindow(const double time_window){
+  if(!(time_window>0.0)){
+    throw invalid_argument("The time window must be a positive value.");
+  }
+  time_window_ = time_window;
+}
+
+void DomainDecomposedSystem::initializeSystem(
+    const charge_transport::Cuboid & lattice,
+    const unordered_map<int, unordered_map<int, double>> & ratesOfAllSites,
+    const ConfigureFunction & configure){
+
+  vector<pair<int,int>> edges;
+  set<int> site_ids;
+  for(const auto & site_and_rates : ratesOfAllSites){
+    site_ids.insert(site_and_rates.first);
+    for(const auto & neigh_and_rate : site_and_rates.second){
+      site_ids.insert(neigh_and_rate.first);
+      edges.emplace_back(site_and_rates.first,neigh_and_rate.first);
+    }
+  }
+  site_ids_.assign(site_ids.begin(),site_ids.end());
+  splitLattice_(lattice,edges);
+
+  configure(0,*domains_.front());
+  domains_.front()->initializeSystem(ratesOfAllSites);
+  initializeRemainingDomains_(configure);
+}
+
+void DomainDecomposedSystem::initializeSystem(
+    const charge_transport::Cuboid & lattice,
+    vector<size_t> row_offsets,
+    vector<int> neighbor_ids,
+    vector<double> rates,
+    const ConfigureFunction & configure){
+
+  if(row_offsets.empty() || row_offsets.back()!=neighbor_ids.size()){
+    throw invalid_argument("Cannot initialize system, the last row offset "
+        "must match the number of neighbor ids.");
+  }
+  vector<pair<int,int>> edges;
+  set<int> site_ids;
+  for(size_t row = 0; row+1 < row_offsets.size(); ++row){
+    site_ids.insert(static_cast<int>(row));
+    for(size_t ind = row_offsets[row]; ind < row_offsets[row+1]; ++ind){
+      site_ids.insert(neighbor_ids[ind]);
+      edges.emplace_back(static_cast<int>(row),neighbor_ids[ind]);
+    }
+  }
+  site_ids_.assign(site_ids.begin(),site_ids.end());
+  splitLattice_(lattice,edges);
+
+  configure(0,*domains_.front());
+  domains_.front()->initializeSystem(
+      move(row_offsets),
+      move(neighbor_ids),
+      move(rates));
+  initializeRemainingDomains_(configure);
+}
+
+size_t DomainDecomposedSystem::getDomainOfSite(const int siteId) const {
+  if(siteId<0 || static_cast<size_t>(siteId)>=domain_of_site_.size()){
+    throw invalid_argument("Site " + to_string(siteId) + " is not part of the "
+        "lattice.");
+  }
+  return domain_of_site_[siteId];
+}
+
+CoarseGrainSystem & DomainDecomposedSystem::getDomain(const size_t domain){
+  if(domain>=domains_.size()){
+    throw out_of_range("Cannot get domain " + to_string(domain) + " the "
+        "lattice is only split into " + to_string(domains_.size()) +
+        " domains.");
+  }
+  return *domains_[domain];
+}
+
+const vector<int> & DomainDecomposedSystem::getGhostSites(const size_t domain) const {
+  if(domain>=domains_.size()){
+    throw out_of_range("Cannot get the ghost sites of domain " +
+        to_string(domain) + " the lattice is only split into " +
+        to_string(domains_.size()) + " domains.");
+  }
+  return ghost_sites_[domain];
+}
+
+int DomainDecomposedSystem::addWalker(const int siteId, const double time){
+  if(domain_of_site_.empty()){
+    throw runtime_error("You must first initialize the system before you "
+        "can add walkers.");
+  }
+  const size_t domain = getDomainOfSite(siteId);
+  if(domains_[domain]->isSiteOccupied(siteId)){
+    throw invalid_argument("Cannot add walker, site " + to_string(siteId) +
+        " is already occupied.");
+  }
+  int walker_id = 0;
+  for(WalkerPool & walkers : walkers_){
+    walker_id = walkers.addWalker(siteId,time);
+  }
+  domains_[domain]->initializeWalker(walkers_[domain],walker_id);
+  domain_of_walker_.push_back(domain);
+  return walker_id;
+}
+
+size_t DomainDecomposedSystem::getDomainOfWalker(const int walker_id) const {
+  checkWalker_(walker_id);
+  return domain_of_walker_[walker_id];
+}
+
+int DomainDecomposedSystem::getIdOfSiteCurrentlyOccupying(const int walker_id) const {
+  checkWalker_(walker_id);
+  return walkers_[domain_of_walker_[walker_id]].getIdOfSiteCurrentlyOccupying(walker_id);
+}
+
+double DomainDecomposedSystem::getTime(const int walker_id) const {
+  checkWalker_(walker_id);
+  return walkers_[domain_of_walker_[walker_id]].getTime(walker_id);
+}
+
+size_t DomainDecomposedSystem::hop(const double time_horizon){
+  if(!(time_window_>0.0)){
+    throw runtime_error("The time window must be set before hopping.");
+  }
+  if(domain_of_site_.empty()){
+    throw runtime_error("You must first initialize the system before "
+        "hopping.");
+  }
+
+  size_t hop_count = 0;
+  vector<size_t> hops(domains_.size(),0);
+  while(time_ < time_horizon){
+    const double window_end = min(time_+time_window_,time_horizon);
+    for(size_t group = 0; group < group_count_; ++group){
+      vector<size_t> domains;
+      for(size_t domain = 0; domain < domains_.size(); ++domain){
+        if(group_[domain]==group) domains.push_back(domain);
+      }
+      // Neighbors of the domains in the group are not moving, so reading
+      // their occupancy is safe
+      thread_pool_->parallelFor(domains.size(),[&](size_t index){
+          const size_t domain = domains[index];
+          refreshGhostSites_(domain);
+          hops[domain] = advanceDomain_(domain,window_end);
+          });
+      for(const size_t & domain : domains) hop_count += hops[domain];
+      migrateWalkers_(domains);
+    }
+    time_ = window_end;
+  }
+  return hop_count;
+}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+void DomainDecomposedSystem::splitLattice_(
+    const charge_transport::Cuboid & lattice,
+    const vector<pair<int,int>> & edges){
+
+  const int length = lattice.getLength();
+  const size_t domain_count = domains_.size();
+  if(static_cast<size_t>(length) < domain_count){
+    throw invalid_argument("Cannot split a lattice of length " +
+        to_string(length) + " into " + to_string(domain_count) + " domains.");
+  }
+
+  const int total = lattice.getLength()*lattice.getWidth()*lattice.getHeight();
+  vector<size_t> domain_of_site(total);
+  for(int index = 0; index < total; ++index){
+    domain_of_site[index] = static_cast<size_t>(lattice.getX(index))*
+      domain_count/static_cast<size_t>(length);
+  }
+  for(const int & siteId : site_ids_){
+    if(siteId<0 || siteId>=total){
+      throw invalid_argument("Site " + to_string(siteId) + " is not part of "
+          "the lattice, the site ids must be the indices of the lattice.");
+    }
+  }
+
+  // The ghost region of each domain and the longest hop along x
+  vector<set<int>> ghost_sites(domain_count);
+  int reach = 0;
+  for(const pair<int,int> & edge : edges){
+    const size_t domain = domain_of_site[edge.first];
+    if(domain_of_site[edge.second]!=domain){
+      ghost_sites[domain].insert(edge.second);
+    }
+    int distance = abs(lattice.getX(edge.first)-lattice.getX(edge.second));
+    if(lattice.isXPeriodic()) distance = min(distance,length-distance);
+    reach = max(reach,distance);
+  }
+  if(domain_count>1){
+    const int narrowest = length/static_cast<int>(domain_count);
+    if(narrowest < 2*reach){
+      throw invalid_argument("Cannot split the lattice into " +
+          to_string(domain_count) + " domains, the narrowest domain is " +
+          to_string(narrowest) + " sites wide but it must be at least twice "
+          "the longest hop along x which is " + to_string(reach) + " sites.");
+    }
+  }
+
+  swap(domain_of_site_,domain_of_site);
+  for(size_t domain = 0; domain < domain_count; ++domain){
+    ghost_sites_[domain].assign(ghost_sites[domain].begin(),ghost_sites[domain].end());
+  }
+  if(domain_count>1){
+    group_count_ = 2;
+    for(size_t domain = 0; domain < domain_count; ++domain){
+      group_[domain] = domain%2;
+    }
+    // The first and last domains are neighbors
+    if(lattice.isXPeriodic() && domain_count%2==1){
+      group_.back() = 2;
+      group_count_ = 3;
+    }
+  }
+}
+
+void DomainDecomposedSystem::initializeRemainingDomains_(
+    const ConfigureFunction & configure){
+
+  const CoarseGrainSystem & first = *domains_.front();
+  thread_pool_->parallelFor(domains_.size(),[&](size_t domain){
+      if(domain>0){
+        configure(domain,*domains_[domain]);
+        domains_[domain]->initializeSystem(first);
+      }
+      vector<int> foreign_site_ids;
+      for(const int & siteId : site_ids_){
+        if(domain_of_site_[siteId]!=domain) foreign_site_ids.push_back(siteId);
+      }
+      domains_[domain]->excludeSitesFromClusters(foreign_site_ids);
+      });
+  site_ids_.clear();
+  site_ids_.shrink_to_fit();
+}
+
+void DomainDecomposedSystem::refreshGhostSites_(const size_t domain){
+  CoarseGrainSystem & system = *domains_[domain];
+  for(const int & siteId : ghost_sites_[domain]){
+    system.setSiteOccupied(siteId,
+        domains_[domain_of_site_[siteId]]->isSiteOccupied(siteId));
+  }
+}
+
+size_t DomainDecomposedSystem::advanceDomain_(
+    const size_t domain,
+    const double time_horizon){
+
+  CoarseGrainSystem & system = *domains_[domain];
+  WalkerPool & walkers = walkers_[domain];
+  const IndexedQueue & event_queue = walkers.getEventQueue();
+  size_t hop_count = 0;
+  while(!event_queue.empty() && event_queue.at(0).second < time_horizon){
+    const int walker_id = event_queue.at(0).first;
+    const double time = event_queue.at(0).second;
+    system.hop(walkers,walker_id);
+    ++hop_count;
+
+    const int siteId = walkers.getIdOfSiteCurrentlyOccupying(walker_id);
+    if(domain_of_site_[siteId]!=domain){
+      system.removeWalkerFromSystem(walkers,walker_id);
+      // Keep the site reserved until the walker has been handed over
+      system.setSiteOccupied(siteId,true);
+      migrations_[domain].push_back(Migration{walker_id,siteId,time});
+    }
+  }
+  return hop_count;
+}
+
+void DomainDecomposedSystem::migrateWalkers_(const vector<size_t> & domains){
+  vector<Migration> migrations;
+  for(const size_t & domain : domains){
+    migrations.insert(migrations.end(),
+        migrations_[domain].begin(),
+        migrations_[domain].end());
+    migrations_[domain].clear();
+  }
+  sort(migrations.begin(),migrations.end(),
+      [](const Migration & migration1, const Migration & migration2){
+        if(migration1.time!=migration2.time){
+          return migration1.time<migration2.time;
+        }
+        return migration1.walker_id<migration2.walker_id;
+      });
+
+  for(const Migration & migration : migrations){
+    const size_t domain = domain_of_site_[migration.site_id];
+    CoarseGrainSystem & system = *domains_[domain];
+    // The ghost sites of the domains simulated together never overlap
+    if(system.isSiteOccupied(migration.site_id)){
+      throw runtime_error("Cannot hand walker " +
+          to_string(migration.walker_id) + " to domain " + to_string(domain) +
+          " site " + to_string(migration.site_id) + " is already occupied.");
+    }
+    walkers_[domain].placeWalker(
+        migration.walker_id,
+        migration.site_id,
+        migration.time);
+    system.initializeWalker(walkers_[domain],migration.walker_id);
+    domain_of_walker_[migration.walker_id] = domain;
+    ++migration_count_;
+  }
+}
+
+void DomainDecomposedSystem::checkWalker_(const int walker_id) const {
+  if(walker_id<0 || static_cast<size_t>(walker_id)>=domain_of_walker_.size()){
+    throw out_of_range("Walker " + to_string(walker_id) + " has not been "
+        "added to the system.");
+  }
+}
+
+}
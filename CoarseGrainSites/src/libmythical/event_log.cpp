@@ -0,0 +1,296 @@
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mythical/event_log.hpp"
+
+#include "binary_file.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Constants
+ ****************************************************************************/
+
+static const char event_log_magic[9] = "MYTHHOPS";
+static const uint32_t event_log_version = 1;
+
+/// Longest the background thread sleeps before draining the buffers
+static const chrono::milliseconds flush_interval(10);
+
+/****************************************************************************
+ * Local Functions
+ ****************************************************************************/
+
+namespace {
+
+  atomic<uint64_t> next_serial(1);
+
+  /// Buffer last used by the thread, saves looking it up on every event
+  struct Ring_Cache {
+    uint64_t serial = 0;
+    Event_Ring * ring = nullptr;
+  };
+  thread_local Ring_Cache ring_cache;
+
+  uint64_t zigzag(const int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^
+      static_cast<uint64_t>(value >> 63);
+  }
+
+  int64_t unzigzag(const uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  void appendVarint(vector<uint8_t> & bytes, uint64_t value) {
+    while(value >= 0x80){
+      bytes.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+  }
+
+  uint64_t timeBits(const double time) {
+    uint64_t bits;
+    memcpy(&bits, &time, sizeof(bits));
+    return bits;
+  }
+}
+
+/**
+ * \brief Ring buffer with a single producer and a single consumer
+ *
+ * The thread recording events pushes and the background thread of the log
+ * pops, neither of them locks.
+ **/
+class Event_Ring {
+  public:
+    explicit Event_Ring(const size_t capacity) :
+      events_(capacity), mask_(capacity-1), head_(0), tail_(0) {}
+
+    size_t capacity() const { return events_.size(); }
+
+    /// Returns the number of events buffered after the push, 0 if full
+    size_t push(const HopEvent & event) {
+      const size_t head = head_.load(memory_order_relaxed);
+      const size_t count = head - tail_.load(memory_order_acquire);
+      if(count==events_.size()) return 0;
+      events_[head & mask_] = event;
+      head_.store(head+1,memory_order_release);
+      return count+1;
+    }
+
+    /// Moves every buffered event into events
+    void popAll(vector<HopEvent> & events) {
+      const size_t tail = tail_.load(memory_order_relaxed);
+      const size_t head = head_.load(memory_order_acquire);
+      events.clear();
+      for(size_t index = tail; index != head; ++index){
+        events.push_back(events_[index & mask_]);
+      }
+      tail_.store(head,memory_order_release);
+    }
+
+  private:
+    vector<HopEvent> events_;
+    size_t mask_;
+    /// Only written by the producer
+    atomic<size_t> head_;
+    /// Only written by the consumer
+    atomic<size_t> tail_;
+};
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+EventLog::EventLog(const string & file_name, const size_t buffer_size) :
+  writer_(new Binary_Writer(file_name,event_log_magic,event_log_version)),
+  buffer_size_(1),
+  serial_(next_serial++),
+  flush_requested_(false),
+  closed_(false),
+  stop_(false) {
+
+  if(buffer_size==0){
+    throw invalid_argument("The buffer of an event log must hold at least "
+        "one event.");
+  }
+  while(buffer_size_<buffer_size) buffer_size_ *= 2;
+  thread_ = thread(&EventLog::write_,this);
+}
+
+EventLog::~EventLog() {
+  try {
+    close();
+  }catch(...){
+  }
+}
+
+void EventLog::record(const HopEvent & event) {
+  if(closed_.load(memory_order_relaxed)){
+    throw runtime_error("Cannot record a hop, the event log is closed.");
+  }
+  Event_Ring * ring = ring_cache.ring;
+  if(ring_cache.serial!=serial_){
+    ring = &getRing_();
+  }
+  size_t count = ring->push(event);
+  while(count==0){
+    requestFlush_();
+    this_thread::yield();
+    count = ring->push(event);
+  }
+  if(count==ring->capacity()/2+1) requestFlush_();
+}
+
+void EventLog::close() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if(closed_.exchange(true)) return;
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  if(error_){
+    rethrow_exception(error_);
+  }
+  writer_->close();
+}
+
+EventLogReader::EventLogReader(const string & file_name) :
+  reader_(new Binary_Reader(file_name,event_log_magic,event_log_version)),
+  file_name_(file_name),
+  bytes_(nullptr),
+  size_(0),
+  position_(0),
+  events_left_(0) {}
+
+EventLogReader::~EventLogReader() {}
+
+bool EventLogReader::read(HopEvent & event) {
+  while(events_left_==0){
+    if(position_!=size_){
+      throw runtime_error(file_name_ + " has a block with more bytes than "
+          "events.");
+    }
+    if(reader_->atEnd()) return false;
+    bytes_ = reader_->viewArray<uint8_t>(size_);
+    position_ = 0;
+    events_left_ = readVarint_();
+    previous_ = HopEvent{0, 0, 0, 0.0, false};
+  }
+
+  const uint64_t walker_field = readVarint_();
+  event.in_cluster = (walker_field & 1) != 0;
+  event.walker_id = static_cast<int>(
+      previous_.walker_id + unzigzag(walker_field >> 1));
+  event.from_site_id = static_cast<int>(
+      previous_.from_site_id + unzigzag(readVarint_()));
+  event.to_site_id = static_cast<int>(
+      event.from_site_id + unzigzag(readVarint_()));
+  const uint64_t bits = timeBits(previous_.time) +
+    static_cast<uint64_t>(unzigzag(readVarint_()));
+  memcpy(&event.time, &bits, sizeof(bits));
+
+  previous_ = event;
+  --events_left_;
+  return true;
+}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+Event_Ring & EventLog::getRing_() {
+  lock_guard<mutex> lock(mutex_);
+  Event_Ring *& ring = ring_of_thread_[this_thread::get_id()];
+  if(ring==nullptr){
+    rings_.emplace_back(new Event_Ring(buffer_size_));
+    ring = rings_.back().get();
+  }
+  ring_cache.serial = serial_;
+  ring_cache.ring = ring;
+  return *ring;
+}
+
+void EventLog::requestFlush_() {
+  flush_requested_.store(true,memory_order_relaxed);
+  wake_.notify_one();
+}
+
+void EventLog::write_() {
+  vector<HopEvent> events;
+  vector<uint8_t> bytes;
+  vector<Event_Ring *> rings;
+
+  unique_lock<mutex> lock(mutex_);
+  while(true){
+    wake_.wait_for(lock,flush_interval,[this]{
+        return stop_ || flush_requested_.exchange(false);
+        });
+    const bool stopping = stop_;
+    rings.clear();
+    for(const auto & ring : rings_) rings.push_back(ring.get());
+    lock.unlock();
+
+    for(Event_Ring * ring : rings){
+      writeBlock_(*ring,events,bytes);
+    }
+
+    lock.lock();
+    if(stopping) break;
+  }
+}
+
+// After a failed write the buffers are still drained, so that the threads
+// recording are not left waiting, the error is reported by close
+void EventLog::writeBlock_(
+    Event_Ring & ring,
+    vector<HopEvent> & events,
+    vector<uint8_t> & bytes) {
+
+  ring.popAll(events);
+  if(events.empty() || error_) return;
+
+  bytes.clear();
+  appendVarint(bytes,events.size());
+  HopEvent previous{0, 0, 0, 0.0, false};
+  for(const HopEvent & event : events){
+    const int64_t walker_difference =
+      static_cast<int64_t>(event.walker_id) - previous.walker_id;
+    appendVarint(bytes,(zigzag(walker_difference) << 1) |
+        (event.in_cluster ? 1 : 0));
+    appendVarint(bytes,zigzag(
+          static_cast<int64_t>(event.from_site_id) - previous.from_site_id));
+    appendVarint(bytes,zigzag(
+          static_cast<int64_t>(event.to_site_id) - event.from_site_id));
+    appendVarint(bytes,zigzag(static_cast<int64_t>(
+          timeBits(event.time) - timeBits(previous.time))));
+    previous = event;
+  }
+  try {
+    writer_->writeArray(bytes);
+  }catch(...){
+    error_ = current_exception();
+  }
+}
+
+uint64_t EventLogReader::readVarint_() {
+  uint64_t value = 0;
+  for(unsigned shift = 0; shift < 64; shift += 7){
+    if(position_==size_){
+      throw runtime_error(file_name_ + " ends in the middle of an event.");
+    }
+    const uint8_t byte = bytes_[position_++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if((byte & 0x80)==0) return value;
+  }
+  throw runtime_error(file_name_ + " contains a malformed varint.");
+}
+
+}
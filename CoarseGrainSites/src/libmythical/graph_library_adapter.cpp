@@ -6,6 +6,20 @@ using namespace ugly;
 
 namespace mythical {
 
+  vector<pair<int,Rate_View>> viewSitesOutgoingRates(
+      const Site_Container & site_container,
+      const vector<int> & siteIds)
+  {
+    vector<pair<int,Rate_View>> site_rates;
+    site_rates.reserve(siteIds.size());
+    for (const int & siteId : siteIds) {
+      if (site_container.exist(siteId)) {
+        site_rates.emplace_back(siteId,site_container.getRateView(siteId));
+      }
+    }
+    return site_rates;
+  }
+
   unordered_map<int,shared_ptr<GraphNode<string>>> 
   convertSitesToEmptySharedNodes(vector<int> siteIds)
   {
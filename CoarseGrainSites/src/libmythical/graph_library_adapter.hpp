@@ -5,28 +5,42 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "site_container.hpp"
 #include "ugly/edge_directed_weighted.hpp"
 #include "ugly/graph_node.hpp"
 
 namespace mythical {
-  
+
+  /**
+   * \brief Zero-copy view of the outgoing rates of the requested sites
+   *
+   * Only the rows of the sites that are asked for are touched, so the cost
+   * is proportional to the number of requested sites rather than the size of
+   * the container. Sites that are not stored in the container have no
+   * outgoing rates. The views are only valid as long as the rates of the
+   * sites are not reset.
+   **/
+  std::vector<std::pair<int,Rate_View>> viewSitesOutgoingRates(
+      const Site_Container & site_container,
+      const std::vector<int> & siteIds);
+
   // Can only take arguments of type container<unique_ptr<Edge>>
   template<typename T> 
   T convertSitesOutgoingRatesToUniqueWeightedEdges(
-      Site_Container site_container, 
+      const Site_Container & site_container, 
       int siteId)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
-    for ( auto neigh : rate_map[siteId] ){
-      int neigh_id = neigh.first;
-      double * rate = neigh.second;
-    
-      auto edge_ptr = std::unique_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,neigh_id,*rate));
+    for ( auto site_rates : viewSitesOutgoingRates(site_container,{siteId}) ){
+      const Rate_View & rates = site_rates.second;
+      for ( size_t ind = 0; ind < rates.size(); ++ind ){
+        auto edge_ptr = std::unique_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,rates.neighborId(ind),rates.rate(ind)));
 
-      container.insert(container.begin(),std::move(edge_ptr));
+        container.insert(container.begin(),std::move(edge_ptr));
+      }
     }
     return container; 
   }
@@ -34,55 +48,45 @@ namespace mythical {
   // Can only take arguments of type container<shared_ptr<Edge>>
   template<typename T> 
   T convertSitesOutgoingRatesToSharedWeightedEdges(
-      Site_Container site_container, 
-      int siteId)
+      const Site_Container & site_container, 
+      const std::vector<int> & siteIds)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
-    for ( auto neigh : rate_map[siteId] ){
-      int neigh_id = neigh.first;
-      double * rate = neigh.second;
-    
-      auto edge_ptr = std::shared_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,neigh_id,*rate));
+    for ( auto site_rates : viewSitesOutgoingRates(site_container,siteIds) ){
+      int siteId = site_rates.first;
+      const Rate_View & rates = site_rates.second;
+      for ( size_t ind = 0; ind < rates.size(); ++ind ){
+        auto edge_ptr = std::shared_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,rates.neighborId(ind),rates.rate(ind)));
 
-      container.insert(container.begin(),std::move(edge_ptr));
+        container.insert(container.begin(),std::move(edge_ptr));
+      }
     }
     return container; 
   }
 
-  // Same as the above method but for a vector of integers
+  // Same as the above method but for a single site
   template<typename T> 
   T convertSitesOutgoingRatesToSharedWeightedEdges(
-      Site_Container site_container, 
-      std::vector<int> siteIds)
+      const Site_Container & site_container, 
+      int siteId)
   {
-    T container;
-    Rate_Map rate_map = site_container.getRates();
-    for(auto siteId : siteIds ){
-      for ( auto neigh : rate_map[siteId] ){
-        int neigh_id = neigh.first;
-        double * rate = neigh.second;
-
-        auto edge_ptr = std::shared_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,neigh_id,*rate));
-
-        container.insert(container.begin(),std::move(edge_ptr));
-      }
-    }
-    return container; 
+    return convertSitesOutgoingRatesToSharedWeightedEdges<T>(
+        site_container,
+        std::vector<int>{siteId});
   }
 
   template<typename T> 
   T convertSitesOutgoingRatesToTimeSharedWeightedEdges(
-      Site_Container site_container, 
-      std::vector<int> siteIds)
+      const Site_Container & site_container, 
+      const std::vector<int> & siteIds)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
-    for(auto siteId : siteIds ){
-      for ( auto neigh : rate_map[siteId] ){
-        int neigh_id = neigh.first;
-        double  time = 1.0/(*neigh.second);
-        auto edge_ptr = std::shared_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,neigh_id,time));
+    for ( auto site_rates : viewSitesOutgoingRates(site_container,siteIds) ){
+      int siteId = site_rates.first;
+      const Rate_View & rates = site_rates.second;
+      for ( size_t ind = 0; ind < rates.size(); ++ind ){
+        double time = 1.0/rates.rate(ind);
+        auto edge_ptr = std::shared_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,rates.neighborId(ind),time));
 
         container.insert(container.begin(),std::move(edge_ptr));
       }
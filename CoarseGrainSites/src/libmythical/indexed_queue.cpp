@@ -0,0 +1,157 @@
+
+#include "mythical/indexed_queue.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace mythical {
+
+  const size_t IndexedQueue::not_queued;
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  void IndexedQueue::add(pair<int,double> walker){
+    sortedAdd(walker);
+  }
+
+  void IndexedQueue::sortedAdd(pair<int,double> walker){
+    if(walker.first<0){
+      throw invalid_argument("Walker " + to_string(walker.first) + " cannot "
+          "be stored in the queue, walker ids must not be negative.");
+    }
+    if(findPosition_(walker.first)!=not_queued){
+      throw invalid_argument("Walker " + to_string(walker.first) + " is "
+          "already stored in the queue, use reschedule to change its time.");
+    }
+    const size_t id = static_cast<size_t>(walker.first);
+    if(id>=position_.size()) position_.resize(id+1,not_queued);
+    heap_.push_back(Event{walker,sequence_});
+    ++sequence_;
+    position_[id] = heap_.size()-1;
+    siftUp_(heap_.size()-1);
+    snapshot_valid_ = false;
+  }
+
+  pair<int,double> IndexedQueue::pop_current() {
+    if(heap_.empty()){
+      throw out_of_range("Cannot pop walker from an empty queue.");
+    }
+    pair<int,double> current = heap_.front().walker;
+    removeAt_(0);
+    return current;
+  }
+
+  void IndexedQueue::reschedule(const int walker_id, const double time){
+    size_t index = findPosition_(walker_id);
+    if(index==not_queued){
+      throw invalid_argument("Cannot reschedule walker " +
+          to_string(walker_id) + " it is not stored in the queue.");
+    }
+    double old_time = heap_[index].walker.second;
+    heap_[index].walker.second = time;
+    heap_[index].sequence = sequence_;
+    ++sequence_;
+    if(time < old_time){
+      siftUp_(index);
+    }else{
+      siftDown_(index);
+    }
+    snapshot_valid_ = false;
+  }
+
+  void IndexedQueue::remove(const int walker_id){
+    size_t index = findPosition_(walker_id);
+    if(index==not_queued){
+      throw invalid_argument("Cannot remove walker " + to_string(walker_id) +
+          " it is not stored in the queue.");
+    }
+    removeAt_(index);
+  }
+
+  bool IndexedQueue::contains(const int walker_id) const {
+    return findPosition_(walker_id)!=not_queued;
+  }
+
+  double IndexedQueue::getTime(const int walker_id) const {
+    size_t index = findPosition_(walker_id);
+    if(index==not_queued){
+      throw invalid_argument("Walker " + to_string(walker_id) + " is not "
+          "stored in the queue.");
+    }
+    return heap_[index].walker.second;
+  }
+
+  const pair<int,double> & IndexedQueue::at(int index) const {
+    if(index<0 || static_cast<size_t>(index)>=heap_.size()){
+      throw out_of_range("Index " + to_string(index) + " is outside of the "
+          "queue.");
+    }
+    if(index==0) return heap_.front().walker;
+    if(!snapshot_valid_){
+      vector<Event> sorted_events(heap_);
+      std::sort(sorted_events.begin(),sorted_events.end(),earlier_);
+      snapshot_.clear();
+      snapshot_.reserve(sorted_events.size());
+      for( const Event & event : sorted_events){
+        snapshot_.push_back(event.walker);
+      }
+      snapshot_valid_ = true;
+    }
+    return snapshot_[index];
+  }
+
+  /****************************************************************************
+   * Private Internal Functions
+   ****************************************************************************/
+
+  void IndexedQueue::swap_(size_t index1, size_t index2){
+    std::swap(heap_[index1],heap_[index2]);
+    position_[static_cast<size_t>(heap_[index1].walker.first)] = index1;
+    position_[static_cast<size_t>(heap_[index2].walker.first)] = index2;
+  }
+
+  void IndexedQueue::siftUp_(size_t index){
+    while(index>0){
+      size_t parent = (index-1)/2;
+      if(!earlier_(heap_[index],heap_[parent])) return;
+      swap_(index,parent);
+      index = parent;
+    }
+  }
+
+  void IndexedQueue::siftDown_(size_t index){
+    size_t size = heap_.size();
+    while(true){
+      size_t left = 2*index+1;
+      if(left>=size) return;
+      size_t earliest = left;
+      size_t right = left+1;
+      if(right<size && earlier_(heap_[right],heap_[left])) earliest = right;
+      if(!earlier_(heap_[earliest],heap_[index])) return;
+      swap_(index,earliest);
+      index = earliest;
+    }
+  }
+
+  void IndexedQueue::removeAt_(size_t index){
+    position_[static_cast<size_t>(heap_[index].walker.first)] = not_queued;
+    size_t last = heap_.size()-1;
+    if(index!=last){
+      heap_[index] = heap_[last];
+      position_[static_cast<size_t>(heap_[index].walker.first)] = index;
+      heap_.pop_back();
+      // The moved event may need to travel in either direction
+      siftUp_(index);
+      siftDown_(index);
+    }else{
+      heap_.pop_back();
+    }
+    snapshot_valid_ = false;
+  }
+
+}
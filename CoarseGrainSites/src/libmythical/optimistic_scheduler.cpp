@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "mythical/constants.hpp"
+#include "mythical/indexed_queue.hpp"
+#include "mythical/optimistic_scheduler.hpp"
+
+#include "topologyfeatures/topology_feature.hpp"
+#include "random_stream.hpp"
+#include "site_container.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Constants
+ ****************************************************************************/
+
+static const double no_change = numeric_limits<double>::infinity();
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+OptimisticScheduler::OptimisticScheduler(
+    CoarseGrainSystem & system,
+    const size_t thread_count) :
+  system_(system),
+  time_window_(0.0),
+  rollback_count_(0),
+  hops_rolled_back_(0) {
+
+  thread_pool_ = unique_ptr<Thread_Pool>(new Thread_Pool(thread_count));
+}
+
+OptimisticScheduler::~OptimisticScheduler(){
+}
+
+size_t OptimisticScheduler::getNumberOfThreads() const {
+  return thread_pool_->size();
+}
+
+void OptimisticScheduler::setTimeWindow(const double time_window){
+  if(!(time_window>0.0)){
+    throw invalid_argument("The time window must be a positive value.");
+  }
+  time_window_ = time_window;
+}
+
+size_t OptimisticScheduler::hop(WalkerPool & walkers, const double time_horizon){
+  checkSystem_();
+
+  stamps_.resize(system_.topology_features_.size(),
+      Version_Stamp{no_change,constants::unassignedId,no_change});
+
+  const IndexedQueue & event_queue = walkers.event_queue_;
+  size_t hop_count = 0;
+  while(!event_queue.empty() && event_queue.at(0).second < time_horizon){
+    const double window_end = min(
+        event_queue.at(0).second+time_window_,
+        time_horizon);
+
+    logs_.resize(event_queue.size());
+    for(size_t index = 0; index < event_queue.size(); ++index){
+      Walker_Log & log = logs_[index];
+      log.walker_id = event_queue.at(static_cast<int>(index)).first;
+      const size_t id = static_cast<size_t>(log.walker_id);
+      log.start = Walker_State{
+        walkers.current_site_[id],
+        walkers.potential_site_[id],
+        walkers.dwell_time_[id],
+        walkers.time_[id],
+        system_.walker_steps_[id]};
+    }
+
+    // The walkers only read the state of the system while speculating
+    thread_pool_->parallelFor(logs_.size(),[&](size_t index){
+        speculate_(logs_[index],window_end);
+        });
+
+    for(const Walker_Log & log : logs_){
+      for(size_t hop = 0; hop < log.checkpoints.size(); ++hop){
+        if(!log.moved[hop]) continue;
+        const Walker_State & state = log.checkpoints[hop];
+        stampSite_(state.site_id,state.time,log.walker_id);
+        stampSite_(state.potential_site,state.time,log.walker_id);
+      }
+    }
+
+    vector<double> conflicts(logs_.size());
+    thread_pool_->parallelFor(logs_.size(),[&](size_t index){
+        conflicts[index] = findConflict_(logs_[index]);
+        });
+    const double conflict_time = conflicts.empty() ? no_change :
+      *min_element(conflicts.begin(),conflicts.end());
+    if(conflict_time!=no_change) ++rollback_count_;
+
+    hop_count += commit_(walkers,conflict_time);
+
+    for(const size_t & index : stamped_sites_){
+      stamps_[index] = Version_Stamp{no_change,constants::unassignedId,no_change};
+    }
+    stamped_sites_.clear();
+  }
+  return hop_count;
+}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+void OptimisticScheduler::checkSystem_() const {
+  if(!(time_window_>0.0)){
+    throw runtime_error("The time window must be set before hopping.");
+  }
+  if(system_.topology_features_.empty()){
+    throw runtime_error("You must first initialize the system before "
+        "hopping.");
+  }
+  if(system_.random_policy_!=RandomPolicy::counter_based){
+    throw runtime_error("The optimistic scheduler requires the counter based "
+        "random policy.");
+  }
+  if(system_.iteration_threshold_min_!=constants::inf_iterations ||
+      !system_.getClusters().empty()){
+    throw runtime_error("The optimistic scheduler cannot be used with coarse "
+        "graining, set the iteration threshold to constants::inf_iterations.");
+  }
+}
+
+// Mirrors CoarseGrainSystem::moveWalker_, the other walkers are assumed to
+// stay where they were at the start of the window
+void OptimisticScheduler::speculate_(Walker_Log & log, const double window_end){
+  log.checkpoints.clear();
+  log.moved.clear();
+  Walker_State state = log.start;
+  while(state.time < window_end){
+    log.checkpoints.push_back(state);
+    const int target = state.potential_site;
+    // The walker itself is the one occupying the site it started from
+    const bool occupied = target==state.site_id ||
+      (target!=log.start.site_id &&
+       system_.getTopologyFeature_(target)->isOccupied(target));
+    if(!occupied) state.site_id = target;
+    log.moved.push_back(!occupied);
+
+    TopologyFeature * feature = system_.getTopologyFeature_(state.site_id);
+    Random_Stream stream(system_.seed_,Random_Stream::walkerStream(log.walker_id));
+    stream.setStep(state.step);
+    ++state.step;
+    state.dwell_time = feature->getDwellTime(log.walker_id,stream);
+    state.potential_site = feature->pickNewSiteId(log.walker_id,stream);
+    state.time += state.dwell_time;
+  }
+  log.end = state;
+}
+
+void OptimisticScheduler::stampSite_(
+    const int siteId,
+    const double time,
+    const int walker_id){
+
+  const size_t index = static_cast<size_t>(system_.sites_->getIndex(siteId));
+  Version_Stamp & stamp = stamps_[index];
+  if(stamp.time==no_change) stamped_sites_.push_back(index);
+  if(stamp.walker_id==walker_id){
+    stamp.time = min(stamp.time,time);
+  }else if(time < stamp.time){
+    // The previous earliest change was made by another walker
+    stamp.other_time = stamp.time;
+    stamp.time = time;
+    stamp.walker_id = walker_id;
+  }else{
+    stamp.other_time = min(stamp.other_time,time);
+  }
+}
+
+// Time of the first hop that checked a site another walker had changed
+// earlier in the window
+double OptimisticScheduler::findConflict_(const Walker_Log & log){
+  for(const Walker_State & state : log.checkpoints){
+    const size_t index = static_cast<size_t>(
+        system_.sites_->getIndex(state.potential_site));
+    const Version_Stamp & stamp = stamps_[index];
+    const double changed = stamp.walker_id==log.walker_id ?
+      stamp.other_time : stamp.time;
+    if(changed < state.time) return state.time;
+  }
+  return no_change;
+}
+
+size_t OptimisticScheduler::commit_(WalkerPool & walkers, const double conflict_time){
+  size_t hop_count = 0;
+  for(const Walker_Log & log : logs_){
+    size_t hops = 0;
+    while(hops < log.checkpoints.size() &&
+        log.checkpoints[hops].time < conflict_time){
+      ++hops;
+    }
+    hops_rolled_back_ += log.checkpoints.size()-hops;
+    if(hops==0) continue;
+
+    // The occupancy is a count, so the order the walkers are applied in
+    // does not matter
+    for(size_t hop = 0; hop < hops; ++hop){
+      const Walker_State & state = log.checkpoints[hop];
+      const int siteId = log.moved[hop] ? state.potential_site : state.site_id;
+      system_.getTopologyFeature_(state.site_id)->vacate(state.site_id);
+      system_.getTopologyFeature_(siteId)->occupy(siteId);
+      if(system_.event_log_){
+        committed_events_.push_back(HopEvent{log.walker_id,state.site_id,
+            siteId,state.time,false});
+      }
+    }
+    hop_count += hops;
+
+    const Walker_State & state = hops < log.checkpoints.size() ?
+      log.checkpoints[hops] : log.end;
+    const size_t id = static_cast<size_t>(log.walker_id);
+    walkers.current_site_[id] = state.site_id;
+    walkers.potential_site_[id] = state.potential_site;
+    walkers.dwell_time_[id] = state.dwell_time;
+    walkers.time_[id] = state.time;
+    walkers.event_queue_.reschedule(log.walker_id,state.time);
+    system_.walker_steps_[id] = state.step;
+  }
+
+  // The hops of the window are recorded in the order the serial hop loop
+  // would have made them, there is no coarse graining so no hop is made
+  // from within a cluster
+  if(system_.event_log_){
+    stable_sort(committed_events_.begin(),committed_events_.end(),
+        [](const HopEvent & event1, const HopEvent & event2){
+          return event1.time < event2.time;
+        });
+    for(const HopEvent & event : committed_events_){
+      system_.recordHop_(event.walker_id,event.from_site_id,event.to_site_id,
+          event.time,event.in_cluster);
+    }
+    committed_events_.clear();
+  }
+  return hop_count;
+}
+
+}
@@ -0,0 +1,216 @@
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+#include "binary_file.hpp"
+#include "random_stream.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+  /****************************************************************************
+   * Private Internal Function Declarations
+   ****************************************************************************/
+
+  // Streams that are seeded from the time are given a unique stream id so
+  // that features created in the same clock tick do not share numbers
+  static atomic<uint64_t> unseeded_stream_count(0);
+
+  const uint64_t site_stream_tag = 0;
+  const uint64_t cluster_stream_tag = 1;
+  const uint64_t walker_stream_tag = 2;
+  const uint64_t observer_stream_tag = 3;
+
+  const uint32_t philox_m0 = 0xD2511F53;
+  const uint32_t philox_m1 = 0xCD9E8D57;
+  const uint32_t philox_w0 = 0x9E3779B9;
+  const uint32_t philox_w1 = 0xBB67AE85;
+
+  // 2^-53 used to convert the 53 most significant bits into a double
+  const double inverse_2_pow_53 = 1.0/9007199254740992.0;
+
+  /// Bijective 64 bit mixing function of splitmix64
+  inline uint64_t mix64(uint64_t value){
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+  }
+
+  inline void mulhilo(const uint32_t a, const uint32_t b, uint32_t & hi, uint32_t & lo){
+    uint64_t product = static_cast<uint64_t>(a)*static_cast<uint64_t>(b);
+    hi = static_cast<uint32_t>(product >> 32);
+    lo = static_cast<uint32_t>(product);
+  }
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  Random_Stream::Random_Stream() :
+    policy_(RandomPolicy::counter_based),
+    step_(0),
+    counter_(0) {
+    seed_ = static_cast<uint64_t>(
+        chrono::system_clock::now().time_since_epoch().count());
+    // Use the top of the range so as not to collide with the feature streams
+    stream_id_ = ~(unseeded_stream_count++);
+    setKey_();
+  }
+
+  Random_Stream::Random_Stream(const uint64_t seed, const uint64_t stream_id) :
+    policy_(RandomPolicy::counter_based),
+    seed_(seed),
+    stream_id_(stream_id),
+    step_(0),
+    counter_(0) {
+    setKey_();
+  }
+
+  Random_Stream::Random_Stream(const Random_Stream & stream) :
+    policy_(stream.policy_),
+    seed_(stream.seed_),
+    stream_id_(stream.stream_id_),
+    step_(stream.step_),
+    counter_(stream.counter_),
+    key_(stream.key_) {
+    if(stream.engine_){
+      engine_ = unique_ptr<mt19937>(new mt19937(*stream.engine_));
+    }
+  }
+
+  Random_Stream & Random_Stream::operator=(const Random_Stream & stream){
+    if(this==&stream) return *this;
+    policy_ = stream.policy_;
+    seed_ = stream.seed_;
+    stream_id_ = stream.stream_id_;
+    step_ = stream.step_;
+    counter_ = stream.counter_;
+    key_ = stream.key_;
+    if(stream.engine_){
+      engine_ = unique_ptr<mt19937>(new mt19937(*stream.engine_));
+    }else{
+      engine_.reset();
+    }
+    return *this;
+  }
+
+  void Random_Stream::setPolicy(const RandomPolicy policy){
+    policy_ = policy;
+    seed(seed_,stream_id_);
+  }
+
+  void Random_Stream::seed(const uint64_t seed, const uint64_t stream_id){
+    seed_ = seed;
+    stream_id_ = stream_id;
+    step_ = 0;
+    counter_ = 0;
+    setKey_();
+    if(policy_ == RandomPolicy::mersenne_twister){
+      engine_ = unique_ptr<mt19937>(
+          new mt19937(static_cast<mt19937::result_type>(seed)));
+    }else{
+      engine_.reset();
+    }
+  }
+
+  double Random_Stream::uniform(){
+    if(policy_ == RandomPolicy::mersenne_twister){
+      uniform_real_distribution<double> distribution(0.0,1.0);
+      ++counter_;
+      return distribution(*engine_);
+    }
+    array<uint32_t,4> counter = {{
+      static_cast<uint32_t>(counter_),
+      static_cast<uint32_t>(counter_ >> 32),
+      static_cast<uint32_t>(step_),
+      static_cast<uint32_t>(step_ >> 32)}};
+    ++counter_;
+    array<uint32_t,4> bits = philox4x32_10(counter,key_);
+    uint64_t value = (static_cast<uint64_t>(bits[1]) << 32) | bits[0];
+    // Adding one ensures 0.0 is never returned, which would make log blow up
+    return static_cast<double>((value >> 11) + 1) * inverse_2_pow_53;
+  }
+
+  void Random_Stream::saveState(Binary_Writer & writer) const {
+    writer.write(static_cast<uint8_t>(policy_));
+    writer.write(seed_);
+    writer.write(stream_id_);
+    writer.write(step_);
+    writer.write(counter_);
+    if(policy_ == RandomPolicy::mersenne_twister){
+      // The standard only exposes the state of the engine as text
+      ostringstream engine_state;
+      engine_state << *engine_;
+      writer.writeString(engine_state.str());
+    }
+  }
+
+  void Random_Stream::loadState(Binary_Reader & reader){
+    const uint8_t policy = reader.read<uint8_t>();
+    if(policy > static_cast<uint8_t>(RandomPolicy::mersenne_twister)){
+      throw runtime_error("Unknown random policy " + to_string(policy) +
+          " stored for a random stream.");
+    }
+    policy_ = static_cast<RandomPolicy>(policy);
+    seed_ = reader.read<uint64_t>();
+    stream_id_ = reader.read<uint64_t>();
+    step_ = reader.read<uint64_t>();
+    counter_ = reader.read<uint64_t>();
+    setKey_();
+    engine_.reset();
+    if(policy_ == RandomPolicy::mersenne_twister){
+      engine_ = unique_ptr<mt19937>(new mt19937);
+      istringstream engine_state(reader.readString());
+      engine_state >> *engine_;
+      if(!engine_state){
+        throw runtime_error("Unable to restore the state of a mersenne "
+            "twister stream.");
+      }
+    }
+  }
+
+  uint64_t Random_Stream::siteStream(const int site_id){
+    return (site_stream_tag << 32) | static_cast<uint32_t>(site_id);
+  }
+
+  uint64_t Random_Stream::clusterStream(const int cluster_id){
+    return (cluster_stream_tag << 32) | static_cast<uint32_t>(cluster_id);
+  }
+
+  uint64_t Random_Stream::walkerStream(const int walker_id){
+    return (walker_stream_tag << 32) | static_cast<uint32_t>(walker_id);
+  }
+  uint64_t Random_Stream::observerStream(){
+    return observer_stream_tag << 32;
+  }
+
+  array<uint32_t,4> Random_Stream::philox4x32_10(
+      array<uint32_t,4> counter,
+      array<uint32_t,2> key){
+
+    for(int round = 0; round < 10; ++round){
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(philox_m0,counter[0],hi0,lo0);
+      mulhilo(philox_m1,counter[2],hi1,lo1);
+      counter = {{ hi1^counter[1]^key[0], lo1, hi0^counter[3]^key[1], lo0 }};
+      key[0] += philox_w0;
+      key[1] += philox_w1;
+    }
+    return counter;
+  }
+
+  /****************************************************************************
+   * Private Internal Functions
+   ****************************************************************************/
+
+  // For a given seed the key is a bijection of the stream id, so streams of
+  // the same seed never share a key
+  void Random_Stream::setKey_(){
+    const uint64_t key = mix64(seed_ ^ mix64(stream_id_));
+    key_ = {{ static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32) }};
+  }
+
+}
@@ -0,0 +1,116 @@
+#ifndef MYTHICAL_RANDOM_STREAM_HPP
+#define MYTHICAL_RANDOM_STREAM_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include "mythical/random_policy.hpp"
+
+namespace mythical {
+
+class Binary_Reader;
+class Binary_Writer;
+
+/**
+ * \brief Small state source of uniform random numbers
+ *
+ * By default a counter based generator is used (Philox4x32-10), the nth
+ * random number of a stream is a pure function of the seed, the stream id,
+ * the step and n. Hence, the only state that needs to be stored is the
+ * seed, the stream id, the step and the number of values that have been
+ * drawn. The step and n fill the 128 bit counter, the seed and the stream
+ * id are mixed into the 64 bit key, so for a given seed every stream id has
+ * a key of its own.
+ *
+ * If the mersenne twister policy is chosen an std::mt19937 engine is
+ * allocated on the heap, the stream id is ignored in this case.
+ **/
+class Random_Stream {
+  public:
+    /// Seeded from the time, each instance is given a different stream
+    Random_Stream();
+
+    /// Counter based stream, does not read the clock
+    Random_Stream(const uint64_t seed, const uint64_t stream_id);
+
+    Random_Stream(const Random_Stream & stream);
+    Random_Stream & operator=(const Random_Stream & stream);
+
+    void setPolicy(const RandomPolicy policy);
+    RandomPolicy getPolicy() const { return policy_; }
+
+    /**
+     * \brief Seed the stream
+     *
+     * Resets the step and the number of values that have been drawn to 0.
+     **/
+    void seed(const uint64_t seed, const uint64_t stream_id);
+
+    /// Returns a random number in the range (0,1]
+    double uniform();
+
+    /// Number of values that have been drawn since the stream was seeded or
+    /// the step was set
+    uint64_t getCounter() const { return counter_; }
+
+    /**
+     * \brief Jump to the start of a step
+     *
+     * The values drawn during a step of a counter based stream depend only
+     * on the seed, the stream id and the step, every 64 bit step has its own
+     * sequence. Resets the number of values drawn to 0. Has no effect on the
+     * mersenne twister policy.
+     **/
+    void setStep(const uint64_t step) {
+      step_ = step;
+      counter_ = 0;
+    }
+    uint64_t getStep() const { return step_; }
+
+    /// Write everything needed to carry on drawing the same sequence
+    void saveState(Binary_Writer & writer) const;
+    /// Restore a stream written by saveState, including its policy
+    void loadState(Binary_Reader & reader);
+
+    /**
+     * \brief Creates stream ids that will not collide between different
+     * types of features with the same id
+     **/
+    static uint64_t siteStream(const int site_id);
+    static uint64_t clusterStream(const int cluster_id);
+    static uint64_t walkerStream(const int walker_id);
+    /// Used for draws that must not change the trajectory of any walker
+    static uint64_t observerStream();
+
+    /**
+     * \brief Philox4x32 with 10 rounds
+     *
+     * \param[in] counter 128 bit counter
+     * \param[in] key 64 bit key
+     *
+     * \return 128 bits of random output
+     **/
+    static std::array<uint32_t,4> philox4x32_10(
+        std::array<uint32_t,4> counter,
+        std::array<uint32_t,2> key);
+
+  private:
+    RandomPolicy policy_;
+    uint64_t seed_;
+    uint64_t stream_id_;
+    uint64_t step_;
+    uint64_t counter_;
+    /// Philox key worked out from the seed and the stream id
+    std::array<uint32_t,2> key_;
+
+    void setKey_();
+
+    /// Only allocated for the mersenne twister policy
+    std::unique_ptr<std::mt19937> engine_;
+};
+
+}
+
+#endif // MYTHICAL_RANDOM_STREAM_HPP
@@ -8,7 +8,7 @@ using namespace std;
 
 namespace mythical {
 
-  void Rate_Container::addRate(int siteId, int neighId, double * rate){
+  void Rate_Container::addRate(int siteId, int neighId, const double * rate){
     if(rates_.count(siteId)){
       if(rates_[siteId].count(neighId)){
         throw invalid_argument("Error the rate has already been added.");
@@ -30,7 +30,7 @@ namespace mythical {
 
   }
 
-  double * Rate_Container::getRate(int siteId, int neighId) {
+  const double * Rate_Container::getRate(int siteId, int neighId) {
     if(rates_.count(siteId)==0){
       if(rates_[siteId].count(neighId)==0){
         throw invalid_argument("Cannot retrieve rate as it has not been added.");
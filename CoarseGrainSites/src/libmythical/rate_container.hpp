@@ -7,7 +7,7 @@
 
 namespace mythical {
 
-typedef std::unordered_map<int,std::unordered_map<int, double *>> Rate_Map;
+typedef std::unordered_map<int,std::unordered_map<int, const double *>> Rate_Map;
 /**
  * \brief Class is designed to store rates 
  **/
@@ -16,9 +16,9 @@ class Rate_Container {
     Rate_Container() {};
     Rate_Container(Rate_Map rates) : rates_(rates) {};
 
-    void addRate(int siteId, int neighId,double * rate);
+    void addRate(int siteId, int neighId,const double * rate);
     void addRates(Rate_Map rates);
-    double * getRate(int siteId, int neighId);
+    const double * getRate(int siteId, int neighId);
 
     size_t incomingRateCount(int siteId);
     size_t outgoingRateCount(int siteId);
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mythical/rate_file.hpp"
+
+#include "binary_file.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Constants
+ ****************************************************************************/
+
+static const char rate_file_magic[9] = "MYTHRATE";
+static const uint32_t rate_file_version = 1;
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+RateFileWriter::RateFileWriter(
+    const string & file_name,
+    const size_t site_count,
+    const size_t rate_count,
+    const bool has_positions,
+    const bool has_energies) :
+  writer_(new Binary_Writer(file_name,rate_file_magic,rate_file_version)),
+  site_count_(site_count),
+  rate_count_(rate_count),
+  has_positions_(has_positions),
+  has_energies_(has_energies),
+  section_(site_id_section),
+  remaining_(0) {
+
+  startSection_(site_id_section);
+}
+
+RateFileWriter::~RateFileWriter() {}
+
+void RateFileWriter::writeSiteIds(const int * site_ids, const size_t count) {
+  append_(site_id_section,site_ids,count);
+}
+
+// Stored as uint64 whatever the size of size_t
+void RateFileWriter::writeRowOffsets(
+    const size_t * row_offsets,
+    const size_t count) {
+  uint64_t buffer[512];
+  for(size_t first = 0; first < count; first+=512){
+    const size_t block = min(count-first,static_cast<size_t>(512));
+    for(size_t index = 0; index < block; ++index){
+      buffer[index] = static_cast<uint64_t>(row_offsets[first+index]);
+    }
+    append_(row_offset_section,buffer,block);
+  }
+}
+
+void RateFileWriter::writeNeighborIds(
+    const int * neighbor_ids,
+    const size_t count) {
+  append_(neighbor_id_section,neighbor_ids,count);
+}
+
+void RateFileWriter::writeRates(const double * rates, const size_t count) {
+  append_(rate_section,rates,count);
+}
+
+void RateFileWriter::writePositions(
+    const double * positions,
+    const size_t count) {
+  append_(position_section,positions,count);
+}
+
+void RateFileWriter::writeEnergies(const double * energies, const size_t count) {
+  append_(energy_section,energies,count);
+}
+
+void RateFileWriter::close() {
+  if(section_!=end_section){
+    throw runtime_error("Cannot close the rate file, not all of the values "
+        "have been written.");
+  }
+  writer_->close();
+}
+
+RateFileReader::RateFileReader(const string & file_name) :
+  reader_(new Binary_Reader(file_name,rate_file_magic,rate_file_version)) {
+
+  size_t count;
+  site_ids_ = reader_->viewArray<int>(site_count_);
+  row_offsets_ = reader_->viewArray<uint64_t>(count);
+  if(count!=site_count_+1){
+    throw runtime_error(file_name + " has " + to_string(count) + " row "
+        "offsets for " + to_string(site_count_) + " sites.");
+  }
+  neighbor_ids_ = reader_->viewArray<int>(rate_count_);
+  rates_ = reader_->viewArray<double>(count);
+  if(count!=rate_count_){
+    throw runtime_error(file_name + " has " + to_string(count) + " rates "
+        "for " + to_string(rate_count_) + " neighbors.");
+  }
+  if(row_offsets_[0]!=0 || row_offsets_[site_count_]!=rate_count_){
+    throw runtime_error("The row offsets of " + file_name + " do not cover "
+        "its rates.");
+  }
+  for(size_t index = 0; index < site_count_; ++index){
+    if(row_offsets_[index]>row_offsets_[index+1]){
+      throw runtime_error("The row offsets of " + file_name + " are not in "
+          "increasing order.");
+    }
+  }
+
+  positions_ = reader_->viewArray<double>(count);
+  if(count==0){
+    positions_ = nullptr;
+  }else if(count!=3*site_count_){
+    throw runtime_error(file_name + " has " + to_string(count) + " position "
+        "values for " + to_string(site_count_) + " sites.");
+  }
+  energies_ = reader_->viewArray<double>(count);
+  if(count==0){
+    energies_ = nullptr;
+  }else if(count!=site_count_){
+    throw runtime_error(file_name + " has " + to_string(count) + " energies "
+        "for " + to_string(site_count_) + " sites.");
+  }
+  reader_->checkEnd();
+}
+
+RateFileReader::~RateFileReader() {}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+size_t RateFileWriter::sectionSize_(const Section section) const {
+  switch(section){
+    case site_id_section:
+      return site_count_;
+    case row_offset_section:
+      return site_count_+1;
+    case neighbor_id_section:
+    case rate_section:
+      return rate_count_;
+    case position_section:
+      return has_positions_ ? 3*site_count_ : 0;
+    case energy_section:
+      return has_energies_ ? site_count_ : 0;
+    default:
+      return 0;
+  }
+}
+
+template<typename T>
+void RateFileWriter::append_(
+    const Section section,
+    const T * values,
+    const size_t count) {
+  if(section!=section_ || count>remaining_){
+    throw runtime_error("Values must be written to the rate file in the "
+        "order of its arrays, without writing more values than were "
+        "declared.");
+  }
+  writer_->writeValues(values,count);
+  remaining_ -= count;
+  if(remaining_==0) startSection_(static_cast<Section>(section_+1));
+}
+
+// Empty arrays are written straight away
+void RateFileWriter::startSection_(const Section section) {
+  section_ = section;
+  while(section_!=end_section){
+    remaining_ = sectionSize_(section_);
+    switch(section_){
+      case row_offset_section:
+        writer_->beginArray<uint64_t>(remaining_);
+        break;
+      case site_id_section:
+      case neighbor_id_section:
+        writer_->beginArray<int>(remaining_);
+        break;
+      default:
+        writer_->beginArray<double>(remaining_);
+    }
+    if(remaining_>0) return;
+    section_ = static_cast<Section>(section_+1);
+  }
+}
+
+}
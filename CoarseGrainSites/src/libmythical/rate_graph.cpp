@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "binary_file.hpp"
+#include "rate_graph.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+  Rate_Graph::Rate_Graph() :
+    site_ids_(nullptr),
+    row_offsets_(nullptr),
+    neighbor_ids_(nullptr),
+    rates_(nullptr),
+    site_count_(0),
+    rate_count_(0),
+    owned_row_offsets_(1,0),
+    single_row_(false),
+    dense_ids_(true),
+    first_id_(0) {
+    useOwnedArrays_();
+  }
+
+  Rate_Graph::Rate_Graph(
+      const unordered_map<int, unordered_map<int, double>> & rates) :
+    Rate_Graph() {
+
+    // Rows are ordered by site id, drains included, so that consecutive site
+    // ids end up in consecutive rows
+    set<int> site_ids;
+    for( const auto & site_and_rates : rates ){
+      site_ids.insert(site_and_rates.first);
+      for( const auto & neigh_and_rate : site_and_rates.second ){
+        site_ids.insert(neigh_and_rate.first);
+      }
+    }
+
+    owned_site_ids_.assign(site_ids.begin(),site_ids.end());
+    owned_row_offsets_.reserve(owned_site_ids_.size()+1);
+    for( const int & site_id : owned_site_ids_ ){
+      auto site_and_rates = rates.find(site_id);
+      if(site_and_rates!=rates.end()){
+        for( const auto & neigh_and_rate : site_and_rates->second ){
+          owned_neighbor_ids_.push_back(neigh_and_rate.first);
+          owned_rates_.push_back(neigh_and_rate.second);
+        }
+      }
+      owned_row_offsets_.push_back(owned_neighbor_ids_.size());
+    }
+    useOwnedArrays_();
+    buildIndex_();
+    sortRows_();
+    buildHopTables_();
+  }
+
+  Rate_Graph::Rate_Graph(
+      vector<int> site_ids,
+      vector<size_t> row_offsets,
+      vector<int> neighbor_ids,
+      vector<double> rates) :
+    Rate_Graph() {
+
+    if(row_offsets.size()!=site_ids.size()+1){
+      throw invalid_argument("Cannot create rate graph, there must be one more "
+          "row offset than there are sites.");
+    }
+    if(neighbor_ids.size()!=rates.size()){
+      throw invalid_argument("Cannot create rate graph, the last row offset, "
+          "the number of neighbor ids and the number of rates must match.");
+    }
+    owned_site_ids_ = move(site_ids);
+    owned_row_offsets_ = move(row_offsets);
+    owned_neighbor_ids_ = move(neighbor_ids);
+    owned_rates_ = move(rates);
+    useOwnedArrays_();
+    checkRowOffsets_();
+    finishOwnedArrays_();
+  }
+
+  Rate_Graph::Rate_Graph(
+      shared_ptr<const void> storage,
+      const int * site_ids,
+      const size_t * row_offsets,
+      const int * neighbor_ids,
+      const double * rates,
+      const size_t site_count) :
+    Rate_Graph() {
+
+    site_ids_ = site_ids;
+    row_offsets_ = row_offsets;
+    neighbor_ids_ = neighbor_ids;
+    rates_ = rates;
+    site_count_ = site_count;
+    rate_count_ = row_offsets[site_count];
+    checkRowOffsets_();
+    buildIndex_();
+
+    if(canUseInPlace_()){
+      storage_ = move(storage);
+      // Checks the rates, the rows are already sorted so nothing is moved
+      sortRows_();
+      buildHopTables_();
+      return;
+    }
+    owned_site_ids_.assign(site_ids,site_ids+site_count);
+    owned_row_offsets_.assign(row_offsets,row_offsets+site_count+1);
+    owned_neighbor_ids_.assign(neighbor_ids,neighbor_ids+rate_count_);
+    owned_rates_.assign(rates,rates+rate_count_);
+    useOwnedArrays_();
+    finishOwnedArrays_();
+  }
+
+  shared_ptr<Rate_Graph> Rate_Graph::createSingleRow(
+      const int site_id,
+      const Rate_View rates) {
+
+    auto rate_graph = make_shared<Rate_Graph>();
+    rate_graph->single_row_ = true;
+    rate_graph->owned_site_ids_.assign(1,site_id);
+    rate_graph->owned_row_offsets_.assign({0, rates.size()});
+    rate_graph->owned_neighbor_ids_.assign(
+        rates.neighbor_ids,rates.neighbor_ids+rates.size());
+    rate_graph->owned_rates_.assign(rates.rates,rates.rates+rates.size());
+    rate_graph->useOwnedArrays_();
+    rate_graph->buildIndex_();
+    rate_graph->sortRows_();
+    rate_graph->buildHopTables_();
+    return rate_graph;
+  }
+
+  void Rate_Graph::setRates(vector<pair<int,double>> neigh_rates) {
+    if(!single_row_){
+      throw runtime_error("Cannot change the rates of a rate graph that was "
+          "not created with createSingleRow.");
+    }
+    sort(neigh_rates.begin(),neigh_rates.end());
+    for(size_t ind = 0; ind < neigh_rates.size(); ++ind){
+      if(!(neigh_rates[ind].second > 0.0)){
+        throw invalid_argument("Cannot set the rate to site " +
+            to_string(neigh_rates[ind].first) + ", it must be a positive "
+            "value.");
+      }
+      if(ind>0 && neigh_rates[ind].first==neigh_rates[ind-1].first){
+        throw invalid_argument("Cannot set more than one rate to site " +
+            to_string(neigh_rates[ind].first));
+      }
+    }
+
+    // Merge the new rates into the row, both are sorted by neighbor id
+    vector<int> neighbor_ids;
+    vector<double> rates;
+    neighbor_ids.reserve(rate_count_+neigh_rates.size());
+    rates.reserve(rate_count_+neigh_rates.size());
+    size_t ind = 0;
+    for(const pair<int,double> & neigh_rate : neigh_rates){
+      while(ind < rate_count_ && owned_neighbor_ids_[ind] < neigh_rate.first){
+        neighbor_ids.push_back(owned_neighbor_ids_[ind]);
+        rates.push_back(owned_rates_[ind]);
+        ++ind;
+      }
+      if(ind < rate_count_ && owned_neighbor_ids_[ind]==neigh_rate.first) ++ind;
+      neighbor_ids.push_back(neigh_rate.first);
+      rates.push_back(neigh_rate.second);
+    }
+    neighbor_ids.insert(neighbor_ids.end(),
+        owned_neighbor_ids_.begin()+ind,owned_neighbor_ids_.end());
+    rates.insert(rates.end(),owned_rates_.begin()+ind,owned_rates_.end());
+
+    swap(owned_neighbor_ids_,neighbor_ids);
+    swap(owned_rates_,rates);
+    owned_row_offsets_[1] = owned_neighbor_ids_.size();
+    useOwnedArrays_();
+    buildHopTables_();
+  }
+
+  bool Rate_Graph::exist(const int siteId) const {
+    return findIndex_(siteId)!=-1;
+  }
+
+  int Rate_Graph::getIndex(const int siteId) const {
+    int index = findIndex_(siteId);
+    if(index==-1){
+      throw invalid_argument("Site " + to_string(siteId) + " is not stored in "
+          "the rate graph.");
+    }
+    return index;
+  }
+
+  int Rate_Graph::getSiteId(const int index) const {
+    if(index<0 || static_cast<size_t>(index)>=site_count_){
+      throw out_of_range("Row " + to_string(index) + " is not part of the "
+          "rate graph.");
+    }
+    return site_ids_[index];
+  }
+
+  int Rate_Graph::findNeighbor(const int index, const int neighId) const {
+    const int * begin = neighbor_ids_ + row_offsets_[index];
+    const int * end = neighbor_ids_ + row_offsets_[index+1];
+    auto it = lower_bound(begin,end,neighId);
+    if(it==end || *it!=neighId) return -1;
+    return static_cast<int>(it-begin);
+  }
+
+  double Rate_Graph::getRate(const int index, const int neighId) const {
+    int position = findNeighbor(index,neighId);
+    if(position==-1){
+      throw invalid_argument("Site " + to_string(neighId) + " is not a "
+          "neighbor of site " + to_string(site_ids_[index]));
+    }
+    return rates_[row_offsets_[index]+position];
+  }
+
+  void Rate_Graph::saveState(Binary_Writer & writer) const {
+    writer.writeArray(site_ids_,site_count_);
+    writer.writeArray(row_offsets_,site_count_+1);
+    writer.writeArray(neighbor_ids_,rate_count_);
+    writer.writeArray(rates_,rate_count_);
+  }
+
+  uint64_t Rate_Graph::getHash() const {
+    // The sizes are included so that rows can not shift between arrays
+    uint64_t sizes[2] = {site_count_, rate_count_};
+    uint64_t hash = hashBytes(sizes,sizeof(sizes));
+    hash = hashBytes(site_ids_,site_count_*sizeof(int),hash);
+    hash = hashBytes(row_offsets_,(site_count_+1)*sizeof(size_t),hash);
+    hash = hashBytes(neighbor_ids_,rate_count_*sizeof(int),hash);
+    return hashBytes(rates_,rate_count_*sizeof(double),hash);
+  }
+
+  shared_ptr<Rate_Graph> Rate_Graph::loadState(Binary_Reader & reader) {
+    vector<int> site_ids;
+    vector<size_t> row_offsets;
+    vector<int> neighbor_ids;
+    vector<double> rates;
+    reader.readArray(site_ids);
+    reader.readArray(row_offsets);
+    reader.readArray(neighbor_ids);
+    reader.readArray(rates);
+    return make_shared<Rate_Graph>(
+        move(site_ids),
+        move(row_offsets),
+        move(neighbor_ids),
+        move(rates));
+  }
+
+  /****************************************************************************
+   * Private Internal Functions
+   ****************************************************************************/
+
+  void Rate_Graph::useOwnedArrays_(){
+    site_ids_ = owned_site_ids_.data();
+    row_offsets_ = owned_row_offsets_.data();
+    neighbor_ids_ = owned_neighbor_ids_.data();
+    rates_ = owned_rates_.data();
+    site_count_ = owned_site_ids_.size();
+    rate_count_ = owned_neighbor_ids_.size();
+  }
+
+  void Rate_Graph::checkRowOffsets_() const {
+    if(row_offsets_[0]!=0){
+      throw invalid_argument("Cannot create rate graph, the first row offset "
+          "must be 0.");
+    }
+    if(row_offsets_[site_count_]!=rate_count_){
+      throw invalid_argument("Cannot create rate graph, the last row offset, "
+          "the number of neighbor ids and the number of rates must match.");
+    }
+    for(size_t row = 0; row < site_count_; ++row){
+      if(row_offsets_[row+1]<row_offsets_[row]){
+        throw invalid_argument("Cannot create rate graph, row offsets must be "
+            "monotonically increasing.");
+      }
+    }
+  }
+
+  bool Rate_Graph::canUseInPlace_() const {
+    for(size_t row = 0; row < site_count_; ++row){
+      for(size_t ind = row_offsets_[row]; ind < row_offsets_[row+1]; ++ind){
+        if(ind>row_offsets_[row] && neighbor_ids_[ind]<=neighbor_ids_[ind-1]){
+          return false;
+        }
+        if(!exist(neighbor_ids_[ind])) return false;
+      }
+    }
+    return true;
+  }
+
+  // Called once the owned arrays hold the rows passed in
+  void Rate_Graph::finishOwnedArrays_(){
+    buildIndex_();
+    addDrainRows_();
+    sortRows_();
+    buildHopTables_();
+  }
+
+  void Rate_Graph::buildIndex_(){
+    index_of_site_.clear();
+    dense_ids_ = true;
+    first_id_ = site_count_==0 ? 0 : site_ids_[0];
+    for(size_t row = 0; row < site_count_; ++row){
+      if(static_cast<long>(site_ids_[row]) !=
+          static_cast<long>(first_id_) + static_cast<long>(row)){
+        dense_ids_ = false;
+        break;
+      }
+    }
+    if(dense_ids_) return;
+
+    index_of_site_.reserve(site_count_);
+    for(size_t row = 0; row < site_count_; ++row){
+      if(index_of_site_.count(site_ids_[row])){
+        throw invalid_argument("Cannot create rate graph, site " +
+            to_string(site_ids_[row]) + " appears in more than one row.");
+      }
+      index_of_site_[site_ids_[row]] = static_cast<int>(row);
+    }
+  }
+
+  // Sites that can be hopped to but that have no rates off of them are given
+  // an empty row so that they can still be indexed
+  void Rate_Graph::addDrainRows_(){
+    set<int> drain_site_ids;
+    for(size_t ind = 0; ind < rate_count_; ++ind){
+      if(!exist(neighbor_ids_[ind])){
+        drain_site_ids.insert(neighbor_ids_[ind]);
+      }
+    }
+    if(drain_site_ids.empty()) return;
+    for( const int & drain_site_id : drain_site_ids ){
+      owned_site_ids_.push_back(drain_site_id);
+      owned_row_offsets_.push_back(owned_neighbor_ids_.size());
+    }
+    useOwnedArrays_();
+    buildIndex_();
+  }
+
+  // Also checks the rates, rows that are already in order are left alone so
+  // that arrays used in place are never written to
+  void Rate_Graph::sortRows_(){
+    vector<pair<int,double>> row_entries;
+    for(size_t row = 0; row < site_count_; ++row){
+      size_t begin = row_offsets_[row];
+      size_t end = row_offsets_[row+1];
+      bool sorted = true;
+      for(size_t ind = begin; ind < end; ++ind){
+        if(!(rates_[ind] > 0.0)){
+          throw invalid_argument("Cannot create rate graph, the rate from site "
+              + to_string(site_ids_[row]) + " to site " +
+              to_string(neighbor_ids_[ind]) + " must be a positive value.");
+        }
+        if(ind>begin && neighbor_ids_[ind]<=neighbor_ids_[ind-1]){
+          sorted = false;
+        }
+      }
+      if(sorted) continue;
+
+      row_entries.clear();
+      for(size_t ind = begin; ind < end; ++ind){
+        row_entries.emplace_back(neighbor_ids_[ind],rates_[ind]);
+      }
+      sort(row_entries.begin(),row_entries.end());
+      for(size_t ind = begin; ind < end; ++ind){
+        const pair<int,double> & entry = row_entries[ind-begin];
+        if(ind>begin && entry.first == owned_neighbor_ids_[ind-1]){
+          throw invalid_argument("Cannot create rate graph, site " +
+              to_string(site_ids_[row]) + " has more than one rate to site " +
+              to_string(entry.first));
+        }
+        owned_neighbor_ids_[ind] = entry.first;
+        owned_rates_[ind] = entry.second;
+      }
+    }
+  }
+
+  void Rate_Graph::buildHopTables_(){
+    time_constants_.assign(site_count_,0.0);
+    probabilities_.assign(rate_count_,0.0);
+    samplers_.assign(site_count_,Discrete_Sampler());
+    vector<double> row_probabilities;
+    for(size_t row = 0; row < site_count_; ++row){
+      size_t begin = row_offsets_[row];
+      size_t end = row_offsets_[row+1];
+      if(begin==end) continue;
+      double sum = 0.0;
+      for(size_t ind = begin; ind < end; ++ind){
+        sum += rates_[ind];
+      }
+      time_constants_[row] = 1.0/sum;
+      row_probabilities.clear();
+      for(size_t ind = begin; ind < end; ++ind){
+        probabilities_[ind] = rates_[ind]/sum;
+        row_probabilities.push_back(probabilities_[ind]);
+      }
+      samplers_[row].build(row_probabilities);
+    }
+  }
+
+}
@@ -0,0 +1,262 @@
+#ifndef MYTHICAL_RATE_GRAPH_HPP
+#define MYTHICAL_RATE_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "discrete_sampler.hpp"
+
+namespace mythical {
+
+class Binary_Reader;
+class Binary_Writer;
+
+/**
+ * \brief Light weight view of the outgoing rates of a single site
+ *
+ * The view does not own any memory, it simply points into the contiguous
+ * arrays stored in a Rate_Graph. The neighbor ids are sorted in ascending
+ * order.
+ **/
+struct Rate_View {
+  const int * neighbor_ids;
+  const double * rates;
+  size_t count;
+
+  size_t size() const { return count; }
+  int neighborId(const size_t index) const { return neighbor_ids[index]; }
+  double rate(const size_t index) const { return rates[index]; }
+};
+
+/**
+ * \brief Compressed sparse row storage of the rates between sites
+ *
+ * Every site is assigned a dense index in the range 0 to size()-1. The
+ * outgoing rates of the site with index i are stored contiguously in the
+ * neighbor id and rate arrays between row_offsets[i] and row_offsets[i+1].
+ * This means that walking over the neighbors of a site touches a single
+ * block of memory instead of chasing pointers through nested hash maps.
+ *
+ * Sites that only appear as a neighbor (drains) are given a row with no
+ * outgoing rates. The rates are copied into the graph when it is created,
+ * unless they are handed over in a form that can be used in place, see the
+ * constructor taking a storage pointer. If the site ids of the rows are
+ * consecutive, e.g. 0,1,2..., a site id is converted into its row by a
+ * subtraction, otherwise a hash map is used.
+ *
+ * Everything that can be derived from the rates, the time constant of each
+ * site, the probability of hopping to each neighbor and the tables used to
+ * pick the neighbor, is also computed once when the graph is created. The
+ * graph is never changed afterwards so a single copy can be shared by the
+ * sites of any number of systems, including systems used on different
+ * threads. The sites themselves only hold the state of a single run. The
+ * exception is a graph created by createSingleRow, which holds the rates of
+ * a site that is not part of a system and is changed by that site alone.
+ **/
+class Rate_Graph {
+  public:
+    Rate_Graph();
+
+    /// The arrays may point into the graph itself
+    Rate_Graph(const Rate_Graph &) = delete;
+    Rate_Graph & operator=(const Rate_Graph &) = delete;
+
+    /**
+     * \brief Build the graph from a map of maps
+     *
+     * The first int is the id of the site the rate originates from, the
+     * second int is the id of the neighboring site. Rows are assigned in
+     * ascending order of the site ids, including any drain sites.
+     **/
+    explicit Rate_Graph(
+        const std::unordered_map<int, std::unordered_map<int, double>> & rates);
+
+    /**
+     * \brief Build the graph from compressed sparse row arrays
+     *
+     * \param[in] site_ids the id of the site stored in each row
+     * \param[in] row_offsets must contain site_ids.size()+1 monotonically
+     * increasing values, starting at 0 and ending at neighbor_ids.size()
+     * \param[in] neighbor_ids the ids of the neighboring sites
+     * \param[in] rates the rate to each of the neighboring sites
+     **/
+    Rate_Graph(
+        std::vector<int> site_ids,
+        std::vector<size_t> row_offsets,
+        std::vector<int> neighbor_ids,
+        std::vector<double> rates);
+
+    /**
+     * \brief Use compressed sparse row arrays held elsewhere without copying
+     *
+     * Meant for arrays memory mapped from a file. storage is kept alive for
+     * as long as the graph and must keep the arrays valid and unchanged. The
+     * arrays are used in place if the neighbor ids of each row are already
+     * in ascending order and every neighbor has a row of its own, otherwise
+     * they are copied and treated as by the constructor above. The arrays
+     * are checked in the same way either way.
+     *
+     * \param[in] site_count number of rows, row_offsets holds site_count+1
+     * values
+     **/
+    Rate_Graph(
+        std::shared_ptr<const void> storage,
+        const int * site_ids,
+        const size_t * row_offsets,
+        const int * neighbor_ids,
+        const double * rates,
+        const size_t site_count);
+
+    /**
+     * \brief Graph holding the rates of a single site
+     *
+     * The neighbors are not given rows of their own so the graph only has
+     * the one row. Unlike other graphs its rates can be changed afterwards
+     * with setRates.
+     *
+     * \param[in] site_id id of the row
+     * \param[in] rates initial rates, e.g. those of another graph
+     **/
+    static std::shared_ptr<Rate_Graph> createSingleRow(
+        const int site_id,
+        const Rate_View rates);
+
+    /// True if the graph was created by createSingleRow
+    bool isSingleRow() const { return single_row_; }
+
+    /**
+     * \brief Add or change rates of a graph created by createSingleRow
+     *
+     * Rates to the other neighbors are kept. Only the tables of the one row
+     * are updated, which takes time proportional to the number of neighbors.
+     *
+     * \param[in] neigh_rates the id of each neighbor and the rate to it
+     **/
+    void setRates(std::vector<std::pair<int,double>> neigh_rates);
+
+    /// Number of rows (sites) stored in the graph including drains
+    size_t size() const { return site_count_; }
+
+    /// Total number of directed rates stored in the graph
+    size_t getNumberOfRates() const { return rate_count_; }
+
+    /// False if the arrays were copied into the graph
+    bool usesArraysInPlace() const { return storage_ != nullptr; }
+
+    bool exist(const int siteId) const;
+
+    /// Convert a site id into its dense row index
+    int getIndex(const int siteId) const;
+
+    /// Convert a dense row index into a site id
+    int getSiteId(const int index) const;
+
+    Rate_View getRates(const int index) const {
+      return Rate_View{
+        neighbor_ids_ + row_offsets_[index],
+        rates_ + row_offsets_[index],
+        row_offsets_[index+1] - row_offsets_[index]};
+    }
+
+    /// Time constant of the row, 1/(sum of the rates), 0 for drains
+    double getTimeConstant(const int index) const {
+      return time_constants_[index];
+    }
+
+    /// Probability of hopping to each neighbor, in the same order as the rates
+    const double * getProbabilities(const int index) const {
+      return probabilities_.data() + row_offsets_[index];
+    }
+
+    /**
+     * \brief Pick a neighbor in proportion to the rates
+     *
+     * \param[in] index the row
+     * \param[in] number a random number in the range (0,1]
+     *
+     * \return the position of the neighbor within the row
+     **/
+    size_t sampleNeighbor(const int index, const double number) const {
+      return samplers_[index].sample(number);
+    }
+
+    /**
+     * \brief Get the rate between the site in row index and a neighbor
+     *
+     * Will throw an error if the neighbor does not exist
+     **/
+    double getRate(const int index, const int neighId) const;
+
+    /// Returns the position of the neighbor within the row or -1
+    int findNeighbor(const int index, const int neighId) const;
+
+    /// Write the rows and rates, the derived tables are not stored
+    void saveState(Binary_Writer & writer) const;
+
+    /// Create a graph from the rows written by saveState
+    static std::shared_ptr<Rate_Graph> loadState(Binary_Reader & reader);
+
+    /// Hash of the site ids, rows and rates, equal graphs give equal hashes
+    uint64_t getHash() const;
+
+  private:
+    /// Point either into the owned arrays or into memory kept alive by
+    /// storage_
+    const int * site_ids_;
+    const size_t * row_offsets_;
+    const int * neighbor_ids_;
+    const double * rates_;
+    size_t site_count_;
+    size_t rate_count_;
+
+    std::vector<int> owned_site_ids_;
+    std::vector<size_t> owned_row_offsets_;
+    std::vector<int> owned_neighbor_ids_;
+    std::vector<double> owned_rates_;
+    std::shared_ptr<const void> storage_;
+    /// Created by createSingleRow, no drain rows
+    bool single_row_;
+
+    /// True as long as the site ids are first_id_, first_id_+1, ...
+    bool dense_ids_;
+    int first_id_;
+    /// Only used if the site ids are not consecutive
+    std::unordered_map<int,int> index_of_site_;
+
+    /// Derived from the rates, see buildHopTables_
+    std::vector<double> time_constants_;
+    std::vector<double> probabilities_;
+    std::vector<Discrete_Sampler> samplers_;
+
+    /// Returns -1 if the site is not stored in the graph
+    int findIndex_(const int siteId) const {
+      if(dense_ids_){
+        long index = static_cast<long>(siteId) - first_id_;
+        if(index<0 || index>=static_cast<long>(site_count_)) return -1;
+        return static_cast<int>(index);
+      }
+      auto it = index_of_site_.find(siteId);
+      if(it==index_of_site_.end()) return -1;
+      return it->second;
+    }
+
+    /// Point the arrays at the owned vectors
+    void useOwnedArrays_();
+    void checkRowOffsets_() const;
+    /// True if every row is in ascending order and all neighbors have rows
+    bool canUseInPlace_() const;
+    void finishOwnedArrays_();
+
+    void addDrainRows_();
+    void sortRows_();
+    void buildIndex_();
+    void buildHopTables_();
+};
+
+}
+
+#endif // MYTHICAL_RATE_GRAPH_HPP
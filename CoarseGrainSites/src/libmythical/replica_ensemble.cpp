@@ -0,0 +1,119 @@
+#include <stdexcept>
+#include <string>
+
+#include "mythical/replica_ensemble.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+ReplicaEnsemble::ReplicaEnsemble(
+    const size_t replica_count,
+    const size_t thread_count){
+
+  if(replica_count==0){
+    throw invalid_argument("The replica ensemble must contain at least a "
+        "single replica.");
+  }
+  for(size_t replica = 0; replica < replica_count; ++replica){
+    replicas_.push_back(unique_ptr<CoarseGrainSystem>(new CoarseGrainSystem));
+  }
+  thread_pool_ = unique_ptr<Thread_Pool>(new Thread_Pool(thread_count));
+}
+
+ReplicaEnsemble::~ReplicaEnsemble(){
+}
+
+size_t ReplicaEnsemble::getNumberOfThreads() const {
+  return thread_pool_->size();
+}
+
+void ReplicaEnsemble::initializeSystems(
+    const unordered_map<int, unordered_map<int, double>> & ratesOfAllSites,
+    const ConfigureFunction & configure){
+
+  configure(0,*replicas_.front());
+  replicas_.front()->initializeSystem(ratesOfAllSites);
+  initializeRemainingSystems_(configure);
+}
+
+void ReplicaEnsemble::initializeSystems(
+    vector<size_t> row_offsets,
+    vector<int> neighbor_ids,
+    vector<double> rates,
+    const ConfigureFunction & configure){
+
+  configure(0,*replicas_.front());
+  replicas_.front()->initializeSystem(
+      move(row_offsets),
+      move(neighbor_ids),
+      move(rates));
+  initializeRemainingSystems_(configure);
+}
+
+CoarseGrainSystem & ReplicaEnsemble::getReplica(const size_t replica){
+  if(replica>=replicas_.size()){
+    throw out_of_range("Cannot get replica " + to_string(replica) + " the "
+        "ensemble only contains " + to_string(replicas_.size()) + " replicas.");
+  }
+  return *replicas_[replica];
+}
+
+void ReplicaEnsemble::forEachReplica(const ConfigureFunction & function){
+  thread_pool_->parallelFor(replicas_.size(),[&](size_t replica){
+      function(replica,*replicas_[replica]);
+      });
+}
+
+vector<vector<double>> ReplicaEnsemble::run(
+    const size_t sample_count,
+    const SampleFunction & sample){
+
+  vector<vector<double>> totals;
+  totals.reserve(sample_count);
+  vector<vector<double>> observables(replicas_.size());
+  for(size_t sample_index = 0; sample_index < sample_count; ++sample_index){
+    thread_pool_->parallelFor(replicas_.size(),[&](size_t replica){
+        observables[replica].clear();
+        sample(replica,sample_index,*replicas_[replica],observables[replica]);
+        });
+
+    // Reduce in a fixed order so the sums do not depend on the threads
+    vector<double> total = observables.front();
+    for(size_t replica = 1; replica < replicas_.size(); ++replica){
+      if(observables[replica].size()!=total.size()){
+        throw runtime_error("Replica " + to_string(replica) + " stored " +
+            to_string(observables[replica].size()) + " observables during "
+            "sample " + to_string(sample_index) + " but replica 0 stored " +
+            to_string(total.size()) + ".");
+      }
+      for(size_t index = 0; index < total.size(); ++index){
+        total[index] += observables[replica][index];
+      }
+    }
+    totals.push_back(move(total));
+  }
+  return totals;
+}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+void ReplicaEnsemble::initializeRemainingSystems_(
+    const ConfigureFunction & configure){
+
+  const CoarseGrainSystem & first = *replicas_.front();
+  thread_pool_->parallelFor(replicas_.size()-1,[&](size_t index){
+      const size_t replica = index+1;
+      configure(replica,*replicas_[replica]);
+      replicas_[replica]->initializeSystem(first);
+      });
+}
+
+}
@@ -6,30 +6,66 @@ using namespace std;
 namespace mythical {
 
   void Site_Container::addSite(Site& site){
-    if(sites_.count(site.getId())){
+    int siteId = site.getId();
+    if(findIndex_(siteId)!=-1){
       throw invalid_argument("Cannot add site it has already been added.");
     }
-    sites_[site.getId()] = site;
+    if(sites_.size()==0){
+      first_id_ = siteId;
+    }else if(dense_ids_ && 
+        static_cast<long>(siteId)-first_id_ != static_cast<long>(sites_.size())){
+      // Ids are no longer consecutive switch to the hash map
+      dense_ids_ = false;
+      index_of_site_.reserve(sites_.size()+1);
+      for(size_t index = 0; index < sites_.size(); ++index){
+        index_of_site_[sites_[index].getId()] = static_cast<int>(index);
+      }
+    }
+    if(!dense_ids_){
+      index_of_site_[siteId] = static_cast<int>(sites_.size());
+    }
+    sites_.push_back(site);
   }
 
   void Site_Container::addSites(vector<Site>& sites){
+    sites_.reserve(sites_.size()+sites.size());
     for ( Site & site : sites ){
       addSite(site);
     }
   }
 
+  void Site_Container::addSites(shared_ptr<Rate_Graph> rate_graph){
+    sites_.reserve(sites_.size()+rate_graph->size());
+    for ( size_t index = 0; index < rate_graph->size(); ++index ){
+      Site site;
+      site.setId(rate_graph->getSiteId(static_cast<int>(index)));
+      site.setRatesToNeighbors(rate_graph,static_cast<int>(index));
+      addSite(site);
+    }
+  }
+
   Site& Site_Container::getSite(const int & siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
+      throw invalid_argument("Site is not stored in the container.");
+    }
+    return sites_[index];
+  }
+
+  int Site_Container::getIndex(const int & siteId) const {
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Site is not stored in the container.");
     }
-    return sites_[siteId];
+    return index;
   }
 
   unordered_map<int,Site> Site_Container::getSites(vector<int> siteIds){
     unordered_map<int,Site> sites;
     for( auto siteId : siteIds ){
-      if(sites_.count(siteId)){
-        sites[siteId] = sites_[siteId];
+      int index = findIndex_(siteId);
+      if(index!=-1){
+        sites[siteId] = sites_[index];
       }else{
         throw invalid_argument("Site is not found in the container.");
       }
@@ -38,35 +74,43 @@ namespace mythical {
   }
 
   unordered_map<int,Site> Site_Container::getSites(){
-    return sites_;
+    unordered_map<int,Site> sites;
+    sites.reserve(sites_.size());
+    for( const Site & site : sites_ ){
+      sites[site.getId()] = site;
+    }
+    return sites;
   } 
 
   void Site_Container::setClusterId(int siteId, int clusterId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Site is not stored in the container.");
     }
-    sites_[siteId].setClusterId(clusterId);
+    sites_[index].setClusterId(clusterId);
   }
 
   int Site_Container::getClusterIdOfSite(int siteId) {
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Site is not stored in the container.");
     }
-    return sites_[siteId].getClusterId();
+    return sites_[index].getClusterId();
   }
 
   bool Site_Container::partOfCluster(int siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Site is not stored in the container.");
     }
-    return sites_[siteId].partOfCluster();
+    return sites_[index].partOfCluster();
   }
 
   int Site_Container::getSmallestClusterId(vector<int> siteIds){
     LOG("Getting the favored cluster Id", 1);
     int favoredClusterId = constants::unassignedId;
     for (auto siteId : siteIds) {
-      int clusterId = sites_[siteId].getClusterId();
+      int clusterId = getSite(siteId).getClusterId();
       if (favoredClusterId == constants::unassignedId) {
         favoredClusterId = clusterId;
       } else if (clusterId != constants::unassignedId &&
@@ -78,31 +122,34 @@ namespace mythical {
   }
 
   bool Site_Container::exist(const int & siteId) const{
-    return sites_.count(siteId)!=0;
+    return findIndex_(siteId)!=-1;
   }
   
   bool Site_Container::isOccupied(const int & siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot determine if site is occupied as it is not"
           " stored in the container");
     }
-    return sites_[siteId].isOccupied();
+    return sites_[index].isOccupied();
   }
 
   void Site_Container::vacate(const int & siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot vacate as site is not stored in the "
           "container.");
     }
-    sites_[siteId].vacate();
+    sites_[index].vacate();
   }
 
   void Site_Container::occupy(const int & siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot occupy site as it is not stored in the "
           "container.");
     }
-    sites_[siteId].occupy();
+    sites_[index].occupy();
   }
 /*
   Rate_Map Site_Container::getInternalRates(vector<int> siteIds){
@@ -115,8 +162,9 @@ namespace mythical {
 */
   vector<int> Site_Container::getSiteIds(){
     vector<int> siteIds;
-    for(auto site : sites_ ){
-      siteIds.push_back(site.first);
+    siteIds.reserve(sites_.size());
+    for(const Site & site : sites_ ){
+      siteIds.push_back(site.getId());
     }
     return siteIds;
   }
@@ -142,51 +190,64 @@ namespace mythical {
   }
 */
   double Site_Container::getDwellTime(int siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot get site dwell time as site is not in the "
           "container.");
     }
-    return sites_[siteId].getDwellTime(constants::unassignedId);
+    return sites_[index].getDwellTime(constants::unassignedId);
   }
 
   double Site_Container::getTimeConstant(int siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot get site time constant as site is not in "
           "the container.");
     }
-    return sites_[siteId].getTimeConstant();
+    return sites_[index].getTimeConstant();
   }
 
   Rate_Map Site_Container::getRates(){
     Rate_Map rate_map;
-    for( auto site : sites_ ){
-      auto rates = site.second.getNeighborsAndRates();
-      rate_map[site.first] = rates;
+    for( Site & site : sites_ ){
+      rate_map[site.getId()] = site.getNeighborsAndRates();
     }
     return rate_map;
   }
 
+  Rate_View Site_Container::getRateView(const int & siteId) const {
+    int index = findIndex_(siteId);
+    if(index==-1){
+      throw invalid_argument("Cannot get rates of site as it is not stored in "
+          "the container.");
+    }
+    return sites_[index].getRateView();
+  }
+
   double Site_Container::getFastestRateOffSite(int siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot get fastest rate off site as it is not "
           "stored in the container.");
     }
-    return sites_[siteId].getFastestRate();
+    return sites_[index].getFastestRate();
   }
 
   double Site_Container::getRateToNeighborOfSite(int siteId, int neighId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot get rate from site to neighbor as site is "
           "not stored in the container");
     }
-    return sites_[siteId].getRateToNeighbor(neighId);    
+    return sites_[index].getRateToNeighbor(neighId);    
   }
 
   vector<int> Site_Container::getSiteIdsOfNeighbors(int siteId){
-    if(sites_.count(siteId)==0){
+    int index = findIndex_(siteId);
+    if(index==-1){
       throw invalid_argument("Cannot get neighbor site ids from site as site is "
           "not stored in the container");
     }
-    return sites_[siteId].getNeighborSiteIds();
+    return sites_[index].getNeighborSiteIds();
   }
 }
@@ -2,9 +2,11 @@
 #define MYTHICAL_SITE_CONTAINER_HPP
 
 #include <unordered_map>
+#include <vector>
 
 #include "log.hpp"
 #include "rate_container.hpp"
+#include "rate_graph.hpp"
 #include "topologyfeatures/site.hpp"
 
 namespace mythical {
@@ -12,15 +14,34 @@ namespace mythical {
 /**
  * \brief Class is designed to store kmc sites
  *
+ * The sites are stored contiguously and each is assigned a dense index in the
+ * order it was added. The public interface still works with the user defined
+ * site ids, these are remapped to the dense index. If the ids are consecutive
+ * e.g. 1,2,3,4... the remapping is a simple subtraction, otherwise a hash map
+ * is used.
  **/
 class Site_Container {
   public:
-    Site_Container() {};
+    Site_Container() : dense_ids_(true), first_id_(0) {};
 
     void addSite(Site& site);
     void addSites(std::vector<Site>& sites);
+
+    /**
+     * \brief Create a site for every row of the rate graph
+     *
+     * The sites read their rates directly from the graph, which is shared
+     * between all of them.
+     **/
+    void addSites(std::shared_ptr<Rate_Graph> rate_graph);
     Site& getSite(const int & siteId);
 
+    /// Convert a site id into its dense index, throws if it does not exist
+    int getIndex(const int & siteId) const;
+
+    /// Access a site by its dense index without any remapping
+    Site& getSiteByIndex(const size_t index) { return sites_[index]; }
+
     std::unordered_map<int,Site> getSites(std::vector<int> siteIds);
     std::unordered_map<int,Site> getSites();
     size_t size() const {return sites_.size();}
@@ -42,11 +63,37 @@ class Site_Container {
 
     Rate_Map getRates();
 
+    /**
+     * \brief Outgoing rates of a single site without copying them
+     *
+     * The view is only valid as long as the rates of the site are not reset.
+     * Throws if the site is not stored in the container.
+     **/
+    Rate_View getRateView(const int & siteId) const;
+
     double getFastestRateOffSite(int siteId);
     double getRateToNeighborOfSite(int siteId, int neighId);
     std::vector<int> getSiteIdsOfNeighbors(int siteId);
   private:
-    std::unordered_map<int,Site> sites_;
+    std::vector<Site> sites_;
+
+    /// True as long as the site ids are first_id_, first_id_+1, ...
+    bool dense_ids_;
+    int first_id_;
+    /// Only used if the site ids are not consecutive
+    std::unordered_map<int,int> index_of_site_;
+
+    /// Returns -1 if the site is not stored in the container
+    int findIndex_(const int siteId) const {
+      if(dense_ids_){
+        long index = static_cast<long>(siteId) - first_id_;
+        if(index<0 || index>=static_cast<long>(sites_.size())) return -1;
+        return static_cast<int>(index);
+      }
+      auto it = index_of_site_.find(siteId);
+      if(it==index_of_site_.end()) return -1;
+      return it->second;
+    }
 
 };
 
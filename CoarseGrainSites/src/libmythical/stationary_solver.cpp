@@ -0,0 +1,584 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "stationary_solver.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+  const size_t Stationary_Solver::dense_threshold;
+
+  /****************************************************************************
+   * Constants
+   ****************************************************************************/
+
+  /// Size of the Krylov subspace before GMRES restarts
+  static const size_t krylov_size = 100;
+  static const size_t max_restarts = 200;
+  /// Residual relative to |b| + |A||x| at which GMRES has converged
+  static const double gmres_tolerance = 1E-12;
+  /// Pivots smaller than this relative to the largest entry are treated as 0
+  static const double singular_tolerance = 1E-13;
+  /// Inverse iteration stops once no probability changes by more than this
+  /// relative to the largest one
+  static const double inverse_iteration_tolerance = 1E-12;
+  static const size_t max_inverse_iterations = 200;
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  bool Stationary_Solver::solve(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & rates,
+      const vector<double> & initial_guess){
+
+    const size_t count = checkArguments_(row_offsets,columns,rates);
+
+    rate_off_.assign(count,0.0);
+    for(size_t state = 0; state < count; ++state){
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        if(static_cast<size_t>(columns[ind])!=state) rate_off_[state] += rates[ind];
+      }
+    }
+
+    if(count==1){
+      solution_.assign(1,1.0);
+      return true;
+    }
+    if(count < dense_threshold_){
+      return solveDense_(row_offsets,columns,rates);
+    }
+    return solveGMRES_(row_offsets,columns,rates,initial_guess);
+  }
+
+  bool Stationary_Solver::solveQuasiStationary(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & probabilities,
+      const vector<double> & initial_guess){
+
+    const size_t count = checkArguments_(row_offsets,columns,probabilities);
+
+    // Without any loss I - P^T is singular, solve should be used instead
+    double largest_loss = 0.0;
+    for(size_t state = 0; state < count; ++state){
+      double stay = 1.0;
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        stay -= probabilities[ind];
+      }
+      largest_loss = max(largest_loss,stay);
+    }
+    if(!(largest_loss > singular_tolerance)) return false;
+
+    assembleJumpMatrix_(row_offsets,columns,probabilities);
+    const bool dense = count < dense_threshold_;
+    if(dense){
+      matrix_.assign(count*count,0.0);
+      for(size_t row = 0; row < count; ++row){
+        for(size_t ind = sparse_offsets_[row]; ind < sparse_offsets_[row+1]; ++ind){
+          matrix_[row*count+static_cast<size_t>(sparse_columns_[ind])] = sparse_values_[ind];
+        }
+      }
+      if(!factorDense_(count)) return false;
+    }else{
+      if(!factorize_()) return false;
+    }
+
+    bool valid_guess = initial_guess.size()==count;
+    for(size_t state = 0; state < count && valid_guess; ++state){
+      valid_guess = initial_guess[state] >= 0.0;
+    }
+    if(valid_guess){
+      solution_ = initial_guess;
+      valid_guess = normalize_();
+    }
+    if(!valid_guess) solution_.assign(count,1.0/static_cast<double>(count));
+
+    // Inverse iteration, each solve of (I - P^T) x = p multiplies the
+    // component along the wanted eigenvector by 1/(1-lambda) which is the
+    // largest factor, the sum of x estimates it
+    double growth = 1.0;
+    for(size_t iteration = 0; iteration < max_inverse_iterations; ++iteration){
+      previous_ = solution_;
+      if(dense){
+        solveFactored_(count,solution_.data());
+      }else{
+        for(double & value : solution_) value *= growth;
+        if(!gmres_(previous_,solution_)) return false;
+      }
+      growth = 0.0;
+      for(const double & value : solution_) growth += value;
+      if(!normalize_()) return false;
+
+      double change = 0.0;
+      double largest = 0.0;
+      for(size_t state = 0; state < count; ++state){
+        change = max(change,fabs(solution_[state]-previous_[state]));
+        largest = max(largest,solution_[state]);
+      }
+      if(change <= inverse_iteration_tolerance*largest) return true;
+    }
+    return false;
+  }
+
+  /****************************************************************************
+   * Private Internal Functions
+   ****************************************************************************/
+
+  size_t Stationary_Solver::checkArguments_(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & values) const {
+
+    if(row_offsets.size()<2){
+      throw invalid_argument("Cannot solve for the stationary distribution, "
+          "there are no states.");
+    }
+    const size_t count = row_offsets.size()-1;
+    if(row_offsets.back()!=columns.size() || columns.size()!=values.size()){
+      throw invalid_argument("Cannot solve for the stationary distribution, "
+          "the sizes of the rate arrays do not match the row offsets.");
+    }
+    for(const int & column : columns){
+      if(column < 0 || static_cast<size_t>(column) >= count){
+        throw out_of_range("Cannot solve for the stationary distribution, "
+            "a rate leads to a state that does not exist.");
+      }
+    }
+    return count;
+  }
+
+  bool Stationary_Solver::solveDense_(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & rates){
+
+    const size_t count = row_offsets.size()-1;
+    const size_t last = count-1;
+    matrix_.assign(count*count,0.0);
+    // Row i of the transposed generator collects the rates coming into i
+    for(size_t state = 0; state < count; ++state){
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        size_t target = static_cast<size_t>(columns[ind]);
+        if(target!=state && target!=last) matrix_[target*count+state] += rates[ind];
+      }
+      if(state!=last) matrix_[state*count+state] -= rate_off_[state];
+    }
+    fill(matrix_.begin()+last*count,matrix_.end(),1.0);
+
+    if(!factorDense_(count)) return false;
+    solution_.assign(count,0.0);
+    solution_[last] = 1.0;
+    solveFactored_(count,solution_.data());
+    return normalize_();
+  }
+
+  bool Stationary_Solver::factorDense_(const size_t count){
+    double largest = 0.0;
+    for(const double & value : matrix_) largest = max(largest,fabs(value));
+
+    // LU decomposition with partial pivoting, the multipliers are stored
+    // below the diagonal
+    pivots_.resize(count);
+    for(size_t col = 0; col < count; ++col){
+      size_t pivot = col;
+      for(size_t row = col+1; row < count; ++row){
+        if(fabs(matrix_[row*count+col]) > fabs(matrix_[pivot*count+col])) pivot = row;
+      }
+      if(fabs(matrix_[pivot*count+col]) <= singular_tolerance*largest) return false;
+      pivots_[col] = pivot;
+      if(pivot!=col){
+        swap_ranges(
+            matrix_.begin()+col*count,
+            matrix_.begin()+(col+1)*count,
+            matrix_.begin()+pivot*count);
+      }
+      const double inverse_pivot = 1.0/matrix_[col*count+col];
+      for(size_t row = col+1; row < count; ++row){
+        double factor = matrix_[row*count+col]*inverse_pivot;
+        matrix_[row*count+col] = factor;
+        if(factor==0.0) continue;
+        for(size_t ind = col+1; ind < count; ++ind){
+          matrix_[row*count+ind] -= factor*matrix_[col*count+ind];
+        }
+      }
+    }
+    return true;
+  }
+
+  void Stationary_Solver::solveFactored_(const size_t count, double * x) const {
+    // The rows were swapped along with their multipliers so all the swaps
+    // are applied before L
+    for(size_t col = 0; col < count; ++col){
+      if(pivots_[col]!=col) swap(x[col],x[pivots_[col]]);
+    }
+    for(size_t col = 0; col < count; ++col){
+      for(size_t row = col+1; row < count; ++row){
+        x[row] -= matrix_[row*count+col]*x[col];
+      }
+    }
+
+    // Back substitution
+    for(size_t row = count; row-- > 0;){
+      double value = x[row];
+      for(size_t ind = row+1; ind < count; ++ind){
+        value -= matrix_[row*count+ind]*x[ind];
+      }
+      x[row] = value/matrix_[row*count+row];
+    }
+  }
+
+  bool Stationary_Solver::solveGMRES_(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & rates,
+      const vector<double> & initial_guess){
+
+    const size_t count = row_offsets.size()-1;
+    // The last state is fixed to 1 so there is one unknown less
+    const size_t unknowns = count-1;
+
+    assembleSparse_(row_offsets,columns,rates);
+    if(!factorize_()) return false;
+
+    // The right hand side
+    previous_.assign(residual_.begin(),residual_.end());
+
+    solution_.assign(unknowns,0.0);
+    if(initial_guess.size()==count && initial_guess.back() > 0.0){
+      for(size_t state = 0; state < unknowns; ++state){
+        solution_[state] = initial_guess[state]/initial_guess.back();
+      }
+    }
+    if(!gmres_(previous_,solution_)) return false;
+
+    solution_.push_back(1.0);
+    return normalize_();
+  }
+
+  bool Stationary_Solver::gmres_(
+      const vector<double> & rhs_vector,
+      vector<double> & solution){
+
+    const size_t unknowns = sparse_offsets_.size()-1;
+    const size_t basis_size = min(krylov_size,unknowns);
+
+    double rhs_norm = 0.0;
+    for(const double & value : rhs_vector) rhs_norm += value*value;
+    rhs_norm = sqrt(rhs_norm);
+    // For solve nothing flows into the last state so it cannot be fixed to 1
+    if(rhs_norm==0.0) return false;
+
+    // Infinity norm of the matrix. Measuring the residual against |A||x| as
+    // well as |b| keeps the tolerance above round off when the solution is
+    // much larger than the right hand side, as in inverse iteration
+    double matrix_norm = 0.0;
+    for(size_t row = 0; row < unknowns; ++row){
+      double row_sum = 0.0;
+      for(size_t ind = sparse_offsets_[row]; ind < sparse_offsets_[row+1]; ++ind){
+        row_sum += fabs(sparse_values_[ind]);
+      }
+      matrix_norm = max(matrix_norm,row_sum);
+    }
+
+    matrix_.resize((basis_size+1)*unknowns);
+    hessenberg_.resize((basis_size+1)*basis_size);
+    work_.resize(unknowns);
+    residual_.resize(unknowns);
+    cosines_.resize(basis_size);
+    sines_.resize(basis_size);
+    rhs_.resize(basis_size+1);
+
+    for(size_t restart = 0; restart < max_restarts; ++restart){
+      multiply_(solution.data(),residual_.data());
+      double beta = 0.0;
+      for(size_t state = 0; state < unknowns; ++state){
+        residual_[state] = rhs_vector[state] - residual_[state];
+        beta += residual_[state]*residual_[state];
+      }
+      beta = sqrt(beta);
+      double solution_norm = 0.0;
+      for(const double & value : solution) solution_norm += value*value;
+      const double tolerance = gmres_tolerance*(rhs_norm+matrix_norm*sqrt(solution_norm));
+      if(beta < tolerance) return true;
+
+      for(size_t state = 0; state < unknowns; ++state) matrix_[state] = residual_[state]/beta;
+      fill(rhs_.begin(),rhs_.end(),0.0);
+      rhs_[0] = beta;
+
+      size_t steps = 0;
+      for(size_t k = 0; k < basis_size; ++k){
+        const double * basis_k = matrix_.data()+k*unknowns;
+        double * basis_next = matrix_.data()+(k+1)*unknowns;
+        copy(basis_k,basis_k+unknowns,work_.begin());
+        precondition_(work_.data());
+        multiply_(work_.data(),basis_next);
+
+        // Modified Gram-Schmidt
+        for(size_t i = 0; i <= k; ++i){
+          const double * basis_i = matrix_.data()+i*unknowns;
+          double dot = 0.0;
+          for(size_t state = 0; state < unknowns; ++state) dot += basis_next[state]*basis_i[state];
+          hessenberg_[i*basis_size+k] = dot;
+          for(size_t state = 0; state < unknowns; ++state) basis_next[state] -= dot*basis_i[state];
+        }
+        double norm = 0.0;
+        for(size_t state = 0; state < unknowns; ++state) norm += basis_next[state]*basis_next[state];
+        norm = sqrt(norm);
+        hessenberg_[(k+1)*basis_size+k] = norm;
+        if(norm > 0.0){
+          for(size_t state = 0; state < unknowns; ++state) basis_next[state] /= norm;
+        }
+
+        // Apply the previous Givens rotations to the new column
+        for(size_t i = 0; i < k; ++i){
+          double upper = hessenberg_[i*basis_size+k];
+          double lower = hessenberg_[(i+1)*basis_size+k];
+          hessenberg_[i*basis_size+k] = cosines_[i]*upper + sines_[i]*lower;
+          hessenberg_[(i+1)*basis_size+k] = -sines_[i]*upper + cosines_[i]*lower;
+        }
+        double upper = hessenberg_[k*basis_size+k];
+        double lower = hessenberg_[(k+1)*basis_size+k];
+        double radius = sqrt(upper*upper+lower*lower);
+        if(radius==0.0)return false;
+        cosines_[k] = upper/radius;
+        sines_[k] = lower/radius;
+        hessenberg_[k*basis_size+k] = radius;
+        hessenberg_[(k+1)*basis_size+k] = 0.0;
+        rhs_[k+1] = -sines_[k]*rhs_[k];
+        rhs_[k] = cosines_[k]*rhs_[k];
+
+        steps = k+1;
+        if(fabs(rhs_[k+1]) < tolerance || norm==0.0) break;
+      }
+
+      // Solve the upper triangular system, the result is stored in rhs_
+      for(size_t row = steps; row-- > 0;){
+        double value = rhs_[row];
+        for(size_t ind = row+1; ind < steps; ++ind){
+          value -= hessenberg_[row*basis_size+ind]*rhs_[ind];
+        }
+        rhs_[row] = value/hessenberg_[row*basis_size+row];
+      }
+      fill(work_.begin(),work_.end(),0.0);
+      for(size_t i = 0; i < steps; ++i){
+        const double * basis_i = matrix_.data()+i*unknowns;
+        for(size_t state = 0; state < unknowns; ++state) work_[state] += rhs_[i]*basis_i[state];
+      }
+      precondition_(work_.data());
+      for(size_t state = 0; state < unknowns; ++state) solution[state] += work_[state];
+    }
+    return false;
+  }
+
+
+  void Stationary_Solver::assembleSparse_(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & rates){
+
+    const size_t count = row_offsets.size()-1;
+    const size_t last = count-1;
+
+    // Row i of the transposed generator holds the rates coming into i
+    sparse_offsets_.assign(count,0);
+    for(size_t state = 0; state < last; ++state){
+      // The diagonal
+      ++sparse_offsets_[state+1];
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        size_t target = static_cast<size_t>(columns[ind]);
+        if(target!=state && target!=last) ++sparse_offsets_[target+1];
+      }
+    }
+    for(size_t state = 0; state < last; ++state){
+      sparse_offsets_[state+1] += sparse_offsets_[state];
+    }
+
+    sparse_columns_.resize(sparse_offsets_[last]);
+    sparse_values_.resize(sparse_offsets_[last]);
+    marker_.assign(sparse_offsets_.begin(),sparse_offsets_.end()-1);
+    residual_.assign(last,0.0);
+    for(size_t state = 0; state < count; ++state){
+      if(state!=last){
+        sparse_columns_[marker_[state]] = static_cast<int>(state);
+        sparse_values_[marker_[state]] = -rate_off_[state];
+        ++marker_[state];
+      }
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        size_t target = static_cast<size_t>(columns[ind]);
+        if(target==state || target==last) continue;
+        if(state==last){
+          // The probability of the last state is fixed to 1
+          residual_[target] -= rates[ind];
+        }else{
+          sparse_columns_[marker_[target]] = static_cast<int>(state);
+          sparse_values_[marker_[target]] = rates[ind];
+          ++marker_[target];
+        }
+      }
+    }
+
+    // Sort each row by column and merge duplicates
+    sortSparseRows_();
+  }
+
+  void Stationary_Solver::assembleJumpMatrix_(
+      const vector<size_t> & row_offsets,
+      const vector<int> & columns,
+      const vector<double> & probabilities){
+
+    const size_t count = row_offsets.size()-1;
+
+    // Row k of I - P^T holds the probabilities of hopping into k
+    sparse_offsets_.assign(count+1,0);
+    for(size_t state = 0; state < count; ++state){
+      // The diagonal
+      ++sparse_offsets_[state+1];
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        size_t target = static_cast<size_t>(columns[ind]);
+        if(target!=state) ++sparse_offsets_[target+1];
+      }
+    }
+    for(size_t state = 0; state < count; ++state){
+      sparse_offsets_[state+1] += sparse_offsets_[state];
+    }
+
+    sparse_columns_.resize(sparse_offsets_[count]);
+    sparse_values_.resize(sparse_offsets_[count]);
+    marker_.assign(sparse_offsets_.begin(),sparse_offsets_.end()-1);
+    for(size_t state = 0; state < count; ++state){
+      size_t diagonal = static_cast<size_t>(marker_[state]);
+      sparse_columns_[diagonal] = static_cast<int>(state);
+      sparse_values_[diagonal] = 1.0;
+      ++marker_[state];
+    }
+    for(size_t state = 0; state < count; ++state){
+      for(size_t ind = row_offsets[state]; ind < row_offsets[state+1]; ++ind){
+        size_t target = static_cast<size_t>(columns[ind]);
+        if(target==state){
+          sparse_values_[sparse_offsets_[state]] -= probabilities[ind];
+        }else{
+          sparse_columns_[marker_[target]] = static_cast<int>(state);
+          sparse_values_[marker_[target]] = -probabilities[ind];
+          ++marker_[target];
+        }
+      }
+    }
+    sortSparseRows_();
+  }
+
+  void Stationary_Solver::sortSparseRows_(){
+    const size_t rows = sparse_offsets_.size()-1;
+    size_t position = 0;
+    size_t row_start = 0;
+    for(size_t row = 0; row < rows; ++row){
+      row_entries_.clear();
+      for(size_t ind = row_start; ind < sparse_offsets_[row+1]; ++ind){
+        row_entries_.emplace_back(sparse_columns_[ind],sparse_values_[ind]);
+      }
+      row_start = sparse_offsets_[row+1];
+      sort(row_entries_.begin(),row_entries_.end(),
+          [](const pair<int,double> & x, const pair<int,double> & y){
+            return x.first < y.first;
+          });
+      sparse_offsets_[row] = position;
+      for(size_t ind = 0; ind < row_entries_.size(); ++ind){
+        if(ind>0 && row_entries_[ind].first==row_entries_[ind-1].first){
+          sparse_values_[position-1] += row_entries_[ind].second;
+        }else{
+          sparse_columns_[position] = row_entries_[ind].first;
+          sparse_values_[position] = row_entries_[ind].second;
+          ++position;
+        }
+      }
+    }
+    sparse_offsets_[rows] = position;
+    sparse_columns_.resize(position);
+    sparse_values_.resize(position);
+  }
+
+  bool Stationary_Solver::factorize_(){
+    const size_t unknowns = sparse_offsets_.size()-1;
+    factors_ = sparse_values_;
+    diagonal_index_.resize(unknowns);
+    for(size_t row = 0; row < unknowns; ++row){
+      for(size_t ind = sparse_offsets_[row]; ind < sparse_offsets_[row+1]; ++ind){
+        if(static_cast<size_t>(sparse_columns_[ind])==row) diagonal_index_[row] = ind;
+      }
+    }
+
+    marker_.assign(unknowns,-1);
+    for(size_t row = 0; row < unknowns; ++row){
+      for(size_t ind = sparse_offsets_[row]; ind < sparse_offsets_[row+1]; ++ind){
+        marker_[sparse_columns_[ind]] = static_cast<long>(ind);
+      }
+      for(size_t ind = sparse_offsets_[row]; ind < diagonal_index_[row]; ++ind){
+        size_t col = static_cast<size_t>(sparse_columns_[ind]);
+        double pivot = factors_[diagonal_index_[col]];
+        if(pivot==0.0) return false;
+        factors_[ind] /= pivot;
+        for(size_t ind2 = diagonal_index_[col]+1; ind2 < sparse_offsets_[col+1]; ++ind2){
+          long target = marker_[sparse_columns_[ind2]];
+          if(target!=-1) factors_[target] -= factors_[ind]*factors_[ind2];
+        }
+      }
+      if(factors_[diagonal_index_[row]]==0.0) return false;
+      for(size_t ind = sparse_offsets_[row]; ind < sparse_offsets_[row+1]; ++ind){
+        marker_[sparse_columns_[ind]] = -1;
+      }
+    }
+    return true;
+  }
+
+  void Stationary_Solver::multiply_(const double * x, double * y) const {
+    const size_t unknowns = sparse_offsets_.size()-1;
+    for(size_t row = 0; row < unknowns; ++row){
+      double value = 0.0;
+      for(size_t ind = sparse_offsets_[row]; ind < sparse_offsets_[row+1]; ++ind){
+        value += sparse_values_[ind]*x[sparse_columns_[ind]];
+      }
+      y[row] = value;
+    }
+  }
+
+  void Stationary_Solver::precondition_(double * x) const {
+    const size_t unknowns = sparse_offsets_.size()-1;
+    // L has a unit diagonal
+    for(size_t row = 0; row < unknowns; ++row){
+      for(size_t ind = sparse_offsets_[row]; ind < diagonal_index_[row]; ++ind){
+        x[row] -= factors_[ind]*x[sparse_columns_[ind]];
+      }
+    }
+    for(size_t row = unknowns; row-- > 0;){
+      for(size_t ind = diagonal_index_[row]+1; ind < sparse_offsets_[row+1]; ++ind){
+        x[row] -= factors_[ind]*x[sparse_columns_[ind]];
+      }
+      x[row] /= factors_[diagonal_index_[row]];
+    }
+  }
+
+  bool Stationary_Solver::normalize_(){
+    double total = 0.0;
+    double largest = 0.0;
+    for(const double & value : solution_){
+      if(!isfinite(value)) return false;
+      total += value;
+      largest = max(largest,fabs(value));
+    }
+    for(double & value : solution_){
+      if(value < 0.0){
+        // Anything more than round off means there is no valid distribution
+        if(value < -1E-9*largest) return false;
+        total -= value;
+        value = 0.0;
+      }
+    }
+    if(!(total > 0.0)) return false;
+    for(double & value : solution_) value /= total;
+    return true;
+  }
+}
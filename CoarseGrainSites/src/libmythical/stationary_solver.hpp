@@ -0,0 +1,180 @@
+#ifndef MYTHICAL_STATIONARY_SOLVER_HPP
+#define MYTHICAL_STATIONARY_SOLVER_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mythical {
+
+/**
+ * \brief Solves for the stationary distribution of a continuous time Markov
+ * chain
+ *
+ * The chain is described by the rates between its states stored in
+ * compressed sparse row form, row i holds the rates leaving state i. The
+ * stationary distribution pi satisfies pi Q = 0 where Q is the generator
+ * matrix, Q_ij is the rate from i to j and Q_ii the negative sum of the rates
+ * leaving i. One of the equations is replaced by the normalization sum(pi) = 1
+ * so that the system has a unique solution.
+ *
+ * Chains with fewer than dense_threshold states are solved with a dense LU
+ * decomposition with partial pivoting, O(N^3). Larger chains are solved with
+ * restarted GMRES on the sparse matrix, preconditioned with an incomplete LU
+ * factorization without fill in, ILU(0). For GMRES the probability of the
+ * last state is fixed instead of adding the normalization, which keeps the
+ * matrix sparse, and the solution is normalized afterwards.
+ *
+ * solveQuasiStationary handles jump chains that lose probability on every
+ * hop, where there is no stationary distribution to solve for.
+ *
+ * The buffers are kept between calls.
+ **/
+class Stationary_Solver {
+  public:
+    /// Chains with at least this many states are solved with GMRES
+    static const size_t dense_threshold = 200;
+
+    Stationary_Solver() : dense_threshold_(dense_threshold) {};
+
+    void setDenseThreshold(const size_t threshold) { dense_threshold_ = threshold; }
+
+    /**
+     * \brief Solve for the stationary distribution
+     *
+     * \param[in] row_offsets one more value than there are states
+     * \param[in] columns the state each rate goes to
+     * \param[in] rates
+     * \param[in] initial_guess optional, only used by GMRES
+     *
+     * \return false if the chain does not have a unique stationary
+     * distribution or the solver did not converge, the solution is then not
+     * valid
+     **/
+    bool solve(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & rates,
+        const std::vector<double> & initial_guess = std::vector<double>());
+
+    /**
+     * \brief Solve for the quasi-stationary distribution of a leaky jump
+     * chain
+     *
+     * Row i holds the probabilities of hopping from state i to each state,
+     * the rows may sum to less than 1 in which case the rest is lost. The
+     * solution is the distribution p that keeps its shape after a hop,
+     * P^T p = lambda p with the largest lambda. It is found by inverse
+     * iteration on I - P^T, which is factored once with the same dense LU or
+     * ILU(0) preconditioned GMRES as solve. The closer lambda is to 1
+     * compared to the other eigenvalues the fewer iterations are needed.
+     *
+     * \param[in] row_offsets one more value than there are states
+     * \param[in] columns the state each hop goes to
+     * \param[in] probabilities
+     * \param[in] initial_guess optional, the first iterate
+     *
+     * \return false if no probability is lost, use solve then, or if the
+     * iteration did not converge, the solution is then not valid
+     **/
+    bool solveQuasiStationary(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & probabilities,
+        const std::vector<double> & initial_guess = std::vector<double>());
+
+    /// Probability of being in each state, sums to 1
+    const std::vector<double> & getSolution() const { return solution_; }
+
+  private:
+    size_t dense_threshold_;
+
+    std::vector<double> solution_;
+
+    /// Sum of the rates leaving each state
+    std::vector<double> rate_off_;
+    /// Dense matrix and its LU factors, or the GMRES Krylov basis
+    std::vector<double> matrix_;
+    /// Row swapped with each row during the dense LU decomposition
+    std::vector<size_t> pivots_;
+    /// Right hand side of GMRES, or the last iterate of inverse iteration
+    std::vector<double> previous_;
+
+    /// Sparse transposed generator without the last state, or I - P^T, CSR
+    /// with sorted columns
+    std::vector<size_t> sparse_offsets_;
+    std::vector<int> sparse_columns_;
+    std::vector<double> sparse_values_;
+    /// ILU(0) factors, same sparsity as above
+    std::vector<double> factors_;
+    std::vector<size_t> diagonal_index_;
+    std::vector<long> marker_;
+    /// Used to sort the entries of a row
+    std::vector<std::pair<int,double>> row_entries_;
+
+    std::vector<double> hessenberg_;
+    std::vector<double> residual_;
+    std::vector<double> work_;
+    std::vector<double> cosines_;
+    std::vector<double> sines_;
+    std::vector<double> rhs_;
+
+    /// Returns the number of states, throws if the arrays do not match
+    size_t checkArguments_(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & values) const;
+
+    bool solveDense_(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & rates);
+
+    /// LU decomposition of matrix_ in place, returns false if it is singular
+    bool factorDense_(const size_t count);
+
+    /// Solves L U x = x in place with the factors from factorDense_
+    void solveFactored_(const size_t count, double * x) const;
+
+    bool solveGMRES_(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & rates,
+        const std::vector<double> & initial_guess);
+
+    /// Solves A x = rhs with the sparse matrix, x holds the initial guess
+    bool gmres_(
+        const std::vector<double> & rhs_vector,
+        std::vector<double> & solution);
+
+    /// Builds the sparse matrix and the right hand side, stored in residual_
+    void assembleSparse_(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & rates);
+
+    /// Builds I - P^T from the hop probabilities
+    void assembleJumpMatrix_(
+        const std::vector<size_t> & row_offsets,
+        const std::vector<int> & columns,
+        const std::vector<double> & probabilities);
+
+    /// Sorts each row of the sparse matrix by column and merges duplicates
+    void sortSparseRows_();
+
+    /// Returns false if a zero pivot is found
+    bool factorize_();
+
+    /// y = A x with the sparse matrix
+    void multiply_(const double * x, double * y) const;
+
+    /// Solves L U x = x in place with the ILU(0) factors
+    void precondition_(double * x) const;
+
+    /// Clamps round off below zero and normalizes the solution
+    bool normalize_();
+};
+
+}
+
+#endif // MYTHICAL_STATIONARY_SOLVER_HPP
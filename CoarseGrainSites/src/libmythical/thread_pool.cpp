@@ -0,0 +1,93 @@
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+/****************************************************************************
+ * Public Facing Functions
+ ****************************************************************************/
+
+Thread_Pool::Thread_Pool(const size_t thread_count) :
+  task_(nullptr),
+  count_(0),
+  next_(0),
+  finished_(0),
+  generation_(0),
+  stop_(false) {
+
+  size_t count = thread_count;
+  if(count==0) count = thread::hardware_concurrency();
+  // hardware_concurrency is allowed to return 0 if it is not known
+  if(count==0) count = 1;
+  threads_.reserve(count);
+  for(size_t index = 0; index < count; ++index){
+    threads_.emplace_back(&Thread_Pool::work_,this);
+  }
+}
+
+Thread_Pool::~Thread_Pool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for(thread & worker : threads_) worker.join();
+}
+
+void Thread_Pool::parallelFor(
+    const size_t count,
+    const function<void(size_t)> & task) {
+
+  if(count==0) return;
+  unique_lock<mutex> lock(mutex_);
+  task_ = &task;
+  count_ = count;
+  next_ = 0;
+  finished_ = 0;
+  error_ = nullptr;
+  ++generation_;
+  start_.notify_all();
+  done_.wait(lock,[this]{ return finished_==count_; });
+  task_ = nullptr;
+
+  if(error_){
+    exception_ptr error = error_;
+    error_ = nullptr;
+    rethrow_exception(error);
+  }
+}
+
+/****************************************************************************
+ * Private Internal Functions
+ ****************************************************************************/
+
+void Thread_Pool::work_() {
+  uint64_t generation = 0;
+  unique_lock<mutex> lock(mutex_);
+  while(true){
+    start_.wait(lock,[this,&generation]{
+        return stop_ || generation_!=generation;
+        });
+    if(stop_) return;
+    generation = generation_;
+
+    // A thread that wakes up late finds no indices left to take
+    while(next_<count_){
+      const size_t index = next_++;
+      lock.unlock();
+      exception_ptr error;
+      try {
+        (*task_)(index);
+      }catch(...){
+        error = current_exception();
+      }
+      lock.lock();
+      if(error && !error_) error_ = error;
+      ++finished_;
+      if(finished_==count_) done_.notify_one();
+    }
+  }
+}
+
+}
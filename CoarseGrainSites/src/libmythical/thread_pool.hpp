@@ -0,0 +1,67 @@
+#ifndef MYTHICAL_THREAD_POOL_HPP
+#define MYTHICAL_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mythical {
+
+/**
+ * \brief Fixed set of worker threads used to run loops in parallel
+ *
+ * The threads are created by the constructor and sleep between calls to
+ * parallelFor, they are joined by the destructor. Only one loop can be run
+ * at a time, parallelFor should not be called from within a task.
+ **/
+class Thread_Pool {
+  public:
+    /// A thread count of 0 starts one thread per hardware thread
+    explicit Thread_Pool(const size_t thread_count = 0);
+    ~Thread_Pool();
+
+    Thread_Pool(const Thread_Pool &) = delete;
+    Thread_Pool & operator=(const Thread_Pool &) = delete;
+
+    size_t size() const { return threads_.size(); }
+
+    /**
+     * \brief Call task with every index from 0 to count-1
+     *
+     * The indices are handed out to the threads one at a time, the function
+     * returns once every task has finished. If a task throws the remaining
+     * tasks are still run and the first exception is rethrown.
+     **/
+    void parallelFor(const size_t count, const std::function<void(size_t)> & task);
+
+  private:
+    void work_();
+
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    /// Signals the threads that a loop has started or that they should stop
+    std::condition_variable start_;
+    /// Signals parallelFor that the last task has finished
+    std::condition_variable done_;
+
+    const std::function<void(size_t)> * task_;
+    size_t count_;
+    /// Next index to hand out
+    size_t next_;
+    /// Number of tasks that have finished
+    size_t finished_;
+    /// Incremented each time a loop is started
+    uint64_t generation_;
+    bool stop_;
+    std::exception_ptr error_;
+};
+
+}
+
+#endif // MYTHICAL_THREAD_POOL_HPP
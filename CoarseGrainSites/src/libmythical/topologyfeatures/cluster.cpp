@@ -1,12 +1,14 @@
-
 #include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <cassert>
 
 #include "cluster.hpp"
 #include "site.hpp"
+#include "libmythical/binary_file.hpp"
 #include "libmythical/log.hpp"
 
 using namespace std;
@@ -17,30 +19,29 @@ namespace mythical {
  * Constants
  ****************************************************************************/
 
-/// Cluster Id counter is used to ensure that each new cluster has a unique id
-static int clusterIdCounter = 0;
+/// Above this fraction of added sites the cluster is updated from scratch
+static const double incremental_update_fraction = 0.25;
 
 /****************************************************************************
  * Public Facing Functions
  ****************************************************************************/
 void occupyCluster_(TopologyFeature* feature, const int& siteId){
   Cluster * cluster = static_cast<Cluster *>(feature);
-  
-  Site & site = cluster->sitesInCluster_[siteId];
-  assert(cluster->site_visits_.count(siteId));
-  ++cluster->total_visit_freq_; 
-  site.setToOccupiedStatus(); 
+
+  int index = cluster->getLocalIndex_(siteId);
+  assert(static_cast<size_t>(index) < cluster->site_visits_.size());
+  ++cluster->total_visit_freq_;
+  cluster->sites_[index]->setToOccupiedStatus();
 }
 
 bool isOccupiedCluster_(TopologyFeature* feature,const int& siteId){
   auto cluster = static_cast<Cluster *>(feature);
-  assert(cluster->sitesInCluster_.count(siteId));
-  return cluster->sitesInCluster_[siteId].isOccupied();
+  return cluster->sites_[cluster->getLocalIndex_(siteId)]->isOccupied();
 }
 
 void vacateCluster_(TopologyFeature* feature,const int& siteId){
   auto cluster = static_cast<Cluster *>(feature);
-  cluster->sitesInCluster_[siteId].vacate();
+  cluster->sites_[cluster->getLocalIndex_(siteId)]->vacate();
   cluster->vacate();
 }
 
@@ -49,15 +50,17 @@ void removeWalkerCluster_(TopologyFeature * feature,const int & walker_id){
   cluster->remaining_walker_dwell_times_.erase(walker_id);
 }
 
-Cluster::Cluster() : TopologyFeature() {
-  setId(clusterIdCounter);
-  clusterIdCounter++;
+Cluster::Cluster() : Cluster(0) {}
+
+Cluster::Cluster(const int id) : TopologyFeature() {
+  setId(id);
   iterations_ = 3;
   resolution_ = 20.0;
   total_visit_freq_ = 0;
   prev_total_visit_freq_ = 0;
   convergenceTolerance_ = 0.01;
   convergence_method_ = converge_by_iterations_per_site;
+  exit_directly_ = false;
 
   occupy_siteId_ptr_ = occupyCluster_;
   vacate_siteId_ptr_ = vacateCluster_;
@@ -66,64 +69,64 @@ Cluster::Cluster() : TopologyFeature() {
 }
 
 void Cluster::addSite(Site& newSite) {
-  assert(sitesInCluster_.count(newSite.getId())==0 && "Site has already been "
+  assert(local_index_.count(newSite.getId())==0 && "Site has already been "
       "added to the cluster");
   newSite.setClusterId(this->getId());
-  sitesInCluster_[newSite.getId()] = newSite;
-
+  local_index_[newSite.getId()] = static_cast<int>(sites_.size());
+  sites_.push_back(&newSite);
 }
 
 void Cluster::addSites(vector<Site>& newSites) {
-    for (Site & site : newSites) {
-    assert(sitesInCluster_.count(site.getId())==0 && "Site has already been "
-        "added to the cluster");
-    site.setClusterId(this->getId());
-    sitesInCluster_[site.getId()] = site;
-  }
+  for (Site & site : newSites) addSite(site);
+}
+
+void Cluster::mergeSites(const vector<Site *> & newSites) {
+  const size_t old_site_count = sites_.size();
+  for (Site * site : newSites) addSite(*site);
+  updateIncrementally_(old_site_count,vector<double>());
 }
 
 void Cluster::updateProbabilitiesAndTimeConstant() {
 
-  unordered_map<int,int> temporary_visit_frequencies = getVisitFrequencies_();
+  registerVisits_();
 
+  calculateEdges_(vector<bool>(sites_.size(),true));
   solveMasterEquation_();
-  calculateSumOfEscapeRatesFromSitesToTheirNeighbors_();
-  calculateSumOfEscapeRatesFromSitesToInternalSites_();
   calculateProbabilityHopOffInternalSite_();
   calculateProbabilityHopBetweenInternalSite_();
   calculateEscapeTimeConstant_();
   calculateInternalTimeConstant_();
 
-  site_visits_.clear();
-  for( auto site : sitesInCluster_ ){
-    site_visits_[site.first] = 0.0;
-    if(temporary_visit_frequencies.count(site.first)){
-      setVisitFrequency(temporary_visit_frequencies[site.first],site.first);
-    }
-  }
+  // Sites that have been added start without any visits
+  site_visits_.resize(sites_.size(),0.0);
   calculateInternalDwellTimes_();
 
 }
 
-unordered_map<int,int> Cluster::getVisitFrequencies_(){
-  unordered_map<int,int> frequencies;
+void Cluster::registerVisits_(){
+  if(total_visit_freq_==prev_total_visit_freq_) return;
 
-  for(auto site :site_visits_){
-    frequencies[site.first] = getVisitFrequency(site.first);    
+  double difference = total_visit_freq_ - prev_total_visit_freq_;
+  for(size_t index = 0; index < site_visits_.size(); ++index){
+    double visits = static_cast<double>(difference)*probabilityOnSite_[index]*sites_[index]->getTimeConstant();
+    visits = visits/internal_dwell_time_[index];
+    visits = escape_time_constant_*visits;
+    visits = visits/resolution_;
+    site_visits_[index] += round(visits);
   }
-  return frequencies;
+  prev_total_visit_freq_ = total_visit_freq_;
 }
 
 vector<Site> Cluster::getSitesInCluster() const {
   vector<Site> sites;
-  for (auto site : sitesInCluster_) sites.push_back(site.second);
+  for (const Site * site : sites_) sites.push_back(*site);
   return sites;
 }
 
 vector<int> Cluster::getSiteIdsInCluster() const {
   vector<int> siteIds;
-  for (auto site : sitesInCluster_) {
-    siteIds.push_back(site.first);
+  for (const Site * site : sites_) {
+    siteIds.push_back(site->getId());
   }
   return siteIds;
 }
@@ -135,47 +138,53 @@ vector<int> Cluster::getSiteIdsNeighboringCluster() const {
 }
 
 double Cluster::getProbabilityOfOccupyingInternalSite(const int siteId) {
-  assert(sitesInCluster_.count(siteId) && "the provided site is not in the cluster");
-  return probabilityOnSite_[siteId];
+  return probabilityOnSite_[getLocalIndex_(siteId)];
 }
 
 void Cluster::migrateSitesFrom(Cluster& cluster) {
 
-  unordered_map<int,int> visits;
-  for (auto& site : cluster.sitesInCluster_) {
-    site.second.setClusterId(getId());
-    visits[site.first] = cluster.getVisitFrequency(site.first);
+  const size_t old_site_count = sites_.size();
+  vector<int> visits;
+  for (Site * site : cluster.sites_) {
+    visits.push_back(cluster.getVisitFrequency(site->getId()));
+    addSite(*site);
+  }
+  vector<double> new_site_probabilities;
+  if (cluster.probabilityOnSite_.size()==cluster.sites_.size()) {
+    swap(new_site_probabilities,cluster.probabilityOnSite_);
   }
 
-  move(cluster.sitesInCluster_.begin(),
-      cluster.sitesInCluster_.end(),
-      inserter(this->sitesInCluster_,this->sitesInCluster_.end()));
-
-  // Change the cluster so that it will not be used unless sites are added 
-  cluster.sitesInCluster_.clear();
+  // Change the cluster so that it will not be used unless sites are added
+  cluster.sites_.clear();
+  cluster.local_index_.clear();
   cluster.probabilityOnSite_.clear();
   cluster.sumOfEscapeRateFromSiteToNeighbor_.clear();
+  cluster.sumOfEscapeRateFromSiteToInternalSite_.clear();
+  cluster.internal_offsets_.clear();
+  cluster.internal_columns_.clear();
+  cluster.internal_rates_.clear();
+  cluster.boundary_edges_.clear();
   cluster.site_visits_.clear();
   cluster.internal_dwell_time_.clear();
   cluster.probabilityHopToNeighbor_.clear();
-  cluster.cumulitive_probabilityHopToNeighbor_.clear();
+  cluster.neighbor_sampler_.clear();
   cluster.escape_time_constant_ = constants::unassigned_value;
   cluster.internal_time_constant_ = constants::unassigned_value;
 
-  updateProbabilitiesAndTimeConstant();
+  updateIncrementally_(old_site_count,new_site_probabilities);
   // Do not need to update the cluster because the sites have been removed
-  
+
   // Add the visits back in
-  for( auto site : visits){
-    setVisitFrequency(site.second,site.first);
+  for (size_t index = 0; index < visits.size(); ++index) {
+    setVisitFrequency(visits[index],sites_[old_site_count+index]->getId());
   }
 }
 
-int Cluster::pickNewSiteId(const int & walker_id) {
+int Cluster::pickNewSiteId(const int & walker_id, Random_Stream & stream) {
   if (hopWithinCluster_(walker_id)) {
-    return pickInternalSite_();
+    return pickInternalSite_(stream);
   }
-  return pickClusterNeighbor_(walker_id);
+  return pickClusterNeighbor_(walker_id,stream);
 }
 
 double Cluster::getProbabilityOfHoppingToNeighborOfCluster(
@@ -202,11 +211,17 @@ void Cluster::setConvergenceIterations(long iterations) {
   iterations_ = iterations;
 }
 
-double Cluster::getDwellTime(const int & walker_id) {
+double Cluster::getDwellTime(const int & walker_id, Random_Stream & stream) {
   assert(escape_time_constant_!=constants::unassigned_value && "Cannot get "
       "dwell time of the cluster as the escape_time_constant is not defined.");
   if(remaining_walker_dwell_times_.count(walker_id)==0){
-    remaining_walker_dwell_times_[walker_id]=TopologyFeature::getDwellTime(walker_id);
+    remaining_walker_dwell_times_[walker_id]=TopologyFeature::getDwellTime(walker_id,stream);
+  }
+  if(exit_directly_){
+    // Whatever is left is used up at once so the next hop leaves the cluster
+    auto dwell_time = remaining_walker_dwell_times_[walker_id];
+    remaining_walker_dwell_times_[walker_id] = 0.0;
+    return dwell_time;
   }
   auto dwell_time = remaining_walker_dwell_times_[walker_id];
   remaining_walker_dwell_times_[walker_id]-=time_increment_;
@@ -220,40 +235,33 @@ double Cluster::getDwellTime(const int & walker_id) {
   return dwell_time;
 }
 
+
 void Cluster::setVisitFrequency(int frequency,const int & siteId){
-  assert(site_visits_.count(siteId) && "Be sure to call occupy site to register"
-      " a visit");
+  int index = getLocalIndex_(siteId);
+  assert(static_cast<size_t>(index) < site_visits_.size() && "Be sure to "
+      "call occupy site to register a visit");
   assert(escape_time_constant_!=constants::unassigned_value && "Cannot set the "
       "visit frequency as the escape_time_constant is not defined. Be sure "
       "that you have called the update function and that there exist at least "
       "one rate off the cluster.");
 
-  // Need to convert to the right storage format 
+  // Need to convert to the right storage format
   double visits = static_cast<double>(frequency);
-  site_visits_[siteId] = visits;
+  site_visits_[index] = visits;
 }
 
 int Cluster::getVisitFrequency(const int & siteId){
-  assert(site_visits_.count(siteId));
+  int index = getLocalIndex_(siteId);
+  assert(static_cast<size_t>(index) < site_visits_.size());
   assert(escape_time_constant_!=constants::unassigned_value && "Cannot get the "
       "visit frequency as the escape_time_constant is not defined. Be sure "
       "that you have called the update function and that there exist at least "
       "one rate off the cluster.");
 
-  if(total_visit_freq_!=prev_total_visit_freq_){
-    double difference = total_visit_freq_ - prev_total_visit_freq_; 
-    for(auto site_visit : site_visits_){
-      double visits = static_cast<double>(difference)*probabilityOnSite_[site_visit.first]*sitesInCluster_.at(site_visit.first).getTimeConstant();
-      visits = visits/internal_dwell_time_.at(site_visit.first);
-      visits = escape_time_constant_*visits;
-      visits = visits/resolution_;
-      site_visits_[site_visit.first] += round(visits);
-    }
-    prev_total_visit_freq_ = total_visit_freq_;
-  }
+  registerVisits_();
 
-  double visit_count = (site_visits_[siteId]); 
-  return static_cast<int>(round(visit_count)); 
+  double visit_count = site_visits_[index];
+  return static_cast<int>(round(visit_count));
 }
 
 std::ostream& operator<<(std::ostream& os,
@@ -261,24 +269,130 @@ std::ostream& operator<<(std::ostream& os,
 
   os << "Cluster Id: " << cluster.getId() << endl;
   os << "Cluster visitFreq: " << cluster.total_visit_freq_ << endl;
-  os << "Number of sites in Cluster: " << cluster.sitesInCluster_.size();
+  os << "Number of sites in Cluster: " << cluster.sites_.size();
   os << endl;
 
   os << "Sites in cluster: " << endl;
-  for (auto site : cluster.sitesInCluster_) {
-    os << (site.second) << endl;
+  for (const Site * site : cluster.sites_) {
+    os << (*site) << endl;
   }
   return os;
 }
 
-double Cluster::getFastestRateOffCluster(){
-  auto rates_to_neighbors = getRatesToNeighborsOfCluster_();
+void Cluster::saveState(Binary_Writer & writer) const {
+  TopologyFeature::saveState(writer);
+  saveSolution(writer);
+  writer.write(static_cast<int32_t>(prev_total_visit_freq_));
+  writer.writeArray(site_visits_);
+
+  // Sorted so the file does not depend on the order of the hash map
+  vector<pair<int,double>> remaining(
+      remaining_walker_dwell_times_.begin(),
+      remaining_walker_dwell_times_.end());
+  sort(remaining.begin(),remaining.end());
+  vector<int> walker_ids;
+  vector<double> dwell_times;
+  for (const pair<int,double> & walker_and_time : remaining) {
+    walker_ids.push_back(walker_and_time.first);
+    dwell_times.push_back(walker_and_time.second);
+  }
+  writer.writeArray(walker_ids);
+  writer.writeArray(dwell_times);
+}
+
+void Cluster::loadState(Binary_Reader & reader) {
+  TopologyFeature::loadState(reader);
+  loadSolution(reader);
+  prev_total_visit_freq_ = reader.read<int32_t>();
+  reader.readArray(site_visits_);
+  if (site_visits_.size()!=sites_.size()) {
+    throw runtime_error("The stored visits of cluster " + to_string(getId()) +
+        " do not match the sites of the cluster.");
+  }
+
+  vector<int> walker_ids;
+  vector<double> dwell_times;
+  reader.readArray(walker_ids);
+  reader.readArray(dwell_times);
+  if (walker_ids.size()!=dwell_times.size()) {
+    throw runtime_error("The stored state of cluster " + to_string(getId()) +
+        " has a different number of walkers and dwell times.");
+  }
+  remaining_walker_dwell_times_.clear();
+  for (size_t index = 0; index < walker_ids.size(); ++index) {
+    remaining_walker_dwell_times_[walker_ids[index]] = dwell_times[index];
+  }
+}
+
+void Cluster::saveSolution(Binary_Writer & writer) const {
+  writer.write(resolution_);
+  writer.write(static_cast<int64_t>(iterations_));
+  writer.write(convergenceTolerance_);
+  writer.write(static_cast<int32_t>(convergence_method_));
+  writer.write(static_cast<uint8_t>(exit_directly_));
+  writer.writeArray(probabilityOnSite_);
+
+  // The edges are kept rather than recalculated, after an incremental
+  // update they are not in the order a full rescan would give
+  writer.writeArray(internal_offsets_);
+  writer.writeArray(internal_columns_);
+  writer.writeArray(internal_rates_);
+  writer.writeArray(boundary_edges_);
+}
+
+void Cluster::loadSolution(Binary_Reader & reader) {
+  resolution_ = reader.read<double>();
+  iterations_ = static_cast<long>(reader.read<int64_t>());
+  convergenceTolerance_ = reader.read<double>();
+  convergence_method_ = static_cast<Method>(reader.read<int32_t>());
+  exit_directly_ = reader.read<uint8_t>()!=0;
+  reader.readArray(probabilityOnSite_);
+  reader.readArray(internal_offsets_);
+  reader.readArray(internal_columns_);
+  reader.readArray(internal_rates_);
+  reader.readArray(boundary_edges_);
+
+  const size_t count = sites_.size();
+  if (count<2 || probabilityOnSite_.size()!=count ||
+      internal_offsets_.size()!=count+1 ||
+      internal_offsets_.back()!=internal_columns_.size() ||
+      internal_columns_.size()!=internal_rates_.size()) {
+    throw runtime_error("The stored state of cluster " + to_string(getId()) +
+        " does not match the sites of the cluster.");
+  }
+  for (const int & column : internal_columns_) {
+    if (column<0 || static_cast<size_t>(column)>=count) {
+      throw runtime_error("The stored state of cluster " +
+          to_string(getId()) + " has an edge to an unknown site.");
+    }
+  }
+  for (const Boundary_Edge & edge : boundary_edges_) {
+    if (edge.source<0 || static_cast<size_t>(edge.source)>=count) {
+      throw runtime_error("The stored state of cluster " +
+          to_string(getId()) + " has an edge off an unknown site.");
+    }
+  }
+
+  // Start without any visits, loadState restores them
+  prev_total_visit_freq_ = total_visit_freq_;
+  site_visits_.assign(count,0.0);
+
+  // Same order as when the probabilities were last updated
+  calculateEscapeRateSums_();
+  calculateProbabilityHopToInternalSite_();
+  calculateProbabilityHopToNeighbors_();
+  calculateInternalDwellTimes_();
+  calculateProbabilityHopOffInternalSite_();
+  calculateProbabilityHopBetweenInternalSite_();
+  calculateEscapeTimeConstant_();
+  calculateInternalTimeConstant_();
+}
+
+double Cluster::getFastestRateOffCluster() const {
   double fastest_rate = 0.0;
-  for( auto site_pr : rates_to_neighbors){
-    for( auto rate : site_pr.second ) {
-      if(rate.second>fastest_rate){
-        fastest_rate = rate.second;
-      }
+  for( const Boundary_Edge & edge : boundary_edges_ ){
+    if(edge.rate>fastest_rate){
+      fastest_rate = edge.rate;
     }
   }
   return fastest_rate;
@@ -288,92 +402,126 @@ double Cluster::getFastestRateOffCluster(){
  * Private Internal Functions
  ****************************************************************************/
 
-// The firsts int is the id of site within cluster
-// second int is the id of the neighbor of site outside of cluster
-unordered_map<int, unordered_map<int, double>>
-    Cluster::getRatesToNeighborsOfCluster_() {
-
-  unordered_map<int, unordered_map<int, double>> externalRates;
-
-  for (auto site : sitesInCluster_) {
-    for (auto neighId : site.second.getNeighborSiteIds()) {
-      if (!siteIsInCluster(neighId)) {
-        externalRates[site.first][neighId] =
-            site.second.getRateToNeighbor(neighId);
+void Cluster::calculateEdges_(const vector<bool> & rescan) {
+
+  const size_t count = sites_.size();
+  assert(rescan.size()==count);
+
+  vector<size_t> offsets(1,0);
+  offsets.reserve(count+1);
+  vector<int> columns;
+  columns.reserve(internal_columns_.size());
+  vector<double> rates;
+  rates.reserve(internal_rates_.size());
+  vector<Boundary_Edge> boundary_edges;
+  for (const Boundary_Edge & edge : boundary_edges_) {
+    if (!rescan[edge.source]) boundary_edges.push_back(edge);
+  }
+
+  for (size_t index = 0; index < count; ++index) {
+    if (!rescan[index]) {
+      assert(index+1 < internal_offsets_.size() && "Sites added since the "
+          "edges were last calculated must be rescanned.");
+      columns.insert(columns.end(),
+          internal_columns_.begin()+internal_offsets_[index],
+          internal_columns_.begin()+internal_offsets_[index+1]);
+      rates.insert(rates.end(),
+          internal_rates_.begin()+internal_offsets_[index],
+          internal_rates_.begin()+internal_offsets_[index+1]);
+    } else {
+      Rate_View site_rates = sites_[index]->getRateView();
+      for (size_t ind = 0; ind < site_rates.size(); ++ind) {
+        auto it = local_index_.find(site_rates.neighborId(ind));
+        if (it!=local_index_.end()) {
+          columns.push_back(it->second);
+          rates.push_back(site_rates.rate(ind));
+        } else {
+          Boundary_Edge edge;
+          edge.source = static_cast<int>(index);
+          edge.neighbor_id = site_rates.neighborId(ind);
+          edge.rate = site_rates.rate(ind);
+          boundary_edges.push_back(edge);
+        }
       }
     }
+    offsets.push_back(columns.size());
   }
-  return externalRates;
-}
 
-unordered_map<int, unordered_map<int,double>>
-Cluster::getRatesBetweenInternalSites_() {
+  swap(internal_offsets_,offsets);
+  swap(internal_columns_,columns);
+  swap(internal_rates_,rates);
+  swap(boundary_edges_,boundary_edges);
 
-  unordered_map<int, unordered_map<int,double>> internal_rates;
+  calculateEscapeRateSums_();
+}
 
-  for (auto site : sitesInCluster_ ){
-    for( auto neighId : site.second.getNeighborSiteIds()){
-      if(siteIsInCluster(neighId)){
-        internal_rates[site.first][neighId] = 
-          site.second.getRateToNeighbor(neighId);
-      }
+void Cluster::calculateEscapeRateSums_() {
+  const size_t count = sites_.size();
+  sumOfEscapeRateFromSiteToInternalSite_.assign(count,0.0);
+  for (size_t index = 0; index < count; ++index) {
+    for (size_t ind = internal_offsets_[index]; ind < internal_offsets_[index+1]; ++ind) {
+      sumOfEscapeRateFromSiteToInternalSite_[index] += internal_rates_[ind];
     }
   }
-  return internal_rates;
+  sumOfEscapeRateFromSiteToNeighbor_.assign(count,0.0);
+  for (const Boundary_Edge & edge : boundary_edges_) {
+    sumOfEscapeRateFromSiteToNeighbor_[edge.source] += edge.rate;
+  }
 }
 
 void Cluster::initializeProbabilityOnSites_() {
-  for (auto site : sitesInCluster_) {
-    probabilityOnSite_[site.first] =
-        1.0 / (static_cast<double>(sitesInCluster_.size()));
-  }
+  probabilityOnSite_.assign(sites_.size(),
+      1.0 / (static_cast<double>(sites_.size())));
   return;
 }
 
 void Cluster::iterate_() {
 
-  unordered_map<int, double> temp_probabilityOnSite;
+  const size_t count = sites_.size();
   // Initialize temporary probabilities
-  for(auto site : sitesInCluster_){
-    temp_probabilityOnSite[site.first] = probabilityOnSite_[site.first];
+  temp_probabilityOnSite_ = probabilityOnSite_;
+
+  // The probability of hopping from site i to k is the rate from i to k
+  // multiplied by the time constant of site i
+  for (size_t index = 0; index < count; ++index) {
+    double flux_off_site = probabilityOnSite_[index]*sites_[index]->getTimeConstant();
+    for (size_t ind = internal_offsets_[index]; ind < internal_offsets_[index+1]; ++ind) {
+      double flux = internal_rates_[ind]*flux_off_site;
+      temp_probabilityOnSite_[internal_columns_[ind]] += flux;
+      temp_probabilityOnSite_[index] -= flux;
+    }
   }
-  
+  for (const Boundary_Edge & edge : boundary_edges_) {
+    temp_probabilityOnSite_[edge.source] -= edge.rate*
+      probabilityOnSite_[edge.source]*sites_[edge.source]->getTimeConstant();
+  }
+
   double total = 0.0;
-  for (auto site : sitesInCluster_) {
-    for (auto neighsite : site.second.getNeighborSiteIds()) {
-      if (siteIsInCluster(neighsite)) {
-        temp_probabilityOnSite[site.first] +=
-          sitesInCluster_[neighsite].getProbabilityOfHoppingToNeighboringSite(site.first) *
-          probabilityOnSite_[neighsite];
-      }
-      temp_probabilityOnSite[site.first] -=
-        sitesInCluster_[site.first].getProbabilityOfHoppingToNeighboringSite(neighsite) *
-        probabilityOnSite_[site.first];
-    }
-    total += temp_probabilityOnSite[site.first];
+  for (const double & temp_prob : temp_probabilityOnSite_) {
+    total += temp_prob;
   }
 
   // Combine the former probability with the presently calculated probability
   double total2 = 0.0;
   double inverse_total = 1.0/total;
-  for (auto site : sitesInCluster_) {
-    probabilityOnSite_[site.first] =
-        (temp_probabilityOnSite[site.first]*inverse_total +
-         probabilityOnSite_[site.first]) * 0.5;;
+  for (size_t index = 0; index < count; ++index) {
+    probabilityOnSite_[index] =
+        (temp_probabilityOnSite_[index]*inverse_total +
+         probabilityOnSite_[index]) * 0.5;
 
-    total2 += probabilityOnSite_[site.first];
+    total2 += probabilityOnSite_[index];
   }
 
   // Normalize the probability
   double inverse_total2 = 1.0/total2;
-  for (auto site : sitesInCluster_) {
-    probabilityOnSite_[site.first] = probabilityOnSite_[site.first]*inverse_total2;
+  for (double & probability : probabilityOnSite_) {
+    probability = probability*inverse_total2;
   }
 }
 
-void Cluster::solveMasterEquation_() {
+void Cluster::solveMasterEquation_(const bool warm_start) {
 
-  initializeProbabilityOnSites_();
+  if (!warm_start) initializeProbabilityOnSites_();
 
   if (convergence_method_ == converge_by_iterations_per_cluster) {
     for (long i = 0; i < iterations_; i++) {
@@ -382,46 +530,143 @@ void Cluster::solveMasterEquation_() {
   } else if (convergence_method_ == converge_by_iterations_per_site) {
 
     long total_iterations =
-        iterations_ * static_cast<long>(sitesInCluster_.size());
+        iterations_ * static_cast<long>(sites_.size());
 
     for (long i = 0; i < total_iterations; i++) {
       iterate_();
     }
-  } else {
-    double error = convergenceTolerance_ * 1.1;
-
-    while (error > convergenceTolerance_) {
-      auto oldSiteProbs = probabilityOnSite_;
-      iterate_();
-      error = 0.0;
-      for (auto site : oldSiteProbs) {
-        auto diff = oldSiteProbs[site.first] - probabilityOnSite_[site.first];
-        error += pow(diff, 2.0);
-      }
-      error = pow(error, 1.0 / 2.0);
+  } else if (convergence_method_ == converge_by_direct_solve) {
+    if(!solveMasterEquationDirectly_(warm_start)){
+      LOG("Direct solve of the cluster failed, iterating instead", 1);
+      convergeByTolerance_();
     }
+  } else {
+    convergeByTolerance_();
   }
   calculateProbabilityHopToInternalSite_();
   calculateProbabilityHopToNeighbors_();
   calculateInternalDwellTimes_();
 }
 
+void Cluster::convergeByTolerance_() {
+  double error = convergenceTolerance_ * 1.1;
+
+  vector<double> oldSiteProbs;
+  while (error > convergenceTolerance_) {
+    oldSiteProbs = probabilityOnSite_;
+    iterate_();
+    error = 0.0;
+    for (size_t index = 0; index < oldSiteProbs.size(); ++index) {
+      auto diff = oldSiteProbs[index] - probabilityOnSite_[index];
+      error += pow(diff, 2.0);
+    }
+    error = pow(error, 1.0 / 2.0);
+  }
+}
+
+void Cluster::updateIncrementally_(
+    const size_t old_site_count,
+    const vector<double> & new_site_probabilities) {
+
+  const size_t total_sites = sites_.size();
+  const size_t new_site_count = total_sites - old_site_count;
+  if (new_site_count==0 && probabilityOnSite_.size()==total_sites) return;
+  if (old_site_count==0 || probabilityOnSite_.size()!=old_site_count ||
+      static_cast<double>(new_site_count) >
+      incremental_update_fraction*static_cast<double>(total_sites)) {
+    updateProbabilitiesAndTimeConstant();
+    return;
+  }
+
+  // Register the visits with the old probabilities before they change
+  registerVisits_();
 
-unordered_map<int, vector<pair<int, double>>>
-    Cluster::getInternalRatesFromNeighborsComingToSite_() {
+  // Start from the current probabilities, the new sites get the probability
+  // they had in their old cluster or else a uniform share
+  const double old_weight = static_cast<double>(old_site_count)/static_cast<double>(total_sites);
+  const double new_weight = 1.0 - old_weight;
+  for (double & probability : probabilityOnSite_) probability *= old_weight;
+  for (size_t index = 0; index < new_site_count; ++index) {
+    if (new_site_probabilities.size()==new_site_count) {
+      probabilityOnSite_.push_back(new_site_probabilities[index]*new_weight);
+    } else {
+      probabilityOnSite_.push_back(1.0/static_cast<double>(total_sites));
+    }
+  }
 
-  unordered_map<int, vector<pair<int, double>>> internalRates;
+  // Only the old sites on the boundary can have rates to the new sites
+  vector<bool> rescan(total_sites,false);
+  fill(rescan.begin()+old_site_count,rescan.end(),true);
+  for (const Boundary_Edge & edge : boundary_edges_) rescan[edge.source] = true;
+  calculateEdges_(rescan);
 
-  for (auto site : sitesInCluster_) {
-    for (auto neighId : site.second.getNeighborSiteIds()) {
-      if (siteIsInCluster(neighId)) {
-        auto rateToNeigh = site.second.getRateToNeighbor(neighId);
-        pair<int, double> rateToSite(site.first, rateToNeigh);
-        internalRates[neighId].push_back(rateToSite);
+  solveMasterEquation_(true);
+  calculateProbabilityHopOffInternalSite_();
+  calculateProbabilityHopBetweenInternalSite_();
+  calculateEscapeTimeConstant_();
+  calculateInternalTimeConstant_();
+
+  site_visits_.resize(total_sites,0.0);
+  calculateInternalDwellTimes_();
+}
+
+bool Cluster::solveMasterEquationDirectly_(const bool warm_start) {
+
+  const size_t count = sites_.size();
+
+  if (!boundary_edges_.empty()) {
+    // Probability leaves the cluster on every hop, iterate_ converges to the
+    // distribution that keeps its shape, P^T p = lambda p, where
+    // P(i->k) = rate*tau_i and tau_i includes the rates leaving the cluster
+    jump_probabilities_.resize(internal_rates_.size());
+    for (size_t index = 0; index < count; ++index) {
+      double time_constant = sites_[index]->getTimeConstant();
+      for (size_t ind = internal_offsets_[index]; ind < internal_offsets_[index+1]; ++ind) {
+        jump_probabilities_[ind] = internal_rates_[ind]*time_constant;
       }
     }
+    vector<double> initial_guess;
+    if (warm_start) initial_guess = probabilityOnSite_;
+
+    if(!stationary_solver_.solveQuasiStationary(
+          internal_offsets_,
+          internal_columns_,
+          jump_probabilities_,
+          initial_guess)) return false;
+    probabilityOnSite_ = stationary_solver_.getSolution();
+    return true;
+  }
+
+  // Nothing leaves the cluster so the probabilities follow from the
+  // stationary distribution of the rates within it. The solver works with
+  // the fraction of time spent on each site
+  vector<double> initial_guess;
+  if (warm_start) {
+    for (size_t index = 0; index < count; ++index) {
+      initial_guess.push_back(probabilityOnSite_[index]*sites_[index]->getTimeConstant());
+    }
   }
-  return internalRates;
+
+  if(!stationary_solver_.solve(
+        internal_offsets_,
+        internal_columns_,
+        internal_rates_,
+        initial_guess)) return false;
+
+  // The master equation works with the probability per hop,
+  // P(i->k) = rate*tau_i, so divide by the time constant of each site
+  const vector<double> & time_on_site = stationary_solver_.getSolution();
+  probabilityOnSite_.resize(count);
+  double total = 0.0;
+  for (size_t index = 0; index < count; ++index) {
+    double probability = time_on_site[index]/sites_[index]->getTimeConstant();
+    probabilityOnSite_[index] = probability;
+    total += probability;
+  }
+  for (double & probability : probabilityOnSite_) {
+    probability /= total;
+  }
+  return true;
 }
 
 bool Cluster::hopWithinCluster_(const int & walker_id) const {
@@ -431,138 +676,82 @@ bool Cluster::hopWithinCluster_(const int & walker_id) const {
   return remaining_walker_dwell_times_.at(walker_id)>0;
 }
 
-int Cluster::pickClusterNeighbor_(const int & walker_id) {
+int Cluster::pickClusterNeighbor_(const int & walker_id, Random_Stream & stream) {
   remaining_walker_dwell_times_.erase(walker_id);
 
-  double number = random_distribution_(random_engine_);
-  for (const pair<int,double> & pval : cumulitive_probabilityHopToNeighbor_) {
-    if (number < pval.second) return pval.first;
-  }
-  assert("Cummulitive probability distribution is flawed or random "
-      "number is greater than 1");
-  return -1;
+  double number = stream.uniform();
+  assert(neighbor_sampler_.size()!=0 && "The cluster has no neighbors, make "
+      "sure the probabilities have been updated.");
+  return probabilityHopToNeighbor_[neighbor_sampler_.sample(number)].first;
 }
 
-int Cluster::pickInternalSite_() {
+int Cluster::pickInternalSite_(Random_Stream & stream) {
 
-  double number = random_distribution_(random_engine_);
-  for (const pair<int,double> & pval : cumulitive_probabilityHopToInternalSite_) {
-    if (number < pval.second) {
-      return pval.first;
-    }
-  }
-  assert("cumulitive probability distribution of sites in the cluster "
-    "is flawed or random number is greater than 1");
-  return -1;
+  double number = stream.uniform();
+  assert(internal_site_sampler_.size()!=0 && "The cluster has no sites, make "
+      "sure the probabilities have been updated.");
+  return probabilityHopToInternalSite_[internal_site_sampler_.sample(number)].first;
 }
 
+
 void Cluster::calculateProbabilityHopOffInternalSite_() {
- 
-  probabilityHopOffInternalSite_.clear();
-  assert(sitesInCluster_.size()>1 && "Cannot create a cluster from a single site");
 
-  auto ratesToNeighbors = getRatesToNeighborsOfCluster_();
+  assert(sites_.size()>1 && "Cannot create a cluster from a single site");
+
   auto sum_rates_off = 0.0;
-  for(auto site_to_neigh : ratesToNeighbors){
-    for(auto rate : site_to_neigh.second ){
-      sum_rates_off+=rate.second;
-    }
+  for(const double & rate_off : sumOfEscapeRateFromSiteToNeighbor_){
+    sum_rates_off+=rate_off;
   }
   auto sum_time_constants = 0.0;
-  for(auto site_prob : probabilityOnSite_) {
-    sum_time_constants+=sitesInCluster_[site_prob.first].getTimeConstant();
+  for(const Site * site : sites_) {
+    sum_time_constants+=site->getTimeConstant();
   }
   double total2 = 0.0;
-  for(auto site_prob : probabilityOnSite_ ){
-    probabilityHopOffInternalSite_[site_prob.first] = site_prob.second*sumOfEscapeRateFromSiteToNeighbor_[site_prob.first]/sum_rates_off*sitesInCluster_[site_prob.first].getTimeConstant()/sum_time_constants;
-    total2+=probabilityHopOffInternalSite_[site_prob.first];
-
+  probabilityHopOffInternalSite_.assign(sites_.size(),0.0);
+  for(size_t index = 0; index < sites_.size(); ++index){
+    probabilityHopOffInternalSite_[index] = probabilityOnSite_[index]*sumOfEscapeRateFromSiteToNeighbor_[index]/sum_rates_off*sites_[index]->getTimeConstant()/sum_time_constants;
+    total2+=probabilityHopOffInternalSite_[index];
   }
 
-  for(auto hop_off : probabilityHopOffInternalSite_){
-    probabilityHopOffInternalSite_[hop_off.first] = hop_off.second/total2;
+  for(double & hop_off : probabilityHopOffInternalSite_){
+    hop_off = hop_off/total2;
   }
 }
 
 
 void Cluster::calculateProbabilityHopBetweenInternalSite_() {
- 
-  probabilityHopBetweenInternalSite_.clear();
-  assert(sitesInCluster_.size()>1 && "Cannot create a cluster from a single site");
 
-  auto ratesBetweenSites = getRatesBetweenInternalSites_();
+  assert(sites_.size()>1 && "Cannot create a cluster from a single site");
 
-  unordered_map<int,double> sum_sites_prob_to_hop;
   double sum_internal = 0.0;
+  probabilityHopBetweenInternalSite_.assign(sites_.size(),0.0);
 
   // rate_1 to 2 / sum( rate_1 to j) is the same as rate_1 to 2 * dwell_1
-  for(auto site_to_site : ratesBetweenSites){
-    int site_id = site_to_site.first;
-    double sum_internal_rates = 0.0;
-
-    for(auto internal_neigh : site_to_site.second){
-      sum_internal_rates+=internal_neigh.second;
-    }
-    sum_sites_prob_to_hop[site_id] = sum_internal_rates*sitesInCluster_[site_id].getTimeConstant();
-    probabilityHopBetweenInternalSite_[site_id] = sum_sites_prob_to_hop[site_id]*probabilityOnSite_[site_id];
-    sum_internal+=probabilityHopBetweenInternalSite_[site_id]; 
+  for(size_t index = 0; index < sites_.size(); ++index){
+    if(internal_offsets_[index]==internal_offsets_[index+1]) continue;
+    double sum_site_prob_to_hop = sumOfEscapeRateFromSiteToInternalSite_[index]*sites_[index]->getTimeConstant();
+    probabilityHopBetweenInternalSite_[index] = sum_site_prob_to_hop*probabilityOnSite_[index];
+    sum_internal+=probabilityHopBetweenInternalSite_[index];
   }
 
   // Normalize
-  for(auto site : probabilityHopBetweenInternalSite_){
-    probabilityHopOffInternalSite_[site.first]/=sum_internal;
+  for(size_t index = 0; index < sites_.size(); ++index){
+    if(internal_offsets_[index]==internal_offsets_[index+1]) continue;
+    probabilityHopOffInternalSite_[index]/=sum_internal;
   }
-  
-}
-
-// Calculates the sum of the rates off of each site that is in the cluster to
-// sites external to the cluster
-void Cluster::calculateSumOfEscapeRatesFromSitesToTheirNeighbors_() {
-
-  auto ratesToNeighbors = getRatesToNeighborsOfCluster_();
-
-  unordered_map<int, double> temp;
 
-  for (auto site : ratesToNeighbors) {
-    auto site_id_source = site.first;
-    for (auto neigh_terminate_rate : site.second) {
-      if (temp.count(site_id_source)==0) {
-        temp[site_id_source] = neigh_terminate_rate.second;
-      } else {
-        temp[site_id_source] += neigh_terminate_rate.second;
-      }
-    }
-  }
-  sumOfEscapeRateFromSiteToNeighbor_ = temp;
 }
 
-// Calculates the sum of the rates off of each site that is in the cluster to
-// sites internal to the cluster
-void Cluster::calculateSumOfEscapeRatesFromSitesToInternalSites_() {
-
-  auto ratesToInternalSites = getRatesBetweenInternalSites_();
-
-  unordered_map<int, double> temp;
-  for (auto site : ratesToInternalSites) {
-    auto site_id_source = site.first;
-    double sum_rates = 0.0;
-    for (auto site_terminate_rate : site.second) {
-      sum_rates+=site_terminate_rate.second;
-    }
-    temp[site_id_source] += sum_rates;
-  }
-  sumOfEscapeRateFromSiteToInternalSite_ = temp;
-}
 // Requires that calculateProbabilityHopOffInternalSites has first been called
 void Cluster::calculateEscapeTimeConstant_() {
   escape_time_constant_ = 0.0;
-  if(getRatesToNeighborsOfCluster_().size()==0){
+  if(boundary_edges_.empty()){
     escape_time_constant_ = constants::unassigned_value;
   }else{
-    for( auto site_prob : probabilityHopOffInternalSite_ ){
-      auto rate_off = sumOfEscapeRateFromSiteToNeighbor_[site_prob.first];
+    for(size_t index = 0; index < sites_.size(); ++index){
+      auto rate_off = sumOfEscapeRateFromSiteToNeighbor_[index];
       if(rate_off>0){
-        escape_time_constant_ += 1.0/rate_off *site_prob.second ;
+        escape_time_constant_ += 1.0/rate_off *probabilityHopOffInternalSite_[index];
       }
     }
   }
@@ -570,112 +759,94 @@ void Cluster::calculateEscapeTimeConstant_() {
 }
 void Cluster::calculateInternalTimeConstant_() {
   internal_time_constant_ = 0.0;
-  if(getRatesBetweenInternalSites_().size()==0){
+  if(internal_columns_.empty()){
     internal_time_constant_ = constants::unassigned_value;
   }else{
-    for( auto site_prob : probabilityHopBetweenInternalSite_  ){
-      auto rate_off = sumOfEscapeRateFromSiteToInternalSite_[site_prob.first];
+    for(size_t index = 0; index < sites_.size(); ++index){
+      auto rate_off = sumOfEscapeRateFromSiteToInternalSite_[index];
       if(rate_off>0){
-        internal_time_constant_ += 1.0/rate_off *site_prob.second;
+        internal_time_constant_ += 1.0/rate_off *probabilityHopBetweenInternalSite_[index];
       }
     }
   }
 }
 void Cluster::calculateProbabilityHopToInternalSite_() {
 
-  unordered_map<int, double> probabilityHopToInternalSite;
+  probabilityHopToInternalSite_.clear();
   double total = 0.0;
-  for(auto site_prob : probabilityOnSite_){
-    probabilityHopToInternalSite[site_prob.first] = site_prob.second * sitesInCluster_[site_prob.first].getTimeConstant();
-
-    total+=probabilityHopToInternalSite[site_prob.first];
+  for(size_t index = 0; index < sites_.size(); ++index){
+    double probability = probabilityOnSite_[index] * sites_[index]->getTimeConstant();
+    probabilityHopToInternalSite_.emplace_back(sites_[index]->getId(),probability);
+    total+=probability;
   }
 
   // Normalize
-  for(auto site_prob_per_time : probabilityHopToInternalSite){
-    probabilityHopToInternalSite[site_prob_per_time.first]/=total;
+  for(auto & site_prob_per_time : probabilityHopToInternalSite_){
+    site_prob_per_time.second/=total;
   }
 
-  probabilityHopToInternalSite_.clear();
-  copy(probabilityHopToInternalSite.begin(),
-      probabilityHopToInternalSite.end(),
-      back_inserter(probabilityHopToInternalSite_));
-
   sort(probabilityHopToInternalSite_.begin(),
       probabilityHopToInternalSite_.end(),
       [](const pair<int,double>& x,const pair<int,double>&y)->bool{
         return x.second>y.second;
       });
 
-  total = 0.0;
-  for(pair<int,double> site_and_prob : probabilityHopToInternalSite_){
-    site_and_prob.second+=total;
-    total = site_and_prob.second;
-    cumulitive_probabilityHopToInternalSite_.push_back(site_and_prob);
-  }
+  internal_site_sampler_.build(probabilityHopToInternalSite_);
 }
 
 // requires master equation convergence as it uses probabilityOnSite_
 void Cluster::calculateProbabilityHopToNeighbors_() {
 
   probabilityHopToNeighbor_.clear();
-  unordered_map<int, double> temp_probabilityHopToNeighbor;
-
-  for (auto site : sitesInCluster_) {
-    for (auto neighsite : site.second.getNeighborSiteIds()) {
-      if (!siteIsInCluster(neighsite)) {
-        if(temp_probabilityHopToNeighbor.count(neighsite)){
-          temp_probabilityHopToNeighbor[neighsite] +=
-            sitesInCluster_[site.first].getProbabilityOfHoppingToNeighboringSite(neighsite) *
-            probabilityOnSite_[site.first];
-        }else{
-          temp_probabilityHopToNeighbor[neighsite] =
-            sitesInCluster_[site.first].getProbabilityOfHoppingToNeighboringSite(neighsite) *
-            probabilityOnSite_[site.first];
-        }
-      }
+  for (const Boundary_Edge & edge : boundary_edges_) {
+    double prob_on_site = probabilityOnSite_[edge.source]*sites_[edge.source]->getTimeConstant();
+    probabilityHopToNeighbor_.emplace_back(edge.neighbor_id,edge.rate*prob_on_site);
+  }
+
+  // Several sites in the cluster can have rates to the same neighbor
+  sort(probabilityHopToNeighbor_.begin(),
+      probabilityHopToNeighbor_.end(),
+      [](const pair<int,double>& x,const pair<int,double>&y)->bool{
+        return x.first<y.first;
+      });
+  size_t unique_count = 0;
+  for (size_t ind = 0; ind < probabilityHopToNeighbor_.size(); ++ind) {
+    if (unique_count>0 &&
+        probabilityHopToNeighbor_[unique_count-1].first==probabilityHopToNeighbor_[ind].first) {
+      probabilityHopToNeighbor_[unique_count-1].second += probabilityHopToNeighbor_[ind].second;
+    } else {
+      probabilityHopToNeighbor_[unique_count] = probabilityHopToNeighbor_[ind];
+      ++unique_count;
     }
   }
+  probabilityHopToNeighbor_.resize(unique_count);
 
   double total = 0.0;
-  for(auto prob : temp_probabilityHopToNeighbor){
+  for(auto prob : probabilityHopToNeighbor_){
     total += prob.second;
   }
 
   // Normalize the probability
   double inverse_total = 1.0/total;
-  unordered_map<int, double> probabilityHopToNeighbor;
-  for (auto prob : temp_probabilityHopToNeighbor) {
-    probabilityHopToNeighbor[prob.first] = prob.second*inverse_total;
+  for (auto & prob : probabilityHopToNeighbor_) {
+    prob.second = prob.second*inverse_total;
   }
 
-  copy(probabilityHopToNeighbor.begin(),
-      probabilityHopToNeighbor.end(),
-      back_inserter(probabilityHopToNeighbor_));
-
   sort(probabilityHopToNeighbor_.begin(),
       probabilityHopToNeighbor_.end(),
       [](const pair<int,double>& x,const pair<int,double>&y)->bool{
         return x.second>y.second;
       });
 
-  total = 0.0;
-  for(pair<int,double>  site_and_prob : probabilityHopToNeighbor_){
-    site_and_prob.second+=total;
-    total = site_and_prob.second;
-    cumulitive_probabilityHopToNeighbor_.push_back(site_and_prob);
-  }
+  neighbor_sampler_.build(probabilityHopToNeighbor_);
 }
 
+// Sites without any rates to other sites in the cluster are given an
+// infinite internal dwell time
 void Cluster::calculateInternalDwellTimes_(){
-  auto internal_rates = getRatesBetweenInternalSites_();
-
-  for (auto rate_to_neigh : internal_rates) {
-    double sum_internal_site_rates = 0.0;
-    for (auto rate : rate_to_neigh.second) {
-      sum_internal_site_rates += rate.second;
-    }
-    internal_dwell_time_[rate_to_neigh.first] = 1.0/sum_internal_site_rates;
+  internal_dwell_time_.resize(sites_.size());
+  for (size_t index = 0; index < sites_.size(); ++index) {
+    internal_dwell_time_[index] = 1.0/sumOfEscapeRateFromSiteToInternalSite_[index];
   }
 }
 
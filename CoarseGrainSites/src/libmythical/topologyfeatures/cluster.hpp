@@ -10,6 +10,8 @@
 
 #include "topology_feature.hpp"
 #include "site.hpp"
+#include "libmythical/discrete_sampler.hpp"
+#include "libmythical/stationary_solver.hpp"
 
 namespace mythical {
 
@@ -42,12 +44,20 @@ class Cluster : public TopologyFeature {
    *
    * random number generator seed: based on time
    *
-   * It is also worth noting that each cluster will be given a different id
-   * on creation. This is automated in the constructor. Such that every new
-   * cluster will be given an integer id greater than the last one created.
+   * The cluster is given an id of 0, the owner of the cluster is
+   * responsible for handing out unique ids, see the constructor below.
    **/
   Cluster();
 
+  /**
+   * \brief Constructor for a cluster with the given id
+   *
+   * The ids are handed out by whoever owns the clusters, e.g. each
+   * CoarseGrainSystem numbers its own clusters from 0, so that independent
+   * systems can be created and used on different threads.
+   **/
+  explicit Cluster(const int id);
+
   /**
    * \brief Convergence Methods
    *
@@ -80,11 +90,24 @@ class Cluster : public TopologyFeature {
    * chosen convergence of the master equation continues for an unspecified
    * number of iterations but until the maximum difference of the sites
    * probabilities is less than the tolerance.
+   *
+   * converge_by_direct_solve
+   *
+   * The probabilities the iterations converge to are solved for directly, a
+   * dense LU decomposition is used for small clusters and GMRES for large
+   * ones. If no rates leave the cluster they are the stationary distribution
+   * of the generator of the rates between its sites. Otherwise probability
+   * is lost on every hop and they are the distribution that keeps its shape,
+   * found by inverse iteration on the hop probabilities including the rates
+   * leaving the cluster, which takes few iterations when the walker mixes
+   * within the cluster faster than it leaves. The tolerance is only used if
+   * the solve fails, converge_by_tolerance is used then.
    **/
   enum Method {
     converge_by_iterations_per_cluster,
     converge_by_iterations_per_site,
-    converge_by_tolerance
+    converge_by_tolerance,
+    converge_by_direct_solve
   };
 
   /**
@@ -94,11 +117,28 @@ class Cluster : public TopologyFeature {
    * sites may be added. However, an error will be thrown if you attempt to
    * add the same site more than once.
    *
-   * \param[in] site a shared pointer to a site
+   * The sites are not copied, the cluster refers to them so they must
+   * outlive the cluster and must not be moved.
+   *
+   * \param[in] site a reference to a site
    **/
   void addSite(Site& site);
   void addSites(std::vector<Site>& sites);
 
+  /**
+   * \brief Adds sites to a cluster that has already been updated
+   *
+   * Instead of solving the master equation from scratch the current
+   * probabilities are used as the starting point and only the escape rates
+   * of the added sites and of the sites on the boundary of the cluster are
+   * recalculated. If the added sites make up more than a quarter of the
+   * cluster, or the cluster has not been updated yet, a full update is done
+   * instead.
+   *
+   * \param[in] sites the sites to add, they are referred to as with addSite
+   **/
+  void mergeSites(const std::vector<Site *> & sites);
+
   /**
    * \brief will update the probabilities and time constant stored in the
    * cluster
@@ -119,7 +159,7 @@ class Cluster : public TopologyFeature {
    * \return True if the site is in the cluster false otherwise
    **/
   bool siteIsInCluster(const int siteId) const {
-    return sitesInCluster_.count(siteId);
+    return local_index_.count(siteId);
   }
 
   /**
@@ -136,7 +176,7 @@ class Cluster : public TopologyFeature {
   /**
    * \brief Returns the number of sites in the cluster
    **/
-  int getNumberOfSitesInCluster() const { return sitesInCluster_.size(); }
+  int getNumberOfSitesInCluster() const { return sites_.size(); }
 
   /**
    * \brief Calculates the probability of hopping to a site in the cluster
@@ -154,7 +194,9 @@ class Cluster : public TopologyFeature {
    * \brief Move the sites in one cluster to another
    *
    * Here we are moving the sites from one cluster to the other. After doing
-   * this any internal values that need to be recalibrated are.
+   * this any internal values that need to be recalibrated are, the same way
+   * as mergeSites does. The probabilities of the moved sites in their old
+   * cluster are used as the starting point.
    *
    * \param[in] cluster a smart pointer to a cluster
    **/
@@ -199,8 +241,38 @@ class Cluster : public TopologyFeature {
    * \return site id generated to reproduce the probability of a particle
    * moving to it
    **/
-  int pickNewSiteId(const int & walker_id);
-  //int pickNewSiteId();
+  using TopologyFeature::pickNewSiteId;
+  int pickNewSiteId(const int & walker_id, Random_Stream & stream) override;
+
+  /**
+   * \brief Let walkers leave the cluster in a single event
+   *
+   * By default a walker spends its escape time on the cluster in slices of
+   * the time increment and hops to a site within the cluster after each
+   * slice, which keeps the time resolution. When exiting directly the dwell
+   * time returned is the whole escape time, drawn from the same exponential
+   * distribution, and the next site picked is always a neighbor of the
+   * cluster. The site occupied in the meantime can be drawn with
+   * pickOccupiedSite if it is needed.
+   *
+   * \param[in] exit_directly true to skip the hops within the cluster
+   **/
+  void setExitDirectly(const bool exit_directly) {
+    exit_directly_ = exit_directly;
+  }
+
+  bool exitsDirectly() const { return exit_directly_; }
+
+  /**
+   * \brief Draw the site a walker on the cluster occupies
+   *
+   * The sites are drawn from the fraction of time spent on each of them,
+   * which does not depend on how long the walker has been on the cluster.
+   * Does not change the state of any walker.
+   *
+   * \return site id of a site within the cluster
+   **/
+  int pickOccupiedSite(Random_Stream & stream) { return pickInternalSite_(stream); }
 
   /**
    * \brief Set the convergence method
@@ -256,14 +328,40 @@ class Cluster : public TopologyFeature {
   /**
    * \brief Returns the dwell time, each call will return a different value
    **/
-  double getDwellTime(const int & walker_id);
-  //double getDwellTime();
+  using TopologyFeature::getDwellTime;
+  double getDwellTime(const int & walker_id, Random_Stream & stream) override;
 
-  double getFastestRateOffCluster();
+  double getFastestRateOffCluster() const;
 
   void setVisitFrequency(int frequency,const int & siteId);
   int getVisitFrequency(const int & siteId);
 
+  /**
+   * \brief Write the state of the cluster
+   *
+   * Besides the state written by every feature this includes the settings,
+   * the stationary probabilities, the visits to each site, the remaining
+   * dwell times of the walkers and the edges. The sites are not written,
+   * before loadState is called they must be added again in the order given
+   * by getSiteIdsInCluster. The hop tables are then rebuilt without solving
+   * the master equation.
+   **/
+  void saveState(Binary_Writer & writer) const override;
+  void loadState(Binary_Reader & reader) override;
+
+  /**
+   * \brief Write the parts of the cluster that depend only on the rates
+   *
+   * The settings, the stationary probabilities and the edges, but not the
+   * visits, the walkers or the random number stream. Used to reuse clusters
+   * between runs with the same rates, see CoarseGrainSystem::exportClusters.
+   **/
+  void saveSolution(Binary_Writer & writer) const;
+
+  /// Restore the solution written by saveSolution, the cluster starts
+  /// without any visits
+  void loadSolution(Binary_Reader & reader);
+
   /**
    * \brief Prints the contents of the cluster
    **/
@@ -292,6 +390,9 @@ class Cluster : public TopologyFeature {
   /// Time increment of the cluster
   double time_increment_;
 
+  /// Walkers leave in a single event instead of in slices of time_increment_
+  bool exit_directly_;
+
   double internal_time_constant_;
   /**
    * \brief Stores the particle and its total dwell time on the cluster
@@ -310,65 +411,127 @@ class Cluster : public TopologyFeature {
    * probability given as a value between 0 and 1.
    **/
   std::vector<std::pair<int, double>> probabilityHopToNeighbor_;
-  std::vector<std::pair<int, double>> cumulitive_probabilityHopToNeighbor_;
+  /// Picks an index of probabilityHopToNeighbor_
+  Discrete_Sampler neighbor_sampler_;
 
   /**
-   * \brief Stores the internal dwell time of the sites in the cluster
+   * \brief The sites in the cluster, they are owned elsewhere
    *
-   * In other words this stores the dwell times as if there are no rates to
-   * sites neighboring the cluster. 
+   * The position of a site in this vector is its local index. All the
+   * vectors below that store a value per site are indexed by it.
    **/
-  std::unordered_map<int,double> internal_dwell_time_;
+  std::vector<Site *> sites_;
+
+  /// Converts a site id into its local index
+  std::unordered_map<int,int> local_index_;
 
   /**
-   * \brief Stores the number of times a site in the cluster is visited
+   * \brief The probability of a particle being on each of the sites
    *
+   * A probability between 0 and 1 which is found from solving the Master
+   * Equation.
    **/
-  std::unordered_map<int,double> site_visits_;
+  std::vector<double> probabilityOnSite_;
 
   /**
-   * \brief Stores the rates from each site in the cluster to the neighbors
+   * \brief Stores the internal dwell time of the sites in the cluster
    *
-   * The first int is the site id of an internal site, the double is a sum of
-   * all the rates going from the internal site to sites neighboring the cluster.
+   * In other words this stores the dwell times as if there are no rates to
+   * sites neighboring the cluster. 
    **/
-  std::unordered_map<int, double> sumOfEscapeRateFromSiteToNeighbor_;
+  std::vector<double> internal_dwell_time_;
+
   /**
-   * Same as above but the double is the sum of the rates going to other sites
-   * within the cluster. 
+   * \brief Stores the number of times a site in the cluster is visited
+   *
+   * Sites added since the last update do not have an entry yet.
    **/
-  std::unordered_map<int, double> sumOfEscapeRateFromSiteToInternalSite_;
+  std::vector<double> site_visits_;
 
   /**
-   * \brief Stores the pointers to sites that are in the cluster
+   * \brief Sum of the rates going from each site to sites neighboring the
+   * cluster
    **/
-  std::unordered_map<int, Site> sitesInCluster_;
+  std::vector<double> sumOfEscapeRateFromSiteToNeighbor_;
+  /// Same as above but the sum of the rates going to other sites within the
+  /// cluster
+  std::vector<double> sumOfEscapeRateFromSiteToInternalSite_;
 
-  std::unordered_map<int,double> probabilityHopOffInternalSite_;
-  std::unordered_map<int,double> probabilityHopBetweenInternalSite_;
+  std::vector<double> probabilityHopOffInternalSite_;
+  std::vector<double> probabilityHopBetweenInternalSite_;
 
   /**
-   * \brief The probability of a particle being on each of the sites
+   * \brief Rates between the sites of the cluster
    *
-   * The first int is the site id of a site within the cluster, the double
-   * is a probability between 0 and 1 which is found from solving the
-   * Master Eqaution.
+   * Compressed sparse row form, row i holds the rates leaving the site with
+   * local index i and the columns are local indices as well.
    **/
-  std::unordered_map<int, double> probabilityOnSite_;
+  std::vector<size_t> internal_offsets_;
+  std::vector<int> internal_columns_;
+  std::vector<double> internal_rates_;
+
+  /// A rate from a site in the cluster to a site neighboring the cluster
+  struct Boundary_Edge {
+    /// Local index of the site in the cluster
+    int source;
+    int neighbor_id;
+    double rate;
+  };
+  std::vector<Boundary_Edge> boundary_edges_;
+
+  /// Scratch space used when iterating the master equation
+  std::vector<double> temp_probabilityOnSite_;
 
   std::vector<std::pair<int,double>> probabilityHopToInternalSite_;
-  std::vector<std::pair<int,double>> cumulitive_probabilityHopToInternalSite_;
+  /// Picks an index of probabilityHopToInternalSite_
+  Discrete_Sampler internal_site_sampler_;
+
+  /// Used by converge_by_direct_solve
+  Stationary_Solver stationary_solver_;
+  /// Probability of each hop in internal_rates_, rate*tau of the source
+  std::vector<double> jump_probabilities_;
 
   /************************************************************************
    * Local Cluster Functions
    ************************************************************************/
 
-  //void incrementVisits_();
+  /// Adds the visits made since the last call to site_visits_
+  void registerVisits_();
 
-  std::unordered_map<int,int> getVisitFrequencies_();
+  /// Local index of a site, the site must be in the cluster
+  int getLocalIndex_(const int siteId) const {
+    assert(local_index_.count(siteId) && "the provided site is not in the "
+        "cluster");
+    return local_index_.at(siteId);
+  }
 
-  /// Will solve the Master Equation
-  void solveMasterEquation_();
+  /**
+   * \brief Will solve the Master Equation
+   *
+   * \param[in] warm_start if true probabilityOnSite_ already holds a guess
+   * of the solution and is used as the starting point
+   **/
+  void solveMasterEquation_(const bool warm_start = false);
+
+  /**
+   * \brief Updates the cluster after sites have been added to it
+   *
+   * The added sites are the ones with a local index of old_site_count or
+   * more.
+   *
+   * \param[in] old_site_count number of sites before any were added
+   * \param[in] new_site_probabilities optional guess of the probability of
+   * the added sites in the same order, should sum to 1
+   **/
+  void updateIncrementally_(
+      const size_t old_site_count,
+      const std::vector<double> & new_site_probabilities);
+
+  /// Iterates until the change in the probabilities is below the tolerance
+  void convergeByTolerance_();
+
+  /// Returns false if the solver failed, the probabilities are then not valid
+  bool solveMasterEquationDirectly_(const bool warm_start);
 
   /**
    * \brief Picks a neighboring site of the cluster
@@ -379,8 +542,7 @@ class Cluster : public TopologyFeature {
    *
    * \return the site id of one of the neighbors
    **/
-  int pickClusterNeighbor_(const int & walker_id);
-  //int pickClusterNeighbor_();
+  int pickClusterNeighbor_(const int & walker_id, Random_Stream & stream);
 
   /**
    * \brief Picks a site within the cluster
@@ -391,7 +553,7 @@ class Cluster : public TopologyFeature {
    *
    * \return the site id of a site within the cluster
    **/
-  int pickInternalSite_();
+  int pickInternalSite_(Random_Stream & stream);
 
   /**
      * \brief Calculates the time constant used to calculate the dwell time
@@ -424,14 +586,17 @@ class Cluster : public TopologyFeature {
     bool hopWithinCluster_(const int & walker_id) const;
     //bool hopWithinCluster_();
 
-    // First int is the Id of a site within the cluster
-    // pair - first int is the id of the site neighboring the cluster
-    // double is the rate
-    std::unordered_map<int, std::unordered_map<int, double>>
-        getRatesToNeighborsOfCluster_();
+    /**
+     * \brief Sorts the rates of the sites into internal and boundary rates
+     *
+     * Only the sites flagged in rescan are read again, the rows of the other
+     * sites are copied from the previous call. Sites added since the last
+     * call must be flagged. The sums of the escape rates are updated as well.
+     **/
+    void calculateEdges_(const std::vector<bool> & rescan);
 
-    std::unordered_map<int, std::unordered_map<int, double>>
-        getRatesBetweenInternalSites_();
+    /// Sum the rates of the edges off each site
+    void calculateEscapeRateSums_();
 
     void iterate_();
 
@@ -440,33 +605,9 @@ class Cluster : public TopologyFeature {
     void calculateProbabilityHopOffInternalSite_();
     void calculateProbabilityHopBetweenInternalSite_();
     void calculateInternalDwellTimes_();
-    void calculateSumOfEscapeRatesFromSitesToTheirNeighbors_();
-    void calculateSumOfEscapeRatesFromSitesToInternalSites_();
 
     void initializeProbabilityOnSites_();
 
-    /**
-     * \brief Will grab all the internal rates going to each site in the
-     * cluster
-     *
-     * This function organises the rates describing movement within a cluster
-     * such that the first integer in the map is the internal neighbor id of
-     * a site. The vector of pairs contains the directional rate going from
-     * the neighbor to a site. Thus the integer in the pair is the site id
-     * and the double is the rate.
-     *
-     * E.g.
-     *
-     * site1 <- internal_neigh1 -> site2
-     *                |
-     *                v
-     *              site3
-     *
-     * The diagram explains how the contents are stored in the map.
-     **/
-    std::unordered_map<int, std::vector<std::pair<int, double>>>
-        getInternalRatesFromNeighborsComingToSite_();
-
     friend void occupyCluster_(TopologyFeature*,const int&);
     friend void vacateCluster_(TopologyFeature*,const int&);
     friend bool isOccupiedCluster_(TopologyFeature*,const int&);
@@ -1,7 +1,6 @@
 
 #include <algorithm>
 #include <chrono>
-#include <set>
 #include <utility>
 #include <cassert>
 
@@ -12,21 +11,6 @@ using namespace std;
 
 namespace mythical {
 
-  class CustomComparitor
-  {
-    public:
-      int operator()(const pair<double,int>& lhs, const pair<double,int>& rhs)
-      {
-        if(lhs.first==rhs.first){
-          return 0;
-        }
-        if(lhs.second==rhs.second){
-          return lhs.first<rhs.first;
-        }
-        return lhs.second < rhs.second;
-      }
-  };
-
 /*********************************************************************
  * Public Facing Functions
  *********************************************************************/
@@ -35,103 +19,111 @@ Site::Site()
     : TopologyFeature() {
 
   cluster_id_ = constants::unassignedId;
+  rate_index_ = 0;
 }
 
 Site::~Site() {}
 
-void Site::setRatesToNeighbors(unordered_map<int, double>& neighRates) {
+void Site::setRatesToNeighbors(const unordered_map<int, double>& neighRates) {
   assert(neighRates.size()!=0 && "Sites must have at least one rate to a "
     "neighbor. Cannot set rates to neighbors with empty map.");
-  for (auto neighAndRate : neighRates) {
+  for (const pair<const int,double> & neighAndRate : neighRates) {
     assert(neighAndRate.second!=0 && "One of the rates is 0.0. You cannot "
         "set a rate to a value of 0.0 as it is meaningless.");
-    neighRates_[neighAndRate.first] = &(neighRates[neighAndRate.first]);
   }
-  calculateDwellTimeConstant_();
-  calculateProbabilityHopToNeighbors_();
+  // Rates already stored are kept unless they are to one of the neighbors
+  // given
+  setOwnedRates_(vector<pair<int,double>>(neighRates.begin(),neighRates.end()));
+}
+
+void Site::setRatesToNeighbors(shared_ptr<Rate_Graph> rate_graph, const int index) {
+  rate_graph_ = rate_graph;
+  rate_index_ = index;
+  escape_time_constant_ = rate_graph_->getTimeConstant(rate_index_);
 }
 
 void Site::addNeighRate(const pair<int, double*> neighRate) {
 
-  assert(neighRates_.count(neighRate.first)==0 && "That neighbor has already been added.");
-  neighRates_[neighRate.first] = neighRate.second;
-  calculateDwellTimeConstant_();
-  calculateProbabilityHopToNeighbors_();
+  assert(!isNeighbor(neighRate.first) && "That neighbor has already been added.");
+  setOwnedRates_({{neighRate.first,*(neighRate.second)}});
 }
 
 void Site::resetNeighRate(const pair<int, double*> neighRate) {
-  neighRates_[neighRate.first] = neighRate.second;
-  calculateDwellTimeConstant_();
-  calculateProbabilityHopToNeighbors_();
+  setOwnedRates_({{neighRate.first,*(neighRate.second)}});
 }
 
 vector<double> Site::getRateToNeighbors() const {
-  vector<double> rates;
-  for (auto & rate : neighRates_) rates.push_back(*(rate.second));
-  return rates;
+  Rate_View rates = getRateView();
+  return vector<double>(rates.rates, rates.rates + rates.size());
 }
 
 double Site::getRateToNeighbor(const int & neighSiteId) const {
-  assert(neighRates_.count(neighSiteId)!=0 && "Error the site Id is not a neighbor of the site ");
-  return *(neighRates_.at(neighSiteId));
+  assert(isNeighbor(neighSiteId) && "Error the site Id is not a neighbor of the site ");
+  return rate_graph_->getRate(rate_index_,neighSiteId);
 }
 
 double Site::getFastestRate(){
+  Rate_View rates = getRateView();
   double rate =0.0;
-  for(auto neigh_rate: neighRates_) {
-    if(*(neigh_rate.second)>rate) rate = *(neigh_rate.second);
+  for (size_t ind = 0; ind < rates.size(); ++ind) {
+    if(rates.rate(ind)>rate) rate = rates.rate(ind);
   }
   return rate;
 }
 
 vector<int> Site::getNeighborSiteIds() const {
-  vector<int> neighborIds;
-  for (auto neighId : neighRates_) neighborIds.push_back(neighId.first);
-  return neighborIds;
+  Rate_View rates = getRateView();
+  return vector<int>(rates.neighbor_ids, rates.neighbor_ids + rates.size());
 }
 
-int Site::pickNewSiteId(const int &) {
-  return pickNewSiteId();
+int Site::pickNewSiteId() {
+  return pickNewSiteId(constants::unassignedId,random_stream_);
 }
 
-int Site::pickNewSiteId() {
-  double number = random_distribution_(random_engine_);
-  double threshold = 0.0;
-  for (pair<int,double> & pval : probabilityHopToNeighbor_) {
-    threshold += pval.second;
-    if (number < threshold) return pval.first;
+int Site::pickNewSiteId(const int &, Random_Stream & stream) {
+  double number = stream.uniform();
+  Rate_View rates = getRateView();
+  if(rates.size()==0){
+    assert(false && "Error the site has no neighbors");
+    return -1;
   }
-  assert("Error cummulitive probability distribution is flawed or "
-      " the random number generator has calculated a value greater than 1, or"
-      " the site has no neighbors");
-  return -1;
+  return rates.neighborId(rate_graph_->sampleNeighbor(rate_index_,number));
 }
 
-unordered_map<int,double *> Site::getNeighborsAndRates(){
-  return neighRates_;
+unordered_map<int,const double *> Site::getNeighborsAndRates() const {
+  unordered_map<int,const double *> neigh_rates;
+  if(!rate_graph_) return neigh_rates;
+  Rate_View rates = getRateView();
+  for (size_t ind = 0; ind < rates.size(); ++ind) {
+    neigh_rates[rates.neighborId(ind)] = rates.rates + ind;
+  }
+  return neigh_rates;
 }
 
-const unordered_map<int,double *> & Site::getNeighborsAndRatesConst() const{
-  return neighRates_;
+Rate_View Site::getRateView() const {
+  if(!rate_graph_) return Rate_View{nullptr,nullptr,0};
+  return rate_graph_->getRates(rate_index_);
 }
 
 double Site::getProbabilityOfHoppingToNeighboringSite(
     const int & neighSiteId) 
 {
-  assert(neighRates_.count(neighSiteId) != 0 && "Error site "
+  assert(isNeighbor(neighSiteId) && "Error site "
       " is not a neighbor ");
 
-  auto it = find_if(
-      probabilityHopToNeighbor_.begin(),
-      probabilityHopToNeighbor_.end(),
-      [&neighSiteId](const pair<int,double>& neigh_and_prob)
-      { return neighSiteId==neigh_and_prob.first; }); 
-
-  return it->second;
+  int position = rate_graph_->findNeighbor(rate_index_,neighSiteId);
+  return rate_graph_->getProbabilities(rate_index_)[position];
 }
 
 vector<pair<int, double>> Site::getProbabilitiesAndIdsOfNeighbors() const {
-  return probabilityHopToNeighbor_;
+  vector<pair<int, double>> neigh_and_prob;
+  Rate_View rates = getRateView();
+  if(rates.size()==0) return neigh_and_prob;
+  const double * probabilities = rate_graph_->getProbabilities(rate_index_);
+  for (size_t ind = 0; ind < rates.size(); ++ind) {
+    neigh_and_prob.emplace_back(rates.neighborId(ind),probabilities[ind]);
+  }
+  return neigh_and_prob;
 }
 
 std::ostream& operator<<(std::ostream& os,
@@ -141,11 +133,12 @@ std::ostream& operator<<(std::ostream& os,
   os << "Total Visit Frequency: " << site.total_visit_freq_ << endl;
   os << "Escape Time Constant: " << site.escape_time_constant_ << endl;
   os << "Neighbors:Rates" << endl;
-  for (auto rate_ptr : site.neighRates_) {
-    os << "\t" << rate_ptr.first << ":" << *(rate_ptr.second) << endl;
+  Rate_View rates = site.getRateView();
+  for (size_t ind = 0; ind < rates.size(); ++ind) {
+    os << "\t" << rates.neighborId(ind) << ":" << rates.rate(ind) << endl;
   }
   os << "Neighbors:Probability hop to them" << endl;
-  for (auto probability : site.probabilityHopToNeighbor_) {
+  for (auto probability : site.getProbabilitiesAndIdsOfNeighbors()) {
     os << "\t" << probability.first << ":" << probability.second << endl;
   }
   return os;
@@ -154,29 +147,15 @@ std::ostream& operator<<(std::ostream& os,
 /*********************************************************************
  * Private Internal Functions
  *********************************************************************/
-void Site::calculateProbabilityHopToNeighbors_() {
-  double sumRates = getSumOfRates_();
-  set<pair<int,double>,CustomComparitor> neigh_and_prob;
-  for (auto rateToNeigh : neighRates_) {
-    auto values = pair<int,double> (rateToNeigh.first,(*rateToNeigh.second) / sumRates);
-    neigh_and_prob.insert(values);
-  }
-
-  probabilityHopToNeighbor_.clear();
-  copy(neigh_and_prob.begin(),neigh_and_prob.end(),back_inserter(probabilityHopToNeighbor_));
-}
-
-void Site::calculateDwellTimeConstant_() {
-  auto sumRates = getSumOfRates_();
-  escape_time_constant_ = 1.0 / sumRates;
-}
-
-double Site::getSumOfRates_() {
-  double sum = 0.0;
-  for (auto rate : neighRates_) {
-    sum += *(rate.second);
+void Site::setOwnedRates_(vector<pair<int,double>> neigh_rates) {
+  // A graph shared with a system or with a copy of this site is left alone,
+  // the site takes a copy of its row first
+  if (!rate_graph_ || !rate_graph_->isSingleRow() || rate_graph_.use_count()>1) {
+    rate_graph_ = Rate_Graph::createSingleRow(constants::unassignedId,getRateView());
+    rate_index_ = 0;
   }
-  return sum;
+  rate_graph_->setRates(move(neigh_rates));
+  escape_time_constant_ = rate_graph_->getTimeConstant(rate_index_);
 }
 
 }
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "topology_feature.hpp"
+#include "libmythical/rate_graph.hpp"
 
 namespace mythical {
 
@@ -16,9 +17,11 @@ namespace mythical {
  *
  * This class keeps track of all information related to a site and it's
  * neighbors. It is an internal class meaning it is not meant to be used by
- * the public. It does not store rates to the neighboring sites locally, this
- * is to make it possible for an end user to alter the rates externally
- * without having to touch this class.
+ * the public. It does not store rates to the neighboring sites locally,
+ * instead it reads them from a row of a Rate_Graph which may be shared by
+ * all the sites in the system. The hop probabilities and time constant are
+ * read from the graph as well, so the site only holds the state of a single
+ * run: occupancy, cluster membership, visits and random numbers.
  **/
 class Site : public TopologyFeature {
  public:
@@ -32,10 +35,21 @@ class Site : public TopologyFeature {
    * however, it may very well overwrite a rate to a previously stored
    * neighboring site.
    *
-   * \param[in] neighRates Stores the site id of the neighbor with a pointer
-   * to the rate going to the neighboring site.
+   * \param[in] neighRates Stores the site id of the neighbor with the rate
+   * going to the neighboring site, the rates are copied.
    **/
-  void setRatesToNeighbors(std::unordered_map<int, double>& neighRates);
+  void setRatesToNeighbors(const std::unordered_map<int, double>& neighRates);
+
+  /**
+   * \brief Point the site at a row of a rate graph
+   *
+   * The rates are not copied, the site reads them directly from the graph.
+   * A row without any rates is allowed and is used for drain sites.
+   *
+   * \param[in] rate_graph graph storing the rates of the system
+   * \param[in] index the dense index of the row in the graph
+   **/
+  void setRatesToNeighbors(std::shared_ptr<Rate_Graph> rate_graph, const int index);
 
   /**
    * \brief Add a rate to a neighboring site
@@ -45,7 +59,8 @@ class Site : public TopologyFeature {
    * In such a case you should call resetNeighRate instead.
    *
    * \param[in] neighborRate The first int is the site id of neighboring
-   * site, this is followed by a pointer to actual rate.
+   * site, this is followed by a pointer to actual rate, the value of which
+   * is copied.
    **/
   void addNeighRate(const std::pair<int, double*> neighRate);
 
@@ -56,7 +71,7 @@ class Site : public TopologyFeature {
    * call reset rate.
    *
    * \param[in] neighRate the first int is the id of the neighboring site,
-   * the double pointer will point to the rate.
+   * the double pointer will point to the rate, the value of which is copied.
    **/
   void resetNeighRate(const std::pair<int, double*> neighRate);
 
@@ -70,7 +85,7 @@ class Site : public TopologyFeature {
    * \return True if it is a neighbor and False if it is not
    **/
   bool isNeighbor(const int neighSiteId) const {
-    return neighRates_.count(neighSiteId);
+    return rate_graph_ && rate_graph_->findNeighbor(rate_index_,neighSiteId)!=-1;
   }
 
   /**
@@ -118,7 +133,8 @@ class Site : public TopologyFeature {
    *
    * \return site id of a neigboring site
    **/
-  int pickNewSiteId(const int & ) override;
+  using TopologyFeature::pickNewSiteId;
+  int pickNewSiteId(const int &, Random_Stream & stream) override;
   int pickNewSiteId() override;
 
   /**
@@ -148,8 +164,19 @@ class Site : public TopologyFeature {
    **/
   double getProbabilityOfHoppingToNeighboringSite(const int & neighSiteId);
 
-  std::unordered_map<int,double *> getNeighborsAndRates();
-  const std::unordered_map<int,double *>& getNeighborsAndRatesConst() const;
+  /// Points into the rate graph, which may be shared, the rates are read only
+  std::unordered_map<int,const double *> getNeighborsAndRates() const;
+
+  /**
+   * \brief Returns a view of the contiguous neighbor ids and rates
+   *
+   * The view is only valid for as long as the rates of the site are not
+   * changed.
+   **/
+  Rate_View getRateView() const;
+
+  /// Number of neighbors the site has rates to
+  size_t getNumberOfNeighbors() const { return getRateView().size(); }
 
   /**
    * \brief Gets the ids and the probabilities of hopping to neighbors
@@ -168,14 +195,12 @@ class Site : public TopologyFeature {
 
    private:
   /**
-   * \brief Contains the probability of hopping to each neighbor
+   * \brief Graph storing the rates to each of the neighboring sites
    **/
-  std::vector<std::pair<int, double>> probabilityHopToNeighbor_;
+  std::shared_ptr<Rate_Graph> rate_graph_;
 
-  /**
-   * \brief Stores pointers to the rates to each of the neighboring sites
-   **/
-  std::unordered_map<int, double*> neighRates_;
+  /// Row of the rate graph associated with this site
+  int rate_index_;
 
   /**
    * \brief Stores the id of the cluster the site is a part of
@@ -183,24 +208,11 @@ class Site : public TopologyFeature {
   int cluster_id_;
 
   /**
-   * \brief Distribution to be used when picking random numbers
-   **/
-  std::uniform_real_distribution<double> randomDistribution_;
-
-  /**
-   * \brief This function calculates the probability of hopping to each
-   * neighboring site
+   * \brief Add or change rates in a single row graph owned by the site
    *
-   * The probabilities are stored in the probHopToNeighbor_ map
+   * Only the row of the site is updated, the rest of the rates are kept.
    **/
-  void calculateProbabilityHopToNeighbors_();
-
-  /**
-   * \brief Calculates the escapeTimeConstant_
-   **/
-  void calculateDwellTimeConstant_();
-
-  double getSumOfRates_();
+  void setOwnedRates_(std::vector<std::pair<int,double>> neigh_rates);
 
 };
 
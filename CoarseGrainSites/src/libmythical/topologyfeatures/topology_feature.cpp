@@ -1,7 +1,6 @@
 
-#include <chrono>
-
 #include "topology_feature.hpp"
+#include "libmythical/binary_file.hpp"
 
 using namespace std;
 
@@ -38,9 +37,6 @@ namespace mythical {
   }
 
   TopologyFeature::TopologyFeature(){
-    auto seed = chrono::system_clock::now().time_since_epoch().count();
-    random_engine_ = mt19937(seed);
-    random_distribution_ = uniform_real_distribution<double>(0.0, 1.0);
     occupied_ = 0;
     escape_time_constant_ = 0.0;
     total_visit_freq_ = 0;
@@ -58,11 +54,29 @@ namespace mythical {
   }
 
   void TopologyFeature::setRandomSeed(const unsigned long seed){
-    random_engine_ = mt19937(seed);
+    random_stream_.seed(seed,0);
+  }
+
+  void TopologyFeature::setRandomSeed(
+      const unsigned long seed, 
+      const uint64_t stream_id){
+    random_stream_.seed(seed,stream_id);
+  }
+
+  void TopologyFeature::saveState(Binary_Writer & writer) const {
+    writer.write(static_cast<int32_t>(occupied_));
+    writer.write(static_cast<int32_t>(total_visit_freq_));
+    random_stream_.saveState(writer);
+  }
+
+  void TopologyFeature::loadState(Binary_Reader & reader){
+    occupied_ = reader.read<int32_t>();
+    total_visit_freq_ = reader.read<int32_t>();
+    random_stream_.loadState(reader);
   }
 
-  double TopologyFeature::getDwellTime(const int & ){
-    double number = random_distribution_(random_engine_);
+  double TopologyFeature::getDwellTime(const int &, Random_Stream & stream){
+    double number = stream.uniform();
     return (-1.0)*log(number) * escape_time_constant_;
   }
 
@@ -5,14 +5,18 @@
 #include <unordered_map>
 #include <math.h>
 #include <memory>
-#include <random>
 #include <vector>
 
 #include "mythical/constants.hpp"
+#include "mythical/random_policy.hpp"
 #include "libmythical/identity.hpp"
+#include "libmythical/random_stream.hpp"
 
 namespace mythical {
 
+class Binary_Reader;
+class Binary_Writer;
+
 /**
  * \brief TopologyFeature Class
  *
@@ -48,17 +52,12 @@ class TopologyFeature : public virtual Identity {
   double escape_time_constant_;
 
   /**
-   * \brief This is the random number engine
+   * \brief This is the source of random numbers
    *
-   * This engine creates pseudo random numbers, it has been initialized
-   * from the time.
-   **/
-  std::mt19937 random_engine_;
-
-  /**
-   * \brief Distribution to be used when picking random numbers
+   * Creates pseudo random numbers in the range (0,1], it has been
+   * initialized from the time.
    **/
-  std::uniform_real_distribution<double> random_distribution_;
+  Random_Stream random_stream_;
 
   /// Create function pointer variables
 
@@ -99,6 +98,27 @@ class TopologyFeature : public virtual Identity {
    **/
   void setRandomSeed(const unsigned long seed);
 
+  /**
+   * \brief Set the seed and the stream of the random number generator
+   *
+   * With the counter based policy features that share a seed but have
+   * different stream ids produce independent sequences. The stream id is
+   * ignored by the mersenne twister policy.
+   *
+   * \param[in] seed a random number seed
+   * \param[in] stream_id typically derived from the id of the feature
+   **/
+  void setRandomSeed(const unsigned long seed, const uint64_t stream_id);
+
+  /**
+   * \brief Choose the random number generator
+   *
+   * Should be called before the seed is set as changing the policy will
+   * restart the sequence.
+   **/
+  void setRandomPolicy(const RandomPolicy policy) 
+  { random_stream_.setPolicy(policy); }
+
   /**
    * \brief Determine if site is occupied by a particle
    *
@@ -166,8 +186,16 @@ class TopologyFeature : public virtual Identity {
    * \return A time indicating how long a particle was on the site before it
    * hopped
    **/
-  virtual double getDwellTime(const int & walker_id);
-  //virtual double getDwellTime();
+  double getDwellTime(const int & walker_id) 
+  { return getDwellTime(walker_id,random_stream_); }
+
+  /**
+   * \brief Return the hop time of the site drawing from the stream provided
+   *
+   * Allows the random numbers to be tied to the walker instead of to the
+   * feature.
+   **/
+  virtual double getDwellTime(const int & walker_id, Random_Stream & stream);
 
   /**
    * \brief Returns the id of a neighboring site
@@ -180,9 +208,16 @@ class TopologyFeature : public virtual Identity {
    *
    * \return site id of a neigboring site
    **/
-  virtual int pickNewSiteId(const int & walker_id) = 0;
+  int pickNewSiteId(const int & walker_id) 
+  { return pickNewSiteId(walker_id,random_stream_); }
   virtual int pickNewSiteId() { return -1;}
 
+  /**
+   * \brief Returns the id of a neighboring site drawing from the stream 
+   * provided
+   **/
+  virtual int pickNewSiteId(const int & walker_id, Random_Stream & stream) = 0;
+
   virtual void setVisitFrequency(const int & frequency) 
   { total_visit_freq_ = frequency;}
   virtual void setVisitFrequency(const int & frequency, int) 
@@ -193,6 +228,17 @@ class TopologyFeature : public virtual Identity {
   virtual int getVisitFrequency(int) 
   { return total_visit_freq_; }
 
+  /**
+   * \brief Write the state that changes as walkers hop
+   *
+   * The occupation, the visits and the random number stream. Anything that
+   * can be derived from the rates is not written.
+   **/
+  virtual void saveState(Binary_Writer & writer) const;
+
+  /// Restore the state written by saveState
+  virtual void loadState(Binary_Reader & reader);
+
 
 };
 
@@ -0,0 +1,41 @@
+
+#include <stdexcept>
+#include <string>
+
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+
+namespace mythical {
+
+  int WalkerPool::addWalker(const int siteId, const double time) {
+    current_site_.push_back(siteId);
+    potential_site_.push_back(constants::unassignedId);
+    dwell_time_.push_back(0.0);
+    time_.push_back(time);
+    return static_cast<int>(current_site_.size()-1);
+  }
+
+  void WalkerPool::placeWalker(
+      const int walker_id,
+      const int siteId,
+      const double time) {
+    if(walker_id<0 || static_cast<size_t>(walker_id)>=current_site_.size()){
+      throw out_of_range("Cannot place walker " + to_string(walker_id) +
+          " it has not been added to the pool.");
+    }
+    if(isActive(walker_id)){
+      throw invalid_argument("Cannot place walker " + to_string(walker_id) +
+          " it is still active.");
+    }
+    current_site_[walker_id] = siteId;
+    potential_site_[walker_id] = constants::unassignedId;
+    dwell_time_[walker_id] = 0.0;
+    time_[walker_id] = time;
+  }
+
+  bool WalkerPool::isActive(const int walker_id) const {
+    return event_queue_.contains(walker_id);
+  }
+
+}
@@ -0,0 +1,100 @@
+
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../../libmythical/basin_graph.hpp"
+#include "../../libmythical/rate_graph.hpp"
+#include "../../libmythical/site_container.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: Basin Graph","[unit]"){
+
+  //
+  // site1 -> site2 -> site3 -> site4
+  //       <-       <-       <-
+  //
+  // Times to cross each edge 1/rate
+  //
+  //   1->2 0.5  2->3 0.25  3->4 1.0
+  //   2->1 1.0  3->2 0.5   4->3 0.1
+  //
+  unordered_map<int,unordered_map<int,double>> rates;
+  rates[1][2] = 2.0;
+  rates[2][1] = 1.0;
+  rates[2][3] = 4.0;
+  rates[3][2] = 2.0;
+  rates[3][4] = 1.0;
+  rates[4][3] = 10.0;
+
+  auto rate_graph = make_shared<Rate_Graph>(rates);
+  Site_Container site_container;
+  site_container.addSites(rate_graph);
+
+  cout << "Testing: build" << endl;
+  {
+    Basin_Graph basin_graph;
+    // Duplicates and sites outside of the container are ignored
+    basin_graph.build(site_container,{3,2,3});
+    assert(basin_graph.size()==2);
+    assert(basin_graph.getSiteId(0)==2);
+    assert(basin_graph.getSiteId(1)==3);
+    assert(basin_graph.getIndex(3)==1);
+    assert(basin_graph.getIndex(4)==-1);
+
+    bool thrown = false;
+    try {
+      basin_graph.getShortestPath(0,1);
+    }catch(...){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: calculateShortestPaths" << endl;
+  {
+    Basin_Graph basin_graph;
+    basin_graph.build(site_container,{1,2,3});
+    basin_graph.calculateShortestPaths();
+
+    // Edges leaving the basin, 3->4, are ignored
+    assert(basin_graph.getShortestPath(0,0)==0.0);
+    assert(fabs(basin_graph.getShortestPath(0,2)-0.75)<1E-12);
+    assert(fabs(basin_graph.getShortestPath(2,0)-1.5)<1E-12);
+    assert(fabs(basin_graph.getEccentricity(0)-0.75)<1E-12);
+    assert(fabs(basin_graph.getEccentricity(2)-1.5)<1E-12);
+    assert(fabs(basin_graph.getDiameter()-1.5)<1E-12);
+
+    // Buffers are reused when the graph is rebuilt
+    basin_graph.build(site_container,{3,4});
+    basin_graph.calculateShortestPaths();
+    assert(fabs(basin_graph.getDiameter()-1.0)<1E-12);
+  }
+
+  cout << "Testing: unreachable sites" << endl;
+  {
+    Basin_Graph basin_graph;
+    // There is no edge between site 1 and site 3
+    basin_graph.build(site_container,{1,3});
+    basin_graph.calculateShortestPaths();
+    assert(basin_graph.getShortestPath(0,1)==numeric_limits<double>::infinity());
+    assert(basin_graph.getDiameter()==0.0);
+  }
+
+  cout << "Testing: empty graph" << endl;
+  {
+    Basin_Graph basin_graph;
+    basin_graph.build(site_container,{});
+    basin_graph.calculateShortestPaths();
+    assert(basin_graph.size()==0);
+    assert(basin_graph.getDiameter()==0.0);
+  }
+}
@@ -8,6 +8,7 @@
 
 #include "../../libmythical/topologyfeatures/cluster.hpp"
 #include "../../libmythical/topologyfeatures/site.hpp"
+#include "../../libmythical/random_stream.hpp"
 
 using namespace std;
 using namespace mythical;
@@ -56,6 +57,32 @@ TEST_CASE("Testing: Cluster","[unit]"){
   }
 
 
+  cout << "Testing: sites are referenced not copied" << endl;
+  {
+    double rate = 1.0;
+    Site site;
+    site.setId(1);
+    site.addNeighRate(pair<int,double *>(2,&rate));
+    site.addNeighRate(pair<int,double *>(3,&rate));
+
+    Site site2;
+    site2.setId(2);
+    site2.addNeighRate(pair<int,double *>(1,&rate));
+
+    Cluster cluster;
+    cluster.addSite(site);
+    cluster.addSite(site2);
+    cluster.updateProbabilitiesAndTimeConstant();
+    assert(site.getClusterId()==cluster.getId());
+
+    assert(!site.isOccupied());
+    cluster.occupy(1);
+    assert(site.isOccupied());
+    assert(cluster.isOccupied(1));
+    cluster.vacate(1);
+    assert(!site.isOccupied());
+  }
+
   cout << "Testing: siteIsInCluster" << endl;
   {
     Site site;
@@ -216,6 +243,119 @@ TEST_CASE("Testing: Cluster","[unit]"){
 
   }
 
+  cout << "Testing: getProbabilityOfOccupyingInternalSite direct solve" << endl;
+  {
+
+    // site1 -> site2  -> site3
+    //       <-        <-
+    //
+    // The rate from site1 to site2 is twice the other rates. The direct
+    // solve should agree with iterating to a tight tolerance.
+
+    Site site;
+    site.setId(1);
+    double rate = 2;
+    site.addNeighRate(pair<int, double *>(2,&rate));
+
+    Site site2;
+    site2.setId(2);
+    double rate2 = 1;
+    double rate3 = 1;
+    site2.addNeighRate(pair<int, double *>(1,&rate2));
+    site2.addNeighRate(pair<int, double *>(3,&rate3));
+
+    Site site3;
+    site3.setId(3);
+    double rate4 = 1;
+    site3.addNeighRate(pair<int, double *>(2,&rate4));
+
+    Cluster cluster;
+    cluster.setConvergenceMethod(Cluster::Method::converge_by_direct_solve);
+    cluster.addSite(site);
+    cluster.addSite(site2);
+    cluster.addSite(site3);
+    cluster.updateProbabilitiesAndTimeConstant();
+
+    Cluster cluster2;
+    cluster2.setConvergenceMethod(Cluster::Method::converge_by_tolerance);
+    cluster2.setConvergenceTolerance(1E-9);
+    cluster2.addSite(site);
+    cluster2.addSite(site2);
+    cluster2.addSite(site3);
+    cluster2.updateProbabilitiesAndTimeConstant();
+
+    double total = 0.0;
+    for(int siteId = 1; siteId <= 3; ++siteId){
+      double direct = cluster.getProbabilityOfOccupyingInternalSite(siteId);
+      double iterated = cluster2.getProbabilityOfOccupyingInternalSite(siteId);
+      assert(fabs(direct-iterated) < 1E-6);
+      total += direct;
+    }
+    assert(fabs(total-1.0) < 1E-12);
+    assert(fabs(cluster.getTimeConstant()-cluster2.getTimeConstant()) < 1E-6);
+  }
+
+  cout << "Testing: getProbabilityOfOccupyingInternalSite direct solve leaky basin" << endl;
+  {
+
+    // site4 <- site1 -> site2  -> site3 -> site5
+    //                <-        <-
+    //
+    // Sites 4 and 5 are not in the cluster and site1 loses a lot more
+    // probability to them than site3, the direct solve has to include those
+    // losses to agree with iterating to a tight tolerance.
+
+    Site site;
+    site.setId(1);
+    double rate = 2;
+    double rate_out = 5;
+    site.addNeighRate(pair<int, double *>(2,&rate));
+    site.addNeighRate(pair<int, double *>(4,&rate_out));
+
+    Site site2;
+    site2.setId(2);
+    double rate2 = 1;
+    double rate3 = 1;
+    site2.addNeighRate(pair<int, double *>(1,&rate2));
+    site2.addNeighRate(pair<int, double *>(3,&rate3));
+
+    Site site3;
+    site3.setId(3);
+    double rate4 = 1;
+    double rate_out2 = 0.5;
+    site3.addNeighRate(pair<int, double *>(2,&rate4));
+    site3.addNeighRate(pair<int, double *>(5,&rate_out2));
+
+    Cluster cluster;
+    cluster.setConvergenceMethod(Cluster::Method::converge_by_direct_solve);
+    cluster.addSite(site);
+    cluster.addSite(site2);
+    cluster.addSite(site3);
+    cluster.updateProbabilitiesAndTimeConstant();
+
+    Cluster cluster2;
+    cluster2.setConvergenceMethod(Cluster::Method::converge_by_tolerance);
+    cluster2.setConvergenceTolerance(1E-12);
+    cluster2.addSite(site);
+    cluster2.addSite(site2);
+    cluster2.addSite(site3);
+    cluster2.updateProbabilitiesAndTimeConstant();
+
+    double total = 0.0;
+    for(int siteId = 1; siteId <= 3; ++siteId){
+      double direct = cluster.getProbabilityOfOccupyingInternalSite(siteId);
+      double iterated = cluster2.getProbabilityOfOccupyingInternalSite(siteId);
+      assert(fabs(direct-iterated) < 1E-8);
+      total += direct;
+    }
+    assert(fabs(total-1.0) < 1E-12);
+    assert(fabs(cluster.getTimeConstant()-cluster2.getTimeConstant()) < 1E-8);
+    for(int neighId = 4; neighId <= 5; ++neighId){
+      assert(fabs(cluster.getProbabilityOfHoppingToNeighborOfCluster(neighId)-
+            cluster2.getProbabilityOfHoppingToNeighborOfCluster(neighId)) < 1E-8);
+    }
+  }
+
   cout << "Testing: get probability of hopping to a neighbor" << endl;
   {
 
@@ -293,6 +433,100 @@ TEST_CASE("Testing: Cluster","[unit]"){
 
   }
 
+  cout << "Testing: setExitDirectly" << endl;
+  {
+    // neigh4 <- site1 <-> site2 <-> site3 -> neigh5
+    double rate_fast = 10.0;
+    double rate_slow = 0.1;
+    Site site;
+    site.setId(1);
+    site.addNeighRate(pair<int, double *>(2,&rate_fast));
+    site.addNeighRate(pair<int, double *>(4,&rate_slow));
+
+    Site site2;
+    site2.setId(2);
+    site2.addNeighRate(pair<int, double *>(1,&rate_fast));
+    site2.addNeighRate(pair<int, double *>(3,&rate_fast));
+
+    Site site3;
+    site3.setId(3);
+    site3.addNeighRate(pair<int, double *>(2,&rate_fast));
+    site3.addNeighRate(pair<int, double *>(5,&rate_slow));
+
+    Cluster cluster;
+    cluster.setConvergenceMethod(Cluster::Method::converge_by_direct_solve);
+    cluster.addSite(site);
+    cluster.addSite(site2);
+    cluster.addSite(site3);
+    cluster.updateProbabilitiesAndTimeConstant();
+    cluster.setResolution(20);
+    assert(!cluster.exitsDirectly());
+    cluster.setExitDirectly(true);
+    assert(cluster.exitsDirectly());
+
+    Random_Stream stream(1,0);
+    int walker_id = 0;
+    int total = 20000;
+    double total_time = 0.0;
+    vector<int> occupied_count(3,0);
+    for(int count = 0; count < total; ++count){
+      double dwell_time = cluster.getDwellTime(walker_id,stream);
+      assert(dwell_time>0.0);
+      total_time += dwell_time;
+      int next_site = cluster.pickNewSiteId(walker_id,stream);
+      assert(next_site==4 || next_site==5);
+      ++occupied_count.at(cluster.pickOccupiedSite(stream)-1);
+    }
+    // The mean of the exponential distribution is the time constant
+    double mean_time = total_time/static_cast<double>(total);
+    assert(fabs(mean_time-cluster.getTimeConstant()) < 0.05*cluster.getTimeConstant());
+
+    // The fraction of time spent on each site is the same for all three
+    for(int siteId = 1; siteId <= 3; ++siteId){
+      double fraction = static_cast<double>(occupied_count.at(siteId-1))/static_cast<double>(total);
+      assert(fabs(fraction-1.0/3.0) < 0.02);
+    }
+  }
+
+  cout << "Testing: mergeSites" << endl;
+  {
+    // neigh0 <- site1 <-> site2 <-> site3 <-> site4 <-> site5 -> neigh6
+    //
+    // Adding site5 to a cluster of sites 1 to 4 should give the same result
+    // as creating the cluster from all five sites
+    vector<double> forward_rates = {1.0, 2.0, 3.0, 4.0, 0.5};
+    vector<double> backward_rates = {0.25, 1.5, 2.5, 3.5, 0.75};
+    vector<Site> sites(5);
+    for(int ind = 0; ind < 5; ++ind){
+      sites.at(ind).setId(ind+1);
+      sites.at(ind).addNeighRate(pair<int, double *>(ind,&backward_rates.at(ind)));
+      sites.at(ind).addNeighRate(pair<int, double *>(ind+2,&forward_rates.at(ind)));
+    }
+
+    Cluster cluster;
+    cluster.setConvergenceMethod(Cluster::Method::converge_by_direct_solve);
+    for(int ind = 0; ind < 4; ++ind) cluster.addSite(sites.at(ind));
+    cluster.updateProbabilitiesAndTimeConstant();
+    cluster.mergeSites({&sites.at(4)});
+
+    Cluster cluster2;
+    cluster2.setConvergenceMethod(Cluster::Method::converge_by_direct_solve);
+    cluster2.addSites(sites);
+    cluster2.updateProbabilitiesAndTimeConstant();
+
+    assert(cluster.getNumberOfSitesInCluster()==5);
+    for(int siteId = 1; siteId <= 5; ++siteId){
+      assert(fabs(cluster.getProbabilityOfOccupyingInternalSite(siteId)-
+            cluster2.getProbabilityOfOccupyingInternalSite(siteId)) < 1E-12);
+    }
+    assert(fabs(cluster.getProbabilityOfHoppingToNeighborOfCluster(0)-
+          cluster2.getProbabilityOfHoppingToNeighborOfCluster(0)) < 1E-12);
+    assert(fabs(cluster.getProbabilityOfHoppingToNeighborOfCluster(6)-
+          cluster2.getProbabilityOfHoppingToNeighborOfCluster(6)) < 1E-12);
+    assert(fabs(cluster.getTimeConstant()-cluster2.getTimeConstant()) <
+        1E-12*cluster2.getTimeConstant());
+  }
+
   cout << "Testing: pickNewSiteId" << endl;
   {
     Site site;
@@ -1,7 +1,9 @@
 #include <catch2/catch.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <stdexcept>
 #include <vector>
 #include <memory>
 
@@ -270,5 +272,42 @@ TEST_CASE("Testing: CoarseGrainSystem2","[unit]"){
       assert(site11_found);
 
     } // With cluster formation
+
+    cout << "Coarse graining the traps before hopping" << endl;
+    {
+      // The same trap is found whatever the number of threads
+      for( size_t thread_count : {1, 3} ){
+        CoarseGrainSystem CGsystem;
+        CGsystem.setRandomSeed(1);
+        CGsystem.setTimeResolution(time_limit/10.0);
+        CGsystem.setMinCoarseGrainIterationThreshold(500);
+        CGsystem.initializeSystem(ratesToNeighbors);
+
+        assert(CGsystem.coarseGrainTraps(thread_count)>0);
+        unordered_map<int,vector<int>> clusters = CGsystem.getClusters();
+        assert(clusters.size()==1);
+        vector<int> cluster_site_ids = clusters.begin()->second;
+        sort(cluster_site_ids.begin(),cluster_site_ids.end());
+        assert(cluster_site_ids==vector<int>({6,7,10,11}));
+
+        // Nothing is left to coarse grain
+        assert(CGsystem.coarseGrainTraps(thread_count)==0);
+      }
+
+      CoarseGrainSystem CGsystem;
+      bool thrown = false;
+      try {
+        CGsystem.coarseGrainTraps();
+      }catch(runtime_error & e){
+        thrown = true;
+      }
+      assert(thrown);
+
+      CGsystem.setTimeResolution(time_limit/10.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(constants::inf_iterations);
+      CGsystem.initializeSystem(ratesToNeighbors);
+      assert(CGsystem.coarseGrainTraps()==0);
+      assert(CGsystem.getClusters().size()==0);
+    } // Coarse graining the traps before hopping
   }
 }
@@ -0,0 +1,287 @@
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mythical/coarsegrainsystem.hpp"
+#include "mythical/constants.hpp"
+#include "mythical/random_policy.hpp"
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: CoarseGrainSystem snapshots","[unit]") {
+
+  // A ring of sites with two pairs of strongly coupled sites which act as
+  // traps, so clusters form before the snapshot is taken
+  const int number_of_sites = 40;
+  unordered_map<int,unordered_map<int,double>> rates;
+  for(int site = 0; site < number_of_sites; ++site){
+    int next = (site+1)%number_of_sites;
+    rates[site][next] = 1.0;
+    rates[next][site] = 1.0;
+  }
+  rates[10][11] = 1000.0;
+  rates[11][10] = 1000.0;
+  rates[25][26] = 2000.0;
+  rates[26][25] = 2000.0;
+
+  const string file_name = "test_coarsegrainsystem_snapshot.bin";
+  const double time_limit = 200.0;
+
+  auto configure = [&rates](CoarseGrainSystem & system, RandomPolicy policy){
+    system.setRandomPolicy(policy);
+    system.setRandomSeed(3);
+    system.setTimeResolution(1.0);
+    system.setMinCoarseGrainIterationThreshold(20);
+    system.initializeSystem(rates);
+  };
+
+  for(const RandomPolicy policy :
+      {RandomPolicy::counter_based, RandomPolicy::mersenne_twister}){
+
+    cout << "Testing: saveSnapshot and loadSnapshot" << endl;
+    {
+      CoarseGrainSystem system;
+      configure(system,policy);
+      WalkerPool walkers;
+      walkers.addWalker(10);
+      walkers.addWalker(25);
+      walkers.addWalker(0);
+      system.initializeWalkers(walkers);
+      system.hop(walkers,time_limit);
+      assert(system.getClusters().size()>0);
+
+      system.saveSnapshot(file_name,walkers);
+      system.hop(walkers,2.0*time_limit);
+
+      CoarseGrainSystem restored;
+      WalkerPool restored_walkers;
+      restored.loadSnapshot(file_name,restored_walkers);
+      assert(restored.getTimeResolution()==system.getTimeResolution());
+      restored.hop(restored_walkers,2.0*time_limit);
+
+      // The restarted run must follow exactly the same trajectory
+      assert(restored_walkers.getIdsOfSitesCurrentlyOccupying()==
+          walkers.getIdsOfSitesCurrentlyOccupying());
+      assert(restored_walkers.getTimes()==walkers.getTimes());
+      assert(restored_walkers.getDwellTimes()==walkers.getDwellTimes());
+
+      unordered_map<int,vector<int>> clusters = system.getClusters();
+      unordered_map<int,vector<int>> restored_clusters = restored.getClusters();
+      assert(clusters.size()==restored_clusters.size());
+      for(auto & cluster : clusters){
+        assert(restored_clusters.count(cluster.first));
+        vector<int> & restored_sites = restored_clusters[cluster.first];
+        sort(cluster.second.begin(),cluster.second.end());
+        sort(restored_sites.begin(),restored_sites.end());
+        assert(cluster.second==restored_sites);
+      }
+      for(int site = 0; site < number_of_sites; ++site){
+        assert(system.getVisitFrequencyOfSite(site)==
+            restored.getVisitFrequencyOfSite(site));
+        assert(system.isSiteOccupied(site)==restored.isSiteOccupied(site));
+      }
+
+      // Without a pool only the system is restored
+      CoarseGrainSystem system_only;
+      system_only.loadSnapshot(file_name);
+      assert(system_only.getClusterIdOfSite(10)==
+          restored.getClusterIdOfSite(10));
+    }
+  }
+
+  cout << "Testing: loadSnapshot errors" << endl;
+  {
+    CoarseGrainSystem system;
+    configure(system,RandomPolicy::counter_based);
+    system.saveSnapshot(file_name);
+
+    // The system has already been initialized
+    bool thrown = false;
+    try {
+      system.loadSnapshot(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // The snapshot does not contain a pool
+    CoarseGrainSystem system2;
+    WalkerPool walkers;
+    thrown = false;
+    try {
+      system2.loadSnapshot(file_name,walkers);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+    // The system is left uninitialized so it can be used again
+    system2.loadSnapshot(file_name);
+
+    // Truncated file
+    string contents;
+    {
+      ifstream file(file_name,ios::binary);
+      contents.assign(istreambuf_iterator<char>(file),istreambuf_iterator<char>());
+    }
+    {
+      ofstream file(file_name,ios::binary|ios::trunc);
+      file.write(contents.data(),static_cast<streamsize>(contents.size()/2));
+    }
+    CoarseGrainSystem system3;
+    thrown = false;
+    try {
+      system3.loadSnapshot(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Not a snapshot
+    {
+      ofstream file(file_name,ios::binary|ios::trunc);
+      file << "NOTASNAPSHOT0123456789";
+    }
+    thrown = false;
+    try {
+      system3.loadSnapshot(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+    remove(file_name.c_str());
+  }
+}
+
+TEST_CASE("Testing: CoarseGrainSystem cluster cache","[unit]") {
+
+  const int number_of_sites = 40;
+  unordered_map<int,unordered_map<int,double>> rates;
+  for(int site = 0; site < number_of_sites; ++site){
+    int next = (site+1)%number_of_sites;
+    rates[site][next] = 1.0;
+    rates[next][site] = 1.0;
+  }
+  rates[10][11] = 1000.0;
+  rates[11][10] = 1000.0;
+  rates[25][26] = 2000.0;
+  rates[26][25] = 2000.0;
+
+  const string file_name = "test_coarsegrainsystem_cluster_cache.bin";
+
+  auto configure = [&rates](CoarseGrainSystem & system, unsigned long seed){
+    system.setRandomSeed(seed);
+    system.setTimeResolution(1.0);
+    system.setMinCoarseGrainIterationThreshold(20);
+    system.initializeSystem(rates);
+  };
+
+  CoarseGrainSystem system;
+  configure(system,3);
+  {
+    WalkerPool walkers;
+    walkers.addWalker(10);
+    walkers.addWalker(25);
+    system.initializeWalkers(walkers);
+    system.hop(walkers,200.0);
+  }
+  unordered_map<int,vector<int>> clusters = system.getClusters();
+  assert(clusters.size()>0);
+  system.exportClusters(file_name);
+
+  cout << "Testing: getClusterCacheKey" << endl;
+  {
+    CoarseGrainSystem other_seed;
+    configure(other_seed,7);
+    assert(other_seed.getClusterCacheKey()==system.getClusterCacheKey());
+
+    CoarseGrainSystem other_resolution;
+    other_resolution.setTimeResolution(2.0);
+    other_resolution.initializeSystem(rates);
+    assert(other_resolution.getClusterCacheKey()!=system.getClusterCacheKey());
+
+    unordered_map<int,unordered_map<int,double>> other_rates = rates;
+    other_rates[0][1] = 1.5;
+    CoarseGrainSystem other_graph;
+    other_graph.setTimeResolution(1.0);
+    other_graph.initializeSystem(other_rates);
+    assert(other_graph.getClusterCacheKey()!=system.getClusterCacheKey());
+
+    bool thrown = false;
+    try {
+      other_graph.importClusters(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+    assert(other_graph.getClusters().size()==0);
+  }
+
+  cout << "Testing: exportClusters and importClusters" << endl;
+  {
+    CoarseGrainSystem cached;
+    configure(cached,7);
+    cached.importClusters(file_name);
+
+    unordered_map<int,vector<int>> cached_clusters = cached.getClusters();
+    assert(cached_clusters.size()==clusters.size());
+    for(auto & cluster : clusters){
+      vector<int> & cached_sites = cached_clusters.at(cluster.first);
+      sort(cluster.second.begin(),cluster.second.end());
+      sort(cached_sites.begin(),cached_sites.end());
+      assert(cluster.second==cached_sites);
+      for(const int & site : cached_sites){
+        assert(cached.getClusterIdOfSite(site)==cluster.first);
+        // The visits of the first run are not carried over
+        assert(cached.getVisitFrequencyOfSite(site)==0);
+      }
+    }
+    assert(cached.getTimeIncrementOfClusters()==
+        system.getTimeIncrementOfClusters());
+
+    // Clusters can only be imported once
+    bool thrown = false;
+    try {
+      cached.importClusters(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // The walkers start on the pre-built clusters
+    WalkerPool walkers;
+    walkers.addWalker(10);
+    walkers.addWalker(25);
+    cached.initializeWalkers(walkers);
+    cached.hop(walkers,200.0);
+    assert(walkers.getTime(0)>0.0 && walkers.getTime(1)>0.0);
+  }
+
+  cout << "Testing: importClusters with excluded sites" << endl;
+  {
+    CoarseGrainSystem excluded;
+    configure(excluded,7);
+    excluded.excludeSitesFromClusters({10});
+    bool thrown = false;
+    try {
+      excluded.importClusters(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+    // Nothing is left behind by the failed import
+    assert(excluded.getClusters().size()==0);
+    assert(excluded.getClusterIdOfSite(25)==constants::unassignedId);
+  }
+  remove(file_name.c_str());
+}
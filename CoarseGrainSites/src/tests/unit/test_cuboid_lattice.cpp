@@ -1,8 +1,11 @@
 
 #include <catch2/catch.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "mythical/charge_transport/cuboid_lattice.hpp"
 
@@ -147,3 +150,76 @@ TEST_CASE("Testing: Cuboid lattice neighbors and distances","[unit]") {
     }
   }
 }
+
+TEST_CASE("Testing: Cuboid lattice neighbor distances as CSR arrays","[unit]") {
+
+  GIVEN("A lattice of size 6, 5, 7, periodic in x and z") {
+    Cuboid lattice(6,5,7, 1.0, BoundarySetting::Periodic,
+        BoundarySetting::Fixed, BoundarySetting::Periodic);
+    std::vector<size_t> row_offsets;
+    std::vector<int> neighbor_ids;
+    std::vector<double> distances;
+    lattice.getNeighborDistances(2.0, row_offsets, neighbor_ids, distances, 3);
+    THEN("each row matches the neighbors of the site") {
+      REQUIRE( row_offsets.size() == 6*5*7+1 );
+      CHECK( row_offsets.back() == neighbor_ids.size() );
+      CHECK( distances.size() == neighbor_ids.size() );
+      for ( int index = 0; index < 6*5*7; ++index ) {
+        std::vector<std::pair<int,double>> expected = lattice.getNeighborDistances(index, 2.0);
+        std::vector<std::pair<int,double>> row;
+        for ( size_t ind = row_offsets[index]; ind < row_offsets[index+1]; ++ind ) {
+          row.emplace_back(neighbor_ids[ind], distances[ind]);
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(row.begin(), row.end());
+        CHECK( row == expected );
+      }
+    }
+    THEN("the arrays do not depend on the number of threads") {
+      std::vector<size_t> row_offsets2;
+      std::vector<int> neighbor_ids2;
+      std::vector<double> distances2;
+      lattice.getNeighborDistances(2.0, row_offsets2, neighbor_ids2, distances2, 1);
+      CHECK( row_offsets2 == row_offsets );
+      CHECK( neighbor_ids2 == neighbor_ids );
+      CHECK( distances2 == distances );
+    }
+    THEN("the rows of each plane match the rows of the whole lattice") {
+      std::vector<size_t> counts;
+      std::vector<int> plane_ids;
+      std::vector<double> plane_distances;
+      for ( int z = 0; z < 7; ++z ) {
+        lattice.getPlaneNeighborDistances(z, 2.0, counts, plane_ids, plane_distances);
+        REQUIRE( counts.size() == 6*5 );
+        const size_t first = row_offsets[static_cast<size_t>(z*6*5)];
+        const size_t last = row_offsets[static_cast<size_t>((z+1)*6*5)];
+        CHECK( plane_ids == std::vector<int>(neighbor_ids.begin()+first, neighbor_ids.begin()+last) );
+        CHECK( plane_distances == std::vector<double>(distances.begin()+first, distances.begin()+last) );
+        for ( size_t site = 0; site < counts.size(); ++site ) {
+          const size_t index = static_cast<size_t>(z*6*5) + site;
+          CHECK( counts[site] == row_offsets[index+1] - row_offsets[index] );
+        }
+      }
+      CHECK_THROWS( lattice.getPlaneNeighborDistances(7, 2.0, counts, plane_ids, plane_distances) );
+    }
+  }
+
+  GIVEN("A periodic lattice of size 2, 2, 2") {
+    Cuboid lattice(2,2,2, 1.0, BoundarySetting::Periodic,
+        BoundarySetting::Periodic, BoundarySetting::Periodic);
+    THEN("periodic images of the same neighbor are only listed once") {
+      std::vector<size_t> row_offsets;
+      std::vector<int> neighbor_ids;
+      std::vector<double> distances;
+      lattice.getNeighborDistances(1.5, row_offsets, neighbor_ids, distances);
+      for ( size_t index = 0; index < 8; ++index ) {
+        // Three neighbors along the axes and three along the face diagonals
+        CHECK( row_offsets[index+1] - row_offsets[index] == 6 );
+      }
+      for ( size_t ind = 0; ind < 6; ++ind ) {
+        CHECK( neighbor_ids[ind] != 0 );
+      }
+      CHECK( distances[0] == Approx(1.0) );
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../libmythical/discrete_sampler.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: Discrete Sampler","[unit]"){
+
+  cout << "Testing: Constructor" << endl;
+  {
+    Discrete_Sampler sampler;
+    assert(sampler.size()==0);
+  }
+
+  cout << "Testing: build" << endl;
+  {
+    Discrete_Sampler sampler;
+    vector<double> weights = { 1.0, 3.0 };
+    sampler.build(weights);
+    assert(sampler.size()==2);
+    assert(sampler.usesAliasTable()==false);
+
+    vector<double> many_weights(Discrete_Sampler::alias_threshold,1.0);
+    sampler.build(many_weights);
+    assert(sampler.usesAliasTable());
+
+    sampler.setMethod(Discrete_Sampler::cumulative);
+    sampler.build(many_weights);
+    assert(sampler.usesAliasTable()==false);
+
+    vector<double> bad_weights = { 1.0, -3.0 };
+    bool throw_error = false;
+    try {
+      sampler.build(bad_weights);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: sample cumulative" << endl;
+  {
+    Discrete_Sampler sampler;
+    sampler.setMethod(Discrete_Sampler::cumulative);
+    vector<pair<int,double>> ids_and_weights = { {4, 0.25}, {7, 0.75} };
+    sampler.build(ids_and_weights);
+    assert(sampler.sample(0.0)==0);
+    assert(sampler.sample(0.2)==0);
+    assert(sampler.sample(0.3)==1);
+    assert(sampler.sample(1.0)==1);
+  }
+
+  cout << "Testing: sample alias and cumulative distributions" << endl;
+  {
+    vector<double> weights;
+    for(int index = 0; index < 40; ++index){
+      weights.push_back(static_cast<double>((index*7)%11));
+    }
+    double total = 0.0;
+    for( double weight : weights ) total += weight;
+
+    for( int method = 1; method < 3; ++method){
+      Discrete_Sampler sampler;
+      sampler.setMethod(static_cast<Discrete_Sampler::Method>(method));
+      sampler.build(weights);
+
+      mt19937 random_number_generator;
+      random_number_generator.seed(1);
+      uniform_real_distribution<double> distribution(0.0,1.0);
+      vector<double> counts(weights.size(),0.0);
+      int samples = 400000;
+      for(int i = 0; i < samples; ++i){
+        size_t index = sampler.sample(distribution(random_number_generator));
+        assert(index<weights.size());
+        counts.at(index) += 1.0;
+      }
+      assert(sampler.sample(1.0)<weights.size());
+      for(size_t index = 0; index < weights.size(); ++index){
+        double expected = weights.at(index)/total;
+        double found = counts.at(index)/static_cast<double>(samples);
+        if(weights.at(index)==0.0){
+          assert(counts.at(index)==0.0);
+        }else{
+          assert(fabs(found-expected)<0.005);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,192 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "mythical/charge_transport/cuboid_lattice.hpp"
+#include "mythical/coarsegrainsystem.hpp"
+#include "mythical/domain_decomposed_system.hpp"
+
+using namespace std;
+using namespace mythical;
+using namespace mythical::charge_transport;
+
+TEST_CASE("Testing: domain decomposed system","[unit]") {
+
+  // Periodic along x so the first and last domains are neighbors
+  Cuboid lattice(12,3,3,1.0,
+      BoundarySetting::Periodic,
+      BoundarySetting::Fixed,
+      BoundarySetting::Fixed);
+
+  unordered_map<int,unordered_map<int,double>> rates;
+  auto distances = lattice.getNeighborDistances(1.01);
+  for(const auto & site_and_neighbors : distances){
+    for(const auto & neighbor : site_and_neighbors.second){
+      rates[site_and_neighbors.first][neighbor.first] = 1.0;
+    }
+  }
+  // A trap inside the second domain and one across the first boundary
+  const int trap1 = lattice.getIndex(5,1,1);
+  const int trap2 = lattice.getIndex(6,1,1);
+  const int boundary_trap1 = lattice.getIndex(3,1,1);
+  const int boundary_trap2 = lattice.getIndex(4,1,1);
+  rates[trap1][trap2] = 1000.0;
+  rates[trap2][trap1] = 1000.0;
+  rates[boundary_trap1][boundary_trap2] = 1000.0;
+  rates[boundary_trap2][boundary_trap1] = 1000.0;
+
+  auto configure = [](const size_t domain, CoarseGrainSystem & system){
+    system.setTimeResolution(0.1);
+    system.setMinCoarseGrainIterationThreshold(100);
+    system.setRandomSeed(static_cast<unsigned long>(10+domain));
+  };
+
+  cout << "Testing: DomainDecomposedSystem constructor" << endl;
+  {
+    DomainDecomposedSystem system(3,2);
+    assert(system.size()==3);
+    assert(system.getNumberOfThreads()==2);
+
+    bool thrown = false;
+    try {
+      DomainDecomposedSystem system2(0);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+      system.getDomain(3);
+    }catch(out_of_range & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+      system.setTimeWindow(0.0);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: DomainDecomposedSystem initializeSystem" << endl;
+  {
+    DomainDecomposedSystem system(3,2);
+    system.initializeSystem(lattice,rates,configure);
+    assert(system.getDomainOfSite(lattice.getIndex(0,0,0))==0);
+    assert(system.getDomainOfSite(lattice.getIndex(3,2,2))==0);
+    assert(system.getDomainOfSite(lattice.getIndex(4,0,0))==1);
+    assert(system.getDomainOfSite(lattice.getIndex(11,0,0))==2);
+
+    // The ghost sites of the first domain are on either side of it
+    set<int> ghost_sites(
+        system.getGhostSites(0).begin(),
+        system.getGhostSites(0).end());
+    assert(ghost_sites.size()==18);
+    assert(ghost_sites.count(lattice.getIndex(4,1,1)));
+    assert(ghost_sites.count(lattice.getIndex(11,1,1)));
+    assert(ghost_sites.count(lattice.getIndex(5,1,1))==0);
+
+    // The domains are too thin for the longest hop
+    DomainDecomposedSystem system2(7);
+    bool thrown = false;
+    try {
+      system2.initializeSystem(lattice,rates,configure);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Walkers cannot be added before the system is initialized
+    thrown = false;
+    try {
+      system2.addWalker(0);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Or hop before the time window is set
+    thrown = false;
+    try {
+      system.hop(1.0);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: DomainDecomposedSystem hop" << endl;
+  {
+    const size_t walker_count = 20;
+    const double time_horizon = 50.0;
+    vector<vector<int>> final_sites;
+    vector<vector<double>> final_times;
+    for(size_t thread_count = 1; thread_count < 4; thread_count+=2){
+      DomainDecomposedSystem system(3,thread_count);
+      system.setTimeWindow(0.5);
+      system.initializeSystem(lattice,rates,configure);
+      for(size_t walker = 0; walker < walker_count; ++walker){
+        int walker_id = system.addWalker(static_cast<int>(walker*5));
+        assert(walker_id==static_cast<int>(walker));
+      }
+      assert(system.getNumberOfWalkers()==walker_count);
+
+      // A walker cannot be placed on an occupied site
+      bool thrown = false;
+      try {
+        system.addWalker(0);
+      }catch(invalid_argument & e){
+        thrown = true;
+      }
+      assert(thrown);
+
+      size_t hop_count = system.hop(time_horizon);
+      assert(hop_count>0);
+      assert(system.getCurrentTime()==time_horizon);
+      assert(system.getNumberOfMigrations()>0);
+
+      vector<int> sites;
+      vector<double> times;
+      set<int> occupied_sites;
+      for(size_t walker = 0; walker < walker_count; ++walker){
+        const int walker_id = static_cast<int>(walker);
+        const int siteId = system.getIdOfSiteCurrentlyOccupying(walker_id);
+        // Each walker is simulated by the domain owning its site
+        assert(system.getDomainOfSite(siteId)==system.getDomainOfWalker(walker_id));
+        assert(system.getDomain(system.getDomainOfWalker(walker_id)).isSiteOccupied(siteId));
+        occupied_sites.insert(siteId);
+        sites.push_back(siteId);
+        times.push_back(system.getTime(walker_id));
+      }
+      // No two walkers share a site
+      assert(occupied_sites.size()==walker_count);
+
+      // Clusters only contain the sites of a single domain
+      bool trap_clustered = false;
+      for(size_t domain = 0; domain < system.size(); ++domain){
+        for(const auto & cluster : system.getDomain(domain).getClusters()){
+          for(const int & siteId : cluster.second){
+            assert(system.getDomainOfSite(siteId)==domain);
+            if(siteId==trap1) trap_clustered = true;
+          }
+        }
+      }
+      assert(trap_clustered);
+
+      final_sites.push_back(sites);
+      final_times.push_back(times);
+    }
+    // The results do not depend on the number of threads
+    assert(final_sites.at(0)==final_sites.at(1));
+    assert(final_times.at(0)==final_times.at(1));
+  }
+}
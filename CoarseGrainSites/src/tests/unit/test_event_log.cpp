@@ -0,0 +1,234 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mythical/coarsegrainsystem.hpp"
+#include "mythical/constants.hpp"
+#include "mythical/event_log.hpp"
+#include "mythical/indexed_queue.hpp"
+#include "mythical/walker.hpp"
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+using namespace mythical;
+
+namespace {
+  vector<HopEvent> readEvents(const string & file_name) {
+    EventLogReader reader(file_name);
+    vector<HopEvent> events;
+    HopEvent event;
+    while(reader.read(event)) events.push_back(event);
+    return events;
+  }
+
+  bool sameEvent(const HopEvent & event1, const HopEvent & event2) {
+    return event1.walker_id==event2.walker_id &&
+      event1.from_site_id==event2.from_site_id &&
+      event1.to_site_id==event2.to_site_id &&
+      event1.time==event2.time &&
+      event1.in_cluster==event2.in_cluster;
+  }
+}
+
+TEST_CASE("Testing: event log","[unit]") {
+
+  const string file_name = "test_event_log.bin";
+
+  cout << "Testing: EventLog and EventLogReader" << endl;
+  {
+    // The buffers are small so the threads have to wait for the writer
+    const int thread_count = 3;
+    const int event_count = 2000;
+    vector<vector<HopEvent>> recorded(thread_count);
+    {
+      EventLog log(file_name,4);
+      vector<thread> threads;
+      for(int thread_index = 0; thread_index < thread_count; ++thread_index){
+        threads.emplace_back([&log,&recorded,thread_index,event_count](){
+          for(int index = 0; index < event_count; ++index){
+            HopEvent event;
+            event.walker_id = thread_index*1000000 + index%7;
+            event.from_site_id = index%2==0 ? -index : index*1000;
+            event.to_site_id = event.from_site_id + (index%3) - 1;
+            event.time = index%5==0 ? -1.5E-3*index : 2.5E-9*index;
+            event.in_cluster = index%4==0;
+            log.record(event);
+            recorded.at(thread_index).push_back(event);
+          }
+        });
+      }
+      for(thread & recording_thread : threads) recording_thread.join();
+      log.close();
+
+      bool thrown = false;
+      try {
+        log.record(recorded.at(0).at(0));
+      }catch(runtime_error & e){
+        thrown = true;
+      }
+      assert(thrown);
+    }
+
+    // The events of each thread are in the order they were recorded
+    vector<HopEvent> events = readEvents(file_name);
+    assert(events.size()==thread_count*event_count);
+    vector<size_t> next(thread_count,0);
+    for(const HopEvent & event : events){
+      const int thread_index = event.walker_id/1000000;
+      assert(sameEvent(event,recorded.at(thread_index).at(next.at(thread_index))));
+      ++next.at(thread_index);
+    }
+
+    // An empty log
+    {
+      EventLog log(file_name);
+    }
+    assert(readEvents(file_name).empty());
+
+    // Not an event log
+    {
+      ofstream file(file_name,ios::binary|ios::trunc);
+      file << "MYTHRATE0123456789abcdef";
+    }
+    bool thrown = false;
+    try {
+      EventLogReader reader(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+#ifdef __linux__
+    // The file is no longer mapped once the reader has thrown
+    {
+      ifstream maps("/proc/self/maps");
+      string line;
+      while(getline(maps,line)){
+        assert(line.find(file_name)==string::npos);
+      }
+    }
+#endif
+
+    thrown = false;
+    try {
+      EventLog log(file_name,0);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: CoarseGrainSystem setEventLog" << endl;
+  {
+    vector<size_t> row_offsets = { 0, 2, 4, 6, 8, 10, 12 };
+    vector<int> neighbor_ids = { 1, 2, 0, 2, 0, 1, 4, 5, 3, 5, 3, 4 };
+    vector<double> rates = { 1.0, 2.0, 3.0, 1.0, 1.0, 5.0,
+                             2.0, 1.0, 4.0, 1.0, 1.0, 3.0 };
+
+    class Electron : public Walker {};
+    // Walkers hopped one at a time are given the sum of their dwell times,
+    // the same times as the event queue of the batched hop
+    vector<vector<HopEvent>> logged(2);
+    const double time_horizon = 5.0;
+    for( int system = 0; system < 2; ++system){
+      CoarseGrainSystem CGsystem;
+      CGsystem.setTimeResolution(10.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(constants::inf_iterations);
+      CGsystem.setRandomSeed(3);
+      CGsystem.initializeSystem(row_offsets,neighbor_ids,rates);
+      shared_ptr<EventLog> log(new EventLog(file_name));
+      CGsystem.setEventLog(log);
+
+      vector<pair<int,shared_ptr<Walker>>> electrons;
+      electrons.emplace_back(7,shared_ptr<Walker>( new Electron));
+      electrons.emplace_back(2,shared_ptr<Walker>( new Electron));
+      electrons.at(0).second->occupySite(0);
+      electrons.at(1).second->occupySite(4);
+      CGsystem.initializeWalkers(electrons);
+
+      IndexedQueue event_queue;
+      for( auto & electron : electrons ){
+        event_queue.add(pair<int,double>(electron.first,electron.second->getDwellTime()));
+      }
+
+      size_t hop_count = 0;
+      if(system==0){
+        while(event_queue.at(0).second < time_horizon){
+          pair<int,double> walker_time = event_queue.at(0);
+          auto & electron = electrons.at(walker_time.first==7 ? 0 : 1);
+          CGsystem.hop(electron);
+          walker_time.second += electron.second->getDwellTime();
+          event_queue.reschedule(walker_time.first,walker_time.second);
+          ++hop_count;
+        }
+      }else{
+        hop_count = CGsystem.hop(electrons,event_queue,time_horizon);
+      }
+      // Hops are no longer recorded
+      CGsystem.setEventLog(nullptr);
+      CGsystem.hop(electrons.at(0));
+      log->close();
+
+      logged.at(system) = readEvents(file_name);
+      assert(hop_count > 0);
+      assert(logged.at(system).size()==hop_count);
+      for( size_t index = 1; index < hop_count; ++index){
+        assert(logged.at(system).at(index-1).time <=
+            logged.at(system).at(index).time);
+        assert(logged.at(system).at(index).time < time_horizon);
+      }
+    }
+    for( size_t index = 0; index < logged.at(0).size(); ++index){
+      assert(sameEvent(logged.at(0).at(index),logged.at(1).at(index)));
+    }
+
+    // A walker of a pool follows the sites it is recorded hopping between,
+    // sites 1 and 2 form a trap
+    CoarseGrainSystem CGsystem;
+    CGsystem.setTimeResolution(1.0E9);
+    CGsystem.setMinCoarseGrainIterationThreshold(10);
+    CGsystem.setRandomSeed(5);
+    CGsystem.initializeSystem(
+        vector<size_t>{ 0, 1, 3, 5, 6 },
+        vector<int>{ 1, 0, 2, 1, 3, 2 },
+        vector<double>{ 1.0, 1.0, 100.0, 100.0, 1.0, 1.0 });
+    shared_ptr<EventLog> log(new EventLog(file_name));
+    CGsystem.setEventLog(log);
+
+    WalkerPool walkers;
+    walkers.addWalker(1);
+    CGsystem.initializeWalkers(walkers);
+    vector<int> sites = { 1 };
+    vector<double> times;
+    for( int hop = 0; hop < 500; ++hop){
+      times.push_back(walkers.getTime(0));
+      CGsystem.hop(walkers,0);
+      sites.push_back(walkers.getIdOfSiteCurrentlyOccupying(0));
+    }
+    log->close();
+
+    vector<HopEvent> events = readEvents(file_name);
+    assert(events.size()==500);
+    bool in_cluster = false;
+    for( size_t index = 0; index < events.size(); ++index){
+      assert(events.at(index).walker_id==0);
+      assert(events.at(index).from_site_id==sites.at(index));
+      assert(events.at(index).to_site_id==sites.at(index+1));
+      assert(events.at(index).time==times.at(index));
+      if(events.at(index).in_cluster){
+        in_cluster = true;
+        assert(CGsystem.getClusterIdOfSite(events.at(index).from_site_id)!=
+            constants::unassignedId);
+      }
+    }
+    assert(in_cluster);
+  }
+  remove(file_name.c_str());
+}
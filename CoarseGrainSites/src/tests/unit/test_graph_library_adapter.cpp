@@ -100,4 +100,44 @@ TEST_CASE("Testing: graph library adapter","[unit]"){
       assert(found_edge2_3);
     }
   }
+
+  cout << "Testing: viewSitesOutgoingRates" << endl;
+  {
+    Site site1;
+    Site site2;
+
+    site1.setId(1);
+    site2.setId(2);
+
+    unordered_map<int, double> neigh_rates_site1;
+    neigh_rates_site1[2] = 1.0;
+    site1.setRatesToNeighbors(neigh_rates_site1);
+
+    unordered_map<int, double> neigh_rates_site2;
+    neigh_rates_site2[1] = 3.0;
+    site2.setRatesToNeighbors(neigh_rates_site2);
+
+    Site_Container site_container;
+    site_container.addSite(site1);
+    site_container.addSite(site2);
+
+    // Site 5 is not stored in the container and should be skipped
+    auto site_rates = viewSitesOutgoingRates(site_container,{2,5});
+    assert(site_rates.size()==1);
+    assert(site_rates.at(0).first==2);
+    assert(site_rates.at(0).second.size()==1);
+    assert(site_rates.at(0).second.neighborId(0)==1);
+    assert(site_rates.at(0).second.rate(0)==3.0);
+
+    // The view points at the rates stored in the container, nothing is copied
+    assert(site_rates.at(0).second.rates==
+        site_container.getSite(2).getRateView().rates);
+
+    auto edges = convertSitesOutgoingRatesToTimeSharedWeightedEdges<vector<shared_ptr<Edge>>>(
+        site_container,{1,2});
+    assert(edges.size()==2);
+    for(auto& edge : edges ){
+      if(edge->getVertex1()==2) assert(edge->getWeight()==1.0/3.0);
+    }
+  }
 }
@@ -0,0 +1,161 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "mythical/indexed_queue.hpp"
+#include "mythical/queue.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: IndexedQueue","[unit]"){
+
+  cout << "Testing: IndexedQueue constructor" << endl;
+  { IndexedQueue kmc_queue; }
+
+  cout << "Testing: IndexedQueue size" << endl;
+  {
+    IndexedQueue kmc_queue;
+    assert(kmc_queue.size()==0);
+    assert(kmc_queue.empty());
+    assert(kmc_queue.isSorted() );
+  }
+
+  cout << "Testing: IndexedQueue sortedAdd" << endl;
+  {
+    pair<int,double> pr1{ 1, 23.1};
+    pair<int,double> pr2{ 3, 10.3};
+    pair<int,double> pr3{ 2, 0.13};
+
+    IndexedQueue kmc_queue;
+    kmc_queue.sortedAdd(pr1);
+    assert(kmc_queue.size()==1);
+    kmc_queue.sortedAdd(pr2);
+    assert(kmc_queue.size()==2);
+    kmc_queue.add(pr3);
+    assert(kmc_queue.size()==3);
+    assert(kmc_queue.isSorted());
+
+    assert(kmc_queue.at(0).first == 2 );
+    assert(kmc_queue.at(1).first == 3 );
+    assert(kmc_queue.at(2).first == 1 );
+    assert(kmc_queue.contains(3));
+    assert(kmc_queue.contains(4)==false);
+    assert(kmc_queue.getTime(3)==10.3);
+
+    // The same walker cannot be added twice
+    bool throw_error = false;
+    try {
+      kmc_queue.sortedAdd(pr1);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: IndexedQueue pop_current" << endl;
+  {
+    pair<int,double> pr1{ 1, 23.1};
+    pair<int,double> pr2{ 3, 10.3};
+    pair<int,double> pr3{ 2, 0.13};
+
+    IndexedQueue kmc_queue;
+    kmc_queue.sortedAdd(pr1);
+    kmc_queue.sortedAdd(pr2);
+    kmc_queue.sortedAdd(pr3);
+
+    auto pr = kmc_queue.pop_current();
+    assert(pr==pr3);
+    assert(kmc_queue.at(0).first == 3 );
+    assert(kmc_queue.at(1).first == 1 );
+    pr = kmc_queue.pop_current();
+    assert(pr==pr2);
+    assert(kmc_queue.at(0).first == 1 );
+    pr = kmc_queue.pop_current();
+    assert(pr==pr1);
+    assert(kmc_queue.size()==0);
+
+    bool throw_error = false;
+    try {
+      kmc_queue.pop_current();
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: IndexedQueue reschedule" << endl;
+  {
+    IndexedQueue kmc_queue;
+    kmc_queue.sortedAdd(pair<int,double>(1,23.1));
+    kmc_queue.sortedAdd(pair<int,double>(3,10.3));
+    kmc_queue.sortedAdd(pair<int,double>(2,0.13));
+
+    // Decrease key
+    kmc_queue.reschedule(1,0.01);
+    assert(kmc_queue.at(0).first == 1 );
+    assert(kmc_queue.at(1).first == 2 );
+    assert(kmc_queue.at(2).first == 3 );
+
+    // Increase key
+    kmc_queue.reschedule(1,50.0);
+    assert(kmc_queue.at(0).first == 2 );
+    assert(kmc_queue.at(2).first == 1 );
+    assert(kmc_queue.getTime(1)==50.0);
+
+    kmc_queue.remove(3);
+    assert(kmc_queue.size()==2);
+    assert(kmc_queue.contains(3)==false);
+    assert(kmc_queue.at(1).first == 1 );
+
+    bool throw_error = false;
+    try {
+      kmc_queue.reschedule(3,1.0);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+
+    // Ids do not need to be consecutive but may not be negative
+    assert(kmc_queue.contains(40)==false);
+    assert(kmc_queue.contains(-1)==false);
+    kmc_queue.sortedAdd(pair<int,double>(40,0.0));
+    assert(kmc_queue.contains(40));
+    assert(kmc_queue.at(0).first == 40 );
+    assert(kmc_queue.pop_current().first == 40 );
+    assert(kmc_queue.contains(40)==false);
+
+    throw_error = false;
+    try {
+      kmc_queue.sortedAdd(pair<int,double>(-1,1.0));
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: IndexedQueue matches Queue ordering" << endl;
+  {
+    // Walkers with the same time should leave in the order they were added
+    Queue kmc_queue;
+    IndexedQueue kmc_indexed_queue;
+    mt19937 random_number_generator;
+    random_number_generator.seed(2);
+    uniform_int_distribution<int> distribution(0,20);
+    for(int walker_id = 0; walker_id < 200; ++walker_id){
+      pair<int,double> walker(walker_id,
+          static_cast<double>(distribution(random_number_generator)));
+      kmc_queue.sortedAdd(walker);
+      kmc_indexed_queue.sortedAdd(walker);
+    }
+    while(kmc_queue.size()!=0){
+      pair<int,double> walker = kmc_queue.pop_current();
+      assert(walker == kmc_indexed_queue.pop_current());
+    }
+    assert(kmc_indexed_queue.size()==0);
+  }
+}
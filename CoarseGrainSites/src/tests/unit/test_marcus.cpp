@@ -0,0 +1,130 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "mythical/charge_transport/marcus.hpp"
+#include "mythical/constants.hpp"
+
+using namespace std;
+using namespace mythical;
+using namespace mythical::charge_transport;
+
+// Number of representable doubles between two non negative values
+static int64_t ulpDistance(const double value1, const double value2){
+  int64_t bits1;
+  int64_t bits2;
+  memcpy(&bits1,&value1,sizeof(bits1));
+  memcpy(&bits2,&value2,sizeof(bits2));
+  return bits1 > bits2 ? bits1-bits2 : bits2-bits1;
+}
+
+TEST_CASE("Testing: Marcus batch rates","[unit]") {
+
+  // The batch rates are allowed to differ from getRate by 2 ulp
+  const int64_t ulp_tolerance = 2;
+
+  cout << "Testing: Marcus getRates" << endl;
+  {
+    Marcus marcus(0.2,300.0);
+    mt19937 random_engine(7);
+    normal_distribution<double> energy(0.0,0.1);
+    uniform_real_distribution<double> coupling(0.0,0.05);
+
+    const size_t count = 10000;
+    vector<double> E_i(count);
+    vector<double> E_j(count);
+    vector<double> H_AB(count);
+    for( size_t ind = 0; ind < count; ++ind){
+      E_i[ind] = energy(random_engine);
+      E_j[ind] = energy(random_engine);
+      H_AB[ind] = coupling(random_engine);
+    }
+
+    vector<double> rates;
+    marcus.getRates(E_i,E_j,H_AB,rates);
+    assert(rates.size()==count);
+    for( size_t ind = 0; ind < count; ++ind){
+      double rate = marcus.getRate(E_i[ind],E_j[ind],H_AB[ind]);
+      assert(ulpDistance(rate,rates[ind])<=ulp_tolerance);
+    }
+
+    vector<double> forward_rates;
+    vector<double> reverse_rates;
+    marcus.getForwardAndReverseRates(E_i,E_j,H_AB,forward_rates,reverse_rates);
+    assert(forward_rates.size()==count);
+    assert(reverse_rates.size()==count);
+    for( size_t ind = 0; ind < count; ++ind){
+      assert(forward_rates[ind]==rates[ind]);
+      double rate = marcus.getRate(E_j[ind],E_i[ind],H_AB[ind]);
+      assert(ulpDistance(rate,reverse_rates[ind])<=ulp_tolerance);
+    }
+  }
+
+  cout << "Testing: Marcus getRates full range of the exponent" << endl;
+  {
+    // Chosen so the exponent is -(1 + E_j - E_i)^2, going from 0 down past
+    // the point where exp underflows
+    Marcus marcus(1.0,1.0/(4.0*constants::k_B));
+    const size_t count = 30000;
+    vector<double> E_i(count,0.0);
+    vector<double> E_j(count);
+    vector<double> H_AB(count,1.0);
+    for( size_t ind = 0; ind < count; ++ind){
+      E_j[ind] = -1.0 + static_cast<double>(ind)*0.001;
+    }
+    vector<double> rates;
+    marcus.getRates(E_i,E_j,H_AB,rates);
+    // Rate with an exponent of 0
+    const double pre_factor = marcus.getRate(0.0,-1.0,1.0);
+    bool underflow = false;
+    for( size_t ind = 0; ind < count; ++ind){
+      double rate = marcus.getRate(E_i[ind],E_j[ind],H_AB[ind]);
+      double exponent = (1.0+E_j[ind])*(1.0+E_j[ind]);
+      if(exponent < 708.0){
+        assert(ulpDistance(rate,rates[ind])<=ulp_tolerance);
+      }else{
+        // The exponential is subnormal
+        assert(fabs(rate-rates[ind])<=
+            2.0*pre_factor*numeric_limits<double>::denorm_min());
+      }
+      if(rate==0.0) underflow = true;
+    }
+    assert(underflow);
+  }
+
+  cout << "Testing: Marcus getRates sizes" << endl;
+  {
+    Marcus marcus(0.2,300.0);
+    vector<double> E_i(3,0.0);
+    vector<double> E_j(2,0.0);
+    vector<double> H_AB(3,0.01);
+    vector<double> rates;
+    bool thrown = false;
+    try {
+      marcus.getRates(E_i,E_j,H_AB,rates);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    vector<double> reverse_rates;
+    thrown = false;
+    try {
+      marcus.getForwardAndReverseRates(E_i,E_j,H_AB,rates,reverse_rates);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Nothing to do for empty arrays
+    marcus.getRates(nullptr,nullptr,nullptr,nullptr,0);
+  }
+}
@@ -0,0 +1,209 @@
+
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "mythical/charge_transport/cuboid_lattice.hpp"
+#include "mythical/coarsegrainsystem.hpp"
+#include "mythical/constants.hpp"
+#include "mythical/event_log.hpp"
+#include "mythical/optimistic_scheduler.hpp"
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+using namespace mythical;
+using namespace mythical::charge_transport;
+
+TEST_CASE("Testing: optimistic scheduler","[unit]") {
+
+  // Small periodic lattice so the walkers often block each other
+  Cuboid lattice(6,4,4,1.0,
+      BoundarySetting::Periodic,
+      BoundarySetting::Periodic,
+      BoundarySetting::Periodic);
+
+  unordered_map<int,unordered_map<int,double>> rates;
+  auto distances = lattice.getNeighborDistances(1.01);
+  for(const auto & site_and_neighbors : distances){
+    for(const auto & neighbor : site_and_neighbors.second){
+      // Different rates so the walkers do not all hop at the same pace
+      rates[site_and_neighbors.first][neighbor.first] =
+        1.0+static_cast<double>((site_and_neighbors.first+2*neighbor.first)%5);
+    }
+  }
+
+  auto configure = [&rates](CoarseGrainSystem & system){
+    system.setTimeResolution(0.1);
+    system.setRandomSeed(4);
+    system.setMinCoarseGrainIterationThreshold(constants::inf_iterations);
+    system.initializeSystem(rates);
+  };
+
+  auto add_walkers = [](WalkerPool & walkers){
+    for(int site = 0; site < 96; site+=4){
+      walkers.addWalker(site);
+    }
+  };
+
+  cout << "Testing: OptimisticScheduler setTimeWindow" << endl;
+  {
+    CoarseGrainSystem system;
+    configure(system);
+    OptimisticScheduler scheduler(system,2);
+    assert(scheduler.getNumberOfThreads()==2);
+
+    bool thrown = false;
+    try {
+      scheduler.setTimeWindow(-1.0);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // The window must be set before hopping
+    WalkerPool walkers;
+    add_walkers(walkers);
+    system.initializeWalkers(walkers);
+    thrown = false;
+    try {
+      scheduler.hop(walkers,1.0);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    scheduler.setTimeWindow(0.5);
+    assert(scheduler.getTimeWindow()==0.5);
+  }
+
+  cout << "Testing: OptimisticScheduler unsupported systems" << endl;
+  {
+    CoarseGrainSystem system;
+    system.setRandomPolicy(RandomPolicy::mersenne_twister);
+    configure(system);
+    OptimisticScheduler scheduler(system,1);
+    scheduler.setTimeWindow(0.5);
+    WalkerPool walkers;
+    add_walkers(walkers);
+    system.initializeWalkers(walkers);
+    bool thrown = false;
+    try {
+      scheduler.hop(walkers,1.0);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    CoarseGrainSystem system2;
+    system2.setTimeResolution(0.1);
+    system2.setMinCoarseGrainIterationThreshold(100);
+    system2.initializeSystem(rates);
+    OptimisticScheduler scheduler2(system2,1);
+    scheduler2.setTimeWindow(0.5);
+    thrown = false;
+    try {
+      scheduler2.hop(walkers,1.0);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: OptimisticScheduler hop matches the serial hop" << endl;
+  {
+    const double time_horizon = 20.0;
+
+    for(size_t thread_count = 1; thread_count <= 3; thread_count+=2){
+      CoarseGrainSystem serial_system;
+      configure(serial_system);
+      WalkerPool serial_walkers;
+      add_walkers(serial_walkers);
+      serial_system.initializeWalkers(serial_walkers);
+      size_t serial_hops = serial_system.hop(serial_walkers,time_horizon);
+      assert(serial_hops>0);
+
+      CoarseGrainSystem system;
+      configure(system);
+      WalkerPool walkers;
+      add_walkers(walkers);
+      system.initializeWalkers(walkers);
+
+      OptimisticScheduler scheduler(system,thread_count);
+      scheduler.setTimeWindow(1.0);
+      size_t hops = scheduler.hop(walkers,time_horizon);
+      assert(hops==serial_hops);
+      // The window is long enough that the walkers run into each other
+      assert(scheduler.getNumberOfRollbacks()>0);
+      assert(scheduler.getNumberOfHopsRolledBack()>0);
+
+      for(int walker_id = 0; walker_id < static_cast<int>(walkers.size()); ++walker_id){
+        assert(walkers.getIdOfSiteCurrentlyOccupying(walker_id)==
+            serial_walkers.getIdOfSiteCurrentlyOccupying(walker_id));
+        assert(walkers.getPotentialSite(walker_id)==
+            serial_walkers.getPotentialSite(walker_id));
+        assert(walkers.getTime(walker_id)==serial_walkers.getTime(walker_id));
+      }
+      for(int site = 0; site < 96; ++site){
+        assert(system.isSiteOccupied(site)==serial_system.isSiteOccupied(site));
+      }
+
+      // Carrying on from the same state gives the same result
+      assert(scheduler.hop(walkers,2*time_horizon)==
+          serial_system.hop(serial_walkers,2*time_horizon));
+      assert(walkers.getTimes()==serial_walkers.getTimes());
+    }
+  }
+
+  cout << "Testing: OptimisticScheduler hop records the serial events" << endl;
+  {
+    const double time_horizon = 10.0;
+    const string file_names[2] = {
+      "test_optimistic_scheduler_serial.bin",
+      "test_optimistic_scheduler.bin" };
+    vector<vector<HopEvent>> events(2);
+
+    for(int run = 0; run < 2; ++run){
+      CoarseGrainSystem system;
+      configure(system);
+      WalkerPool walkers;
+      add_walkers(walkers);
+      system.initializeWalkers(walkers);
+      shared_ptr<EventLog> log(new EventLog(file_names[run]));
+      system.setEventLog(log);
+
+      size_t hops;
+      if(run==0){
+        hops = system.hop(walkers,time_horizon);
+      }else{
+        OptimisticScheduler scheduler(system,3);
+        scheduler.setTimeWindow(1.0);
+        hops = scheduler.hop(walkers,time_horizon);
+        assert(scheduler.getNumberOfHopsRolledBack()>0);
+      }
+      log->close();
+
+      EventLogReader reader(file_names[run]);
+      HopEvent event;
+      while(reader.read(event)) events.at(run).push_back(event);
+      assert(events.at(run).size()==hops);
+      remove(file_names[run].c_str());
+    }
+
+    for(size_t index = 0; index < events.at(0).size(); ++index){
+      const HopEvent & serial_event = events.at(0).at(index);
+      const HopEvent & event = events.at(1).at(index);
+      assert(event.walker_id==serial_event.walker_id);
+      assert(event.from_site_id==serial_event.from_site_id);
+      assert(event.to_site_id==serial_event.to_site_id);
+      assert(event.time==serial_event.time);
+      assert(event.in_cluster==serial_event.in_cluster);
+    }
+  }
+}
@@ -0,0 +1,158 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../libmythical/random_stream.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: Random Stream","[unit]"){
+
+  cout << "Testing: philox4x32_10 known answers" << endl;
+  {
+    // Known answer tests from the Random123 library
+    array<uint32_t,4> bits = Random_Stream::philox4x32_10(
+        {{0x00000000,0x00000000,0x00000000,0x00000000}},
+        {{0x00000000,0x00000000}});
+    assert(bits[0]==0x6627e8d5);
+    assert(bits[1]==0xe169c58d);
+    assert(bits[2]==0xbc57ac4c);
+    assert(bits[3]==0x9b00dbd8);
+
+    bits = Random_Stream::philox4x32_10(
+        {{0xffffffff,0xffffffff,0xffffffff,0xffffffff}},
+        {{0xffffffff,0xffffffff}});
+    assert(bits[0]==0x408f276d);
+    assert(bits[1]==0x41c83b0e);
+    assert(bits[2]==0xa20bc7c6);
+    assert(bits[3]==0x6d5451fd);
+
+    bits = Random_Stream::philox4x32_10(
+        {{0x243f6a88,0x85a308d3,0x13198a2e,0x03707344}},
+        {{0xa4093822,0x299f31d0}});
+    assert(bits[0]==0xd16cfe09);
+    assert(bits[1]==0x94fdcceb);
+    assert(bits[2]==0x5001e420);
+    assert(bits[3]==0x24126ea1);
+  }
+
+  cout << "Testing: uniform" << endl;
+  {
+    Random_Stream stream;
+    stream.seed(1,Random_Stream::siteStream(3));
+    double total = 0.0;
+    int samples = 100000;
+    for(int i = 0; i < samples; ++i){
+      double number = stream.uniform();
+      assert(number>0.0);
+      assert(number<=1.0);
+      total += number;
+    }
+    assert(stream.getCounter()==static_cast<uint64_t>(samples));
+    double mean = total/static_cast<double>(samples);
+    assert(mean>0.49 && mean<0.51);
+  }
+
+  cout << "Testing: seed" << endl;
+  {
+    Random_Stream stream1;
+    Random_Stream stream2;
+    Random_Stream stream3;
+    Random_Stream stream4;
+    stream1.seed(5,Random_Stream::siteStream(1));
+    stream2.seed(5,Random_Stream::siteStream(1));
+    stream3.seed(5,Random_Stream::siteStream(2));
+    stream4.seed(5,Random_Stream::clusterStream(1));
+
+    int matches = 0;
+    for(int i = 0; i < 100; ++i){
+      double number1 = stream1.uniform();
+      double number3 = stream3.uniform();
+      double number4 = stream4.uniform();
+      assert(number1==stream2.uniform());
+      if(number1==number3 || number1==number4) ++matches;
+    }
+    assert(matches==0);
+
+    // Reseeding restarts the sequence
+    double first = stream1.uniform();
+    stream1.seed(5,Random_Stream::siteStream(1));
+    stream2.seed(5,Random_Stream::siteStream(1));
+    assert(stream1.uniform()==stream2.uniform());
+    assert(stream1.getCounter()==1);
+    (void) first;
+
+    // Streams seeded from the time should still differ
+    Random_Stream stream5;
+    Random_Stream stream6;
+    assert(stream5.uniform()!=stream6.uniform());
+  }
+
+  cout << "Testing: setStep" << endl;
+  {
+    Random_Stream stream1(9,Random_Stream::walkerStream(4));
+    Random_Stream stream2(9,Random_Stream::walkerStream(4));
+    Random_Stream stream3(9,Random_Stream::walkerStream(4));
+    stream1.setStep(0);
+    stream2.setStep(uint64_t(1) << 32);
+    stream3.setStep(uint64_t(1) << 32);
+    for(int i = 0; i < 10; ++i){
+      double number2 = stream2.uniform();
+      // The whole 64 bits of the step are used
+      assert(stream1.uniform()!=number2);
+      assert(stream3.uniform()==number2);
+    }
+    assert(stream2.getCounter()==10);
+    assert(stream2.getStep()==(uint64_t(1) << 32));
+
+    // Drawing many values in one step does not run into the next step
+    stream1.setStep(1);
+    stream2.setStep(0);
+    stream3.setStep(0);
+    stream3.uniform();
+    double number1 = stream1.uniform();
+    assert(number1!=stream2.uniform());
+    assert(number1!=stream3.uniform());
+
+    // Walker streams of the same seed are different
+    Random_Stream stream4(9,Random_Stream::walkerStream(5));
+    stream1.setStep(3);
+    stream4.setStep(3);
+    assert(stream1.uniform()!=stream4.uniform());
+  }
+
+  cout << "Testing: copy" << endl;
+  {
+    Random_Stream stream1;
+    stream1.seed(7,Random_Stream::siteStream(1));
+    stream1.uniform();
+    Random_Stream stream2(stream1);
+    Random_Stream stream3;
+    stream3 = stream1;
+    double number = stream1.uniform();
+    assert(number==stream2.uniform());
+    assert(number==stream3.uniform());
+  }
+
+  cout << "Testing: mersenne twister policy" << endl;
+  {
+    Random_Stream stream;
+    stream.setPolicy(RandomPolicy::mersenne_twister);
+    assert(stream.getPolicy()==RandomPolicy::mersenne_twister);
+    stream.seed(11,Random_Stream::siteStream(1));
+
+    // Should reproduce the std library engine
+    mt19937 engine(11);
+    uniform_real_distribution<double> distribution(0.0,1.0);
+    for(int i = 0; i < 10; ++i){
+      assert(stream.uniform()==distribution(engine));
+    }
+
+    Random_Stream stream2(stream);
+    assert(stream2.uniform()==stream.uniform());
+  }
+}
@@ -0,0 +1,238 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mythical/charge_transport/cuboid_lattice.hpp"
+#include "mythical/charge_transport/marcus.hpp"
+#include "mythical/charge_transport/rate_file.hpp"
+#include "mythical/coarsegrainsystem.hpp"
+#include "mythical/rate_file.hpp"
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+using namespace mythical;
+using namespace mythical::charge_transport;
+
+TEST_CASE("Testing: rate file","[unit]") {
+
+  const string file_name = "test_rate_file.bin";
+
+  // Site 2 is a drain, it does not have a row of its own
+  vector<int> site_ids = {5, 7};
+  vector<size_t> row_offsets = {0, 2, 3};
+  vector<int> neighbor_ids = {7, 2, 5};
+  vector<double> rates = {1.0, 0.5, 2.0};
+  vector<double> energies = {0.1, -0.2};
+
+  cout << "Testing: RateFileWriter and RateFileReader" << endl;
+  {
+    RateFileWriter writer(file_name,2,3,false,true);
+    writer.writeSiteIds(site_ids.data(),2);
+    // Arrays may be written in pieces
+    writer.writeRowOffsets(row_offsets.data(),1);
+    writer.writeRowOffsets(row_offsets.data()+1,2);
+    writer.writeNeighborIds(neighbor_ids.data(),3);
+    writer.writeRates(rates.data(),2);
+    writer.writeRates(rates.data()+2,1);
+    writer.writeEnergies(energies.data(),2);
+    writer.close();
+
+    RateFileReader reader(file_name);
+    assert(reader.getNumberOfSites()==2);
+    assert(reader.getNumberOfRates()==3);
+    assert(!reader.hasPositions());
+    assert(reader.getPositions()==nullptr);
+    assert(reader.hasEnergies());
+    for(size_t index = 0; index < 2; ++index){
+      assert(reader.getSiteIds()[index]==site_ids[index]);
+      assert(reader.getEnergies()[index]==energies[index]);
+    }
+    for(size_t index = 0; index < 3; ++index){
+      assert(reader.getRowOffsets()[index]==row_offsets[index]);
+      assert(reader.getNeighborIds()[index]==neighbor_ids[index]);
+      assert(reader.getRates()[index]==rates[index]);
+    }
+  }
+
+  cout << "Testing: RateFileWriter errors" << endl;
+  {
+    RateFileWriter writer(file_name,2,3,false,false);
+    // Rates before the site ids
+    bool thrown = false;
+    try {
+      writer.writeRates(rates.data(),3);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // More site ids than were declared
+    thrown = false;
+    try {
+      writer.writeSiteIds(neighbor_ids.data(),3);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    writer.writeSiteIds(site_ids.data(),2);
+    // Not all of the arrays have been written
+    thrown = false;
+    try {
+      writer.close();
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: RateFileReader errors" << endl;
+  {
+    // Row offsets that do not cover the rates
+    vector<size_t> bad_offsets = {0, 2, 2};
+    {
+      RateFileWriter writer(file_name,2,3,false,false);
+      writer.writeSiteIds(site_ids.data(),2);
+      writer.writeRowOffsets(bad_offsets.data(),3);
+      writer.writeNeighborIds(neighbor_ids.data(),3);
+      writer.writeRates(rates.data(),3);
+      writer.close();
+    }
+    bool thrown = false;
+    try {
+      RateFileReader reader(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Not a rate file
+    {
+      ofstream file(file_name,ios::binary|ios::trunc);
+      file << "MYTHSNAP0123456789abcdef";
+    }
+    thrown = false;
+    try {
+      RateFileReader reader(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: CoarseGrainSystem initializeSystemFromFile" << endl;
+  {
+    Cuboid lattice(6,5,4,1.0,
+        BoundarySetting::Periodic,
+        BoundarySetting::Periodic,
+        BoundarySetting::Fixed);
+    Marcus marcus(0.2,300.0);
+    mt19937 generator(3);
+    normal_distribution<double> distribution(0.0,0.05);
+    vector<double> site_energies(6*5*4);
+    for(double & energy : site_energies) energy = distribution(generator);
+    auto coupling = [](const double distance){ return 0.01*exp(-distance); };
+
+    writeRateFile(file_name,lattice,marcus,site_energies,1.5,coupling,2);
+
+    vector<size_t> lattice_offsets;
+    vector<int> lattice_neighbors;
+    vector<double> distances;
+    lattice.getNeighborDistances(1.5,lattice_offsets,lattice_neighbors,distances,1);
+    // The file stores the neighbors of each row in order
+    for(size_t site = 0; site+1 < lattice_offsets.size(); ++site){
+      vector<pair<int,double>> row;
+      for(size_t ind = lattice_offsets[site]; ind < lattice_offsets[site+1]; ++ind){
+        row.emplace_back(lattice_neighbors[ind],distances[ind]);
+      }
+      sort(row.begin(),row.end());
+      for(size_t ind = lattice_offsets[site]; ind < lattice_offsets[site+1]; ++ind){
+        lattice_neighbors[ind] = row[ind-lattice_offsets[site]].first;
+        distances[ind] = row[ind-lattice_offsets[site]].second;
+      }
+    }
+    vector<double> lattice_rates;
+    for(size_t site = 0; site+1 < lattice_offsets.size(); ++site){
+      for(size_t ind = lattice_offsets[site]; ind < lattice_offsets[site+1]; ++ind){
+        lattice_rates.push_back(marcus.getRate(
+              site_energies[site],
+              site_energies[static_cast<size_t>(lattice_neighbors[ind])],
+              coupling(distances[ind])));
+      }
+    }
+
+    {
+      RateFileReader reader(file_name);
+      assert(reader.getNumberOfSites()==site_energies.size());
+      assert(reader.getNumberOfRates()==lattice_rates.size());
+      assert(reader.hasPositions());
+      const double * positions = reader.getPositions();
+      for(int site = 0; site < static_cast<int>(site_energies.size()); ++site){
+        assert(reader.getSiteIds()[site]==site);
+        assert(positions[3*site]==lattice.getX(site));
+        assert(positions[3*site+1]==lattice.getY(site));
+        assert(positions[3*site+2]==lattice.getZ(site));
+        assert(reader.getEnergies()[site]==site_energies[site]);
+      }
+      for(size_t site = 0; site < site_energies.size(); ++site){
+        assert(reader.getRowOffsets()[site+1]==lattice_offsets[site+1]);
+      }
+      for(size_t ind = 0; ind < lattice_rates.size(); ++ind){
+        assert(reader.getNeighborIds()[ind]==lattice_neighbors[ind]);
+        double difference = fabs(reader.getRates()[ind]-lattice_rates[ind]);
+        assert(difference<=1E-14*lattice_rates[ind]);
+      }
+    }
+
+    // The same trajectory as a system given the same rates in memory
+    CoarseGrainSystem from_file;
+    from_file.setTimeResolution(1E-9);
+    from_file.setRandomSeed(2);
+    from_file.initializeSystemFromFile(file_name);
+
+    RateFileReader reader(file_name);
+    CoarseGrainSystem from_memory;
+    from_memory.setTimeResolution(1E-9);
+    from_memory.setRandomSeed(2);
+    from_memory.initializeSystem(
+        lattice_offsets,
+        lattice_neighbors,
+        vector<double>(reader.getRates(),reader.getRates()+reader.getNumberOfRates()));
+
+    WalkerPool walkers1;
+    WalkerPool walkers2;
+    for(int site = 0; site < 120; site+=17){
+      walkers1.addWalker(site);
+      walkers2.addWalker(site);
+    }
+    from_file.initializeWalkers(walkers1);
+    from_memory.initializeWalkers(walkers2);
+    size_t hops = from_file.hop(walkers1,1E-10);
+    assert(hops>0);
+    assert(from_memory.hop(walkers2,1E-10)==hops);
+    assert(walkers1.getIdsOfSitesCurrentlyOccupying()==
+        walkers2.getIdsOfSitesCurrentlyOccupying());
+    assert(walkers1.getTimes()==walkers2.getTimes());
+
+    // The time resolution must be set first
+    CoarseGrainSystem unset;
+    bool thrown = false;
+    try {
+      unset.initializeSystemFromFile(file_name);
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  remove(file_name.c_str());
+}
@@ -0,0 +1,252 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "../../libmythical/rate_graph.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: Rate Graph","[unit]"){
+
+  cout << "Testing: Constructor" << endl;
+  {
+    Rate_Graph rate_graph;
+    assert(rate_graph.size()==0);
+    assert(rate_graph.getNumberOfRates()==0);
+  }
+
+  cout << "Testing: Constructor from map" << endl;
+  {
+    unordered_map<int,unordered_map<int,double>> rates;
+    rates[1][4] = 1.0;
+    rates[1][2] = 2.0;
+    rates[2][1] = 3.0;
+    rates[2][3] = 4.0;
+
+    Rate_Graph rate_graph(rates);
+    // Site 3 and 4 are drains and should have been given empty rows
+    assert(rate_graph.size()==4);
+    assert(rate_graph.getNumberOfRates()==4);
+    assert(rate_graph.exist(3));
+    assert(rate_graph.exist(4));
+    assert(rate_graph.exist(5)==false);
+
+    int index = rate_graph.getIndex(1);
+    assert(rate_graph.getSiteId(index)==1);
+    Rate_View view = rate_graph.getRates(index);
+    assert(view.size()==2);
+    // Neighbors are sorted
+    assert(view.neighborId(0)==2);
+    assert(view.neighborId(1)==4);
+    assert(view.rate(0)==2.0);
+    assert(view.rate(1)==1.0);
+
+    assert(rate_graph.getRates(rate_graph.getIndex(3)).size()==0);
+    assert(rate_graph.getRate(rate_graph.getIndex(2),3)==4.0);
+    assert(rate_graph.findNeighbor(rate_graph.getIndex(2),4)==-1);
+
+    bool throw_error = false;
+    try {
+      rate_graph.getRate(rate_graph.getIndex(2),4);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+
+    throw_error = false;
+    try {
+      rate_graph.getIndex(5);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: Constructor from compressed sparse row arrays" << endl;
+  {
+    vector<int> site_ids = { 0, 1, 2 };
+    vector<size_t> row_offsets = { 0, 1, 3, 4 };
+    vector<int> neighbor_ids = { 1, 2, 0, 1 };
+    vector<double> rates = { 1.0, 2.0, 3.0, 4.0 };
+
+    Rate_Graph rate_graph(site_ids,row_offsets,neighbor_ids,rates);
+    assert(rate_graph.size()==3);
+    Rate_View view = rate_graph.getRates(rate_graph.getIndex(1));
+    assert(view.size()==2);
+    assert(view.neighborId(0)==0);
+    assert(view.rate(0)==3.0);
+    assert(view.neighborId(1)==2);
+    assert(view.rate(1)==2.0);
+
+    // Offsets do not match the number of rates
+    vector<size_t> bad_offsets = { 0, 1, 3, 5 };
+    bool throw_error = false;
+    try {
+      Rate_Graph bad_graph(site_ids,bad_offsets,neighbor_ids,rates);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+
+    // Negative rates are not allowed
+    vector<double> bad_rates = { 1.0, -2.0, 3.0, 4.0 };
+    throw_error = false;
+    try {
+      Rate_Graph bad_graph(site_ids,row_offsets,neighbor_ids,bad_rates);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+
+    // Duplicate neighbors are not allowed
+    vector<int> bad_neighbor_ids = { 1, 2, 2, 1 };
+    throw_error = false;
+    try {
+      Rate_Graph bad_graph(site_ids,row_offsets,bad_neighbor_ids,rates);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: Constructor from arrays read in place" << endl;
+  {
+    const vector<int> site_ids = { 0, 1, 2 };
+    const vector<size_t> row_offsets = { 0, 1, 3, 4 };
+    const vector<int> neighbor_ids = { 1, 0, 2, 1 };
+    const vector<double> rates = { 1.0, 3.0, 2.0, 4.0 };
+    shared_ptr<int> storage(new int(0));
+
+    Rate_Graph rate_graph(storage,site_ids.data(),row_offsets.data(),
+        neighbor_ids.data(),rates.data(),site_ids.size());
+    assert(rate_graph.usesArraysInPlace());
+    assert(storage.use_count()==2);
+    assert(rate_graph.getIndex(2)==2);
+    assert(!rate_graph.exist(3));
+    Rate_View view = rate_graph.getRates(1);
+    assert(view.neighbor_ids==neighbor_ids.data()+1);
+    assert(view.rates==rates.data()+1);
+    assert(rate_graph.getTimeConstant(1)==0.2);
+
+    // Rows out of order are copied and sorted
+    const vector<int> unsorted_ids = { 1, 2, 0, 1 };
+    Rate_Graph unsorted_graph(storage,site_ids.data(),row_offsets.data(),
+        unsorted_ids.data(),rates.data(),site_ids.size());
+    assert(!unsorted_graph.usesArraysInPlace());
+    assert(storage.use_count()==2);
+    view = unsorted_graph.getRates(1);
+    assert(view.neighborId(0)==0);
+    assert(view.rate(0)==2.0);
+    assert(view.neighborId(1)==2);
+    assert(view.rate(1)==3.0);
+
+    // As are rows with a neighbor that has no row of its own
+    const vector<int> drain_ids = { 1, 0, 3, 1 };
+    Rate_Graph drain_graph(storage,site_ids.data(),row_offsets.data(),
+        drain_ids.data(),rates.data(),site_ids.size());
+    assert(!drain_graph.usesArraysInPlace());
+    assert(drain_graph.size()==4);
+    assert(drain_graph.getRates(drain_graph.getIndex(3)).size()==0);
+
+    // Site ids that are not consecutive are still found
+    const vector<int> sparse_site_ids = { 0, 1, 5 };
+    const vector<int> sparse_neighbor_ids = { 1, 0, 5, 1 };
+    Rate_Graph sparse_graph(storage,sparse_site_ids.data(),row_offsets.data(),
+        sparse_neighbor_ids.data(),rates.data(),site_ids.size());
+    assert(sparse_graph.usesArraysInPlace());
+    assert(sparse_graph.getIndex(5)==2);
+    assert(!sparse_graph.exist(2));
+
+    const vector<double> bad_rates = { 1.0, 3.0, 0.0, 4.0 };
+    bool throw_error = false;
+    try {
+      Rate_Graph bad_graph(storage,site_ids.data(),row_offsets.data(),
+          neighbor_ids.data(),bad_rates.data(),site_ids.size());
+    }catch(invalid_argument & e){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
+
+  cout << "Testing: hop tables" << endl;
+  {
+    unordered_map<int,unordered_map<int,double>> rates;
+    rates[1][2] = 1.0;
+    rates[1][3] = 3.0;
+    rates[2][1] = 2.0;
+
+    Rate_Graph rate_graph(rates);
+    int index = rate_graph.getIndex(1);
+    assert(rate_graph.getTimeConstant(index)==0.25);
+    const double * probabilities = rate_graph.getProbabilities(index);
+    assert(probabilities[0]==0.25);
+    assert(probabilities[1]==0.75);
+    assert(rate_graph.getTimeConstant(rate_graph.getIndex(2))==0.5);
+    assert(rate_graph.getProbabilities(rate_graph.getIndex(2))[0]==1.0);
+    // Drains
+    assert(rate_graph.getTimeConstant(rate_graph.getIndex(3))==0.0);
+
+    // The neighbor is picked in proportion to the rates
+    vector<int> count(2,0);
+    for( int ind = 1; ind <= 1000; ++ind){
+      double number = (static_cast<double>(ind)-0.5)/1000.0;
+      ++count.at(rate_graph.sampleNeighbor(index,number));
+    }
+    assert(count.at(0)==250);
+    assert(count.at(1)==750);
+  }
+
+  cout << "Testing: single row graph" << endl;
+  {
+    vector<int> neighbor_ids = { 2, 5 };
+    vector<double> rates = { 1.0, 3.0 };
+    auto rate_graph = Rate_Graph::createSingleRow(
+        7,Rate_View{neighbor_ids.data(),rates.data(),neighbor_ids.size()});
+    // The neighbors do not get rows of their own
+    assert(rate_graph->isSingleRow());
+    assert(rate_graph->size()==1);
+    assert(rate_graph->getSiteId(0)==7);
+    assert(rate_graph->getTimeConstant(0)==0.25);
+
+    // New neighbors are merged into the row in order, existing ones changed
+    rate_graph->setRates({{4,2.0},{2,2.0},{1,2.0}});
+    Rate_View view = rate_graph->getRates(0);
+    assert(view.size()==4);
+    assert(view.neighborId(0)==1);
+    assert(view.neighborId(1)==2);
+    assert(view.neighborId(2)==4);
+    assert(view.neighborId(3)==5);
+    assert(rate_graph->getRate(0,2)==2.0);
+    assert(rate_graph->getRate(0,5)==3.0);
+    assert(rate_graph->getNumberOfRates()==4);
+    assert(rate_graph->getTimeConstant(0)==1.0/9.0);
+    assert(rate_graph->getProbabilities(0)[3]==3.0/9.0);
+
+    bool thrown = false;
+    try {
+      rate_graph->setRates({{3,-1.0}});
+    }catch(const invalid_argument &){
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Other graphs can be shared so they can not be changed
+    unordered_map<int,unordered_map<int,double>> map_rates;
+    map_rates[1][2] = 1.0;
+    Rate_Graph shared_graph(map_rates);
+    assert(!shared_graph.isSingleRow());
+    thrown = false;
+    try {
+      shared_graph.setRates({{3,1.0}});
+    }catch(const runtime_error &){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}
@@ -0,0 +1,144 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "mythical/coarsegrainsystem.hpp"
+#include "mythical/replica_ensemble.hpp"
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: replica ensemble","[unit]") {
+
+  // Ring of 6 sites, the walkers are trapped between sites 2 and 3 for long
+  // enough to form a cluster
+  vector<size_t> row_offsets = { 0, 2, 4, 6, 8, 10, 12 };
+  vector<int> neighbor_ids = { 5, 1, 0, 2, 1, 3, 2, 4, 3, 5, 4, 0 };
+  vector<double> rates = { 1.0, 1.0, 1.0, 1.0, 1.0, 1000.0,
+                           1000.0, 1.0, 1.0, 1.0, 1.0, 1.0 };
+
+  auto configure = [](const size_t replica, CoarseGrainSystem & system){
+    system.setTimeResolution(0.1);
+    system.setMinCoarseGrainIterationThreshold(100);
+    system.setRandomSeed(static_cast<unsigned long>(replica+1));
+  };
+
+  // The number of hops made and whether the walker is in the trap
+  auto sample_function = [](
+      vector<WalkerPool> & pools,
+      const size_t replica,
+      const size_t sample,
+      CoarseGrainSystem & system,
+      vector<double> & observables){
+    double time_horizon = 10.0*static_cast<double>(sample+1);
+    size_t hops = system.hop(pools.at(replica),time_horizon);
+    int siteId = pools.at(replica).getIdOfSiteCurrentlyOccupying(0);
+    observables.push_back(static_cast<double>(hops));
+    observables.push_back(siteId==2 || siteId==3 ? 1.0 : 0.0);
+  };
+
+  const size_t replica_count = 4;
+  const size_t sample_count = 20;
+
+  cout << "Testing: ReplicaEnsemble constructor" << endl;
+  {
+    ReplicaEnsemble ensemble(replica_count,2);
+    assert(ensemble.size()==replica_count);
+    assert(ensemble.getNumberOfThreads()==2);
+
+    ReplicaEnsemble ensemble2(1);
+    assert(ensemble2.getNumberOfThreads()>0);
+
+    bool thrown = false;
+    try {
+      ReplicaEnsemble ensemble3(0);
+    }catch(invalid_argument & e){
+      thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+      ensemble.getReplica(replica_count);
+    }catch(out_of_range & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: ReplicaEnsemble run" << endl;
+  {
+    // Independent systems run one after the other
+    vector<vector<double>> expected(sample_count,vector<double>(2,0.0));
+    {
+      vector<WalkerPool> pools(replica_count);
+      for(size_t replica = 0; replica < replica_count; ++replica){
+        CoarseGrainSystem system;
+        configure(replica,system);
+        system.initializeSystem(row_offsets,neighbor_ids,rates);
+        pools.at(replica).addWalker(2);
+        system.initializeWalkers(pools.at(replica));
+        for(size_t sample = 0; sample < sample_count; ++sample){
+          vector<double> observables;
+          sample_function(pools,replica,sample,system,observables);
+          expected.at(sample).at(0) += observables.at(0);
+          expected.at(sample).at(1) += observables.at(1);
+        }
+        // Every system numbers its own clusters from 0
+        auto clusters = system.getClusters();
+        assert(clusters.size()==1);
+        assert(clusters.count(0)==1);
+      }
+    }
+
+    for(size_t thread_count = 1; thread_count < 4; thread_count+=2){
+      ReplicaEnsemble ensemble(replica_count,thread_count);
+      ensemble.initializeSystems(row_offsets,neighbor_ids,rates,configure);
+
+      vector<WalkerPool> pools(replica_count);
+      ensemble.forEachReplica([&pools](const size_t replica, CoarseGrainSystem & system){
+          pools.at(replica).addWalker(2);
+          system.initializeWalkers(pools.at(replica));
+          });
+
+      auto results = ensemble.run(sample_count,[&](
+            const size_t replica,
+            const size_t sample,
+            CoarseGrainSystem & system,
+            vector<double> & observables){
+          sample_function(pools,replica,sample,system,observables);
+          });
+
+      assert(results.size()==sample_count);
+      assert(results==expected);
+      for(size_t replica = 0; replica < replica_count; ++replica){
+        auto clusters = ensemble.getReplica(replica).getClusters();
+        assert(clusters.size()==1);
+        assert(clusters.count(0)==1);
+      }
+    }
+  }
+
+  cout << "Testing: ReplicaEnsemble mismatched observables" << endl;
+  {
+    ReplicaEnsemble ensemble(2,2);
+    ensemble.initializeSystems(row_offsets,neighbor_ids,rates,configure);
+    bool thrown = false;
+    try {
+      ensemble.run(1,[](
+            const size_t replica,
+            const size_t,
+            CoarseGrainSystem &,
+            vector<double> & observables){
+          observables.assign(replica+1,1.0);
+          });
+    }catch(runtime_error & e){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}
@@ -53,6 +53,26 @@ TEST_CASE("Testing: Site","[unit]"){
     
     Site site;
     site.setRatesToNeighbors(neighRates);
+
+    // The rates stored before are kept, only the rate to 2 is overwritten
+    unordered_map< int, double> moreRates;
+    moreRates[2]=50;
+    moreRates[5]=20;
+    site.setRatesToNeighbors(moreRates);
+    assert(site.getNumberOfNeighbors()==5);
+    assert(static_cast<int>(site.getRateToNeighbor(1))==400);
+    assert(static_cast<int>(site.getRateToNeighbor(2))==50);
+    assert(static_cast<int>(site.getRateToNeighbor(4))==1);
+    assert(static_cast<int>(site.getRateToNeighbor(5))==20);
+
+    // A copy of the site keeps its rates when the site is changed
+    Site copy = site;
+    unordered_map< int, double> changedRates;
+    changedRates[1]=100;
+    site.setRatesToNeighbors(changedRates);
+    assert(static_cast<int>(site.getRateToNeighbor(1))==100);
+    assert(static_cast<int>(copy.getRateToNeighbor(1))==400);
+    assert(copy.getNumberOfNeighbors()==5);
   }
 
   cout << "Testing: getRateToNeighbor" << endl;
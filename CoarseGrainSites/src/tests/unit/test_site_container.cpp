@@ -243,4 +243,36 @@ TEST_CASE("Testing: Site Container","[unit]"){
     assert(site_container.getRateToNeighborOfSite(2,1)==rate2_1);
 
   }
+
+  cout << "Testing: getIndex" << endl;
+  {
+    // Consecutive ids
+    Site_Container site_container;
+    for( int siteId = 3; siteId < 6; ++siteId){
+      Site site;
+      site.setId(siteId);
+      site_container.addSite(site);
+    }
+    assert(site_container.getIndex(3)==0);
+    assert(site_container.getIndex(5)==2);
+    assert(site_container.getSiteByIndex(1).getId()==4);
+    assert(site_container.exist(6)==false);
+    assert(site_container.exist(2)==false);
+
+    // Adding a site that breaks the consecutive ordering 
+    Site site;
+    site.setId(10);
+    site_container.addSite(site);
+    assert(site_container.getIndex(10)==3);
+    assert(site_container.getIndex(4)==1);
+    assert(site_container.exist(6)==false);
+
+    bool throw_error = false;
+    try {
+      site_container.getIndex(6);
+    }catch(...){
+      throw_error = true;
+    }
+    assert(throw_error);
+  }
 }
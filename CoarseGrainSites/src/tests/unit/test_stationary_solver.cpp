@@ -0,0 +1,167 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "../../libmythical/stationary_solver.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: Stationary Solver","[unit]"){
+
+  cout << "Testing: three state chain" << endl;
+  {
+    // state0 -> state1 -> state2
+    //        <-        <-
+    // Detailed balance gives pi0*2 = pi1*1 and pi1*3 = pi2*1
+    vector<size_t> row_offsets = { 0, 1, 3, 4 };
+    vector<int> columns = { 1, 0, 2, 1 };
+    vector<double> rates = { 2.0, 1.0, 3.0, 1.0 };
+
+    Stationary_Solver solver;
+    assert(solver.solve(row_offsets,columns,rates));
+    const vector<double> & pi = solver.getSolution();
+    assert(pi.size()==3);
+    assert(fabs(pi.at(0)-1.0/9.0)<1E-12);
+    assert(fabs(pi.at(1)-2.0/9.0)<1E-12);
+    assert(fabs(pi.at(2)-6.0/9.0)<1E-12);
+
+    // GMRES should give the same answer
+    solver.setDenseThreshold(0);
+    assert(solver.solve(row_offsets,columns,rates));
+    assert(fabs(solver.getSolution().at(0)-1.0/9.0)<1E-10);
+    assert(fabs(solver.getSolution().at(2)-6.0/9.0)<1E-10);
+  }
+
+  cout << "Testing: single state" << endl;
+  {
+    Stationary_Solver solver;
+    assert(solver.solve({0,0},{},{}));
+    assert(solver.getSolution().at(0)==1.0);
+  }
+
+  cout << "Testing: chain without a unique stationary distribution" << endl;
+  {
+    // Two disconnected pairs of states
+    vector<size_t> row_offsets = { 0, 1, 2, 3, 4 };
+    vector<int> columns = { 1, 0, 3, 2 };
+    vector<double> rates = { 1.0, 1.0, 1.0, 1.0 };
+
+    Stationary_Solver solver;
+    assert(solver.solve(row_offsets,columns,rates)==false);
+  }
+
+  cout << "Testing: invalid arguments" << endl;
+  {
+    Stationary_Solver solver;
+    bool thrown = false;
+    try {
+      solver.solve({0},{},{});
+    }catch(...){
+      thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+      solver.solve({0,1,2},{1,5},{1.0,1.0});
+    }catch(...){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  cout << "Testing: large ring dense and GMRES agree" << endl;
+  {
+    // Ring of states with uneven rates in each direction
+    const int count = 400;
+    vector<size_t> row_offsets(1,0);
+    vector<int> columns;
+    vector<double> rates;
+    for(int state = 0; state < count; ++state){
+      columns.push_back((state+1)%count);
+      rates.push_back(1.0+static_cast<double>(state%7));
+      columns.push_back((state+count-1)%count);
+      rates.push_back(2.0+static_cast<double>(state%5));
+      row_offsets.push_back(columns.size());
+    }
+
+    Stationary_Solver gmres;
+    assert(gmres.solve(row_offsets,columns,rates));
+
+    Stationary_Solver dense;
+    dense.setDenseThreshold(count+1);
+    assert(dense.solve(row_offsets,columns,rates));
+
+    double total = 0.0;
+    for(int state = 0; state < count; ++state){
+      total += gmres.getSolution().at(state);
+      assert(fabs(gmres.getSolution().at(state)-dense.getSolution().at(state))<1E-9);
+    }
+    assert(fabs(total-1.0)<1E-12);
+
+    // A good initial guess is also accepted
+    assert(gmres.solve(row_offsets,columns,rates,dense.getSolution()));
+    assert(fabs(gmres.getSolution().at(17)-dense.getSolution().at(17))<1E-9);
+  }
+
+  cout << "Testing: quasi-stationary two state chain" << endl;
+  {
+    // state0 -> state1 with probability 0.5, state1 -> state0 with 0.8, the
+    // rest is lost. P^T p = lambda p gives lambda = sqrt(0.4) and
+    // p0/p1 = 0.8/lambda = sqrt(1.6)
+    vector<size_t> row_offsets = { 0, 1, 2 };
+    vector<int> columns = { 1, 0 };
+    vector<double> probabilities = { 0.5, 0.8 };
+
+    Stationary_Solver solver;
+    assert(solver.solveQuasiStationary(row_offsets,columns,probabilities));
+    const vector<double> & p = solver.getSolution();
+    assert(p.size()==2);
+    double ratio = sqrt(1.6);
+    assert(fabs(p.at(0)-ratio/(1.0+ratio))<1E-10);
+    assert(fabs(p.at(1)-1.0/(1.0+ratio))<1E-10);
+
+    // Nothing is lost so there is no quasi-stationary distribution to find
+    vector<double> closed = { 1.0, 1.0 };
+    assert(solver.solveQuasiStationary(row_offsets,columns,closed)==false);
+  }
+
+  cout << "Testing: large leaky ring dense and GMRES agree" << endl;
+  {
+    // Ring of states where every tenth state loses a little probability, the
+    // walker goes round the ring many times before it is lost
+    const int count = 400;
+    vector<size_t> row_offsets(1,0);
+    vector<int> columns;
+    vector<double> probabilities;
+    for(int state = 0; state < count; ++state){
+      double forward = 1.0+static_cast<double>(state%7);
+      double backward = 2.0+static_cast<double>(state%5);
+      double lost = state%10==0 ? 1E-3 : 0.0;
+      double total = forward+backward+lost;
+      columns.push_back((state+1)%count);
+      probabilities.push_back(forward/total);
+      columns.push_back((state+count-1)%count);
+      probabilities.push_back(backward/total);
+      row_offsets.push_back(columns.size());
+    }
+
+    Stationary_Solver gmres;
+    assert(gmres.solveQuasiStationary(row_offsets,columns,probabilities));
+
+    Stationary_Solver dense;
+    dense.setDenseThreshold(count+1);
+    assert(dense.solveQuasiStationary(row_offsets,columns,probabilities));
+
+    double total = 0.0;
+    for(int state = 0; state < count; ++state){
+      total += gmres.getSolution().at(state);
+      assert(fabs(gmres.getSolution().at(state)-dense.getSolution().at(state))<1E-9);
+    }
+    assert(fabs(total-1.0)<1E-12);
+  }
+}
@@ -0,0 +1,72 @@
+#include <catch2/catch.hpp>
+
+#include <cassert>
+#include <iostream>
+
+#include "mythical/constants.hpp"
+#include "mythical/walker_pool.hpp"
+
+using namespace std;
+using namespace mythical;
+
+TEST_CASE("Testing: walker pool","[unit]") {
+
+  cout << "Testing: WalkerPool constructor" << endl;
+  { 
+    WalkerPool walkers; 
+    assert(walkers.size()==0);
+    assert(walkers.countActiveWalkers()==0);
+  }
+
+  cout << "Testing: WalkerPool addWalker" << endl;
+  {
+    WalkerPool walkers;
+    int walker_id = walkers.addWalker(3);
+    assert(walker_id==0);
+    walker_id = walkers.addWalker(5,2.0);
+    assert(walker_id==1);
+    assert(walkers.size()==2);
+
+    assert(walkers.getIdOfSiteCurrentlyOccupying(0)==3);
+    assert(walkers.getIdOfSiteCurrentlyOccupying(1)==5);
+    assert(walkers.getPotentialSite(1)==constants::unassignedId);
+    assert(walkers.getDwellTime(1)==0.0);
+    assert(walkers.getTime(0)==0.0);
+    assert(walkers.getTime(1)==2.0);
+
+    // The walkers are only active once initialized by CoarseGrainSystem
+    assert(walkers.isActive(0)==false);
+    assert(walkers.countActiveWalkers()==0);
+  }
+
+  cout << "Testing: WalkerPool arrays" << endl;
+  {
+    WalkerPool walkers;
+    walkers.addWalker(3,1.0);
+    walkers.addWalker(4,2.0);
+    walkers.addWalker(7,3.0);
+    assert(walkers.getIdsOfSitesCurrentlyOccupying().size()==3);
+    assert(walkers.getIdsOfSitesCurrentlyOccupying().at(2)==7);
+    assert(walkers.getPotentialSites().size()==3);
+    assert(walkers.getDwellTimes().size()==3);
+    assert(walkers.getTimes().at(1)==2.0);
+  }
+
+  cout << "Testing: WalkerPool placeWalker" << endl;
+  {
+    WalkerPool walkers;
+    walkers.addWalker(3,1.0);
+    walkers.placeWalker(0,8,4.0);
+    assert(walkers.getIdOfSiteCurrentlyOccupying(0)==8);
+    assert(walkers.getTime(0)==4.0);
+    assert(walkers.size()==1);
+
+    bool thrown = false;
+    try {
+      walkers.placeWalker(1,8,4.0);
+    }catch(...){
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}
@@ -1,5 +1,5 @@
 
-#include <mythical/queue.hpp>
+#include <mythical/indexed_queue.hpp>
 #include <mythical/walker.hpp>
 #include <mythical/charge_transport/cubic_lattice.hpp>
 #include <mythical/charge_transport/marcus.hpp>
@@ -18,7 +18,6 @@ using namespace std;
 namespace my = mythical;
 namespace myct = mythical::charge_transport;
 
-typedef std::pair<int,double> element_t;
 typedef std::pair<int,shared_ptr<my::Walker>> walker_t;
 
 std::vector<double> generateSiteEnergies(const size_t & total_num_sites) {
@@ -98,9 +97,9 @@ vector<walker_t> populateLattice(size_t num_charges, myct::Cubic & lattice ) {
   return holes;
 }
 
-my::Queue createQueue(const vector<walker_t> & holes, double cutoff_time) {
+my::IndexedQueue createQueue(const vector<walker_t> & holes, double cutoff_time) {
   std::cout << "- Creating queue for holes." << std::endl;
-  my::Queue walker_global_times;
+  my::IndexedQueue walker_global_times;
   mt19937 random_number_generator;
   random_number_generator.seed(4);
   uniform_real_distribution<double> distribution(0.0,1.0);
@@ -108,7 +107,6 @@ my::Queue createQueue(const vector<walker_t> & holes, double cutoff_time) {
   for(size_t walker_index=0; walker_index < holes.size(); ++walker_index){
     walker_global_times.add(pair<int,double>(walker_index,holes.at(walker_index).second->getDwellTime()));
   }
-  walker_global_times.sort();
   assert(walker_global_times.at(0).second<cutoff_time);
 
   return walker_global_times;
@@ -171,7 +169,7 @@ int main() {
   CGsystem.initializeSystem(rates);
   CGsystem.initializeWalkers(holes);
 
-  my::Queue walker_global_times = createQueue(holes, cutoff_time);
+  my::IndexedQueue walker_global_times = createQueue(holes, cutoff_time);
   vector<double> transient_current;
   vector<double> charges_left;
   transient_current.reserve(300*2);
@@ -184,26 +182,17 @@ int main() {
   const double volume = static_cast<double>(len*wid*hei) * nm_to_cm*nm_to_cm*nm_to_cm;
   while(walker_global_times.size() && walker_global_times.at(0).second<cutoff_time){
     double deltaX = 0.0;
-    while(walker_global_times.size() && walker_global_times.at(0).second < sample_time){
-      element_t walker_time = walker_global_times.pop_current();
-      std::shared_ptr<my::Walker>& hole = holes.at(walker_time.first).second;
-      int siteId = hole->getIdOfSiteCurrentlyOccupying();
-      const int old_x_pos = lattice.getX(siteId);
-      CGsystem.hop(walker_time.first,hole);
-      siteId = hole->getIdOfSiteCurrentlyOccupying();
-      const int new_x_pos = lattice.getX(siteId);
-      deltaX+=static_cast<double>(new_x_pos-old_x_pos);
-      // Update the dwell time
-      walker_time.second += hole->getDwellTime();
-      // reorder the walkers based on which one will move next
-      if(new_x_pos < lattice.getLength()-1){
-        walker_global_times.sortedAdd(walker_time);
-      } else {
-        std::cout << "- Removing walker " << walker_time.first << " time " << walker_time.second << std::endl;
-        CGsystem.removeWalkerFromSystem(walker_time.first,hole);
-        --charges_remain;
-      }
-    }
+    CGsystem.hop(holes,walker_global_times,sample_time,
+        [&](const int walker_id, const int previous_site_id, my::Walker & hole, const double time){
+          const int old_x_pos = lattice.getX(previous_site_id);
+          const int new_x_pos = lattice.getX(hole.getIdOfSiteCurrentlyOccupying());
+          deltaX+=static_cast<double>(new_x_pos-old_x_pos);
+          // Walkers reaching the end of the lattice are removed
+          if(new_x_pos < lattice.getLength()-1) return true;
+          std::cout << "- Removing walker " << walker_id << " time " << time << std::endl;
+          --charges_remain;
+          return false;
+        });
     // Current Density velocity of charges * current_density [ J/cm^2 ]
     const double num_charges = static_cast<double>(walker_global_times.size());
     const double avg_velocity = deltaX*nm_to_cm / (num_charges*current_time_sample_increment); 